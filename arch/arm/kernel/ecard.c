@@ -309,8 +309,7 @@ ecard_task(void * unused)
 {
 	struct task_struct *tsk = current;
 
-	tsk->session = 1;
-	tsk->pgrp = 1;
+	change_pids(tsk, 1, 1);
 
 	/*
 	 * We don't want /any/ signals, not even SIGKILL
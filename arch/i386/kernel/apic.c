@@ -22,6 +22,7 @@
 #include <linux/interrupt.h>
 #include <linux/mc146818rtc.h>
 #include <linux/kernel_stat.h>
+#include <linux/hrtimer.h>
 
 #include <asm/smp.h>
 #include <asm/mtrr.h>
@@ -594,6 +595,119 @@ int __init calibrate_APIC_clock(void)
 
 static unsigned int calibration_result;
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+extern unsigned long cpu_khz;
+
+/*
+ * With high resolution timers the local APIC timer runs in one-shot
+ * mode and is programmed for whichever comes first: the next local
+ * tick or the first queued hrtimer. The tick itself is emulated, so
+ * the rest of the kernel still sees HZ local timer interrupts.
+ */
+#define APIC_TICK_NS		(NSEC_PER_SEC / HZ)
+#define APIC_MIN_DELTA_NS	2000
+
+static unsigned long apic_ns_mult;	/* timer counts per ns, << 32 */
+
+static struct apic_event {
+	int oneshot;
+	u64 next_tick;		/* hrtimer_now() time of the next tick */
+	u64 next_event;		/* what the timer is programmed for */
+} ____cacheline_aligned apic_events[NR_CPUS];
+
+#define apic_oneshot(cpu)	(apic_events[cpu].oneshot)
+
+static void apic_program_event(struct apic_event *ev, u64 when)
+{
+	u64 now = hrtimer_now();
+	unsigned long delta = APIC_MIN_DELTA_NS, count;
+
+	if (when > ev->next_tick)
+		when = ev->next_tick;
+	ev->next_event = when;
+	if (when > now + APIC_MIN_DELTA_NS)
+		delta = when - now;
+
+	count = (u64) delta * apic_ns_mult >> 32;
+	apic_write_around(APIC_TMICT, count ? count : 1);
+}
+
+/*
+ * Called by the hrtimer code, with interrupts off, when a timer
+ * becomes the first one queued on this CPU.
+ */
+void hrtimer_reprogram(u64 expires)
+{
+	struct apic_event *ev = apic_events + smp_processor_id();
+
+	if (ev->oneshot && expires < ev->next_event)
+		apic_program_event(ev, expires);
+}
+
+static void apic_event_interrupt(struct pt_regs *regs, int cpu)
+{
+	struct apic_event *ev = apic_events + cpu;
+	u64 now = hrtimer_now();
+
+	if (now >= ev->next_tick) {
+		unsigned long tick_ns = APIC_TICK_NS / prof_multiplier[cpu];
+
+		/* Lost ticks are not replayed, jiffies come from IRQ0 */
+		ev->next_tick += tick_ns;
+		if (ev->next_tick <= now)
+			ev->next_tick = now + tick_ns;
+		smp_local_timer_interrupt(regs);
+	}
+	hrtimer_run_queues();
+	apic_program_event(ev, hrtimer_next_event());
+}
+
+static void setup_APIC_oneshot(void * data)
+{
+	int cpu = smp_processor_id();
+	struct apic_event *ev = apic_events + cpu;
+	unsigned long tick_ns = APIC_TICK_NS / prof_multiplier[cpu];
+	unsigned long flags;
+
+	__save_flags(flags);
+	__cli();
+
+	/* Keep the ticks of different CPUs apart, as setup_APIC_timer() does */
+	ev->next_tick = hrtimer_now() + tick_ns +
+		tick_ns / (smp_num_cpus+1) * (cpu+1);
+	apic_write_around(APIC_LVTT,
+		SET_APIC_TIMER_BASE(APIC_TIMER_BASE_DIV) | LOCAL_TIMER_VECTOR);
+	ev->oneshot = 1;
+	apic_program_event(ev, ev->next_tick);
+
+	__restore_flags(flags);
+}
+
+/*
+ * Switch all CPUs to one-shot mode. We need the TSC as clock, and
+ * the calibration to convert nanoseconds into APIC timer counts.
+ */
+static void __init setup_APIC_hrtimers(void)
+{
+	u64 mult;
+
+	if (!cpu_khz)
+		return;
+
+	mult = (u64) (calibration_result / APIC_DIVISOR) << 32;
+	do_div(mult, APIC_TICK_NS);
+	apic_ns_mult = mult;
+
+	setup_APIC_oneshot(NULL);
+	smp_call_function(setup_APIC_oneshot, NULL, 1, 1);
+	hrtimer_active = 1;
+
+	printk("Using local APIC one-shot timer for high resolution timers.\n");
+}
+#else
+#define apic_oneshot(cpu)	0
+#endif
+
 void __init setup_APIC_clocks (void)
 {
 	__cli();
@@ -608,6 +722,10 @@ void __init setup_APIC_clocks (void)
 
 	/* and update all other cpus */
 	smp_call_function(setup_APIC_timer, (void *)calibration_result, 1, 1);
+
+#ifdef CONFIG_HIGH_RES_TIMERS
+	setup_APIC_hrtimers();
+#endif
 }
 
 /*
@@ -675,7 +793,9 @@ inline void smp_local_timer_interrupt(struct pt_regs * regs)
 		 */
 		prof_counter[cpu] = prof_multiplier[cpu];
 		if (prof_counter[cpu] != prof_old_multiplier[cpu]) {
-			__setup_APIC_LVTT(calibration_result/prof_counter[cpu]);
+			/* in one-shot mode the next tick already uses it */
+			if (!apic_oneshot(cpu))
+				__setup_APIC_LVTT(calibration_result/prof_counter[cpu]);
 			prof_old_multiplier[cpu] = prof_counter[cpu];
 		}
 
@@ -726,8 +846,20 @@ void smp_apic_timer_interrupt(struct pt_regs * regs)
 	 * interrupt lock, which is the WrongThing (tm) to do.
 	 */
 	irq_enter(cpu, 0);
-	smp_local_timer_interrupt(regs);
+#ifdef CONFIG_HIGH_RES_TIMERS
+	if (apic_oneshot(cpu))
+		apic_event_interrupt(regs, cpu);
+	else
+#endif
+		smp_local_timer_interrupt(regs);
 	irq_exit(cpu, 0);
+
+	/*
+	 * The tick raised TIMER_SOFTIRQ for this CPU's timer wheel;
+	 * run it now rather than waiting for some other interrupt.
+	 */
+	if (softirq_active(cpu) & softirq_mask(cpu))
+		do_softirq();
 }
 
 /*
@@ -50,7 +50,11 @@
 
 void __up(struct semaphore *sem)
 {
-	wake_up(&sem->wait);
+	/*
+	 * The woken task usually touches what the releaser just
+	 * worked on, so keep it close to this CPU.
+	 */
+	wake_up_affine(&sem->wait);
 }
 
 static spinlock_t semaphore_lock = SPIN_LOCK_UNLOCKED;
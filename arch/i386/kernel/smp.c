@@ -20,6 +20,7 @@
 
 #include <asm/mtrr.h>
 #include <asm/pgalloc.h>
+#include <asm/tlb.h>
 
 /*
  *	Some notes on x86 processor bugs affecting SMP operation:
@@ -103,6 +104,121 @@
 /* The 'big kernel lock' */
 spinlock_t kernel_flag = SPIN_LOCK_UNLOCKED;
 
+#ifdef CONFIG_BKL_PROFILE
+/*
+ * Per call site kernel lock statistics, in TSC cycles. The table is
+ * only ever written by the lock holder, so kernel_flag protects it.
+ * Sites are hashed by return address; once the table is full new
+ * sites are only counted in bkl_lost.
+ */
+#define BKL_SITES	256
+
+struct bkl_site {
+	void *where;
+	unsigned long count, contended;
+	cycles_t wait, hold, max_hold;
+};
+
+static struct bkl_site bkl_sites[BKL_SITES];
+static struct bkl_site *bkl_holder;
+static cycles_t bkl_acquired;
+static unsigned long bkl_lost;
+
+static struct bkl_site *bkl_lookup(void *where)
+{
+	unsigned int i, h = ((unsigned long) where >> 2) & (BKL_SITES-1);
+
+	for (i = 0; i < BKL_SITES; i++) {
+		struct bkl_site *site = bkl_sites + ((h + i) & (BKL_SITES-1));
+
+		if (site->where == where)
+			return site;
+		if (!site->where) {
+			site->where = where;
+			return site;
+		}
+	}
+	bkl_lost++;
+	return NULL;
+}
+
+void __lock_kernel_flag(void)
+{
+	void *where = __builtin_return_address(0);
+	struct bkl_site *site;
+	cycles_t now, wait = 0;
+
+	if (!spin_trylock(&kernel_flag)) {
+		wait = get_cycles();
+		spin_lock(&kernel_flag);
+		now = get_cycles();
+		wait = now - wait;
+	} else
+		now = get_cycles();
+
+	site = bkl_lookup(where);
+	if (site) {
+		site->count++;
+		if (wait) {
+			site->contended++;
+			site->wait += wait;
+		}
+	}
+	bkl_holder = site;
+	bkl_acquired = now;
+}
+
+void __unlock_kernel_flag(void)
+{
+	struct bkl_site *site = bkl_holder;
+
+	if (site) {
+		cycles_t hold = get_cycles() - bkl_acquired;
+
+		site->hold += hold;
+		if (hold > site->max_hold)
+			site->max_hold = hold;
+	}
+	bkl_holder = NULL;
+	spin_unlock(&kernel_flag);
+}
+
+/*
+ * Read without the lock: a line may be torn, but taking kernel_flag
+ * here would only show up in the profile.
+ */
+int get_bkl_profile(char *buf)
+{
+	extern unsigned long cpu_khz;
+	unsigned long count = 0, contended = 0;
+	cycles_t wait = 0, hold = 0;
+	char *p = buf;
+	int i;
+
+	for (i = 0; i < BKL_SITES; i++) {
+		count += bkl_sites[i].count;
+		contended += bkl_sites[i].contended;
+		wait += bkl_sites[i].wait;
+		hold += bkl_sites[i].hold;
+	}
+	p += sprintf(p, "cpu_khz %lu lost %lu\n", cpu_khz, bkl_lost);
+	p += sprintf(p, "total    %10lu %10lu %16Lu %16Lu\n",
+		     count, contended, wait, hold);
+	for (i = 0; i < BKL_SITES; i++) {
+		struct bkl_site *site = bkl_sites + i;
+
+		if (!site->where)
+			continue;
+		if (p - buf > PAGE_SIZE - 80)
+			break;
+		p += sprintf(p, "%p %10lu %10lu %16Lu %16Lu %10Lu\n",
+			     site->where, site->count, site->contended,
+			     site->wait, site->hold, site->max_hold);
+	}
+	return p - buf;
+}
+#endif
+
 struct tlb_state cpu_tlbstate[NR_CPUS] = {[0 ... NR_CPUS-1] = { &init_mm, 0 }};
 
 /*
@@ -336,6 +452,7 @@ static void flush_tlb_others (unsigned long cpumask, struct mm_struct *mm,
 	 * CPUs affected.
 	 */
 	send_IPI_mask(cpumask, INVALIDATE_TLB_VECTOR);
+	tlb_stat[smp_processor_id()].ipis += hweight32(cpumask);
 
 	while (flush_cpumask)
 		/* nothing. lockup detection does not belong here */;
@@ -402,6 +519,7 @@ static void flush_tlb_all_ipi(void* info)
 void flush_tlb_all(void)
 {
 	smp_call_function (flush_tlb_all_ipi,0,1,1);
+	tlb_stat[smp_processor_id()].ipis += smp_num_cpus - 1;
 
 	do_flush_tlb_all_local();
 }
@@ -41,6 +41,7 @@
 #include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/smp.h>
+#include <linux/hrtimer.h>
 
 #include <asm/io.h>
 #include <asm/smp.h>
@@ -558,6 +559,35 @@ static struct irqaction irq0  = { timer_interrupt, SA_INTERRUPT, 0, "timer", NUL
 #define CALIBRATE_LATCH	(5 * LATCH)
 #define CALIBRATE_TIME	(5 * 1000020/HZ)
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+/*
+ * Nanosecond clock for the high resolution timers, read from the TSC:
+ * ns = cycles * cyc2ns_scale >> CYC2NS_SHIFT, done in two halves so
+ * it doesn't overflow. The TSCs are synchronized at SMP boot, so the
+ * value is comparable across CPUs.
+ */
+#define CYC2NS_SHIFT 20
+
+static unsigned long cyc2ns_scale;
+
+u64 hrtimer_now(void)
+{
+	unsigned long lo, hi;
+
+	rdtsc(lo, hi);
+	return ((u64) hi * cyc2ns_scale << (32 - CYC2NS_SHIFT)) +
+		((u64) lo * cyc2ns_scale >> CYC2NS_SHIFT);
+}
+
+static void __init set_cyc2ns_scale(unsigned long khz)
+{
+	u64 scale = (u64) 1000000 << CYC2NS_SHIFT;
+
+	do_div(scale, khz);
+	cyc2ns_scale = scale;
+}
+#endif
+
 static unsigned long __init calibrate_tsc(void)
 {
        /* Set the Gate high, disable speaker */
@@ -687,6 +717,9 @@ void __init time_init(void)
 	                	"0" (eax), "1" (edx));
 				printk("Detected %lu.%03lu MHz processor.\n", cpu_khz / 1000, cpu_khz % 1000);
 			}
+#ifdef CONFIG_HIGH_RES_TIMERS
+			set_cyc2ns_scale(cpu_khz);
+#endif
 		}
 	}
 
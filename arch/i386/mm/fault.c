@@ -85,17 +85,17 @@ bad_area:
 	return 0;
 }
 
-extern spinlock_t console_lock, timerlist_lock;
+extern spinlock_t console_lock;
 
 /*
  * Unlock any spinlocks which will prevent us from getting the
- * message out (timerlist_lock is aquired through the
+ * message out (the timer base locks are aquired through the
  * console unblank code)
  */
 void bust_spinlocks(void)
 {
 	spin_lock_init(&console_lock);
-	spin_lock_init(&timerlist_lock);
+	timer_bust_locks();
 }
 
 asmlinkage void do_invalid_op(struct pt_regs *, unsigned long);
@@ -542,7 +542,10 @@ static int __init swap_init(void *start_mem, void *swap_data)
 	p->swap_vfsmnt  = &fake_vfsmnt;
 	p->swap_device  = 0;
 	p->swap_map	= swap_data;
-	p->cluster_nr   = 0;
+	memset(p->cluster, 0, sizeof(p->cluster));
+	p->cluster_search = 0;
+	p->extents      = NULL;
+	p->nr_extents   = 0;
 	p->next         = -1;
 	p->prio         = 0x7ff0;	/* a rather high priority, but not the higest
 								 * to give the user a chance to override */
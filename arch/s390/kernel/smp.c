@@ -714,13 +714,13 @@ void smp_local_timer_interrupt(struct pt_regs * regs)
                         }
                         if (p->nice > 0) {
                                 kstat.cpu_nice += user;
-                                kstat.per_cpu_nice[cpu] += user;
+                                kstat_cpu[cpu].nice += user;
                         } else {
                                 kstat.cpu_user += user;
-                                kstat.per_cpu_user[cpu] += user;
+                                kstat_cpu[cpu].user += user;
                         }
                         kstat.cpu_system += system;
-                        kstat.per_cpu_system[cpu] += system;
+                        kstat_cpu[cpu].system += system;
 
                 }
                 irq_exit(cpu, 0);
@@ -502,13 +502,17 @@ int timod_putmsg(unsigned int fd, char *ctl_buf, int ctl_len,
 		args[0] = fd;
 		args[1] = (long)buf+req.DEST_offset;
 		args[2] = req.DEST_length;
+		spin_lock(&filp->f_lock);
 		oldflags = filp->f_flags;
 		filp->f_flags &= ~O_NONBLOCK;
+		spin_unlock(&filp->f_lock);
 		SOLD("calling CONNECT");
 		set_fs(KERNEL_DS);
 		error = sys_socketcall(SYS_CONNECT, args);
 		set_fs(old_fs);
+		spin_lock(&filp->f_lock);
 		filp->f_flags = oldflags;
+		spin_unlock(&filp->f_lock);
 		SOLD("CONNECT done");
 		if (!error) {
 			struct T_conn_con *con;
@@ -744,13 +748,17 @@ int timod_getmsg(unsigned int fd, char *ctl_buf, int ctl_maxlen, s32 *ctl_len,
 			args[0] = fd;
 			args[1] = (long)buf;
 			args[2] = (long)&len;
+			spin_lock(&filp->f_lock);
 			oldflags = filp->f_flags;
 			filp->f_flags |= O_NONBLOCK;
+			spin_unlock(&filp->f_lock);
 			SOLD("calling ACCEPT");
 			set_fs(KERNEL_DS);
 			error = sys_socketcall(SYS_ACCEPT, args);
 			set_fs(old_fs);
+			spin_lock(&filp->f_lock);
 			filp->f_flags = oldflags;
+			spin_unlock(&filp->f_lock);
 			if (error < 0) {
 				SOLD("some error");
 				putpage(buf);
@@ -811,12 +819,16 @@ int timod_getmsg(unsigned int fd, char *ctl_buf, int ctl_maxlen, s32 *ctl_len,
 	if (put_user(tmplen, ctl_len))
 		return -EFAULT;
 	SOLD("set ctl_len");
+	spin_lock(&filp->f_lock);
 	oldflags = filp->f_flags;
 	filp->f_flags |= O_NONBLOCK;
+	spin_unlock(&filp->f_lock);
 	SOLD("calling recvfrom");
 	sys_recvfrom = (int (*)(int, void *, size_t, unsigned, struct sockaddr *, int *))SYS(recvfrom);
 	error = sys_recvfrom(fd, data_buf, min(0,data_maxlen), 0, (struct sockaddr*)tmpbuf, ctl_len);
+	spin_lock(&filp->f_lock);
 	filp->f_flags = oldflags;
+	spin_unlock(&filp->f_lock);
 	if (error < 0)
 		return error;
 	SOLD("error >= 0" ) ;
@@ -967,10 +967,10 @@ void submit_bh(int rw, struct buffer_head * bh)
 
 	switch (rw) {
 		case WRITE:
-			kstat.pgpgout++;
+			kstat_inc(pgpgout);
 			break;
 		default:
-			kstat.pgpgin++;
+			kstat_inc(pgpgin);
 			break;
 	}
 }
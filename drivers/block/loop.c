@@ -465,7 +465,9 @@ static int loop_set_fd(struct loop_device *lo, kdev_t dev, unsigned int arg)
 		lo->lo_backing_file->f_mode = file->f_mode;
 		lo->lo_backing_file->f_pos = file->f_pos;
 		lo->lo_backing_file->f_flags = file->f_flags;
-		lo->lo_backing_file->f_owner = file->f_owner;
+		f_modown(lo->lo_backing_file, file->f_owner.pid,
+			 file->f_owner.uid, file->f_owner.euid, 1);
+		lo->lo_backing_file->f_owner.signum = file->f_owner.signum;
 		lo->lo_backing_file->f_dentry = file->f_dentry;
 		lo->lo_backing_file->f_vfsmnt = mntget(file->f_vfsmnt);
 		lo->lo_backing_file->f_op = fops_get(file->f_op);
@@ -1462,11 +1462,8 @@ static int tty_fasync(int fd, struct file * filp, int on)
 	if (on) {
 		if (!waitqueue_active(&tty->read_wait))
 			tty->minimum_to_wake = 1;
-		if (filp->f_owner.pid == 0) {
-			filp->f_owner.pid = (-tty->pgrp) ? : current->pid;
-			filp->f_owner.uid = current->uid;
-			filp->f_owner.euid = current->euid;
-		}
+		f_modown(filp, (-tty->pgrp) ? : current->pid,
+			 current->uid, current->euid, 0);
 	} else {
 		if (!tty->fasync && !waitqueue_active(&tty->read_wait))
 			tty->minimum_to_wake = N_TTY_BUF_SIZE;
@@ -1535,10 +1532,12 @@ static int fionbio(struct file *file, int *arg)
 	if (get_user(nonblock, arg))
 		return -EFAULT;
 
+	spin_lock(&file->f_lock);
 	if (nonblock)
 		file->f_flags |= O_NONBLOCK;
 	else
 		file->f_flags &= ~O_NONBLOCK;
+	spin_unlock(&file->f_lock);
 	return 0;
 }
 
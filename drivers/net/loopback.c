@@ -51,16 +51,28 @@
 #include <net/sock.h>
 #include <linux/if_ether.h>	/* For the statistics structure. */
 #include <linux/if_arp.h>	/* For ARPHRD_ETHER */
+#include <linux/percpu_stat.h>
 
 #define LOOPBACK_OVERHEAD (128 + MAX_HEADER + 16 + 16)
 
+/*
+ * Every CPU talking to itself over lo would bounce a shared set of
+ * counters, so the statistics are kept per CPU and folded into
+ * dev->priv when they are asked for.
+ */
+struct loopback_stats {
+	struct net_device_stats stats;
+} ____cacheline_aligned;
+
+static struct loopback_stats loopback_stats[NR_CPUS];
+
 /*
  * The higher levels take care of making this non-reentrant (it's
  * called with bh's disabled).
  */
 static int loopback_xmit(struct sk_buff *skb, struct net_device *dev)
 {
-	struct net_device_stats *stats = (struct net_device_stats *)dev->priv;
+	struct net_device_stats *stats = &percpu_stat(loopback_stats).stats;
 
 	/*
 	 *	Optimise so buffers with skb->free=1 are not copied but
@@ -97,7 +109,14 @@ static int loopback_xmit(struct sk_buff *skb, struct net_device *dev)
 
 static struct net_device_stats *get_stats(struct net_device *dev)
 {
-	return (struct net_device_stats *)dev->priv;
+	struct net_device_stats *stats = (struct net_device_stats *)dev->priv;
+	unsigned long *sum = (unsigned long *) stats;
+	int i;
+
+	for (i = 0; i < sizeof(*stats) / sizeof(unsigned long); i++)
+		sum[i] = percpu_stat_fold(loopback_stats,
+					  sizeof(struct loopback_stats), 1, i);
+	return stats;
 }
 
 /* Initialize the rest of the LOOPBACK device. */
@@ -175,8 +175,7 @@ void cpqfcTSWorkerThread( void *host)
 	 */
   exit_mm(current);
 
-  current->session = 1;
-  current->pgrp = 1;
+  change_pids(current, 1, 1);
 	
   /* Become as one with the init task */
 	
@@ -1637,7 +1637,9 @@ static int cm_ioctl(struct inode *inode, struct file *file, unsigned int cmd, un
 		return copy_to_user((void *)arg, &abinfo, sizeof(abinfo)) ? -EFAULT : 0;
 		
         case SNDCTL_DSP_NONBLOCK:
+                spin_lock(&file->f_lock);
                 file->f_flags |= O_NONBLOCK;
+                spin_unlock(&file->f_lock);
                 return 0;
 
         case SNDCTL_DSP_GETODELAY:
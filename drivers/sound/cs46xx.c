@@ -2651,7 +2651,9 @@ static int cs_ioctl(struct inode *inode, struct file *file, unsigned int cmd, un
 		return -ENODEV;
 
 	case SNDCTL_DSP_NONBLOCK:
+		spin_lock(&file->f_lock);
 		file->f_flags |= O_NONBLOCK;
+		spin_unlock(&file->f_lock);
 		return 0;
 
 	case SNDCTL_DSP_GETCAPS:
@@ -730,7 +730,9 @@ static int emu10k1_audio_ioctl(struct inode *inode, struct file *file, unsigned
 	case SNDCTL_DSP_NONBLOCK:
 		DPF(2, "SNDCTL_DSP_NONBLOCK:\n");
 
+		spin_lock(&file->f_lock);
 		file->f_flags |= O_NONBLOCK;
+		spin_unlock(&file->f_lock);
 		break;
 
 	case SNDCTL_DSP_GETODELAY:
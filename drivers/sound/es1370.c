@@ -1569,7 +1569,9 @@ static int es1370_ioctl(struct inode *inode, struct file *file, unsigned int cmd
 		return copy_to_user((void *)arg, &abinfo, sizeof(abinfo)) ? -EFAULT : 0;
 		
         case SNDCTL_DSP_NONBLOCK:
+                spin_lock(&file->f_lock);
                 file->f_flags |= O_NONBLOCK;
+                spin_unlock(&file->f_lock);
                 return 0;
 
         case SNDCTL_DSP_GETODELAY:
@@ -2042,7 +2044,9 @@ static int es1370_ioctl_dac(struct inode *inode, struct file *file, unsigned int
 		return copy_to_user((void *)arg, &abinfo, sizeof(abinfo)) ? -EFAULT : 0;
 
         case SNDCTL_DSP_NONBLOCK:
+                spin_lock(&file->f_lock);
                 file->f_flags |= O_NONBLOCK;
+                spin_unlock(&file->f_lock);
                 return 0;
 
         case SNDCTL_DSP_GETODELAY:
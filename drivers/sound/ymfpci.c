@@ -1764,7 +1764,9 @@ static int ymf_ioctl(struct inode *inode, struct file *file,
 #endif
 
 	case SNDCTL_DSP_NONBLOCK:
+		spin_lock(&file->f_lock);
 		file->f_flags |= O_NONBLOCK;
+		spin_unlock(&file->f_lock);
 		return 0;
 
 	case SNDCTL_DSP_GETCAPS:
@@ -1079,8 +1079,8 @@ int balance_dirty_state(kdev_t dev)
 	 * fix this, wake up bdflush.
 	 */
 	shortage = free_shortage();
-	if (shortage && nr_inactive_dirty_pages > shortage &&
-			nr_inactive_dirty_pages > freepages.high)
+	if (shortage && nr_inactive_dirty_pages() > shortage &&
+			nr_inactive_dirty_pages() > freepages.high)
 		return 0;
 
 	return -1;
@@ -2766,8 +2766,7 @@ int bdflush(void *sem)
 	 *	display semi-sane things. Not real crucial though...  
 	 */
 
-	tsk->session = 1;
-	tsk->pgrp = 1;
+	change_pids(tsk, 1, 1);
 	strcpy(tsk->comm, "bdflush");
 	bdflush_tsk = tsk;
 
@@ -2814,8 +2813,7 @@ int kupdate(void *sem)
 	struct task_struct * tsk = current;
 	int interval;
 
-	tsk->session = 1;
-	tsk->pgrp = 1;
+	change_pids(tsk, 1, 1);
 	strcpy(tsk->comm, "kupdate");
 
 	/* sigstop and sigcont will stop and wakeup kupdate */
@@ -562,19 +562,14 @@ void shrink_dcache_parent(struct dentry * parent)
 }
 
 /*
- * This is called from kswapd when we think we need some
- * more memory, but aren't really sure how much. So we
- * carefully try to free a _bit_ of our dcache, but not
- * too much.
- *
- * Priority:
- *   0 - very urgent: shrink everything
- *  ...
- *   6 - base-level: try to shrink a bit.
+ * The shrinker of the dcache, called from the reclaim code with the
+ * number of unused dentries to free, in proportion to the memory
+ * pressure. See set_shrinker().
  */
-void shrink_dcache_memory(int priority, unsigned int gfp_mask)
+static int shrink_dcache_memory(int nr, unsigned int gfp_mask)
 {
-	int count = 0;
+	if (!nr)
+		return dentry_stat.nr_unused;
 
 	/*
 	 * Nasty deadlock avoidance.
@@ -588,13 +583,11 @@ void shrink_dcache_memory(int priority, unsigned int gfp_mask)
 	 * block allocations, but for now:
 	 */
 	if (!(gfp_mask & __GFP_IO))
-		return;
+		return -1;
 
-	if (priority)
-		count = dentry_stat.nr_unused / priority;
-
-	prune_dcache(count);
+	prune_dcache(nr);
 	kmem_cache_shrink(dentry_cache);
+	return dentry_stat.nr_unused;
 }
 
 #define NAME_ALLOC_LEN(len)	((len+16) & ~15)
@@ -1237,6 +1230,8 @@ static void __init dcache_init(unsigned long mempages)
 	if (!dentry_cache)
 		panic("Cannot create dentry cache");
 
+	set_shrinker(DEFAULT_SEEKS, shrink_dcache_memory);
+
 #if PAGE_SHIFT < 13
 	mempages >>= (13 - PAGE_SHIFT);
 #endif
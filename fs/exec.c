@@ -32,6 +32,7 @@
 #include <linux/smp_lock.h>
 #include <linux/init.h>
 #include <linux/pagemap.h>
+#include <linux/swap.h>
 #include <linux/highmem.h>
 #include <linux/spinlock.h>
 #define __NO_VERSION__
@@ -256,6 +257,7 @@ int copy_strings_kernel(int argc,char ** argv, struct linux_binprm *bprm)
  */
 void put_dirty_page(struct task_struct * tsk, struct page *page, unsigned long address)
 {
+	struct pte_chain * pte_chain = NULL;
 	pgd_t * pgd;
 	pmd_t * pmd;
 	pte_t * pte;
@@ -264,26 +266,30 @@ void put_dirty_page(struct task_struct * tsk, struct page *page, unsigned long a
 		printk("mem_map disagrees with %p at %08lx\n", page, address);
 	pgd = pgd_offset(tsk->mm, address);
 	pmd = pmd_alloc(pgd, address);
-	if (!pmd) {
-		__free_page(page);
-		force_sig(SIGKILL, tsk);
-		return;
-	}
+	if (!pmd)
+		goto oom;
 	pte = pte_alloc(pmd, address);
-	if (!pte) {
-		__free_page(page);
-		force_sig(SIGKILL, tsk);
-		return;
-	}
+	if (!pte)
+		goto oom;
+	if (pte_chain_alloc(&pte_chain, 1, GFP_KERNEL))
+		goto oom;
 	if (!pte_none(*pte)) {
 		pte_ERROR(*pte);
+		pte_chain_free(pte_chain);
 		__free_page(page);
 		return;
 	}
 	flush_dcache_page(page);
 	flush_page_to_ram(page);
+	lru_cache_add_anon(page);
 	set_pte(pte, pte_mkdirty(pte_mkwrite(mk_pte(page, PAGE_COPY))));
+	page_add_rmap(page, pte, tsk->mm, address, &pte_chain);
 /* no need for flush_tlb */
+	return;
+
+oom:
+	__free_page(page);
+	force_sig(SIGKILL, tsk);
 }
 
 int setup_arg_pages(struct linux_binprm *bprm)
@@ -26,6 +26,12 @@
 #include <linux/locks.h>
 #include <asm/uaccess.h>
 
+/* The size of a file that uses all of the indirect blocks */
+#define EXT2_MAX_SIZE(bits)							\
+	(((EXT2_NDIR_BLOCKS + (1LL << (bits - 2)) + 				\
+	   (1LL << (bits - 2)) * (1LL << (bits - 2)) + 				\
+	   (1LL << (bits - 2)) * (1LL << (bits - 2)) * (1LL << (bits - 2))) * 	\
+	  (1LL << bits)) - 1)
 
 
 static char error_buf[1024];
@@ -535,6 +541,7 @@ failed_mount:
 			goto failed_mount;
 		}
 	}
+	sb->s_maxbytes = EXT2_MAX_SIZE(sb->s_blocksize_bits);
 	if (le32_to_cpu(es->s_rev_level) == EXT2_GOOD_OLD_REV) {
 		sb->u.ext2_sb.s_inode_size = EXT2_GOOD_OLD_INODE_SIZE;
 		sb->u.ext2_sb.s_first_ino = EXT2_GOOD_OLD_FIRST_INO;
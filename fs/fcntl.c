@@ -208,10 +208,15 @@ static int setfl(int fd, struct file * filp, unsigned long arg)
 	if (!(arg & O_APPEND) && IS_APPEND(inode))
 		return -EPERM;
 
-	/* Did FASYNC state change? */
+	/*
+	 * Did FASYNC state change? Drivers' fasync methods still
+	 * expect the big kernel lock, the flags themselves don't.
+	 */
 	if ((arg ^ filp->f_flags) & FASYNC) {
 		if (filp->f_op && filp->f_op->fasync) {
+			lock_kernel();
 			error = filp->f_op->fasync(fd, filp, (arg & FASYNC) != 0);
+			unlock_kernel();
 			if (error < 0)
 				return error;
 		}
@@ -222,10 +227,30 @@ static int setfl(int fd, struct file * filp, unsigned long arg)
 	       if (arg & O_NDELAY)
 		   arg |= O_NONBLOCK;
 
+	spin_lock(&filp->f_lock);
 	filp->f_flags = (arg & SETFL_MASK) | (filp->f_flags & ~SETFL_MASK);
+	spin_unlock(&filp->f_lock);
 	return 0;
 }
 
+/*
+ * Set the owner SIGIO/SIGURG go to. send_sigio() reads the owner
+ * from interrupts, hence the irq-safe lock. Unless @force is set an
+ * owner that is already there is left alone.
+ */
+void f_modown(struct file *filp, int pid, uid_t uid, uid_t euid, int force)
+{
+	unsigned long flags;
+
+	write_lock_irqsave(&filp->f_owner.lock, flags);
+	if (force || !filp->f_owner.pid) {
+		filp->f_owner.pid = pid;
+		filp->f_owner.uid = uid;
+		filp->f_owner.euid = euid;
+	}
+	write_unlock_irqrestore(&filp->f_owner.lock, flags);
+}
+
 static long do_fcntl(unsigned int fd, unsigned int cmd,
 		     unsigned long arg, struct file * filp)
 {
@@ -249,9 +274,7 @@ static long do_fcntl(unsigned int fd, unsigned int cmd,
 			err = filp->f_flags;
 			break;
 		case F_SETFL:
-			lock_kernel();
 			err = setfl(fd, filp, arg);
-			unlock_kernel();
 			break;
 		case F_GETLK:
 			err = fcntl_getlk(fd, (struct flock *) arg);
@@ -271,14 +294,10 @@ static long do_fcntl(unsigned int fd, unsigned int cmd,
 			err = filp->f_owner.pid;
 			break;
 		case F_SETOWN:
-			lock_kernel();
-			filp->f_owner.pid = arg;
-			filp->f_owner.uid = current->uid;
-			filp->f_owner.euid = current->euid;
+			f_modown(filp, arg, current->uid, current->euid, 1);
 			err = 0;
 			if (S_ISSOCK (filp->f_dentry->d_inode->i_mode))
 				err = sock_fcntl (filp, F_SETOWN, arg);
-			unlock_kernel();
 			break;
 		case F_GETSIG:
 			err = filp->f_owner.signum;
@@ -338,7 +357,6 @@ asmlinkage long sys_fcntl64(unsigned int fd, unsigned int cmd, unsigned long arg
 	if (!filp)
 		goto out;
 
-	lock_kernel();
 	switch (cmd) {
 		case F_GETLK64:
 			err = fcntl_getlk64(fd, (struct flock64 *) arg);
@@ -353,7 +371,6 @@ asmlinkage long sys_fcntl64(unsigned int fd, unsigned int cmd, unsigned long arg
 			err = do_fcntl(fd, cmd, arg, filp);
 			break;
 	}
-	unlock_kernel();
 	fput(filp);
 out:
 	return err;
@@ -413,8 +430,10 @@ static void send_sigio_to_task(struct task_struct *p,
 void send_sigio(struct fown_struct *fown, int fd, int band)
 {
 	struct task_struct * p;
-	int   pid	= fown->pid;
+	int   pid;
 	
+	read_lock(&fown->lock);
+	pid = fown->pid;
 	read_lock(&tasklist_lock);
 	if ( (pid > 0) && (p = find_task_by_pid(pid)) ) {
 		send_sigio_to_task(p, fown, fd, band);
@@ -430,6 +449,7 @@ void send_sigio(struct fown_struct *fown, int fd, int band)
 	}
 out:
 	read_unlock(&tasklist_lock);
+	read_unlock(&fown->lock);
 }
 
 static rwlock_t fasync_lock = RW_LOCK_UNLOCKED;
@@ -43,6 +43,8 @@ struct file * get_empty_filp(void)
 	new_one:
 		memset(f, 0, sizeof(*f));
 		atomic_set(&f->f_count,1);
+		spin_lock_init(&f->f_lock);
+		rwlock_init(&f->f_owner.lock);
 		f->f_version = ++event;
 		f->f_uid = current->fsuid;
 		f->f_gid = current->fsgid;
@@ -88,6 +90,8 @@ int init_private_file(struct file *filp, struct dentry *dentry, int mode)
 	memset(filp, 0, sizeof(*filp));
 	filp->f_mode   = mode;
 	atomic_set(&filp->f_count, 1);
+	spin_lock_init(&filp->f_lock);
+	rwlock_init(&filp->f_owner.lock);
 	filp->f_dentry = dentry;
 	filp->f_uid    = current->fsuid;
 	filp->f_gid    = current->fsgid;
@@ -109,6 +109,8 @@ static void init_once(void * foo, kmem_cache_t * cachep, unsigned long flags)
 		sema_init(&inode->i_sem, 1);
 		sema_init(&inode->i_zombie, 1);
 		spin_lock_init(&inode->i_data.i_shared_lock);
+		INIT_RADIX_TREE(&inode->i_data.page_tree);
+		spin_lock_init(&inode->i_data.page_lock);
 	}
 }
 
@@ -553,10 +555,13 @@ void prune_icache(int goal)
 
 /*
  * 减小inode 缓存占用的内存
+ *
+ * The shrinker of the icache, see set_shrinker().
  */
-void shrink_icache_memory(int priority, int gfp_mask)
+static int shrink_icache_memory(int nr, unsigned int gfp_mask)
 {
-	int count = 0;
+	if (!nr)
+		return inodes_stat.nr_unused;
 
 	/*
 	 * Nasty deadlock avoidance..
@@ -566,13 +571,11 @@ void shrink_icache_memory(int priority, int gfp_mask)
 	 * in clear_inode() and friends..
 	 */
 	if (!(gfp_mask & __GFP_IO))
-		return;
+		return -1;
 
-	if (priority)
-		count = inodes_stat.nr_unused / priority;
-
-	prune_icache(count);
+	prune_icache(nr);
 	kmem_cache_shrink(inode_cachep);
+	return inodes_stat.nr_unused;
 }
 
 /*
@@ -1021,6 +1024,8 @@ void __init inode_init(unsigned long mempages)
 					 NULL);
 	if (!inode_cachep)
 		panic("cannot create inode slab cache");
+
+	set_shrinker(DEFAULT_SEEKS, shrink_icache_memory);
 }
 
 /**
@@ -55,7 +55,6 @@ asmlinkage long sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 	if (!filp)
 		goto out;
 	error = 0;
-	lock_kernel();
 	switch (cmd) {
 		case FIOCLEX:
 			set_close_on_exec(fd, 1);
@@ -74,10 +73,12 @@ asmlinkage long sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 			if(O_NONBLOCK != O_NDELAY)
 				flag |= O_NDELAY;
 #endif
+			spin_lock(&filp->f_lock);
 			if (on)
 				filp->f_flags |= flag;
 			else
 				filp->f_flags &= ~flag;
+			spin_unlock(&filp->f_lock);
 			break;
 
 		case FIOASYNC:
@@ -87,27 +88,38 @@ asmlinkage long sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 
 			/* Did FASYNC state change ? */
 			if ((flag ^ filp->f_flags) & FASYNC) {
-				if (filp->f_op && filp->f_op->fasync)
+				if (filp->f_op && filp->f_op->fasync) {
+					lock_kernel();
 					error = filp->f_op->fasync(fd, filp, on);
-				else error = -ENOTTY;
+					unlock_kernel();
+				} else error = -ENOTTY;
 			}
 			if (error != 0)
 				break;
 
+			spin_lock(&filp->f_lock);
 			if (on)
 				filp->f_flags |= FASYNC;
 			else
 				filp->f_flags &= ~FASYNC;
+			spin_unlock(&filp->f_lock);
 			break;
 
 		default:
 			error = -ENOTTY;
+			/* sockets do their own locking */
+			if (S_ISSOCK(filp->f_dentry->d_inode->i_mode)) {
+				if (filp->f_op && filp->f_op->ioctl)
+					error = filp->f_op->ioctl(filp->f_dentry->d_inode, filp, cmd, arg);
+				break;
+			}
+			lock_kernel();
 			if (S_ISREG(filp->f_dentry->d_inode->i_mode))
 				error = file_ioctl(filp, cmd, arg);
 			else if (filp->f_op && filp->f_op->ioctl)
 				error = filp->f_op->ioctl(filp->f_dentry->d_inode, filp, cmd, arg);
+			unlock_kernel();
 	}
-	unlock_kernel();
 	fput(filp);
 
 out:
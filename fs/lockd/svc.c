@@ -77,8 +77,7 @@ lockd(struct svc_rqst *rqstp)
 	up(&lockd_start);
 
 	exit_mm(current);
-	current->session = 1;
-	current->pgrp = 1;
+	change_pids(current, 1, 1);
 	sprintf(current->comm, "lockd");
 
 	/* Process request with signals blocked.  */
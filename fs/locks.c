@@ -1175,9 +1175,7 @@ static int lease_modify(struct file_lock **before, int arg, int fd, struct file
 	locks_wake_up_blocks(fl, 0);
 
 	if (arg == F_UNLCK) {
-		filp->f_owner.pid = 0;
-		filp->f_owner.uid = 0;
-		filp->f_owner.euid = 0;
+		f_modown(filp, 0, 0, 0, 1);
 		filp->f_owner.signum = 0;
 		locks_delete_lock(before, 0);
 		fasync_helper(fd, filp, 0, &fl->fl_fasync);
@@ -1269,9 +1267,7 @@ int fcntl_setlease(unsigned int fd, struct file *filp, long arg)
 	fl->fl_next = *before;
 	*before = fl;
 	list_add(&fl->fl_link, &file_lock_list);
-	filp->f_owner.pid = current->pid;
-	filp->f_owner.uid = current->uid;
-	filp->f_owner.euid = current->euid;
+	f_modown(filp, current->pid, current->uid, current->euid, 1);
 out_unlock:
 	unlock_kernel();
 	return error;
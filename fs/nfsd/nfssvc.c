@@ -150,8 +150,7 @@ nfsd(struct svc_rqst *rqstp)
 	MOD_INC_USE_COUNT;
 	lock_kernel();
 	exit_mm(current);
-	current->session = 1;
-	current->pgrp = 1;
+	change_pids(current, 1, 1);
 	sprintf(current->comm, "nfsd");
 	current->fs->umask = 0;
 
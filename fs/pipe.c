@@ -10,14 +10,17 @@
 #include <linux/malloc.h>
 #include <linux/module.h>
 #include <linux/init.h>
+#include <linux/highmem.h>
 
 #include <asm/uaccess.h>
 
 /*
- * We use a start+len construction, which provides full use of the 
- * allocated memory.
- * -- Florian Coosmann (FGC)
- * 
+ * The data is kept in a ring of PIPE_BUFFERS buffers, each of them a
+ * part of a page, so that a pipeline can run several pages ahead and
+ * splice() can put page cache pages into the pipe without copying
+ * them. write() appends to the last buffer as long as its page has
+ * room and belongs to the pipe.
+ *
  * Reads with count = 0 should always return 0.
  * -- Julian Bradfield 1999-06-07.
  */
@@ -35,11 +38,96 @@ void pipe_wait(struct inode * inode)
 	down(PIPE_SEM(*inode));
 }
 
+static void anon_pipe_buf_release(struct pipe_inode_info *info,
+	struct pipe_buffer *pbuf)
+{
+	/* keep one page around, most pipes never need a second one */
+	if (!info->tmp_page)
+		info->tmp_page = pbuf->page;
+	else
+		__free_page(pbuf->page);
+}
+
+struct pipe_buf_operations anon_pipe_buf_ops = {
+	can_merge:	1,
+	release:	anon_pipe_buf_release,
+};
+
+/* A page for a new buffer of the pipe */
+struct page *pipe_alloc_page(struct inode *inode)
+{
+	struct pipe_inode_info *info = inode->i_pipe;
+	struct page *page = info->tmp_page;
+
+	if (page) {
+		info->tmp_page = NULL;
+		return page;
+	}
+	return alloc_page(GFP_HIGHUSER);
+}
+
+/* Queue @len bytes at @offset in @page, the pipe must not be full */
+void pipe_buf_add(struct inode *inode, struct page *page, unsigned int offset,
+	unsigned int len, struct pipe_buf_operations *ops)
+{
+	struct pipe_buffer *pbuf = PIPE_TAILBUF(*inode);
+
+	pbuf->page = page;
+	pbuf->offset = offset;
+	pbuf->len = len;
+	pbuf->ops = ops;
+	PIPE_NRBUFS(*inode)++;
+	PIPE_LEN(*inode) += len;
+}
+
+/* Drop @chars bytes from the current buffer, and the buffer if it is empty */
+void pipe_buf_consume(struct inode *inode, unsigned int chars)
+{
+	struct pipe_inode_info *info = inode->i_pipe;
+	struct pipe_buffer *pbuf = PIPE_CURBUF(*inode);
+
+	pbuf->offset += chars;
+	pbuf->len -= chars;
+	PIPE_LEN(*inode) -= chars;
+	if (!pbuf->len) {
+		pbuf->ops->release(info, pbuf);
+		pbuf->ops = NULL;
+		info->curbuf = (info->curbuf + 1) & (PIPE_BUFFERS - 1);
+		info->nrbufs--;
+	}
+}
+
+/* The last buffer, if write() may append to it */
+static inline struct pipe_buffer *pipe_merge_buf(struct inode *inode)
+{
+	struct pipe_inode_info *info = inode->i_pipe;
+	struct pipe_buffer *pbuf;
+
+	if (!info->nrbufs)
+		return NULL;
+	pbuf = info->bufs + ((info->curbuf + info->nrbufs - 1) & (PIPE_BUFFERS - 1));
+	if (!pbuf->ops->can_merge || pbuf->offset + pbuf->len == PAGE_SIZE)
+		return NULL;
+	return pbuf;
+}
+
+/* How much can be written without waiting */
+static size_t pipe_free(struct inode *inode)
+{
+	struct pipe_buffer *pbuf = pipe_merge_buf(inode);
+	size_t free = (PIPE_BUFFERS - PIPE_NRBUFS(*inode) -
+		       PIPE_RESERVED(*inode)) * PAGE_SIZE;
+
+	if (pbuf)
+		free += PAGE_SIZE - pbuf->offset - pbuf->len;
+	return free;
+}
+
 static ssize_t
 pipe_read(struct file *filp, char *buf, size_t count, loff_t *ppos)
 {
 	struct inode *inode = filp->f_dentry->d_inode;
-	ssize_t size, read, ret;
+	ssize_t read, ret;
 
 	/* Seeks are not allowed on pipes.  */
 	ret = -ESPIPE;
@@ -84,30 +172,27 @@ do_more_read:
 
 	/* Read what data is available.  */
 	ret = -EFAULT;
-	while (count > 0 && (size = PIPE_LEN(*inode))) {
-		char *pipebuf = PIPE_BASE(*inode) + PIPE_START(*inode);
-		ssize_t chars = PIPE_MAX_RCHUNK(*inode);
+	while (count > 0 && !PIPE_EMPTY(*inode)) {
+		struct pipe_buffer *pbuf = PIPE_CURBUF(*inode);
+		ssize_t chars = pbuf->len;
+		char *pipebuf;
+		int error;
 
 		if (chars > count)
 			chars = count;
-		if (chars > size)
-			chars = size;
 
-		if (copy_to_user(buf, pipebuf, chars))
+		pipebuf = kmap(pbuf->page);
+		error = copy_to_user(buf, pipebuf + pbuf->offset, chars);
+		kunmap(pbuf->page);
+		if (error)
 			goto out;
 
 		read += chars;
-		PIPE_START(*inode) += chars;
-		PIPE_START(*inode) &= (PIPE_SIZE - 1);
-		PIPE_LEN(*inode) -= chars;
+		pipe_buf_consume(inode, chars);
 		count -= chars;
 		buf += chars;
 	}
 
-	/* Cache behaviour optimization */
-	if (!PIPE_LEN(*inode))
-		PIPE_START(*inode) = 0;
-
 	if (count && PIPE_WAITING_WRITERS(*inode) && !(filp->f_flags & O_NONBLOCK)) {
 		/*
 		 * We know that we are going to sleep: signal
@@ -162,10 +247,10 @@ pipe_write(struct file *filp, const char *buf, size_t count, loff_t *ppos)
 	/* Wait, or check for, available space.  */
 	if (filp->f_flags & O_NONBLOCK) {
 		ret = -EAGAIN;
-		if (PIPE_FREE(*inode) < free)
+		if (pipe_free(inode) < free)
 			goto out;
 	} else {
-		while (PIPE_FREE(*inode) < free) {
+		while (pipe_free(inode) < free) {
 			PIPE_WAITING_WRITERS(*inode)++;
 			pipe_wait(inode);
 			PIPE_WAITING_WRITERS(*inode)--;
@@ -181,24 +266,55 @@ pipe_write(struct file *filp, const char *buf, size_t count, loff_t *ppos)
 	/* Copy into available space.  */
 	ret = -EFAULT;
 	while (count > 0) {
-		int space;
-		char *pipebuf = PIPE_BASE(*inode) + PIPE_END(*inode);
-		ssize_t chars = PIPE_MAX_WCHUNK(*inode);
+		struct pipe_buffer *pbuf = pipe_merge_buf(inode);
+		struct page *page;
+		char *pipebuf;
+		ssize_t chars;
+		int error;
+
+		if (pbuf) {
+			chars = PAGE_SIZE - pbuf->offset - pbuf->len;
+			if (chars > count)
+				chars = count;
+
+			pipebuf = kmap(pbuf->page);
+			error = copy_from_user(pipebuf + pbuf->offset + pbuf->len,
+					       buf, chars);
+			kunmap(pbuf->page);
+			if (error)
+				goto out;
+
+			pbuf->len += chars;
+			PIPE_LEN(*inode) += chars;
+			written += chars;
+			count -= chars;
+			buf += chars;
+			continue;
+		}
 
-		if ((space = PIPE_FREE(*inode)) != 0) {
+		if (!PIPE_FULL(*inode)) {
+			ret = -ENOMEM;
+			page = pipe_alloc_page(inode);
+			if (!page)
+				goto out;
+			chars = PAGE_SIZE;
 			if (chars > count)
 				chars = count;
-			if (chars > space)
-				chars = space;
 
-			if (copy_from_user(pipebuf, buf, chars))
+			pipebuf = kmap(page);
+			error = copy_from_user(pipebuf, buf, chars);
+			kunmap(page);
+			if (error) {
+				inode->i_pipe->tmp_page = page;
+				ret = -EFAULT;
 				goto out;
+			}
 
+			pipe_buf_add(inode, page, 0, chars, &anon_pipe_buf_ops);
 			written += chars;
-			PIPE_LEN(*inode) += chars;
 			count -= chars;
 			buf += chars;
-			space = PIPE_FREE(*inode);
+			ret = -EFAULT;
 			continue;
 		}
 
@@ -220,7 +336,7 @@ pipe_write(struct file *filp, const char *buf, size_t count, loff_t *ppos)
 				goto out;
 			if (!PIPE_READERS(*inode))
 				goto sigpipe;
-		} while (!PIPE_FREE(*inode));
+		} while (!pipe_free(inode));
 		ret = -EFAULT;
 	}
 
@@ -285,9 +401,12 @@ pipe_poll(struct file *filp, poll_table *wait)
 	poll_wait(filp, PIPE_WAIT(*inode), wait);
 
 	/* Reading only -- no need for acquiring the semaphore.  */
-	mask = POLLIN | POLLRDNORM;
-	if (PIPE_EMPTY(*inode))
-		mask = POLLOUT | POLLWRNORM;
+	mask = 0;
+	if (!PIPE_EMPTY(*inode))
+		mask |= POLLIN | POLLRDNORM;
+	/* a free buffer takes at least PIPE_BUF bytes */
+	if (!PIPE_FULL(*inode))
+		mask |= POLLOUT | POLLWRNORM;
 	if (!PIPE_WRITERS(*inode) && filp->f_version != PIPE_WCOUNTER(*inode))
 		mask |= POLLHUP;
 	if (!PIPE_READERS(*inode))
@@ -306,10 +425,7 @@ pipe_release(struct inode *inode, int decr, int decw)
 	PIPE_READERS(*inode) -= decr;
 	PIPE_WRITERS(*inode) -= decw;
 	if (!PIPE_READERS(*inode) && !PIPE_WRITERS(*inode)) {
-		struct pipe_inode_info *info = inode->i_pipe;
-		inode->i_pipe = NULL;
-		free_page((unsigned long) info->base);
-		kfree(info);
+		free_pipe_info(inode);
 	} else {
 		wake_up_interruptible(PIPE_WAIT(*inode));
 	}
@@ -441,27 +557,33 @@ struct file_operations rdwr_pipe_fops = {
 
 struct inode* pipe_new(struct inode* inode)
 {
-	unsigned long page;
-
-	page = __get_free_page(GFP_USER);
-	if (!page)
-		return NULL;
-
 	inode->i_pipe = kmalloc(sizeof(struct pipe_inode_info), GFP_KERNEL);
 	if (!inode->i_pipe)
-		goto fail_page;
+		return NULL;
 
+	memset(inode->i_pipe, 0, sizeof(struct pipe_inode_info));
 	init_waitqueue_head(PIPE_WAIT(*inode));
-	PIPE_BASE(*inode) = (char*) page;
-	PIPE_START(*inode) = PIPE_LEN(*inode) = 0;
-	PIPE_READERS(*inode) = PIPE_WRITERS(*inode) = 0;
-	PIPE_WAITING_READERS(*inode) = PIPE_WAITING_WRITERS(*inode) = 0;
+	PIPE_LEN(*inode) = 0;
 	PIPE_RCOUNTER(*inode) = PIPE_WCOUNTER(*inode) = 1;
 
 	return inode;
-fail_page:
-	free_page(page);
-	return NULL;
+}
+
+void free_pipe_info(struct inode* inode)
+{
+	struct pipe_inode_info *info = inode->i_pipe;
+	int i;
+
+	inode->i_pipe = NULL;
+	for (i = 0; i < PIPE_BUFFERS; i++) {
+		struct pipe_buffer *pbuf = info->bufs + i;
+
+		if (pbuf->ops)
+			pbuf->ops->release(info, pbuf);
+	}
+	if (info->tmp_page)
+		__free_page(info->tmp_page);
+	kfree(info);
 }
 
 static struct vfsmount *pipe_mnt;
@@ -576,9 +698,7 @@ close_f12_inode_i_j:
 close_f12_inode_i:
 	put_unused_fd(i);
 close_f12_inode:
-	free_page((unsigned long) PIPE_BASE(*inode));
-	kfree(inode->i_pipe);
-	inode->i_pipe = NULL;
+	free_pipe_info(inode);
 	iput(inode);
 close_f12:
 	put_filp(f2);
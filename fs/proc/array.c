@@ -70,6 +70,7 @@
 #include <linux/smp.h>
 #include <linux/signal.h>
 #include <linux/highmem.h>
+#include <linux/hugetlb.h>
 
 #include <asm/uaccess.h>
 #include <asm/pgtable.h>
@@ -404,6 +405,16 @@ static inline void statm_pte_range(pmd_t * pmd, unsigned long address, unsigned
 
 	if (pmd_none(*pmd))
 		return;
+	if (pmd_huge(*pmd)) {
+		/* a huge page, reserved like the pages skipped below */
+		address &= ~PMD_MASK;
+		end = address + size;
+		if (end > PMD_SIZE)
+			end = PMD_SIZE;
+		*total += (end - address) >> PAGE_SHIFT;
+		*pages += (end - address) >> PAGE_SHIFT;
+		return;
+	}
 	if (pmd_bad(*pmd)) {
 		pmd_ERROR(*pmd);
 		pmd_clear(pmd);
@@ -35,6 +35,7 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/smp_lock.h>
+#include <linux/hugetlb.h>
 
 #include <asm/uaccess.h>
 #include <asm/pgtable.h>
@@ -65,6 +66,17 @@ extern int get_filesystem_list(char *);
 extern int get_filesystem_info(char *);
 extern int get_exec_domain_list(char *);
 extern int get_irq_list(char *);
+extern int get_timer_stats(char *);
+extern int get_softirq_list(char *);
+#ifdef CONFIG_BKL_PROFILE
+extern int get_bkl_profile(char *);
+#endif
+#ifdef CONFIG_WAITQUEUE_STATS
+extern int get_wait_queue_stats(char *);
+#endif
+#ifdef CONFIG_LOCKMETER
+extern int get_lockmeter_info(char *, char **, off_t, int);
+#endif
 extern int get_dma_list(char *);
 extern int get_locks_status (char *, char **, off_t, int);
 extern int get_swaparea_info (char *);
@@ -92,11 +104,11 @@ static int loadavg_read_proc(char *page, char **start, off_t off,
 	a = avenrun[0] + (FIXED_1/200);
 	b = avenrun[1] + (FIXED_1/200);
 	c = avenrun[2] + (FIXED_1/200);
-	len = sprintf(page,"%d.%02d %d.%02d %d.%02d %d/%d %d\n",
+	len = sprintf(page,"%d.%02d %d.%02d %d.%02d %ld/%d %d\n",
 		LOAD_INT(a), LOAD_FRAC(a),
 		LOAD_INT(b), LOAD_FRAC(b),
 		LOAD_INT(c), LOAD_FRAC(c),
-		nr_running, nr_threads, last_pid);
+		nr_running(), nr_threads, last_pid);
 	return proc_calc_metrics(page, start, off, count, eof, len);
 }
 
@@ -181,8 +193,8 @@ static int meminfo_read_proc(char *page, char **start, off_t off,
                 K(i.sharedram),
                 K(i.bufferram),
                 K(atomic_read(&page_cache_size)),
-		K(nr_active_pages),
-		K(nr_inactive_dirty_pages),
+		K(nr_active_pages()),
+		K(nr_inactive_dirty_pages()),
 		K(nr_inactive_clean_pages()),
 		K(inactive_target),
                 K(i.totalhigh),
@@ -191,6 +203,7 @@ static int meminfo_read_proc(char *page, char **start, off_t off,
                 K(i.freeram-i.freehigh),
                 K(i.totalswap),
                 K(i.freeswap));
+	len += hugetlb_report_meminfo(page + len);
 
 	return proc_calc_metrics(page, start, off, count, eof, len);
 #undef B
@@ -271,9 +284,9 @@ static int kstat_read_proc(char *page, char **start, off_t off,
 	for (i = 0 ; i < smp_num_cpus; i++) {
 		int cpu = cpu_logical_map(i), j;
 
-		user += kstat.per_cpu_user[cpu];
-		nice += kstat.per_cpu_nice[cpu];
-		system += kstat.per_cpu_system[cpu];
+		user += kstat_cpu[cpu].user;
+		nice += kstat_cpu[cpu].nice;
+		system += kstat_cpu[cpu].system;
 		for (j = 0 ; j < NR_IRQS ; j++)
 			sum += kstat.irqs[cpu][j];
 	}
@@ -283,20 +296,20 @@ static int kstat_read_proc(char *page, char **start, off_t off,
 	for (i = 0 ; i < smp_num_cpus; i++)
 		len += sprintf(page + len, "cpu%d %u %u %u %lu\n",
 			i,
-			kstat.per_cpu_user[cpu_logical_map(i)],
-			kstat.per_cpu_nice[cpu_logical_map(i)],
-			kstat.per_cpu_system[cpu_logical_map(i)],
-			jif - (  kstat.per_cpu_user[cpu_logical_map(i)] \
-			           + kstat.per_cpu_nice[cpu_logical_map(i)] \
-			           + kstat.per_cpu_system[cpu_logical_map(i)]));
+			kstat_cpu[cpu_logical_map(i)].user,
+			kstat_cpu[cpu_logical_map(i)].nice,
+			kstat_cpu[cpu_logical_map(i)].system,
+			jif - (  kstat_cpu[cpu_logical_map(i)].user \
+			           + kstat_cpu[cpu_logical_map(i)].nice \
+			           + kstat_cpu[cpu_logical_map(i)].system));
 	len += sprintf(page + len,
-		"page %u %u\n"
-                "swap %u %u\n"
+		"page %lu %lu\n"
+                "swap %lu %lu\n"
 		"intr %u",
-			kstat.pgpgin,
-			kstat.pgpgout,
-			kstat.pswpin,
-			kstat.pswpout,
+			kstat_sum(pgpgin),
+			kstat_sum(pgpgout),
+			kstat_sum(pswpin),
+			kstat_sum(pswpout),
 			sum
 	);
 	for (i = 0 ; i < NR_IRQS ; i++)
@@ -323,10 +336,10 @@ static int kstat_read_proc(char *page, char **start, off_t off,
 	}
 
 	len += sprintf(page + len,
-		"\nctxt %u\n"
+		"\nctxt %lu\n"
 		"btime %lu\n"
 		"processes %lu\n",
-		kstat.context_swtch,
+		kstat_sum(context_swtch),
 		xtime.tv_sec - jif / HZ,
 		total_forks);
 
@@ -357,6 +370,38 @@ static int interrupts_read_proc(char *page, char **start, off_t off,
 }
 #endif
 
+static int timer_stats_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	int len = get_timer_stats(page);
+	return proc_calc_metrics(page, start, off, count, eof, len);
+}
+
+static int softirqs_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	int len = get_softirq_list(page);
+	return proc_calc_metrics(page, start, off, count, eof, len);
+}
+
+#ifdef CONFIG_BKL_PROFILE
+static int bkl_profile_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	int len = get_bkl_profile(page);
+	return proc_calc_metrics(page, start, off, count, eof, len);
+}
+#endif
+
+#ifdef CONFIG_WAITQUEUE_STATS
+static int wqstat_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	int len = get_wait_queue_stats(page);
+	return proc_calc_metrics(page, start, off, count, eof, len);
+}
+#endif
+
 static int filesystems_read_proc(char *page, char **start, off_t off,
 				 int count, int *eof, void *data)
 {
@@ -409,6 +454,16 @@ static int locks_read_proc(char *page, char **start, off_t off,
 	return len;
 }
 
+#ifdef CONFIG_LOCKMETER
+static int lockmeter_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	int len = get_lockmeter_info(page, start, off, count);
+	if (len < count) *eof = 1;
+	return len;
+}
+#endif
+
 static int mounts_read_proc(char *page, char **start, off_t off,
 				 int count, int *eof, void *data)
 {
@@ -416,6 +471,27 @@ static int mounts_read_proc(char *page, char **start, off_t off,
 	return proc_calc_metrics(page, start, off, count, eof, len);
 }
 
+static int lrustat_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	int len = get_lru_stats(page);
+	return proc_calc_metrics(page, start, off, count, eof, len);
+}
+
+static int rastat_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	int len = get_rastat(page);
+	return proc_calc_metrics(page, start, off, count, eof, len);
+}
+
+static int tlbstat_read_proc(char *page, char **start, off_t off,
+				 int count, int *eof, void *data)
+{
+	int len = get_tlb_stats(page);
+	return proc_calc_metrics(page, start, off, count, eof, len);
+}
+
 static int execdomains_read_proc(char *page, char **start, off_t off,
 				 int count, int *eof, void *data)
 {
@@ -532,6 +608,14 @@ void __init proc_misc_init(void)
 		{"partitions",	partitions_read_proc},
 #if !defined(CONFIG_ARCH_S390)
 		{"interrupts",	interrupts_read_proc},
+#endif
+		{"timer_stats",	timer_stats_read_proc},
+		{"softirqs",	softirqs_read_proc},
+#ifdef CONFIG_BKL_PROFILE
+		{"bkl_profile",	bkl_profile_read_proc},
+#endif
+#ifdef CONFIG_WAITQUEUE_STATS
+		{"wqstat",	wqstat_read_proc},
 #endif
 		{"filesystems",	filesystems_read_proc},
 		{"dma",		dma_read_proc},
@@ -541,8 +625,14 @@ void __init proc_misc_init(void)
 		{"rtc",		ds1286_read_proc},
 #endif
 		{"locks",	locks_read_proc},
+#ifdef CONFIG_LOCKMETER
+		{"lockmeter",	lockmeter_read_proc},
+#endif
 		{"mounts",	mounts_read_proc},
 		{"swaps",	swaps_read_proc},
+		{"lrustat",	lrustat_read_proc},
+		{"rastat",	rastat_read_proc},
+		{"tlbstat",	tlbstat_read_proc},
 		{"iomem",	memory_read_proc},
 		{"execdomains",	execdomains_read_proc},
 		{NULL,}
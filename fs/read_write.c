@@ -24,19 +24,26 @@ ssize_t generic_read_dir(struct file *filp, char *buf, size_t siz, loff_t *ppos)
 	return -EISDIR;
 }
 
-loff_t default_llseek(struct file *file, loff_t offset, int origin)
+/*
+ * Called without the big kernel lock. i_sem keeps the size and the
+ * file position stable against writers and readdir on the same inode.
+ */
+static loff_t llseek_max(struct file *file, loff_t offset, int origin,
+	loff_t max)
 {
+	struct inode *inode = file->f_dentry->d_inode;
 	long long retval;
 
+	down(&inode->i_sem);
 	switch (origin) {
 		case 2:
-			offset += file->f_dentry->d_inode->i_size;
+			offset += inode->i_size;
 			break;
 		case 1:
 			offset += file->f_pos;
 	}
 	retval = -EINVAL;
-	if (offset >= 0) {
+	if (offset >= 0 && offset <= max) {
 		if (offset != file->f_pos) {
 			file->f_pos = offset;
 			file->f_reada = 0;
@@ -44,19 +51,34 @@ loff_t default_llseek(struct file *file, loff_t offset, int origin)
 		}
 		retval = offset;
 	}
+	up(&inode->i_sem);
 	return retval;
 }
 
+loff_t default_llseek(struct file *file, loff_t offset, int origin)
+{
+	return llseek_max(file, offset, origin, ~0ULL >> 1);
+}
+
+/* For filesystems that limit the file size to sb->s_maxbytes */
+loff_t generic_file_llseek(struct file *file, loff_t offset, int origin)
+{
+	return llseek_max(file, offset, origin,
+			  file->f_dentry->d_inode->i_sb->s_maxbytes);
+}
+
 static inline loff_t llseek(struct file *file, loff_t offset, int origin)
 {
-	loff_t (*fn)(struct file *, loff_t, int);
 	loff_t retval;
 
-	fn = default_llseek;
-	if (file->f_op && file->f_op->llseek)
-		fn = file->f_op->llseek;
+	if (!file->f_op || !file->f_op->llseek)
+		return default_llseek(file, offset, origin);
+	if (file->f_op->llseek == generic_file_llseek)
+		return generic_file_llseek(file, offset, origin);
+
+	/* drivers' llseek methods still rely on the kernel lock */
 	lock_kernel();
-	retval = fn(file, offset, origin);
+	retval = file->f_op->llseek(file, offset, origin);
 	unlock_kernel();
 	return retval;
 }
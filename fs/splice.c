@@ -0,0 +1,328 @@
+/*
+ *  linux/fs/splice.c
+ *
+ *  splice(): move data between a pipe and a file without copying it
+ *  through user space.
+ *
+ *  Splicing a file that has a page cache into a pipe puts references
+ *  to the page cache pages into the pipe buffers: no data is copied,
+ *  and the pages are read ahead as for read(). Other files, such as
+ *  sockets, are read straight into pages of the pipe.
+ *
+ *  Splicing out of a pipe writes the pipe pages with the write method
+ *  of the file, as sendfile() does. That is a single copy, into the
+ *  socket buffers or the page cache, instead of two through user space
+ *  and back.
+ *
+ *  A splice moves what it can without waiting once the pipe is ready,
+ *  so it may return less than was asked for.
+ */
+
+#include <linux/mm.h>
+#include <linux/file.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+
+#include <asm/uaccess.h>
+
+static void page_cache_pipe_buf_release(struct pipe_inode_info *info,
+	struct pipe_buffer *pbuf)
+{
+	page_cache_release(pbuf->page);
+}
+
+static struct pipe_buf_operations page_cache_pipe_buf_ops = {
+	can_merge:	0,
+	release:	page_cache_pipe_buf_release,
+};
+
+static inline int is_pipe(struct file *file)
+{
+	struct inode *inode = file->f_dentry->d_inode;
+
+	return S_ISFIFO(inode->i_mode) && inode->i_pipe;
+}
+
+/* do_generic_file_read() actor: queue a reference to the page */
+static int splice_page_actor(read_descriptor_t *desc, struct page *page,
+	unsigned long offset, unsigned long size)
+{
+	struct inode *inode = (struct inode *) desc->buf;
+
+	if (PIPE_FULL(*inode)) {
+		desc->count = 0;
+		return 0;
+	}
+	if (size > desc->count)
+		size = desc->count;
+	page_cache_get(page);
+	pipe_buf_add(inode, page, offset, size, &page_cache_pipe_buf_ops);
+	desc->count -= size;
+	desc->written += size;
+	return size;
+}
+
+static void pipe_put_page(struct inode *inode, struct page *page)
+{
+	if (!inode->i_pipe->tmp_page)
+		inode->i_pipe->tmp_page = page;
+	else
+		__free_page(page);
+}
+
+/*
+ * A lowmem page for splice_read_pages(): the read may sleep for ever,
+ * and a kmap() held that long would starve everybody else of them.
+ */
+static struct page *pipe_alloc_lowmem_page(struct inode *inode)
+{
+	struct page *page = inode->i_pipe->tmp_page;
+
+	if (page && !PageHighMem(page)) {
+		inode->i_pipe->tmp_page = NULL;
+		return page;
+	}
+	return alloc_page(GFP_USER);
+}
+
+/*
+ * Read a file without a page cache into pages of the pipe. Called with
+ * the pipe semaphore held and a free buffer, but a socket or a tty may
+ * sleep in read() for as long as it likes: the semaphore is dropped
+ * around the read, so that the readers of the pipe can go on draining
+ * it meanwhile, and retaken to queue the page.
+ *
+ * What read() returns has been taken from the file and can't be given
+ * back, so the buffer is reserved before the semaphore is dropped: the
+ * writers of the pipe can't fill it up meanwhile, and the page is always
+ * queued.
+ */
+static ssize_t splice_read_pages(struct file *in, loff_t *ppos,
+	struct inode *inode, size_t len)
+{
+	int regular = S_ISREG(in->f_dentry->d_inode->i_mode);
+	ssize_t spliced = 0, ret = 0;
+	mm_segment_t old_fs;
+
+	if (!in->f_op || !in->f_op->read)
+		return -EINVAL;
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	while (len && !PIPE_FULL(*inode) && PIPE_READERS(*inode)) {
+		struct page *page = pipe_alloc_lowmem_page(inode);
+		size_t chars = PAGE_SIZE;
+
+		ret = -ENOMEM;
+		if (!page)
+			break;
+		if (chars > len)
+			chars = len;
+		PIPE_RESERVED(*inode)++;
+		up(PIPE_SEM(*inode));
+		ret = in->f_op->read(in, page_address(page), chars, ppos);
+		down(PIPE_SEM(*inode));
+		PIPE_RESERVED(*inode)--;
+		if (ret <= 0) {
+			pipe_put_page(inode, page);
+			break;
+		}
+		pipe_buf_add(inode, page, 0, ret, &anon_pipe_buf_ops);
+		spliced += ret;
+		len -= ret;
+		/* a socket or tty may block for more, stop with what we got */
+		if (!regular || ret < chars)
+			break;
+	}
+	set_fs(old_fs);
+	return spliced ? spliced : ret;
+}
+
+/* Splice from a file into a pipe */
+static long do_splice_to(struct file *in, loff_t *off_in, struct file *out,
+	size_t len, unsigned int flags)
+{
+	struct inode *in_inode = in->f_dentry->d_inode;
+	struct inode *inode = out->f_dentry->d_inode;
+	loff_t pos, *ppos = &in->f_pos;
+	long ret;
+
+	if (off_in) {
+		if (copy_from_user(&pos, off_in, sizeof(loff_t)))
+			return -EFAULT;
+		ppos = &pos;
+	}
+	ret = locks_verify_area(FLOCK_VERIFY_READ, in_inode, in, *ppos, len);
+	if (ret)
+		return ret;
+
+	if (down_interruptible(PIPE_SEM(*inode)))
+		return -ERESTARTSYS;
+
+	/* Wait for a free buffer */
+	for (;;) {
+		ret = -EPIPE;
+		if (!PIPE_READERS(*inode)) {
+			send_sig(SIGPIPE, current, 0);
+			goto out;
+		}
+		if (!PIPE_FULL(*inode))
+			break;
+		ret = -EAGAIN;
+		if ((flags & SPLICE_F_NONBLOCK) || (out->f_flags & O_NONBLOCK))
+			goto out;
+		PIPE_WAITING_WRITERS(*inode)++;
+		pipe_wait(inode);
+		PIPE_WAITING_WRITERS(*inode)--;
+		ret = -ERESTARTSYS;
+		if (signal_pending(current))
+			goto out;
+	}
+
+	/*
+	 * Only regular files read straight from the page cache: others,
+	 * such as directories or NFS files, check things in their read().
+	 */
+	if (S_ISREG(in_inode->i_mode) && in->f_op &&
+	    in->f_op->read == generic_file_read) {
+		read_descriptor_t desc;
+
+		desc.written = 0;
+		desc.count = len;
+		desc.buf = (char *) inode;
+		desc.error = 0;
+		do_generic_file_read(in, ppos, &desc, splice_page_actor);
+		ret = desc.written;
+		if (!ret)
+			ret = desc.error;
+	} else
+		ret = splice_read_pages(in, ppos, inode, len);
+
+	if (ret > 0) {
+		wake_up_interruptible(PIPE_WAIT(*inode));
+		inode->i_ctime = inode->i_mtime = CURRENT_TIME;
+		mark_inode_dirty(inode);
+	}
+out:
+	up(PIPE_SEM(*inode));
+	if (off_in && ret > 0 && copy_to_user(off_in, &pos, sizeof(loff_t)))
+		ret = -EFAULT;
+	return ret;
+}
+
+/* Splice from a pipe into a file */
+static long do_splice_from(struct file *in, struct file *out, loff_t *off_out,
+	size_t len, unsigned int flags)
+{
+	struct inode *inode = in->f_dentry->d_inode;
+	loff_t pos, *ppos = &out->f_pos;
+	mm_segment_t old_fs;
+	long ret, spliced = 0;
+
+	if (!out->f_op || !out->f_op->write)
+		return -EINVAL;
+	if (off_out) {
+		if (copy_from_user(&pos, off_out, sizeof(loff_t)))
+			return -EFAULT;
+		ppos = &pos;
+	}
+	ret = locks_verify_area(FLOCK_VERIFY_WRITE, out->f_dentry->d_inode,
+				out, *ppos, len);
+	if (ret)
+		return ret;
+
+	if (down_interruptible(PIPE_SEM(*inode)))
+		return -ERESTARTSYS;
+
+	/* Wait for data */
+	while (PIPE_EMPTY(*inode)) {
+		ret = 0;
+		if (!PIPE_WRITERS(*inode))
+			goto out;
+		ret = -EAGAIN;
+		if ((flags & SPLICE_F_NONBLOCK) || (in->f_flags & O_NONBLOCK))
+			goto out;
+		PIPE_WAITING_READERS(*inode)++;
+		pipe_wait(inode);
+		PIPE_WAITING_READERS(*inode)--;
+		ret = -ERESTARTSYS;
+		if (signal_pending(current))
+			goto out;
+	}
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	while (len && !PIPE_EMPTY(*inode)) {
+		struct pipe_buffer *pbuf = PIPE_CURBUF(*inode);
+		size_t chars = pbuf->len;
+		char *addr;
+
+		if (chars > len)
+			chars = len;
+		addr = kmap(pbuf->page);
+		ret = out->f_op->write(out, addr + pbuf->offset, chars, ppos);
+		kunmap(pbuf->page);
+		if (ret <= 0)
+			break;
+		pipe_buf_consume(inode, ret);
+		spliced += ret;
+		len -= ret;
+		if (ret < chars)
+			break;
+	}
+	set_fs(old_fs);
+
+	if (spliced) {
+		ret = spliced;
+		wake_up_interruptible(PIPE_WAIT(*inode));
+	}
+out:
+	up(PIPE_SEM(*inode));
+	if (off_out && ret > 0 && copy_to_user(off_out, &pos, sizeof(loff_t)))
+		ret = -EFAULT;
+	return ret;
+}
+
+/*
+ * One of @fd_in and @fd_out must be a pipe, its offset must be NULL.
+ * The offset of the other one is used and updated instead of its file
+ * position if it is not NULL.
+ */
+asmlinkage long sys_splice(int fd_in, loff_t *off_in, int fd_out,
+	loff_t *off_out, size_t len, unsigned int flags)
+{
+	struct file *in, *out;
+	long ret;
+
+	ret = -EBADF;
+	in = fget(fd_in);
+	if (!in)
+		goto out;
+	out = fget(fd_out);
+	if (!out)
+		goto fput_in;
+	if (!(in->f_mode & FMODE_READ) || !(out->f_mode & FMODE_WRITE))
+		goto fput_out;
+
+	ret = 0;
+	if (!len)
+		goto fput_out;
+
+	ret = -EINVAL;
+	if (is_pipe(out) && !is_pipe(in)) {
+		ret = -ESPIPE;
+		if (!off_out)
+			ret = do_splice_to(in, off_in, out, len, flags);
+	} else if (is_pipe(in) && !is_pipe(out)) {
+		ret = -ESPIPE;
+		if (!off_in)
+			ret = do_splice_from(in, out, off_out, len, flags);
+	}
+
+fput_out:
+	fput(out);
+fput_in:
+	fput(in);
+out:
+	return ret;
+}
@@ -741,6 +741,7 @@ static struct super_block * read_super(kdev_t dev, struct block_device *bdev,
 	s->s_bdev = bdev;
 	s->s_flags = flags;
 	s->s_dirt = 0;
+	s->s_maxbytes = ~0ULL >> 1;
 	sema_init(&s->s_vfs_rename_sem,1);
 	sema_init(&s->s_nfsd_free_path_sem,1);
 	s->s_type = type;
@@ -733,6 +733,7 @@ magic_found:
 	 */
 	sb->s_blocksize =  SWAB32(usb1->fs_fsize);
 	sb->s_blocksize_bits = SWAB32(usb1->fs_fshift);
+	sb->s_maxbytes = 0xffffffffULL;	/* offsets fit in 32 bits */
 	sb->s_op = &ufs_super_ops;
 	sb->dq_op = NULL; /***/
 	sb->s_magic = SWAB32(usb3->fs_magic);
@@ -0,0 +1,94 @@
+#ifndef _ASM_GENERIC_TLB_H
+#define _ASM_GENERIC_TLB_H
+
+/*
+ * Batched TLB flushing for unmapping user pages.
+ *
+ * zap_page_range() and exit_mmap() clear the ptes of a range and hand
+ * the pages they mapped to an mmu_gather. The TLBs are flushed once for
+ * a whole batch of pages, and only then are the pages freed, so that
+ * no CPU can still reach a page through a stale TLB entry once it is
+ * reused. With only one CPU there's no one to race with, and the pages
+ * are freed at once.
+ *
+ * There is one gather per CPU, used with the page_table_lock held.
+ */
+
+#include <linux/config.h>
+#include <linux/threads.h>
+#include <linux/cache.h>
+#include <linux/smp.h>
+#include <linux/swap.h>
+#include <asm/pgalloc.h>
+
+/* enough pages to fill one page together with the rest of the gather */
+#define FREE_PTE_NR	506
+
+typedef struct mmu_gather {
+	struct mm_struct	*mm;
+	unsigned long		nr;		/* ~0UL: free the pages at once */
+	unsigned long		start, end;	/* end == 0: the whole mm */
+	struct page		*pages[FREE_PTE_NR];
+} mmu_gather_t;
+
+extern mmu_gather_t mmu_gathers[NR_CPUS];
+
+/* /proc/tlbstat, per CPU */
+struct tlb_stat {
+	unsigned long	ipis;		/* flush IPIs sent to other CPUs */
+	unsigned long	flushes;	/* batches flushed */
+	unsigned long	pages;		/* pages unmapped */
+} ____cacheline_aligned;
+
+extern struct tlb_stat tlb_stat[NR_CPUS];
+
+extern int unmap_page_range(mmu_gather_t *tlb, struct mm_struct *mm,
+			unsigned long address, unsigned long size);
+
+static inline mmu_gather_t *tlb_gather_mmu(struct mm_struct *mm,
+	unsigned long start, unsigned long end)
+{
+	mmu_gather_t *tlb = &mmu_gathers[smp_processor_id()];
+
+	tlb->mm = mm;
+	tlb->nr = smp_num_cpus > 1 ? 0UL : ~0UL;
+	tlb->start = start;
+	tlb->end = end;
+	return tlb;
+}
+
+static inline void tlb_flush_mmu(mmu_gather_t *tlb)
+{
+	unsigned long i, nr = tlb->nr;
+
+	if (tlb->end)
+		flush_tlb_range(tlb->mm, tlb->start, tlb->end);
+	else
+		flush_tlb_mm(tlb->mm);
+	tlb_stat[smp_processor_id()].flushes++;
+	if (nr == ~0UL)
+		return;
+	tlb->nr = 0;
+	for (i = 0; i < nr; i++)
+		free_page_and_swap_cache(tlb->pages[i]);
+}
+
+/* The pte of @page has been cleared: free it after the next flush */
+static inline void tlb_remove_page(mmu_gather_t *tlb, struct page *page)
+{
+	tlb_stat[smp_processor_id()].pages++;
+	if (tlb->nr == ~0UL) {
+		free_page_and_swap_cache(page);
+		return;
+	}
+	tlb->pages[tlb->nr++] = page;
+	if (tlb->nr >= FREE_PTE_NR)
+		tlb_flush_mmu(tlb);
+}
+
+static inline void tlb_finish_mmu(mmu_gather_t *tlb)
+{
+	tlb_flush_mmu(tlb);
+}
+
+#endif /* _ASM_GENERIC_TLB_H */
@@ -53,6 +53,15 @@ static __inline__ void clear_bit(int nr, volatile void * addr)
 		:"Ir" (nr));
 }
 
+/* WARNING: non atomic and it can be reordered! */
+static __inline__ void __clear_bit(int nr, volatile void * addr)
+{
+	__asm__(
+		"btrl %1,%0"
+		:"=m" (ADDR)
+		:"Ir" (nr));
+}
+
 static __inline__ void change_bit(int nr, volatile void * addr)
 {
 	__asm__ __volatile__( LOCK_PREFIX
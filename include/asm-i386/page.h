@@ -65,6 +65,19 @@ typedef struct { unsigned long pgprot; } pgprot_t;
 /* to align the pointer to the (next) page boundary */
 #define PAGE_ALIGN(addr)	(((addr)+PAGE_SIZE-1)&PAGE_MASK)
 
+#ifdef CONFIG_HUGETLB_PAGE
+/* A huge page is mapped by one pmd entry: 4MB, or 2MB with PAE */
+#ifdef CONFIG_X86_PAE
+#define HPAGE_SHIFT	21
+#else
+#define HPAGE_SHIFT	22
+#endif
+#define HPAGE_SIZE	(1UL << HPAGE_SHIFT)
+#define HPAGE_MASK	(~(HPAGE_SIZE-1))
+#define HUGETLB_PAGE_ORDER	(HPAGE_SHIFT - PAGE_SHIFT)
+#define HPAGE_ALIGN(addr)	(((addr)+HPAGE_SIZE-1)&HPAGE_MASK)
+#endif
+
 /*
  * This handles the memory map.. We could make this a config
  * option, but too many people screw it up, and too few need
@@ -117,6 +117,8 @@ extern inline pte_t * pte_alloc_kernel(pmd_t * pmd, unsigned long address)
 	return (pte_t *) pmd_page(*pmd) + address;
 }
 
+#define pmd_populate(pmd, pte)	set_pmd(pmd, __pmd(_PAGE_TABLE + __pa(pte)))
+
 //建立页中间目录表对应表项
 extern inline pte_t * pte_alloc(pmd_t * pmd, unsigned long address)
 {
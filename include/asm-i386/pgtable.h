@@ -313,6 +313,19 @@ static inline pte_t pte_modify(pte_t pte, pgprot_t newprot)
 #define pmd_page(pmd) \
 ((unsigned long) __va(pmd_val(pmd) & PAGE_MASK))
 
+#ifdef CONFIG_HUGETLB_PAGE
+/*
+ * A user pmd that maps a huge page itself instead of a page table,
+ * see mm/hugetlb.c. Only set up when the CPU has PSE.
+ */
+#define huge_page_supported()	cpu_has_pse
+#define pmd_huge(pmd)		(pmd_val(pmd) & _PAGE_PSE)
+#define mk_huge_pmd(page, pgprot) \
+	__pmd(pte_val(mk_pte((page), (pgprot))) | _PAGE_PSE)
+#define huge_pmd_page(pmd) \
+	(mem_map + (unsigned long) (pmd_val(pmd) >> PAGE_SHIFT))
+#endif
+
 /* to find an entry in a page-table-directory. */
 #define pgd_index(address) ((address >> PGDIR_SHIFT) & (PTRS_PER_PGD-1))
 
@@ -12,13 +12,26 @@ extern spinlock_t kernel_flag;
 
 #define kernel_locked()		spin_is_locked(&kernel_flag)
 
+/*
+ * With CONFIG_BKL_PROFILE every acquisition goes out of line so that
+ * the caller, the time spent spinning and the hold time can be
+ * charged to it (see /proc/bkl_profile).
+ */
+#ifdef CONFIG_BKL_PROFILE
+extern void __lock_kernel_flag(void);
+extern void __unlock_kernel_flag(void);
+#else
+#define __lock_kernel_flag()	spin_lock(&kernel_flag)
+#define __unlock_kernel_flag()	spin_unlock(&kernel_flag)
+#endif
+
 /*
  * Release global kernel lock and global interrupt lock
  */
 #define release_kernel_lock(task, cpu) \
 do { \
 	if (task->lock_depth >= 0) \
-		spin_unlock(&kernel_flag); \
+		__unlock_kernel_flag(); \
 	release_irqlock(cpu); \
 	__sti(); \
 } while (0)
@@ -29,7 +42,7 @@ do { \
 #define reacquire_kernel_lock(task) \
 do { \
 	if (task->lock_depth >= 0) \
-		spin_lock(&kernel_flag); \
+		__lock_kernel_flag(); \
 } while (0)
 
 
@@ -44,7 +57,7 @@ extern __inline__ void lock_kernel(void)
 {
 #if 1
 	if (!++current->lock_depth)
-		spin_lock(&kernel_flag);
+		__lock_kernel_flag();
 #else
 	__asm__ __volatile__(
 		"incl %1\n\t"
@@ -62,7 +75,7 @@ extern __inline__ void unlock_kernel(void)
 		BUG();
 #if 1
 	if (--current->lock_depth < 0)
-		spin_unlock(&kernel_flag);
+		__unlock_kernel_flag();
 #else
 	__asm__ __volatile__(
 		"decl %1\n\t"
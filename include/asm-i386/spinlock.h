@@ -23,6 +23,10 @@ typedef struct {
 #if SPINLOCK_DEBUG
 	unsigned magic;
 #endif
+#ifdef CONFIG_LOCKMETER
+	void *where;		/* lock site of the holder */
+	unsigned long long acquired;	/* cycles */
+#endif
 } spinlock_t;
 
 #define SPINLOCK_MAGIC	0xdead4ead
@@ -65,7 +69,7 @@ typedef struct {
 #define spin_unlock_string \
 	"movb $1,%0"
 
-static inline int spin_trylock(spinlock_t *lock)
+static inline int _raw_spin_trylock(spinlock_t *lock)
 {
 	char oldval;
 	__asm__ __volatile__(
@@ -75,7 +79,7 @@ static inline int spin_trylock(spinlock_t *lock)
 	return oldval > 0;
 }
 
-static inline void spin_lock(spinlock_t *lock)
+static inline void _raw_spin_lock(spinlock_t *lock)
 {
 #if SPINLOCK_DEBUG
 	__label__ here;
@@ -90,7 +94,7 @@ printk("eip: %p\n", &&here);
 		:"=m" (lock->lock) : : "memory");
 }
 
-static inline void spin_unlock(spinlock_t *lock)
+static inline void _raw_spin_unlock(spinlock_t *lock)
 {
 #if SPINLOCK_DEBUG
 	if (lock->magic != SPINLOCK_MAGIC)
@@ -118,6 +122,10 @@ typedef struct {
 #if SPINLOCK_DEBUG
 	unsigned magic;
 #endif
+#ifdef CONFIG_LOCKMETER
+	void *where;		/* lock site of the writer */
+	unsigned long long acquired;	/* cycles */
+#endif
 } rwlock_t;
 
 #define RWLOCK_MAGIC	0xdeaf1eed
@@ -143,7 +151,7 @@ typedef struct {
  */
 /* the spinlock helpers are in arch/i386/kernel/semaphore.c */
 
-static inline void read_lock(rwlock_t *rw)
+static inline void _raw_read_lock(rwlock_t *rw)
 {
 #if SPINLOCK_DEBUG
 	if (rw->magic != RWLOCK_MAGIC)
@@ -152,7 +160,7 @@ static inline void read_lock(rwlock_t *rw)
 	__build_read_lock(rw, "__read_lock_failed");
 }
 
-static inline void write_lock(rwlock_t *rw)
+static inline void _raw_write_lock(rwlock_t *rw)
 {
 #if SPINLOCK_DEBUG
 	if (rw->magic != RWLOCK_MAGIC)
@@ -161,10 +169,10 @@ static inline void write_lock(rwlock_t *rw)
 	__build_write_lock(rw, "__write_lock_failed");
 }
 
-#define read_unlock(rw)		asm volatile("lock ; incl %0" :"=m" ((rw)->lock) : : "memory")
-#define write_unlock(rw)	asm volatile("lock ; addl $" RW_LOCK_BIAS_STR ",%0":"=m" ((rw)->lock) : : "memory")
+#define _raw_read_unlock(rw)	asm volatile("lock ; incl %0" :"=m" ((rw)->lock) : : "memory")
+#define _raw_write_unlock(rw)	asm volatile("lock ; addl $" RW_LOCK_BIAS_STR ",%0":"=m" ((rw)->lock) : : "memory")
 
-static inline int write_trylock(rwlock_t *lock)
+static inline int _raw_write_trylock(rwlock_t *lock)
 {
 	atomic_t *count = (atomic_t *)lock;
 	if (atomic_sub_and_test(RW_LOCK_BIAS, count))
@@ -173,4 +181,42 @@ static inline int write_trylock(rwlock_t *lock)
 	return 0;
 }
 
+/*
+ * With CONFIG_LOCKMETER every lock operation goes through
+ * kernel/lockmeter.c, which charges acquisitions, spin time and hold
+ * time to the caller's address in per-CPU tables. Hold times are
+ * not kept for readers: there can be any number of them at once.
+ */
+#ifndef CONFIG_LOCKMETER
+
+#define spin_lock(lock)		_raw_spin_lock(lock)
+#define spin_unlock(lock)	_raw_spin_unlock(lock)
+#define spin_trylock(lock)	_raw_spin_trylock(lock)
+#define read_lock(rw)		_raw_read_lock(rw)
+#define read_unlock(rw)		_raw_read_unlock(rw)
+#define write_lock(rw)		_raw_write_lock(rw)
+#define write_unlock(rw)	_raw_write_unlock(rw)
+#define write_trylock(rw)	_raw_write_trylock(rw)
+
+#else
+
+extern void _metered_spin_lock(spinlock_t *);
+extern void _metered_spin_unlock(spinlock_t *);
+extern int _metered_spin_trylock(spinlock_t *);
+extern void _metered_read_lock(rwlock_t *);
+extern void _metered_write_lock(rwlock_t *);
+extern void _metered_write_unlock(rwlock_t *);
+extern int _metered_write_trylock(rwlock_t *);
+
+#define spin_lock(lock)		_metered_spin_lock(lock)
+#define spin_unlock(lock)	_metered_spin_unlock(lock)
+#define spin_trylock(lock)	_metered_spin_trylock(lock)
+#define read_lock(rw)		_metered_read_lock(rw)
+#define read_unlock(rw)		_raw_read_unlock(rw)
+#define write_lock(rw)		_metered_write_lock(rw)
+#define write_unlock(rw)	_metered_write_unlock(rw)
+#define write_trylock(rw)	_metered_write_trylock(rw)
+
+#endif /* CONFIG_LOCKMETER */
+
 #endif /* __ASM_SPINLOCK_H */
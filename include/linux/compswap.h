@@ -0,0 +1,31 @@
+#ifndef _LINUX_COMPSWAP_H
+#define _LINUX_COMPSWAP_H
+
+/*
+ * A compressed cache in memory for swapped out pages, see mm/compswap.c.
+ */
+
+#include <linux/config.h>
+#include <linux/swap.h>
+
+#ifdef CONFIG_COMPSWAP
+
+extern int compswap_store(swp_entry_t entry, struct page *page);
+extern int compswap_load(swp_entry_t entry, struct page *page);
+extern void compswap_invalidate(swp_entry_t entry);
+extern void compswap_invalidate_area(unsigned int type);
+extern int compswap_report(char *buf);
+
+extern int sysctl_compswap_pages;
+
+#else /* !CONFIG_COMPSWAP */
+
+#define compswap_store(entry, page)		0
+#define compswap_load(entry, page)		0
+#define compswap_invalidate(entry)		do { } while (0)
+#define compswap_invalidate_area(type)		do { } while (0)
+#define compswap_report(buf)			0
+
+#endif /* !CONFIG_COMPSWAP */
+
+#endif /* _LINUX_COMPSWAP_H */
@@ -21,6 +21,7 @@
 #include <linux/cache.h>
 #include <linux/stddef.h>
 #include <linux/string.h>
+#include <linux/radix-tree.h>
 
 #include <asm/atomic.h>
 #include <asm/bitops.h>
@@ -396,8 +397,19 @@ struct address_space {
 						/* 共享映射链表 */
 	spinlock_t		i_shared_lock;  /* and spinlock protecting it */
 						/* 自旋锁 */
+	struct radix_tree_root	page_tree;	/* index -> page */
+	spinlock_t		page_lock;	/* and spinlock protecting it */
 };
 
+/*
+ * Radix tree tags of the page cache. They follow the inode page lists:
+ * a page is tagged dirty while it is on dirty_pages, and writeback
+ * while it is on locked_pages, so a range of either can be found
+ * without walking the whole list.
+ */
+#define PAGECACHE_TAG_DIRTY	0
+#define PAGECACHE_TAG_WRITEBACK	1
+
 struct block_device {
 	struct list_head	bd_hash;
 	atomic_t		bd_count;
@@ -514,21 +526,54 @@ static inline void mark_inode_dirty_pages(struct inode *inode)
 }
 
 struct fown_struct {
+	rwlock_t lock;		/* protects pid, uid, euid fields */
 	int pid;		/* pid or -pgrp where SIGIO should be sent */
 	uid_t uid, euid;	/* uid/euid of process setting the owner */
 	int signum;		/* posix.1b rt signal to be delivered on IO */
 };
 
+/*
+ * Read-ahead state of an open file, see mm/filemap.c. Each stream
+ * follows one sequential reader.
+ */
+#define RA_STREAMS	4
+
+struct file_ra_stream {
+	unsigned long	start;		/* first page of the current window */
+	unsigned long	size;		/* its length in pages, 0: unused */
+	unsigned long	ahead_start;	/* first page of the window after it */
+	unsigned long	ahead_size;	/* its length, 0: not started yet */
+	unsigned long	prev_page;	/* the page the reader took last */
+	unsigned long	stamp;		/* when it was used, for replacement */
+};
+
+struct file_ra_state {
+	struct file_ra_stream	streams[RA_STREAMS];
+	unsigned long		stamp;
+	unsigned long		max_size;	/* window limit after thrashing, 0: none */
+	unsigned long		hits;		/* pages found in the cache */
+	unsigned long		misses;		/* pages we had to wait for */
+	unsigned long		thrashed;	/* read ahead, but gone before use */
+	unsigned long		windows;	/* read-ahead windows started */
+};
+
 struct file {
 	struct list_head	f_list;
 	struct dentry		*f_dentry;
 	struct vfsmount         *f_vfsmnt;
 	struct file_operations	*f_op;
 	atomic_t		f_count;
+	/*
+	 * Serializes changes of f_flags once the file is in an fd table,
+	 * where fcntl(), ioctl()s and drivers may change it at the same
+	 * time. Setting the flags up in open() before then needs no lock.
+	 */
+	spinlock_t		f_lock;
 	unsigned int 		f_flags;
 	mode_t			f_mode;		//权限信息
 	loff_t			f_pos;
-	unsigned long 		f_reada, f_ramax, f_raend, f_ralen, f_rawin;
+	unsigned long 		f_reada;
+	struct file_ra_state	f_ra;
 	struct fown_struct	f_owner;
 	unsigned int		f_uid, f_gid;
 	int			f_error;
@@ -633,6 +678,7 @@ extern int fasync_helper(int, struct file *, int, struct fasync_struct **);
 extern void kill_fasync(struct fasync_struct **, int, int);
 /* only for net: no internal synchronization */
 extern void __kill_fasync(struct fasync_struct *, int, int);
+extern void f_modown(struct file *, int, uid_t, uid_t, int);
 
 //文件路径查找过程中用到的临时结构
 struct nameidata {
@@ -694,6 +740,7 @@ struct super_block {
 	unsigned char		s_blocksize_bits;
 	unsigned char		s_lock;
 	unsigned char		s_dirt;
+	loff_t			s_maxbytes;	/* for generic_file_llseek() */
 	struct file_system_type	*s_type;
 	struct super_operations	*s_op;
 	struct dquot_operations	*dq_op;
@@ -1103,6 +1150,8 @@ extern int osync_inode_buffers(struct inode *);
 extern int inode_has_buffers(struct inode *);
 extern void filemap_fdatasync(struct address_space *);
 extern void filemap_fdatawait(struct address_space *);
+extern void filemap_fdatasync_range(struct address_space *, unsigned long, unsigned long);
+extern void filemap_fdatawait_range(struct address_space *, unsigned long, unsigned long);
 extern void sync_supers(kdev_t);
 extern int bmap(struct inode *, int);
 extern int notify_change(struct dentry *, struct iattr *);
@@ -1191,6 +1240,7 @@ typedef int (*read_actor_t)(read_descriptor_t *, struct page *, unsigned long, u
 
 /* needed for stackable file system support */
 extern loff_t default_llseek(struct file *file, loff_t offset, int origin);
+extern loff_t generic_file_llseek(struct file *file, loff_t offset, int origin);
 
 extern int __user_walk(const char *, unsigned, struct nameidata *);
 extern int path_init(const char *, unsigned, struct nameidata *);
@@ -1276,6 +1326,7 @@ extern int generic_file_mmap(struct file *, struct vm_area_struct *);
 extern ssize_t generic_file_read(struct file *, char *, size_t, loff_t *);
 extern ssize_t generic_file_write(struct file *, const char *, size_t, loff_t *);
 extern void do_generic_file_read(struct file *, loff_t *, read_descriptor_t *, read_actor_t);
+extern int get_rastat(char *);
 
 extern ssize_t generic_read_dir(struct file *, char *, size_t, loff_t *);
 
@@ -0,0 +1,94 @@
+#ifndef _LINUX_HRTIMER_H
+#define _LINUX_HRTIMER_H
+
+#include <linux/config.h>
+#include <linux/list.h>
+#include <linux/types.h>
+#include <linux/time.h>
+
+#include <asm/div64.h>
+
+#define NSEC_PER_USEC	1000L
+#define NSEC_PER_SEC	1000000000L
+
+/*
+ * High resolution timers. Unlike timer_list these are not tied to the
+ * jiffy: "expires" is an absolute hrtimer_now() time in nanoseconds,
+ * and each CPU keeps its pending timers in a queue sorted by expiry
+ * which the architecture fires from a one-shot interrupt (the local
+ * APIC timer on i386).
+ *
+ * The handler runs in hard interrupt context with interrupts off, so
+ * it must only take irq-safe locks. It may re-arm its own timer.
+ */
+struct hrtimer_base;
+
+struct hrtimer {
+	struct list_head list;
+	u64 expires;
+	unsigned long data;
+	void (*function)(unsigned long);
+	struct hrtimer_base *base;
+};
+
+/* Shortest period we let a periodic itimer run at */
+#define HRTIMER_MIN_PERIOD	(10 * NSEC_PER_USEC)
+
+static inline void init_hrtimer(struct hrtimer * timer)
+{
+	timer->list.next = timer->list.prev = NULL;
+	timer->base = NULL;
+}
+
+static inline int hrtimer_pending(const struct hrtimer * timer)
+{
+	return timer->list.next != NULL;
+}
+
+static inline u64 timespec_to_ns(const struct timespec *ts)
+{
+	return (u64) (unsigned long) ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static inline u64 timeval_to_ns(const struct timeval *tv)
+{
+	return (u64) (unsigned long) tv->tv_sec * NSEC_PER_SEC +
+		(unsigned long) tv->tv_usec * NSEC_PER_USEC;
+}
+
+static inline void ns_to_timespec(u64 ns, struct timespec *ts)
+{
+	ts->tv_nsec = do_div(ns, NSEC_PER_SEC);
+	ts->tv_sec = ns;
+}
+
+static inline void ns_to_timeval(u64 ns, struct timeval *tv)
+{
+	tv->tv_usec = do_div(ns, NSEC_PER_SEC) / NSEC_PER_USEC;
+	tv->tv_sec = ns;
+}
+
+#ifdef CONFIG_HIGH_RES_TIMERS
+
+/*
+ * Set by the architecture once its clock and one-shot event source
+ * are running. Until then (or without a usable TSC/APIC) nanosleep
+ * and itimers keep using jiffy based timers.
+ */
+extern int hrtimer_active;
+
+extern void init_hrtimers(void);
+extern int hrtimer_start(struct hrtimer *, u64);
+extern int hrtimer_cancel(struct hrtimer *);
+extern u64 hrtimer_next_event(void);
+extern void hrtimer_run_queues(void);
+extern long hrtimer_nanosleep(struct timespec *, struct timespec *);
+extern void it_real_hr_fn(unsigned long);
+
+/* provided by the architecture */
+extern u64 hrtimer_now(void);
+extern void hrtimer_reprogram(u64);
+
+#endif /* CONFIG_HIGH_RES_TIMERS */
+
+#endif
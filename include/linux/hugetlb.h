@@ -0,0 +1,67 @@
+#ifndef _LINUX_HUGETLB_H
+#define _LINUX_HUGETLB_H
+
+/*
+ * Huge pages for SysV shared memory (SHM_HUGETLB) and anonymous
+ * mappings (MAP_HUGETLB), see mm/hugetlb.c.
+ */
+
+#include <linux/config.h>
+#include <linux/mman.h>
+
+/* only the architectures with huge pages define it */
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB	0
+#endif
+
+struct ctl_table;
+
+#ifdef CONFIG_HUGETLB_PAGE
+
+static inline int is_vm_hugetlb_page(struct vm_area_struct *vma)
+{
+	return vma->vm_flags & VM_HUGETLB;
+}
+
+extern struct inode_operations hugetlb_inode_operations;
+
+#define is_hugetlb_inode(inode)	((inode)->i_op == &hugetlb_inode_operations)
+#define is_file_hugepages(file)	is_hugetlb_inode((file)->f_dentry->d_inode)
+
+extern int hugetlb_reserve(unsigned long nr);
+extern void hugetlb_unreserve(unsigned long nr);
+extern void hugetlb_truncate(struct inode *inode);
+extern unsigned long hugetlb_get_unmapped_area(unsigned long addr,
+			unsigned long len, unsigned long pgoff, unsigned long flags);
+extern int hugetlb_fault(struct mm_struct *mm, struct vm_area_struct *vma,
+			unsigned long address, int write_access);
+extern int hugetlb_check_unmap(struct vm_area_struct *vma,
+			unsigned long addr, unsigned long len);
+extern struct page *follow_huge_pmd(pmd_t *pmd, unsigned long address);
+extern int hugetlb_report_meminfo(char *buf);
+extern int hugetlb_sysctl_handler(struct ctl_table *, int, struct file *,
+			void *, size_t *);
+
+extern struct file *hugetlb_file_setup(char *name, loff_t size);
+extern int hugetlb_zero_setup(struct vm_area_struct *vma);
+
+extern int nr_huge_pages;
+
+#else /* !CONFIG_HUGETLB_PAGE */
+
+#define is_vm_hugetlb_page(vma)			0
+#define is_hugetlb_inode(inode)			0
+#define is_file_hugepages(file)			0
+#define pmd_huge(pmd)				0
+#define hugetlb_truncate(inode)			do { } while (0)
+#define hugetlb_get_unmapped_area(addr, len, pgoff, flags)	0
+#define hugetlb_fault(mm, vma, address, write_access)	0
+#define hugetlb_check_unmap(vma, addr, len)	0
+#define follow_huge_pmd(pmd, address)		NULL
+#define hugetlb_report_meminfo(buf)		0
+#define hugetlb_file_setup(name, size)		ERR_PTR(-EINVAL)
+#define hugetlb_zero_setup(vma)			(-EINVAL)
+
+#endif /* !CONFIG_HUGETLB_PAGE */
+
+#endif /* _LINUX_HUGETLB_H */
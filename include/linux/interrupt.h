@@ -60,6 +60,7 @@ enum
 	HI_SOFTIRQ=0,
 	NET_TX_SOFTIRQ,
 	NET_RX_SOFTIRQ,
+	TIMER_SOFTIRQ,
 	TASKLET_SOFTIRQ
 };
 
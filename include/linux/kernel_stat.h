@@ -5,6 +5,7 @@
 #include <asm/irq.h>
 #include <linux/smp.h>
 #include <linux/threads.h>
+#include <linux/percpu_stat.h>
 
 /*
  * 'kernel_stat.h' contains the definitions needed for doing
@@ -15,24 +16,34 @@
 #define DK_MAX_MAJOR 16
 #define DK_MAX_DISK 16
 
+/*
+ * Counters every CPU updates all the time, kept per CPU (see
+ * <linux/percpu_stat.h>) and summed by /proc/stat.
+ */
+struct kernel_stat_cpu {
+	unsigned int user, nice, system;
+	unsigned int context_swtch;
+	unsigned int pgpgin, pgpgout;
+	unsigned int pswpin, pswpout;
+} ____cacheline_aligned;
+
+extern struct kernel_stat_cpu kstat_cpu[NR_CPUS];
+
+#define kstat_inc(field)	percpu_stat_inc(kstat_cpu, field)
+#define kstat_sum(field)	percpu_stat_sum(kstat_cpu, field)
+
 struct kernel_stat {
-	unsigned int per_cpu_user[NR_CPUS],
-	             per_cpu_nice[NR_CPUS],
-	             per_cpu_system[NR_CPUS];
 	unsigned int dk_drive[DK_MAX_MAJOR][DK_MAX_DISK];
 	unsigned int dk_drive_rio[DK_MAX_MAJOR][DK_MAX_DISK];
 	unsigned int dk_drive_wio[DK_MAX_MAJOR][DK_MAX_DISK];
 	unsigned int dk_drive_rblk[DK_MAX_MAJOR][DK_MAX_DISK];
 	unsigned int dk_drive_wblk[DK_MAX_MAJOR][DK_MAX_DISK];
-	unsigned int pgpgin, pgpgout;
-	unsigned int pswpin, pswpout;
 #if !defined(CONFIG_ARCH_S390)
 	unsigned int irqs[NR_CPUS][NR_IRQS];
 #endif
 	unsigned int ipackets, opackets;
 	unsigned int ierrors, oerrors;
 	unsigned int collisions;
-	unsigned int context_swtch;
 };
 
 extern struct kernel_stat kstat;
@@ -15,9 +15,7 @@ extern unsigned long max_mapnr;
 extern unsigned long num_physpages;
 extern void * high_memory;
 extern int page_cluster;
-/* The inactive_clean lists are per zone. */
-extern struct list_head active_list;
-extern struct list_head inactive_dirty_list;
+/* The active and inactive lists are per zone, see <linux/mmzone.h>. */
 
 #include <asm/page.h>
 #include <asm/pgtable.h>
@@ -100,7 +98,8 @@ struct vm_area_struct {
 
 #define VM_DONTCOPY	0x00020000      /* Do not copy this vma on fork */
 #define VM_DONTEXPAND	0x00040000	/* Cannot expand with mremap() */
-#define VM_RESERVED	0x00080000	/* Don't unmap it from swap_out */
+#define VM_RESERVED	0x00080000	/* Don't unmap it from page reclaim */
+#define VM_HUGETLB	0x00100000	/* Mapped by huge pages, see mm/hugetlb.c */
 
 #define VM_STACK_FLAGS	0x00000177
 
@@ -156,6 +155,7 @@ typedef struct page {
 	struct buffer_head * buffers;
 	void *virtual; /* non-NULL if kmapped */
 	struct zone_struct *zone;
+	struct pte_chain *pte_chain;	/* ptes mapping the page, see mm/rmap.c */
 } mem_map_t;
 
 #define get_page(p)		atomic_inc(&(p)->count)
@@ -178,6 +178,8 @@ typedef struct page {
 #define PG_skip			10
 #define PG_inactive_clean	11
 #define PG_highmem		12
+#define PG_chainlock		13
+#define PG_ptshared		14	/* page table shared by processes */
 				/* bits 21-29 unused */
 #define PG_arch_1		30
 #define PG_reserved		31
@@ -192,6 +194,20 @@ typedef struct page {
 #define PageLocked(page)	test_bit(PG_locked, &(page)->flags)
 #define LockPage(page)		set_bit(PG_locked, &(page)->flags)
 #define TryLockPage(page)	test_and_set_bit(PG_locked, &(page)->flags)
+#define PageLRU(page)		((page)->flags & ((1 << PG_active) | \
+				 (1 << PG_inactive_dirty) | (1 << PG_inactive_clean)))
+
+/* Spinlock on page->pte_chain */
+#define pte_chain_lock(page)	do { \
+		while (test_and_set_bit(PG_chainlock, &(page)->flags)) \
+			while (test_bit(PG_chainlock, &(page)->flags)) \
+				barrier(); \
+	} while (0)
+#define pte_chain_unlock(page)	do { \
+		smp_mb__before_clear_bit(); \
+		clear_bit(PG_chainlock, &(page)->flags); \
+	} while (0)
+#define pte_chain_trylock(page)	(!test_and_set_bit(PG_chainlock, &(page)->flags))
 
 extern void __set_page_dirty(struct page *);
 
@@ -256,6 +272,14 @@ static inline void set_page_dirty(struct page * page)
 #define PageHighMem(page)		0 /* needed to optimize away at compile time */
 #endif
 
+#ifdef CONFIG_SHAREPTE
+#define PagePtShared(page)		test_bit(PG_ptshared, &(page)->flags)
+#else
+#define PagePtShared(page)		0
+#endif
+#define SetPagePtShared(page)		set_bit(PG_ptshared, &(page)->flags)
+#define ClearPagePtShared(page)		clear_bit(PG_ptshared, &(page)->flags)
+
 #define SetPageReserved(page)		set_bit(PG_reserved, &(page)->flags)
 #define ClearPageReserved(page)		clear_bit(PG_reserved, &(page)->flags)
 
@@ -309,9 +333,8 @@ static inline void set_page_dirty(struct page * page)
  * All pages belonging to an inode make up a doubly linked list
  * inode->i_pages, using the fields page->next and page->prev. (These
  * fields are also used for freelist management when page->count==0.)
- * There is also a hash table mapping (inode,offset) to the page
- * in memory if present. The lists for this hash table use the fields
- * page->next_hash and page->pprev_hash.
+ * The radix tree in the address_space maps the page index to the
+ * page in memory if present.
  *
  * All process pages can do I/O:
  * - inode pages may need to be read from disk,
@@ -375,7 +398,7 @@ extern unsigned long FASTCALL(get_zeroed_page(int gfp_mask));
 		__get_free_pages((gfp_mask),0)
 
 #define __get_dma_pages(gfp_mask, order) \
-		__get_free_pages((gfp_mask) | GFP_DMA,(order))
+		__get_free_pages((gfp_mask) | GFP_DMA | __GFP_COLD,(order))
 
 /*
  * The old interface name will be removed in 2.5:
@@ -387,6 +410,7 @@ extern unsigned long FASTCALL(get_zeroed_page(int gfp_mask));
  */
 extern void FASTCALL(__free_pages(struct page *page, unsigned long order));
 extern void FASTCALL(free_pages(unsigned long addr, unsigned long order));
+extern void FASTCALL(free_cold_page(struct page *page));
 
 #define __free_page(page) __free_pages((page), 0)
 #define free_page(addr) free_pages((addr),0)
@@ -401,6 +425,7 @@ struct file *shmem_file_setup(char * name, loff_t size);
 extern int shmem_zero_setup(struct vm_area_struct *);
 
 extern void zap_page_range(struct mm_struct *mm, unsigned long address, unsigned long size);
+extern int get_tlb_stats(char *);
 extern int copy_page_range(struct mm_struct *dst, struct mm_struct *src, struct vm_area_struct *vma);
 extern int remap_page_range(unsigned long from, unsigned long to, unsigned long size, pgprot_t prot);
 extern int zeromap_page_range(unsigned long from, unsigned long size, pgprot_t prot);
@@ -424,6 +449,20 @@ extern void show_mem(void);
 extern void si_meminfo(struct sysinfo * val);
 extern void swapin_readahead(swp_entry_t);
 
+/*
+ * vmscan.c: a shrinker is called with the number of objects to free
+ * (0 to just count) and the gfp_mask of the allocation. It returns how
+ * many freeable objects are left, or -1 if it can't free any with this
+ * gfp_mask.
+ */
+typedef int (*shrinker_t)(int nr_to_scan, unsigned int gfp_mask);
+
+#define DEFAULT_SEEKS	2
+
+struct shrinker;
+extern struct shrinker *set_shrinker(int seeks, shrinker_t shrink);
+extern void remove_shrinker(struct shrinker *shrinker);
+
 /* mmap.c */
 extern void lock_vma_mappings(struct vm_area_struct *);
 extern void unlock_vma_mappings(struct vm_area_struct *);
@@ -476,12 +515,14 @@ extern struct page *filemap_nopage(struct vm_area_struct *, unsigned long, int);
 #else
 #define __GFP_HIGHMEM	0x0 /* noop */
 #endif
+#define __GFP_COLD	0x20	/* page won't be touched by the CPU soon */
+#define __GFP_MOVABLE	0x40	/* page can be migrated or reclaimed */
 
 
 #define GFP_BUFFER	(__GFP_HIGH | __GFP_WAIT)
 #define GFP_ATOMIC	(__GFP_HIGH)
 #define GFP_USER	(             __GFP_WAIT | __GFP_IO)
-#define GFP_HIGHUSER	(             __GFP_WAIT | __GFP_IO | __GFP_HIGHMEM)
+#define GFP_HIGHUSER	(             __GFP_WAIT | __GFP_IO | __GFP_HIGHMEM | __GFP_MOVABLE)
 #define GFP_KERNEL	(__GFP_HIGH | __GFP_WAIT | __GFP_IO)
 #define GFP_NFS		(__GFP_HIGH | __GFP_WAIT | __GFP_IO)
 #define GFP_KSWAPD	(                          __GFP_IO)
@@ -7,20 +7,70 @@
 #include <linux/config.h>
 #include <linux/spinlock.h>
 #include <linux/list.h>
+#include <linux/cache.h>
+#include <linux/threads.h>
 
 /*
  * Free memory management - zoned buddy allocator.
  */
 
+#if defined(CONFIG_HUGETLB_PAGE) && !defined(CONFIG_X86_PAE)
+#define MAX_ORDER 11		/* the 4MB pages of mm/hugetlb.c */
+#else
 #define MAX_ORDER 10
+#endif
+
+/*
+ * Anti-fragmentation: every zone is divided into blocks of
+ * 2^PAGEBLOCK_ORDER pages, each tagged with the kind of allocation
+ * it serves, and the free lists are kept per kind. Page cache and
+ * user pages (__GFP_MOVABLE) can be migrated or reclaimed, kernel
+ * memory can't; keeping them in separate blocks means the movable
+ * blocks can be emptied again to satisfy a high-order allocation.
+ */
+#define MIGRATE_UNMOVABLE	0
+#define MIGRATE_MOVABLE		1
+#define MIGRATE_TYPES		2
+
+#define PAGEBLOCK_ORDER		(MAX_ORDER-1)
 
 typedef struct free_area_struct {
-	struct list_head	free_list;
+	struct list_head	free_list[MIGRATE_TYPES];
 	unsigned int		*map;		//位图
 } free_area_t;
 
 struct pglist_data;
 
+/*
+ * Per-CPU lists of free order-0 pages, see mm/page_alloc.c.
+ */
+struct per_cpu_pages {
+	int			count;		/* pages on the list */
+	int			high;		/* drain a batch above this */
+	int			batch;		/* pages moved to/from the buddy at once */
+	struct list_head	list;
+};
+
+struct per_cpu_pageset {
+	struct per_cpu_pages	pcp[2];		/* 0: hot, 1: cold */
+} ____cacheline_aligned;
+
+/*
+ * Page reclaim statistics, per zone and LRU list, shown in
+ * /proc/lrustat. Updated under the zone's lru_lock.
+ */
+#define LRU_ACTIVE		0
+#define LRU_INACTIVE_DIRTY	1
+#define LRU_INACTIVE_CLEAN	2
+#define NR_LRU_LISTS		3
+
+struct zone_lru_stat {
+	unsigned long		scanned;	/* pages looked at */
+	unsigned long		rotated;	/* put back, still in use or busy */
+	unsigned long		reclaimed;	/* moved down a list, or freed */
+	unsigned long		written;	/* writeback started */
+};
+
 /* 管理区 */
 typedef struct zone_struct {
 	/*
@@ -36,8 +86,21 @@ typedef struct zone_struct {
 	/*
 	 * free areas of different sizes
 	 */
-	struct list_head	inactive_clean_list;
 	free_area_t		free_area[MAX_ORDER];	//空闲页面队列
+	unsigned char		*pageblock_type;	/* MIGRATE_* per pageblock */
+
+	struct per_cpu_pageset	pageset[NR_CPUS];
+
+	/*
+	 * The page lists of the reclaim code, with their own lock so
+	 * that reclaim in one zone doesn't hold up the others.
+	 */
+	spinlock_t		lru_lock ____cacheline_aligned;
+	unsigned long		active_pages;
+	struct list_head	active_list;
+	struct list_head	inactive_dirty_list;
+	struct list_head	inactive_clean_list;
+	struct zone_lru_stat	lru_stat[NR_LRU_LISTS];
 
 	/*
 	 * rarely used fields:
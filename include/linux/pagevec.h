@@ -0,0 +1,42 @@
+#ifndef _LINUX_PAGEVEC_H
+#define _LINUX_PAGEVEC_H
+
+/*
+ * A pagevec is a small batch of pages, so that an operation that
+ * takes a lock per page - like putting new pages on the LRU lists -
+ * can take it once for the whole batch instead.
+ */
+
+#define PAGEVEC_SIZE	16
+
+struct page;
+
+struct pagevec {
+	unsigned int nr;
+	struct page *pages[PAGEVEC_SIZE];
+};
+
+static inline void pagevec_init(struct pagevec *pvec)
+{
+	pvec->nr = 0;
+}
+
+static inline unsigned int pagevec_count(struct pagevec *pvec)
+{
+	return pvec->nr;
+}
+
+/*
+ * Add a page, returns the room left. The caller flushes the pagevec
+ * when that is zero.
+ */
+static inline unsigned int pagevec_add(struct pagevec *pvec, struct page *page)
+{
+	pvec->pages[pvec->nr++] = page;
+	return PAGEVEC_SIZE - pvec->nr;
+}
+
+/* mm/swap.c */
+extern void __pagevec_lru_add(struct pagevec *pvec);
+
+#endif /* _LINUX_PAGEVEC_H */
@@ -0,0 +1,62 @@
+#ifndef _LINUX_PERCPU_STAT_H
+#define _LINUX_PERCPU_STAT_H
+
+#include <linux/smp.h>
+#include <linux/cache.h>
+#include <linux/threads.h>
+
+/*
+ * Per-CPU statistics counters.
+ *
+ * A counter that every CPU bumps on every tick or packet makes its
+ * cache line bounce between the CPUs. Instead the structure holding
+ * the counters is replicated once per CPU, and each CPU only ever
+ * writes its own copy - no locks, no atomic operations. The copies
+ * are added up when somebody reads the statistics, which is rare.
+ *
+ *	struct foo_stats { unsigned long bar; } ____cacheline_aligned;
+ *	static struct foo_stats foo_stats[NR_CPUS];
+ *
+ *	percpu_stat_inc(foo_stats, bar);
+ *	total = percpu_stat_sum(foo_stats, bar);
+ *
+ * The structure must be ____cacheline_aligned so that the copies
+ * don't share lines. The update is a plain read-modify-write: a
+ * counter that is also updated from interrupts must be updated with
+ * interrupts off, or be split by context like the SNMP MIBs in
+ * <net/snmp.h>.
+ */
+#define percpu_stat(array)			((array)[smp_processor_id()])
+#define percpu_stat_add(array, field, n)	(percpu_stat(array).field += (n))
+#define percpu_stat_inc(array, field)		percpu_stat_add(array, field, 1)
+
+#define percpu_stat_sum(array, field)					\
+({									\
+	unsigned long __sum = 0;					\
+	int __i;							\
+									\
+	for (__i = 0; __i < smp_num_cpus; __i++)			\
+		__sum += (array)[cpu_logical_map(__i)].field;		\
+	__sum;								\
+})
+
+/*
+ * The same for code that walks a statistics structure as an array
+ * of unsigned longs: add up word @nr of every copy. @size is the
+ * size of one copy in bytes and @copies the number of copies per
+ * CPU (2 for the SNMP MIBs).
+ */
+static inline unsigned long percpu_stat_fold(void *array, int size,
+					     int copies, int nr)
+{
+	unsigned long *p = array, sum = 0;
+	int i, j;
+
+	size /= sizeof(unsigned long);
+	for (i = 0; i < smp_num_cpus; i++)
+		for (j = 0; j < copies; j++)
+			sum += p[(copies*cpu_logical_map(i) + j)*size + nr];
+	return sum;
+}
+
+#endif /* _LINUX_PERCPU_STAT_H */
@@ -2,10 +2,35 @@
 #define _LINUX_PIPE_FS_I_H
 
 #define PIPEFS_MAGIC 0x50495045
+
+/*
+ * A pipe is a ring of buffers, each of them a part of a page. The page
+ * is one of the pipe's own, filled by write(), or a reference to a page
+ * of someone else, e.g. a page cache page put there by splice().
+ */
+#define PIPE_BUFFERS		16
+
+struct page;
+struct pipe_inode_info;
+struct pipe_buffer;
+
+struct pipe_buf_operations {
+	int can_merge;		/* write() may append to the page */
+	void (*release)(struct pipe_inode_info *, struct pipe_buffer *);
+};
+
+struct pipe_buffer {
+	struct page *page;
+	unsigned int offset, len;
+	struct pipe_buf_operations *ops;	/* NULL: the slot is free */
+};
+
 struct pipe_inode_info {
 	wait_queue_head_t wait;
-	char *base;
-	unsigned int start;
+	unsigned int nrbufs, curbuf;
+	unsigned int reserved;		/* free buffers promised to splice() */
+	struct pipe_buffer bufs[PIPE_BUFFERS];
+	struct page *tmp_page;		/* kept for the next write */
 	unsigned int readers;
 	unsigned int writers;
 	unsigned int waiting_readers;
@@ -14,15 +39,11 @@ struct pipe_inode_info {
 	unsigned int w_counter;
 };
 
-/* Differs from PIPE_BUF in that PIPE_SIZE is the length of the actual
-   memory allocation, whereas PIPE_BUF makes atomicity guarantees.  */
-#define PIPE_SIZE		PAGE_SIZE
-
 #define PIPE_SEM(inode)		(&(inode).i_sem)
 #define PIPE_WAIT(inode)	(&(inode).i_pipe->wait)
-#define PIPE_BASE(inode)	((inode).i_pipe->base)
-#define PIPE_START(inode)	((inode).i_pipe->start)
 #define PIPE_LEN(inode)		((inode).i_size)
+#define PIPE_NRBUFS(inode)	((inode).i_pipe->nrbufs)
+#define PIPE_RESERVED(inode)	((inode).i_pipe->reserved)
 #define PIPE_READERS(inode)	((inode).i_pipe->readers)
 #define PIPE_WRITERS(inode)	((inode).i_pipe->writers)
 #define PIPE_WAITING_READERS(inode)	((inode).i_pipe->waiting_readers)
@@ -30,16 +51,31 @@ struct pipe_inode_info {
 #define PIPE_RCOUNTER(inode)	((inode).i_pipe->r_counter)
 #define PIPE_WCOUNTER(inode)	((inode).i_pipe->w_counter)
 
-#define PIPE_EMPTY(inode)	(PIPE_LEN(inode) == 0)
-#define PIPE_FULL(inode)	(PIPE_LEN(inode) == PIPE_SIZE)
-#define PIPE_FREE(inode)	(PIPE_SIZE - PIPE_LEN(inode))
-#define PIPE_END(inode)	((PIPE_START(inode) + PIPE_LEN(inode)) & (PIPE_SIZE-1))
-#define PIPE_MAX_RCHUNK(inode)	(PIPE_SIZE - PIPE_START(inode))
-#define PIPE_MAX_WCHUNK(inode)	(PIPE_SIZE - PIPE_END(inode))
+/* the buffer to read from, and the first free one */
+#define PIPE_CURBUF(inode)	((inode).i_pipe->bufs + (inode).i_pipe->curbuf)
+#define PIPE_TAILBUF(inode)	((inode).i_pipe->bufs + \
+	(((inode).i_pipe->curbuf + (inode).i_pipe->nrbufs) & (PIPE_BUFFERS-1)))
+
+#define PIPE_EMPTY(inode)	(PIPE_NRBUFS(inode) == 0)
+#define PIPE_FULL(inode)	(PIPE_NRBUFS(inode) + PIPE_RESERVED(inode) == \
+				 PIPE_BUFFERS)
+
+/* splice() flags */
+#define SPLICE_F_MOVE		0x01	/* move pages instead of copying (a hint) */
+#define SPLICE_F_NONBLOCK	0x02	/* don't block on the pipe */
+#define SPLICE_F_MORE		0x04	/* more data will follow */
 
 /* Drop the inode semaphore and wait for a pipe event, atomically */
 void pipe_wait(struct inode * inode);
 
 struct inode* pipe_new(struct inode* inode);
+void free_pipe_info(struct inode* inode);
+
+/* Buffer handling for fs/splice.c, called with the pipe semaphore held */
+extern struct pipe_buf_operations anon_pipe_buf_ops;
+struct page *pipe_alloc_page(struct inode *inode);
+void pipe_buf_add(struct inode *inode, struct page *page, unsigned int offset,
+		  unsigned int len, struct pipe_buf_operations *ops);
+void pipe_buf_consume(struct inode *inode, unsigned int chars);
 
 #endif
@@ -0,0 +1,60 @@
+#ifndef _LINUX_PTSHARE_H
+#define _LINUX_PTSHARE_H
+
+/*
+ * Page tables shared between processes that map the same part of a
+ * file or shm segment, see mm/ptshare.c.
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+
+#ifdef CONFIG_SHAREPTE
+
+/*
+ * A shared page table is changed with its own lock held as well as
+ * the page_table_lock of the process. Returns whether it was taken.
+ */
+static inline int pte_table_lock(pte_t *ptep)
+{
+	struct page *page = virt_to_page(ptep);
+
+	if (!PagePtShared(page))
+		return 0;
+	pte_chain_lock(page);
+	return 1;
+}
+
+static inline void pte_table_unlock(pte_t *ptep, int locked)
+{
+	if (locked)
+		pte_chain_unlock(virt_to_page(ptep));
+}
+
+extern void pte_try_to_share(struct mm_struct *mm, struct vm_area_struct *vma,
+			pmd_t *pmd, unsigned long address);
+extern int pte_share_fork(struct mm_struct *src, struct vm_area_struct *vma,
+			pmd_t *src_pmd, pmd_t *dst_pmd, unsigned long address);
+extern int unshare_page_range(struct mm_struct *mm, unsigned long start,
+			unsigned long end);
+extern void pte_table_free(pte_t *pte);
+
+#else /* !CONFIG_SHAREPTE */
+
+static inline int pte_table_lock(pte_t *ptep)
+{
+	return 0;
+}
+
+static inline void pte_table_unlock(pte_t *ptep, int locked)
+{
+}
+
+#define pte_try_to_share(mm, vma, pmd, address)		do { } while (0)
+#define pte_share_fork(src, vma, src_pmd, dst_pmd, address)	0
+#define unshare_page_range(mm, start, end)		0
+#define pte_table_free(pte)				pte_free(pte)
+
+#endif /* !CONFIG_SHAREPTE */
+
+#endif /* _LINUX_PTSHARE_H */
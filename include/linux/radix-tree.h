@@ -0,0 +1,47 @@
+#ifndef _LINUX_RADIX_TREE_H
+#define _LINUX_RADIX_TREE_H
+
+/*
+ * A radix tree maps an unsigned long index to a pointer. It is used
+ * for the page cache index of every address_space. See lib/radix-tree.c.
+ */
+
+struct radix_tree_node;
+
+struct radix_tree_root {
+	unsigned int		height;		/* 0: the tree is empty */
+	struct radix_tree_node	*rnode;
+};
+
+/* tags an item can have, see radix_tree_tag_set() */
+#define RADIX_TREE_MAX_TAGS	2
+
+#define RADIX_TREE_INIT()	{ 0, NULL }
+
+#define RADIX_TREE(name) \
+	struct radix_tree_root name = RADIX_TREE_INIT()
+
+#define INIT_RADIX_TREE(root)		\
+do {					\
+	(root)->height = 0;		\
+	(root)->rnode = NULL;		\
+} while (0)
+
+extern int radix_tree_preload(int gfp_mask);
+extern int radix_tree_insert(struct radix_tree_root *, unsigned long, void *);
+extern void *radix_tree_lookup(struct radix_tree_root *, unsigned long);
+extern void **radix_tree_lookup_slot(struct radix_tree_root *, unsigned long);
+extern void *radix_tree_delete(struct radix_tree_root *, unsigned long);
+extern unsigned int radix_tree_gang_lookup(struct radix_tree_root *,
+			void **results, unsigned long first_index,
+			unsigned int max_items);
+extern void *radix_tree_tag_set(struct radix_tree_root *, unsigned long, int tag);
+extern void *radix_tree_tag_clear(struct radix_tree_root *, unsigned long, int tag);
+extern int radix_tree_tag_get(struct radix_tree_root *, unsigned long, int tag);
+extern int radix_tree_tagged(struct radix_tree_root *, int tag);
+extern unsigned int radix_tree_gang_lookup_tag(struct radix_tree_root *,
+			void **results, unsigned long first_index,
+			unsigned int max_items, int tag);
+extern void radix_tree_init(void);
+
+#endif /* _LINUX_RADIX_TREE_H */
@@ -26,6 +26,7 @@ extern unsigned long event;
 #include <linux/signal.h>
 #include <linux/securebits.h>
 #include <linux/fs_struct.h>
+#include <linux/hrtimer.h>
 
 /*
  * cloning flags:
@@ -70,9 +71,14 @@ extern unsigned long avenrun[];		/* Load averages */
 #define CT_TO_SECS(x)	((x) / HZ)
 #define CT_TO_USECS(x)	(((x) % HZ) * 1000000/HZ)
 
-extern int nr_running, nr_threads;
+extern int nr_threads;
 extern int last_pid;
 
+struct task_struct;
+extern void attach_pids(struct task_struct *);
+extern void detach_pids(struct task_struct *);
+extern void change_pids(struct task_struct *, int, int);
+
 #include <linux/fs.h>
 #include <linux/time.h>
 #include <linux/param.h>
@@ -129,13 +135,10 @@ struct sched_param {
 #include <linux/spinlock.h>
 
 /*
- * This serializes "schedule()" and also protects
- * the run-queue from deletions/modifications (but
- * _adding_ to the beginning of the run-queue has
- * a separate lock).
+ * The tasklist_lock protects the list of processes. The
+ * run-queues are per-CPU and private to kernel/sched.c.
  */
 extern rwlock_t tasklist_lock;
-extern spinlock_t runqueue_lock;
 extern spinlock_t mmlist_lock;
 
 extern void sched_init(void);
@@ -146,6 +149,12 @@ extern void trap_init(void);
 extern void update_process_times(int user);
 extern void update_one_process(struct task_struct *p, unsigned long user,
 			       unsigned long system, int cpu);
+extern void scheduler_tick(void);
+extern unsigned long nr_running(void);
+extern void del_from_runqueue(struct task_struct * p);
+#ifdef CONFIG_SMP
+extern void kick_if_running(struct task_struct * p);
+#endif
 
 #define	MAX_SCHEDULE_TIMEOUT	LONG_MAX
 extern signed long FASTCALL(schedule_timeout(signed long timeout));
@@ -227,8 +236,6 @@ struct mm_struct {
 	unsigned long rss, total_vm, locked_vm;
 	unsigned long def_flags;
 	unsigned long cpu_vm_mask;
-	unsigned long swap_cnt;	/* number of pages to swap on next pass */
-	unsigned long swap_address;
 
 	/* Architecture-specific MM context */
 	mm_context_t context;
@@ -282,6 +289,8 @@ struct user_struct {
 extern struct user_struct root_user;
 #define INIT_USER (&root_user)
 
+struct prio_array;
+
 struct task_struct {
 	/*
 	 * offsets of these are hardcoded elsewhere - touch with care
@@ -301,21 +310,20 @@ struct task_struct {
 
 /*
  * offset 32 begins here on 32-bit platforms. We keep
- * all fields in a single cacheline that are needed for
- * the goodness() loop in schedule().
+ * all fields in a single cacheline that are needed by
+ * schedule() and the timer tick.
  */
-	long counter;
+	long counter;		/* ticks left in the timeslice */
 	long nice;
 	unsigned long policy;
 	struct mm_struct *mm;
 	int has_cpu, processor;
 	unsigned long cpus_allowed;
-	/*
-	 * (only the 'next' pointer fits into the cacheline, but
-	 * that's just fine.)
-	 */
+	int prio;		/* dynamic priority, see kernel/sched.c */
+	struct prio_array *array;
 	struct list_head run_list;
-	unsigned long sleep_time;
+	unsigned long sleep_time;	/* jiffies when it last left a CPU */
+	unsigned long sleep_avg;	/* recent sleep time, in ticks */
 
 	struct task_struct *next_task, *prev_task;
 	struct mm_struct *active_mm;
@@ -353,6 +361,10 @@ struct task_struct {
 	unsigned long it_real_value, it_prof_value, it_virt_value;
 	unsigned long it_real_incr, it_prof_incr, it_virt_incr;
 	struct timer_list real_timer;
+#ifdef CONFIG_HIGH_RES_TIMERS
+	struct hrtimer real_hrtimer;		/* ITIMER_REAL if hrtimer_active */
+	u64 it_real_hr_incr;			/* its interval, in ns */
+#endif
 	struct tms times;
 	unsigned long start_time;
 	long per_cpu_utime[NR_CPUS], per_cpu_stime[NR_CPUS];
@@ -441,6 +453,13 @@ struct task_struct {
 #define MAX_COUNTER	(20*HZ/100)
 #define DEF_NICE	(0)
 
+/*
+ * Priority levels used by the scheduler: 0..MAX_RT_PRIO-1 for
+ * realtime tasks, MAX_RT_PRIO..MAX_PRIO-1 for nice -20..19.
+ */
+#define MAX_RT_PRIO	100
+#define MAX_PRIO	(MAX_RT_PRIO + 40)
+
 /*
  *  INIT_TASK is used to set up the first task table, touch at
  * your own risk!. Base=0, limit=0x1fffff (=2MB)
@@ -448,6 +467,15 @@ struct task_struct {
  * INIT_TASK 用于设置第一个进程的task_struct{} 结构体，不要乱动，
  * 后果自负.
  */
+#ifdef CONFIG_HIGH_RES_TIMERS
+#define INIT_REAL_HRTIMER						\
+    real_hrtimer:	{						\
+	function:		it_real_hr_fn				\
+    },
+#else
+#define INIT_REAL_HRTIMER
+#endif
+
 #define INIT_TASK(tsk)	\
 {									\
     state:		0,						\
@@ -458,6 +486,7 @@ struct task_struct {
     lock_depth:		-1,						\
     counter:		DEF_COUNTER,					\
     nice:		DEF_NICE,					\
+    prio:		MAX_PRIO-20,					\
     policy:		SCHED_OTHER,					\
     mm:			NULL,						\
     active_mm:		&init_mm,					\
@@ -472,6 +501,7 @@ struct task_struct {
     real_timer:		{						\
 	function:		it_real_fn				\
     },									\
+    INIT_REAL_HRTIMER							\
     cap_effective:	CAP_INIT_EFF_SET,				\
     cap_inheritable:	CAP_INIT_INH_SET,				\
     cap_permitted:	CAP_FULL_SET,					\
@@ -571,6 +601,8 @@ extern void FASTCALL(wake_up_process(struct task_struct * tsk));
 #define wake_up_interruptible(x)	__wake_up((x),TASK_INTERRUPTIBLE,WQ_FLAG_EXCLUSIVE)
 #define wake_up_interruptible_all(x)	__wake_up((x),TASK_INTERRUPTIBLE,0)
 #define wake_up_interruptible_sync(x)	__wake_up_sync((x),TASK_INTERRUPTIBLE,WQ_FLAG_EXCLUSIVE)
+#define wake_up_affine(x)		__wake_up((x),TASK_UNINTERRUPTIBLE | TASK_INTERRUPTIBLE,WQ_FLAG_EXCLUSIVE | WQ_FLAG_AFFINE)
+#define wake_up_interruptible_affine(x)	__wake_up((x),TASK_INTERRUPTIBLE,WQ_FLAG_EXCLUSIVE | WQ_FLAG_AFFINE)
 
 extern int in_group_p(gid_t);
 extern int in_egroup_p(gid_t);
@@ -840,14 +872,6 @@ do {									\
 #define next_thread(p) \
 	list_entry((p)->thread_group.next, struct task_struct, thread_group)
 
-static inline void del_from_runqueue(struct task_struct * p)
-{
-	nr_running--;
-	p->sleep_time = jiffies;
-	list_del(&p->run_list);
-	p->run_list.next = NULL;
-}
-
 static inline int task_on_runqueue(struct task_struct *p)
 {
 	return (p->run_list.next != NULL);
@@ -859,6 +883,7 @@ static inline void unhash_process(struct task_struct *p)
 	write_lock_irq(&tasklist_lock);
 	nr_threads--;
 	unhash_pid(p);
+	detach_pids(p);
 	REMOVE_LINKS(p);
 	list_del(&p->thread_group);
 	write_unlock_irq(&tasklist_lock);
@@ -38,6 +38,7 @@ struct shmid_ds {
 /* permission flag for shmget */
 #define SHM_R		0400	/* or S_IRUGO from <linux/stat.h> */
 #define SHM_W		0200	/* or S_IWUGO from <linux/stat.h> */
+#define SHM_HUGETLB	04000	/* segment is backed by huge pages */
 
 /* mode for attach */
 #define	SHM_RDONLY	010000	/* read-only access */
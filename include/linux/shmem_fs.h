@@ -1,6 +1,8 @@
 #ifndef __SHMEM_FS_H
 #define __SHMEM_FS_H
 
+#include <linux/radix-tree.h>
+
 /* inode in-kernel data */
 
 #define SHMEM_NR_DIRECT 16
@@ -29,6 +31,8 @@ struct shmem_inode_info {
 	unsigned long	swapped;
 	int		locked;     /* into memory */
 	struct list_head	list;
+	struct radix_tree_root	huge_tree;	/* pages of a hugetlb file */
+	unsigned long	huge_reserved;	/* pool pages it may still take */
 };
 
 struct shmem_sb_info {
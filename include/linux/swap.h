@@ -2,6 +2,7 @@
 #define _LINUX_SWAP_H
 
 #include <linux/spinlock.h>
+#include <linux/threads.h>
 #include <asm/page.h>
 
 #define SWAP_FLAG_PREFER	0x8000	/* set if swap priority specified */
@@ -47,6 +48,23 @@ union swap_header {
 #define SWAP_MAP_MAX	0x7fff
 #define SWAP_MAP_BAD	0x8000
 
+/*
+ * A run of pages of a swap file that lie in consecutive blocks on
+ * disk. The extents of a swap file are set up at swapon, sorted by
+ * start_page.
+ */
+struct swap_extent {
+	unsigned long start_page;
+	unsigned long nr_pages;
+	unsigned long start_block;	/* in blocks of the file system */
+};
+
+/* The cluster a cpu is handing out swap slots from, see scan_swap_map() */
+struct swap_cluster {
+	unsigned int next;
+	unsigned int nr;
+};
+
 //用于磁盘交换的文件
 struct swap_info_struct {
 	unsigned int flags;
@@ -58,8 +76,10 @@ struct swap_info_struct {
 	//供页面交换使用的页面范围
 	unsigned int lowest_bit;
 	unsigned int highest_bit;
-	unsigned int cluster_next;
-	unsigned int cluster_nr;
+	struct swap_cluster cluster[NR_CPUS];
+	unsigned int cluster_search;	/* where the next free cluster is looked for */
+	struct swap_extent * extents;	/* swap file only */
+	int nr_extents;
 	int prio;			/* swap priority */
 	int pages;			/* 交换的页面数量 */
 	unsigned long max;		/* 文件的最大页面号 */
@@ -70,18 +90,20 @@ extern int nr_swap_pages;
 FASTCALL(unsigned int nr_free_pages(void));
 FASTCALL(unsigned int nr_inactive_clean_pages(void));
 FASTCALL(unsigned int nr_free_buffer_pages(void));
-extern int nr_active_pages;
-extern int nr_inactive_dirty_pages;
+FASTCALL(unsigned int nr_active_pages(void));
+FASTCALL(unsigned int nr_inactive_dirty_pages(void));
 extern atomic_t nr_async_pages;
 extern struct address_space swapper_space;
 extern atomic_t page_cache_size;
 extern atomic_t buffermem_pages;
 extern spinlock_t pagecache_lock;
 extern void __remove_inode_page(struct page *);
+extern int migrate_page_cache(struct page *, struct page *);
 
 /* Incomplete types for prototype declarations: */
 struct task_struct;
 struct vm_area_struct;
+struct mm_struct;
 struct sysinfo;
 
 struct zone_t;
@@ -98,11 +120,30 @@ extern void deactivate_page_nolock(struct page *);
 extern void activate_page(struct page *);
 extern void activate_page_nolock(struct page *);
 extern void lru_cache_add(struct page *);
+extern void lru_cache_add_anon(struct page *);
+extern void lru_add_drain(void);
+extern int lru_put_page_testzero(struct page *);
 extern void __lru_cache_del(struct page *);
 extern void lru_cache_del(struct page *);
 extern void recalculate_vm_stats(void);
 extern void swap_setup(void);
 
+/* linux/mm/rmap.c */
+#define SWAP_SUCCESS	0
+#define SWAP_AGAIN	1
+#define SWAP_FAIL	2
+struct pte_chain;
+extern int pte_chain_alloc(struct pte_chain **, int, int);
+extern void pte_chain_free(struct pte_chain *);
+extern void page_add_rmap(struct page *, pte_t *, struct mm_struct *, unsigned long,
+			  struct pte_chain **);
+extern void page_remove_rmap(struct page *, pte_t *);
+extern void page_move_rmap(struct page *, pte_t *, pte_t *, struct mm_struct *, unsigned long);
+extern void page_rmap_set_owner(struct page *, pte_t *, struct mm_struct *, unsigned long);
+extern int page_referenced(struct page *);
+extern int try_to_unmap(struct page *);
+extern void pte_chain_init(void);
+
 /* linux/mm/vmscan.c */
 extern struct page * reclaim_page(zone_t *);
 extern wait_queue_head_t kswapd_wait;
@@ -112,8 +153,10 @@ extern int free_shortage(void);
 extern int inactive_shortage(void);
 extern void wakeup_kswapd(int);
 extern int try_to_free_pages(unsigned int gfp_mask);
+extern int get_lru_stats(char *);
 
 /* linux/mm/page_io.c */
+extern int rw_swap_page_base(int, swp_entry_t, struct page *, int);
 extern void rw_swap_page(int, struct page *, int);
 extern void rw_swap_page_nolock(int, swp_entry_t, char *, int);
 
@@ -121,7 +164,8 @@ extern void rw_swap_page_nolock(int, swp_entry_t, char *, int);
 
 /* linux/mm/swap_state.c */
 extern void show_swap_cache_info(void);
-extern void add_to_swap_cache(struct page *, swp_entry_t);
+extern int add_to_swap_cache(struct page *, swp_entry_t);
+extern int add_to_swap(struct page *);
 extern int swap_check_entry(unsigned long);
 extern struct page * lookup_swap_cache(swp_entry_t);
 extern struct page * read_swap_cache_async(swp_entry_t, int);
@@ -187,8 +231,6 @@ static inline int is_page_shared(struct page *page)
 	return  count > 1;
 }
 
-extern spinlock_t pagemap_lru_lock;
-
 /*
  * Page aging defines.
  * Since we do exponential decay of the page age, we
@@ -200,7 +242,7 @@ extern spinlock_t pagemap_lru_lock;
 
 /*
  * List add/del helper macros. These must be called
- * with the pagemap_lru_lock held!
+ * with the lru_lock of the page's zone held!
  */
 #define DEBUG_ADD_PAGE \
 	if (PageActive(page) || PageInactiveDirty(page) || \
@@ -213,16 +255,15 @@ extern spinlock_t pagemap_lru_lock;
 	DEBUG_ADD_PAGE \
 	ZERO_PAGE_BUG \
 	SetPageActive(page); \
-	list_add(&(page)->lru, &active_list); \
-	nr_active_pages++; \
+	list_add(&(page)->lru, &page->zone->active_list); \
+	page->zone->active_pages++; \
 }
 
 #define add_page_to_inactive_dirty_list(page) { \
 	DEBUG_ADD_PAGE \
 	ZERO_PAGE_BUG \
 	SetPageInactiveDirty(page); \
-	list_add(&(page)->lru, &inactive_dirty_list); \
-	nr_inactive_dirty_pages++; \
+	list_add(&(page)->lru, &page->zone->inactive_dirty_list); \
 	page->zone->inactive_dirty_pages++; \
 }
 
@@ -237,7 +278,7 @@ extern spinlock_t pagemap_lru_lock;
 #define del_page_from_active_list(page) { \
 	list_del(&(page)->lru); \
 	ClearPageActive(page); \
-	nr_active_pages--; \
+	page->zone->active_pages--; \
 	DEBUG_ADD_PAGE \
 	ZERO_PAGE_BUG \
 }
@@ -245,7 +286,6 @@ extern spinlock_t pagemap_lru_lock;
 #define del_page_from_inactive_dirty_list(page) { \
 	list_del(&(page)->lru); \
 	ClearPageInactiveDirty(page); \
-	nr_inactive_dirty_pages--; \
 	page->zone->inactive_dirty_pages--; \
 	DEBUG_ADD_PAGE \
 	ZERO_PAGE_BUG \
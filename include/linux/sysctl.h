@@ -132,7 +132,9 @@ enum
 	VM_PAGECACHE=7,		/* struct: Set cache memory thresholds */
 	VM_PAGERDAEMON=8,	/* struct: Control kswapd behaviour */
 	VM_PGT_CACHE=9,		/* struct: Set page table cache parameters */
-	VM_PAGE_CLUSTER=10	/* int: set number of pages to swap together */
+	VM_PAGE_CLUSTER=10,	/* int: set number of pages to swap together */
+	VM_HUGETLB_PAGES=11,	/* int: number of huge pages in the pool */
+	VM_COMPSWAP_PAGES=12	/* int: memory for compressed swap pages */
 };
 
 
@@ -16,12 +16,19 @@
  * The "data" field is in case you want to use the same
  * timeout function for several timeouts. You can use this
  * to distinguish between the different invocations.
+ *
+ * "base" is the per-CPU timer wheel the timer was last queued on and
+ * is private to kernel/timer.c. It comes last so that existing static
+ * initializers don't have to change.
  */
+struct timer_base;
+
 struct timer_list {
 	struct list_head list;
 	unsigned long expires;
 	unsigned long data;
 	void (*function)(unsigned long);
+	struct timer_base *base;
 };
 
 extern void add_timer(struct timer_list * timer);
@@ -45,10 +52,14 @@ extern void sync_timers(void);
 int mod_timer(struct timer_list *timer, unsigned long expires);
 
 extern void it_real_fn(unsigned long);
+extern void timer_bust_locks(void);
+extern void block_timers(void);
+extern void unblock_timers(void);
 
 static inline void init_timer(struct timer_list * timer)
 {
 	timer->list.next = timer->list.prev = NULL;
+	timer->base = NULL;
 }
 
 static inline int timer_pending (const struct timer_list * timer)
@@ -10,6 +10,7 @@
 
 #ifdef __KERNEL__
 
+#include <linux/config.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/stddef.h>
@@ -46,6 +47,12 @@ extern int printk(const char *fmt, ...);
 struct __wait_queue {
 	unsigned int flags;
 #define WQ_FLAG_EXCLUSIVE	0x01
+/*
+ * Only passed as wq_mode to __wake_up(): wake the exclusive waiter
+ * that last ran on this CPU, and queue it on its own CPU if that
+ * is idle or on the waker's CPU otherwise, see kernel/sched.c.
+ */
+#define WQ_FLAG_AFFINE		0x02
 	struct task_struct * task;
 	struct list_head task_list;
 #if WAITQUEUE_DEBUG
@@ -89,6 +96,15 @@ typedef struct __wait_queue wait_queue_t;
 # define wq_write_unlock spin_unlock
 #endif
 
+/*
+ * Per wait queue wakeup statistics, updated under the queue lock.
+ */
+struct wait_queue_stats {
+	unsigned long wakeups;		/* tasks woken up */
+	unsigned long ipis;		/* wakeups that interrupted another CPU */
+	unsigned long migrations;	/* tasks queued away from their last CPU */
+};
+
 struct __wait_queue_head {
 	wq_lock_t lock;
 	struct list_head task_list;
@@ -96,6 +112,9 @@ struct __wait_queue_head {
 	long __magic;
 	long __creator;
 #endif
+#ifdef CONFIG_WAITQUEUE_STATS
+	struct wait_queue_stats stats;
+#endif
 };
 typedef struct __wait_queue_head wait_queue_head_t;
 
@@ -133,6 +152,9 @@ static inline void init_waitqueue_head(wait_queue_head_t *q)
 	q->__magic = (long)&q->__magic;
 	q->__creator = (long)current_text_addr();
 #endif
+#ifdef CONFIG_WAITQUEUE_STATS
+	q->stats.wakeups = q->stats.ipis = q->stats.migrations = 0;
+#endif
 }
 
 static inline void init_waitqueue_entry(wait_queue_t *q,
@@ -91,6 +91,8 @@ extern void sbus_init(void);
 extern void ppc_init(void);
 extern void sysctl_init(void);
 extern void signals_init(void);
+extern void pte_chain_init(void);
+extern void radix_tree_init(void);
 extern void bdev_init(void);
 extern int init_pcmcia_ds(void);
 extern void net_notifier_init(void);
@@ -585,7 +587,8 @@ asmlinkage void __init start_kernel(void)
 	proc_caches_init();
 	vfs_caches_init(mempages);
 	buffer_init(mempages);
-	page_cache_init(mempages);
+	radix_tree_init();
+	pte_chain_init();
 	kiobuf_setup();
 	signals_init();
 	bdev_init();
@@ -22,6 +22,7 @@
 #include <linux/file.h>
 #include <linux/mman.h>
 #include <linux/proc_fs.h>
+#include <linux/hugetlb.h>
 #include <asm/uaccess.h>
 
 #include "util.h"
@@ -189,7 +190,10 @@ static int newseg (key_t key, int shmflg, size_t size)
 	if (!shp)
 		return -ENOMEM;
 	sprintf (name, "SYSV%08x", key);
-	file = shmem_file_setup(name, size);
+	if (shmflg & SHM_HUGETLB)
+		file = hugetlb_file_setup(name, size);
+	else
+		file = shmem_file_setup(name, size);
 	error = PTR_ERR(file);
 	if (IS_ERR(file))
 		goto no_file;
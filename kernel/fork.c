@@ -26,7 +26,6 @@
 
 /* The idle threads do not count.. */
 int nr_threads;		//内核中进程(+线程)之和
-int nr_running;
 
 int max_threads;
 unsigned long total_forks;	/* Handle normal Linux uptimes. */
@@ -34,6 +33,21 @@ int last_pid;
 
 struct task_struct *pidhash[PIDHASH_SZ];
 
+/*
+ * A number can't be handed out as a pid while any task still uses
+ * it as its pid, process group or session. pid_users counts those
+ * uses and pidmap has a bit set for every number in use, so that
+ * finding a free pid is a bitmap search, however many tasks there
+ * are. 0 is the idle tasks' and is never counted.
+ */
+#define RESERVED_PIDS	300	/* Skip daemons etc. when wrapping */
+
+static unsigned long pidmap[PID_MAX / BITS_PER_LONG];
+static unsigned int *pid_users;
+
+/* Protects pidmap, pid_users and last_pid. */
+spinlock_t lastpid_lock = SPIN_LOCK_UNLOCKED;
+
 void add_wait_queue(wait_queue_head_t *q, wait_queue_t * wait)
 {
 	unsigned long flags;
@@ -74,52 +88,78 @@ void __init fork_init(unsigned long mempages)
 
 	init_task.rlim[RLIMIT_NPROC].rlim_cur = max_threads/2;
 	init_task.rlim[RLIMIT_NPROC].rlim_max = max_threads/2;
+
+	pid_users = vmalloc(PID_MAX * sizeof(unsigned int));
+	if (!pid_users)
+		panic("fork_init: cannot allocate pid map");
+	memset(pid_users, 0, PID_MAX * sizeof(unsigned int));
 }
 
-/* Protects next_safe and last_pid. */
-spinlock_t lastpid_lock = SPIN_LOCK_UNLOCKED;
+static inline void __pidmap_get(int nr)
+{
+	if (nr > 0 && !pid_users[nr]++)
+		set_bit(nr, pidmap);
+}
+
+static inline void __pidmap_put(int nr)
+{
+	if (nr > 0 && !--pid_users[nr])
+		clear_bit(nr, pidmap);
+}
+
+/* Called with tasklist_lock held for writing, when p becomes visible. */
+void attach_pids(struct task_struct *p)
+{
+	spin_lock(&lastpid_lock);
+	__pidmap_get(p->pgrp);
+	__pidmap_get(p->session);
+	spin_unlock(&lastpid_lock);
+}
 
+/* ... and when it goes away. */
+void detach_pids(struct task_struct *p)
+{
+	spin_lock(&lastpid_lock);
+	__pidmap_put(p->pid);
+	__pidmap_put(p->pgrp);
+	__pidmap_put(p->session);
+	spin_unlock(&lastpid_lock);
+}
+
+/* Move p to another process group and/or session. */
+void change_pids(struct task_struct *p, int session, int pgrp)
+{
+	spin_lock(&lastpid_lock);
+	__pidmap_get(session);
+	__pidmap_get(pgrp);
+	__pidmap_put(p->session);
+	__pidmap_put(p->pgrp);
+	p->session = session;
+	p->pgrp = pgrp;
+	spin_unlock(&lastpid_lock);
+}
+
+/* Returns 0 if all pids are in use. */
 static int get_pid(unsigned long flags)
 {
-	static int next_safe = PID_MAX;
-	struct task_struct *p;
+	int pid = PID_MAX;
 
 	if (flags & CLONE_PID)
 		return current->pid;
 
 	spin_lock(&lastpid_lock);
-	if((++last_pid) & 0xffff8000) {
-		last_pid = 300;		/* Skip daemons etc. */
-		goto inside;
-	}
-	if(last_pid >= next_safe) {
-inside:
-		next_safe = PID_MAX;
-		read_lock(&tasklist_lock);
-	repeat:
-		for_each_task(p) {
-			if(p->pid == last_pid	||
-			   p->pgrp == last_pid	||
-			   p->session == last_pid) {
-				if(++last_pid >= next_safe) {
-					if(last_pid & 0xffff8000)
-						last_pid = 300;
-					next_safe = PID_MAX;
-				}
-				goto repeat;
-			}
-			if(p->pid > last_pid && next_safe > p->pid)
-				next_safe = p->pid;
-			if(p->pgrp > last_pid && next_safe > p->pgrp)
-				next_safe = p->pgrp;
-			if(p->session > last_pid && next_safe > p->session)
-				next_safe = p->session;
-		}
-		read_unlock(&tasklist_lock);
-	}
+	if (last_pid + 1 < PID_MAX)
+		pid = find_next_zero_bit(pidmap, PID_MAX, last_pid + 1);
+	if (pid >= PID_MAX)
+		pid = find_next_zero_bit(pidmap, PID_MAX, RESERVED_PIDS);
+	if (pid < PID_MAX) {
+		__pidmap_get(pid);
+		last_pid = pid;
+	} else
+		pid = 0;
 	spin_unlock(&lastpid_lock);
 
-	return last_pid;
+	return pid;
 }
 
 static inline int dup_mmap(struct mm_struct * mm)
@@ -134,8 +174,6 @@ static inline int dup_mmap(struct mm_struct * mm)
 	mm->mmap_cache = NULL;
 	mm->map_count = 0;
 	mm->cpu_vm_mask = 0;
-	mm->swap_cnt = 0;
-	mm->swap_address = 0;
 	pprev = &mm->mmap;
 	for (mpnt = current->mm->mmap ; mpnt ; mpnt = mpnt->vm_next) {
 		struct file *file;
@@ -598,9 +636,13 @@ int do_fork(unsigned long clone_flags, unsigned long stack_start,
 
 	copy_flags(clone_flags, p);
 	p->pid = get_pid(clone_flags);
+	if (!p->pid && !(clone_flags & CLONE_PID))
+		goto bad_fork_cleanup;
 
 	p->run_list.next = NULL;
 	p->run_list.prev = NULL;
+	p->array = NULL;
+	p->sleep_time = jiffies;
 
 	if ((clone_flags & CLONE_VFORK) || !(clone_flags & CLONE_PARENT)) {
 		p->p_opptr = current;
@@ -619,6 +661,11 @@ int do_fork(unsigned long clone_flags, unsigned long stack_start,
 	p->it_real_incr = p->it_virt_incr = p->it_prof_incr = 0;
 	init_timer(&p->real_timer);
 	p->real_timer.data = (unsigned long) p;
+#ifdef CONFIG_HIGH_RES_TIMERS
+	p->it_real_hr_incr = 0;
+	init_hrtimer(&p->real_hrtimer);
+	p->real_hrtimer.data = (unsigned long) p;
+#endif
 
 	p->leader = 0;		/* session leadership doesn't inherit */
 	p->tty_old_pgrp = 0;
@@ -690,6 +737,7 @@ int do_fork(unsigned long clone_flags, unsigned long stack_start,
 	}
 	SET_LINKS(p);
 	hash_pid(p);
+	attach_pids(p);
 	nr_threads++;
 	write_unlock_irq(&tasklist_lock);
 
@@ -711,6 +759,11 @@ bad_fork_cleanup_fs:
 bad_fork_cleanup_files:
 	exit_files(p); /* blocking */
 bad_fork_cleanup:
+	if (!(clone_flags & CLONE_PID)) {
+		spin_lock(&lastpid_lock);
+		__pidmap_put(p->pid);
+		spin_unlock(&lastpid_lock);
+	}
 	put_exec_domain(p->exec_domain);
 	if (p->binfmt && p->binfmt->module)
 		__MOD_DEC_USE_COUNT(p->binfmt->module);
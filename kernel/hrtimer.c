@@ -0,0 +1,271 @@
+/*
+ *  linux/kernel/hrtimer.c
+ *
+ *  High resolution kernel timers.
+ *
+ *  The timer wheel in kernel/timer.c can't do better than a jiffy.
+ *  The timers here are kept per CPU in a list sorted by expiry time,
+ *  in nanoseconds, and the architecture programs a one-shot interrupt
+ *  for the head of the list (see hrtimer_reprogram()). Pending
+ *  timers are few - sleeping tasks and armed itimers - so a sorted
+ *  list beats anything cleverer.
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+
+#include <asm/uaccess.h>
+
+struct hrtimer_base {
+	spinlock_t lock;
+	struct list_head head;
+	struct hrtimer * volatile running;
+} ____cacheline_aligned;
+
+static struct hrtimer_base hrtimer_bases[NR_CPUS];
+
+#define this_hrtimer_base()	(hrtimer_bases + smp_processor_id())
+
+int hrtimer_active;
+
+void __init init_hrtimers(void)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		spin_lock_init(&hrtimer_bases[cpu].lock);
+		INIT_LIST_HEAD(&hrtimer_bases[cpu].head);
+	}
+}
+
+/*
+ * Must be called with base->lock held. New timers mostly expire
+ * after those already queued, so search from the tail.
+ */
+static void enqueue_hrtimer(struct hrtimer_base *base, struct hrtimer *timer)
+{
+	struct list_head *pos;
+
+	for (pos = base->head.prev; pos != &base->head; pos = pos->prev)
+		if (list_entry(pos, struct hrtimer, list)->expires <= timer->expires)
+			break;
+	list_add(&timer->list, pos);
+	timer->base = base;
+
+	if (base->head.next == &timer->list)
+		hrtimer_reprogram(timer->expires);
+}
+
+static inline void detach_hrtimer(struct hrtimer *timer)
+{
+	list_del(&timer->list);
+	timer->list.next = timer->list.prev = NULL;
+	timer->base = NULL;
+}
+
+/*
+ * (Re)arm a timer on this CPU to fire at the absolute time @expires.
+ * Returns 1 if the timer was pending before.
+ */
+int hrtimer_start(struct hrtimer *timer, u64 expires)
+{
+	struct hrtimer_base *old_base, *new_base;
+	unsigned long flags;
+	int ret = 0;
+
+	local_irq_save(flags);
+	new_base = this_hrtimer_base();
+repeat:
+	old_base = timer->base;
+	/* address order, as in mod_timer() */
+	if (old_base && old_base != new_base) {
+		if (old_base < new_base) {
+			spin_lock(&old_base->lock);
+			spin_lock(&new_base->lock);
+		} else {
+			spin_lock(&new_base->lock);
+			spin_lock(&old_base->lock);
+		}
+		if (timer->base != old_base) {
+			spin_unlock(&old_base->lock);
+			spin_unlock(&new_base->lock);
+			goto repeat;
+		}
+	} else {
+		spin_lock(&new_base->lock);
+		if (timer->base != old_base) {
+			spin_unlock(&new_base->lock);
+			goto repeat;
+		}
+	}
+
+	if (old_base) {
+		list_del(&timer->list);
+		ret = 1;
+	}
+	timer->expires = expires;
+	enqueue_hrtimer(new_base, timer);
+
+	if (old_base && old_base != new_base)
+		spin_unlock(&old_base->lock);
+	spin_unlock_irqrestore(&new_base->lock, flags);
+	return ret;
+}
+
+static int __hrtimer_del(struct hrtimer *timer)
+{
+	struct hrtimer_base *base;
+	unsigned long flags;
+
+	for (;;) {
+		base = timer->base;
+		if (!base)
+			return 0;
+		spin_lock_irqsave(&base->lock, flags);
+		if (base == timer->base)
+			break;
+		spin_unlock_irqrestore(&base->lock, flags);
+	}
+	detach_hrtimer(timer);
+	spin_unlock_irqrestore(&base->lock, flags);
+	return 1;
+}
+
+/*
+ * Deactivate a timer and wait for its handler to finish if it is
+ * running on another CPU. The handler may re-arm the timer, so keep
+ * going until it is neither queued nor running. Returns the number
+ * of times the timer was found queued.
+ */
+int hrtimer_cancel(struct hrtimer *timer)
+{
+	int ret = 0;
+
+	for (;;) {
+		int i;
+
+		ret += __hrtimer_del(timer);
+
+		for (i = 0; i < smp_num_cpus; i++)
+			if (hrtimer_bases[cpu_logical_map(i)].running == timer)
+				break;
+		if (i == smp_num_cpus)
+			break;
+
+		while (hrtimer_bases[cpu_logical_map(i)].running == timer)
+			barrier();
+	}
+	return ret;
+}
+
+/*
+ * Expiry time of the first timer queued on this CPU, or ~0 if there
+ * is none. Called by the architecture with interrupts off.
+ */
+u64 hrtimer_next_event(void)
+{
+	struct hrtimer_base *base = this_hrtimer_base();
+	u64 next = ~0ULL;
+
+	spin_lock(&base->lock);
+	if (!list_empty(&base->head))
+		next = list_entry(base->head.next, struct hrtimer, list)->expires;
+	spin_unlock(&base->lock);
+	return next;
+}
+
+/*
+ * Run the expired timers of this CPU. Called from the one-shot
+ * interrupt with interrupts off.
+ */
+void hrtimer_run_queues(void)
+{
+	struct hrtimer_base *base = this_hrtimer_base();
+	u64 now = hrtimer_now();
+
+	spin_lock(&base->lock);
+	while (!list_empty(&base->head)) {
+		struct hrtimer *timer;
+		void (*fn)(unsigned long);
+		unsigned long data;
+
+		timer = list_entry(base->head.next, struct hrtimer, list);
+		if (timer->expires > now) {
+			/* handlers can take a while, look again */
+			now = hrtimer_now();
+			if (timer->expires > now)
+				break;
+		}
+		fn = timer->function;
+		data = timer->data;
+
+		detach_hrtimer(timer);
+		base->running = timer;
+		mb();
+		spin_unlock(&base->lock);
+		fn(data);
+		spin_lock(&base->lock);
+		base->running = NULL;
+	}
+	spin_unlock(&base->lock);
+}
+
+static void hrtimer_wakeup(unsigned long __data)
+{
+	wake_up_process((struct task_struct *) __data);
+}
+
+long hrtimer_nanosleep(struct timespec *t, struct timespec *rmtp)
+{
+	struct hrtimer timer;
+	u64 expires, now;
+
+	init_hrtimer(&timer);
+	timer.data = (unsigned long) current;
+	timer.function = hrtimer_wakeup;
+
+	expires = hrtimer_now() + timespec_to_ns(t);
+
+	current->state = TASK_INTERRUPTIBLE;
+	hrtimer_start(&timer, expires);
+	schedule();
+	hrtimer_cancel(&timer);
+
+	now = hrtimer_now();
+	if (now < expires) {
+		if (rmtp) {
+			struct timespec rem;
+
+			ns_to_timespec(expires - now, &rem);
+			if (copy_to_user(rmtp, &rem, sizeof(struct timespec)))
+				return -EFAULT;
+		}
+		return -EINTR;
+	}
+	return 0;
+}
+
+void it_real_hr_fn(unsigned long __data)
+{
+	struct task_struct * p = (struct task_struct *) __data;
+	u64 interval;
+
+	send_sig(SIGALRM, p, 1);
+	interval = p->it_real_hr_incr;
+	if (interval) {
+		u64 expires = p->real_hrtimer.expires + interval;
+		u64 now = hrtimer_now();
+
+		/*
+		 * Keep the period drift free, but don't queue a burst
+		 * of overruns if we were held off for a long time.
+		 */
+		if (expires <= now)
+			expires = now + interval;
+		hrtimer_start(&p->real_hrtimer, expires);
+	}
+}
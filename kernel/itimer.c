@@ -6,6 +6,7 @@
 
 /* These are all the functions necessary to implement itimers */
 
+#include <linux/config.h>
 #include <linux/mm.h>
 #include <linux/smp_lock.h>
 #include <linux/interrupt.h>
@@ -40,12 +41,52 @@ static void jiffiestotv(unsigned long jiffies, struct timeval *value)
 	value->tv_sec = jiffies / HZ;
 }
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+/*
+ * With high resolution timers ITIMER_REAL runs off real_hrtimer and
+ * keeps its interval in nanoseconds instead of jiffies.
+ */
+static void getitimer_real_hr(struct itimerval *value)
+{
+	u64 val = 0;
+
+	if (hrtimer_pending(&current->real_hrtimer)) {
+		u64 now = hrtimer_now();
+
+		val = current->real_hrtimer.expires;
+		/* look out for negative/zero itimer.. */
+		val = val > now ? val - now : NSEC_PER_USEC;
+	}
+	ns_to_timeval(val, &value->it_value);
+	ns_to_timeval(current->it_real_hr_incr, &value->it_interval);
+}
+
+static void setitimer_real_hr(struct itimerval *value)
+{
+	u64 val = timeval_to_ns(&value->it_value);
+	u64 interval = timeval_to_ns(&value->it_interval);
+
+	hrtimer_cancel(&current->real_hrtimer);
+	if (interval && interval < HRTIMER_MIN_PERIOD)
+		interval = HRTIMER_MIN_PERIOD;
+	current->it_real_hr_incr = interval;
+	if (val)
+		hrtimer_start(&current->real_hrtimer, hrtimer_now() + val);
+}
+#endif
+
 int do_getitimer(int which, struct itimerval *value)
 {
 	register unsigned long val, interval;
 
 	switch (which) {
 	case ITIMER_REAL:
+#ifdef CONFIG_HIGH_RES_TIMERS
+		if (hrtimer_active) {
+			getitimer_real_hr(value);
+			return 0;
+		}
+#endif
 		interval = current->it_real_incr;
 		val = 0;
 		/* 
@@ -116,6 +157,12 @@ int do_setitimer(int which, struct itimerval *value, struct itimerval *ovalue)
 		return k;
 	switch (which) {
 		case ITIMER_REAL:
+#ifdef CONFIG_HIGH_RES_TIMERS
+			if (hrtimer_active) {
+				setitimer_real_hr(value);
+				break;
+			}
+#endif
 			del_timer_sync(&current->real_timer);
 			current->it_real_value = j;
 			current->it_real_incr = i;
@@ -88,8 +88,7 @@ int exec_usermodehelper(char *program_path, char *argv[], char *envp[])
 	int i;
 	struct task_struct *curtask = current;
 
-	curtask->session = 1;
-	curtask->pgrp = 1;
+	change_pids(curtask, 1, 1);
 
 	use_init_fs_context();
 
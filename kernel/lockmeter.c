@@ -0,0 +1,283 @@
+/*
+ *  linux/kernel/lockmeter.c
+ *
+ *  Spinlock and rwlock metering.
+ *
+ *  Every lock operation is charged to the address it was called from,
+ *  in a small hash table per CPU: the metering itself must not add a
+ *  shared cache line to every lock it measures. The tables are only
+ *  summed when /proc/lockmeter is read. All times are TSC cycles.
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/module.h>
+
+#include <asm/timex.h>
+
+#define LOCKMETER_SITES	512
+
+struct lock_site {
+	void *where;
+	void *lock;		/* last lock taken here */
+	unsigned long count;
+	unsigned long contended;
+	cycles_t spin;
+	cycles_t hold;
+};
+
+struct lockmeter_cpu {
+	struct lock_site sites[LOCKMETER_SITES];
+	unsigned long lost;
+} ____cacheline_aligned;
+
+static struct lockmeter_cpu lockmeter_cpus[NR_CPUS];
+
+static inline unsigned int site_hash(void *where)
+{
+	return ((unsigned long) where >> 2) & (LOCKMETER_SITES-1);
+}
+
+/*
+ * Interrupts must be off: handlers take locks too and the table
+ * belongs to this CPU only.
+ */
+static struct lock_site *lookup_site(struct lockmeter_cpu *lm, void *where)
+{
+	unsigned int i, h = site_hash(where);
+
+	for (i = 0; i < LOCKMETER_SITES; i++) {
+		struct lock_site *site = lm->sites + ((h + i) & (LOCKMETER_SITES-1));
+
+		if (site->where == where)
+			return site;
+		if (!site->where) {
+			site->where = where;
+			return site;
+		}
+	}
+	lm->lost++;
+	return NULL;
+}
+
+static void charge_lock(void *where, void *lock, int contended, cycles_t spin)
+{
+	struct lock_site *site;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	site = lookup_site(lockmeter_cpus + smp_processor_id(), where);
+	if (site) {
+		site->lock = lock;
+		site->count++;
+		if (contended) {
+			site->contended++;
+			site->spin += spin;
+		}
+	}
+	local_irq_restore(flags);
+}
+
+static void charge_hold(void *where, cycles_t acquired)
+{
+	cycles_t hold = get_cycles() - acquired;
+	struct lock_site *site;
+	unsigned long flags;
+
+	if (!where)
+		return;
+	local_irq_save(flags);
+	site = lookup_site(lockmeter_cpus + smp_processor_id(), where);
+	if (site)
+		site->hold += hold;
+	local_irq_restore(flags);
+}
+
+void _metered_spin_lock(spinlock_t *lock)
+{
+	void *where = __builtin_return_address(0);
+	cycles_t spin = 0;
+	int contended = 0;
+
+	if (!_raw_spin_trylock(lock)) {
+		contended = 1;
+		spin = get_cycles();
+		_raw_spin_lock(lock);
+		spin = get_cycles() - spin;
+	}
+	charge_lock(where, lock, contended, spin);
+	lock->where = where;
+	lock->acquired = get_cycles();
+}
+
+int _metered_spin_trylock(spinlock_t *lock)
+{
+	void *where = __builtin_return_address(0);
+
+	if (!_raw_spin_trylock(lock))
+		return 0;
+	charge_lock(where, lock, 0, 0);
+	lock->where = where;
+	lock->acquired = get_cycles();
+	return 1;
+}
+
+void _metered_spin_unlock(spinlock_t *lock)
+{
+	void *where = lock->where;
+	cycles_t acquired = lock->acquired;
+
+	lock->where = NULL;
+	_raw_spin_unlock(lock);
+	charge_hold(where, acquired);
+}
+
+/*
+ * There is no read_trylock(): a reader waits if a writer holds or
+ * wants the lock, which is when the count is not positive.
+ */
+void _metered_read_lock(rwlock_t *rw)
+{
+	void *where = __builtin_return_address(0);
+	int contended = (int) rw->lock <= 0;
+	cycles_t spin = get_cycles();
+
+	_raw_read_lock(rw);
+	spin = get_cycles() - spin;
+	charge_lock(where, rw, contended, contended ? spin : 0);
+}
+
+void _metered_write_lock(rwlock_t *rw)
+{
+	void *where = __builtin_return_address(0);
+	cycles_t spin = 0;
+	int contended = 0;
+
+	if (!_raw_write_trylock(rw)) {
+		contended = 1;
+		spin = get_cycles();
+		_raw_write_lock(rw);
+		spin = get_cycles() - spin;
+	}
+	charge_lock(where, rw, contended, spin);
+	rw->where = where;
+	rw->acquired = get_cycles();
+}
+
+int _metered_write_trylock(rwlock_t *rw)
+{
+	void *where = __builtin_return_address(0);
+
+	if (!_raw_write_trylock(rw))
+		return 0;
+	charge_lock(where, rw, 0, 0);
+	rw->where = where;
+	rw->acquired = get_cycles();
+	return 1;
+}
+
+void _metered_write_unlock(rwlock_t *rw)
+{
+	void *where = rw->where;
+	cycles_t acquired = rw->acquired;
+
+	rw->where = NULL;
+	_raw_write_unlock(rw);
+	charge_hold(where, acquired);
+}
+
+EXPORT_SYMBOL(_metered_spin_lock);
+EXPORT_SYMBOL(_metered_spin_trylock);
+EXPORT_SYMBOL(_metered_spin_unlock);
+EXPORT_SYMBOL(_metered_read_lock);
+EXPORT_SYMBOL(_metered_write_lock);
+EXPORT_SYMBOL(_metered_write_trylock);
+EXPORT_SYMBOL(_metered_write_unlock);
+
+/*
+ * Sum one site over all CPUs. Returns 0 if a lower numbered CPU has
+ * the site as well, so that it is only reported once.
+ */
+static int sum_site(int cpu, struct lock_site *site, struct lock_site *sum)
+{
+	int i;
+
+	*sum = *site;
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct lockmeter_cpu *lm = lockmeter_cpus + cpu_logical_map(i);
+		unsigned int j, h = site_hash(site->where);
+
+		if (i == cpu)
+			continue;
+		for (j = 0; j < LOCKMETER_SITES; j++) {
+			struct lock_site *s = lm->sites + ((h + j) & (LOCKMETER_SITES-1));
+
+			if (!s->where)
+				break;
+			if (s->where != site->where)
+				continue;
+			if (i < cpu)
+				return 0;
+			sum->count += s->count;
+			sum->contended += s->contended;
+			sum->spin += s->spin;
+			sum->hold += s->hold;
+			break;
+		}
+	}
+	return 1;
+}
+
+/*
+ * The tables are read without any locking; a line may be a little
+ * off while the site is busy. Interface as get_locks_status().
+ */
+int get_lockmeter_info(char *buffer, char **start, off_t offset, int length)
+{
+	extern unsigned long cpu_khz;
+	unsigned long lost = 0;
+	off_t pos = 0, begin = 0;
+	int len = 0, i, j;
+
+	for (i = 0; i < smp_num_cpus; i++)
+		lost += lockmeter_cpus[cpu_logical_map(i)].lost;
+	len += sprintf(buffer + len, "cpu_khz %lu lost %lu\n", cpu_khz, lost);
+	len += sprintf(buffer + len, "%-10s %-10s %10s %10s %16s %16s\n",
+		       "site", "lock", "count", "contended", "spin", "hold");
+
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct lockmeter_cpu *lm = lockmeter_cpus + cpu_logical_map(i);
+
+		for (j = 0; j < LOCKMETER_SITES; j++) {
+			struct lock_site sum;
+
+			if (!lm->sites[j].where)
+				continue;
+			if (!sum_site(i, lm->sites + j, &sum))
+				continue;
+			len += sprintf(buffer + len,
+				       "%p %p %10lu %10lu %16Lu %16Lu\n",
+				       sum.where, sum.lock, sum.count,
+				       sum.contended,
+				       (unsigned long long) sum.spin,
+				       (unsigned long long) sum.hold);
+			pos = begin + len;
+			if (pos < offset) {
+				len = 0;
+				begin = pos;
+			}
+			if (pos > offset + length)
+				goto done;
+		}
+	}
+done:
+	*start = buffer + (offset - begin);
+	len -= (offset - begin);
+	if (len > length)
+		len = length;
+	if (len < 0)
+		len = 0;
+	return len;
+}
@@ -12,6 +12,7 @@
 #include <linux/mm.h>
 #include <linux/highmem.h>
 #include <linux/smp_lock.h>
+#include <linux/hugetlb.h>
 
 #include <asm/pgtable.h>
 #include <asm/uaccess.h>
@@ -36,6 +37,9 @@ repeat:
 	pgmiddle = pmd_offset(pgdir, addr);
 	if (pmd_none(*pgmiddle))
 		goto fault_in_page;
+	/* huge pages are reserved pages, see below */
+	if (pmd_huge(*pgmiddle))
+		return 0;
 	if (pmd_bad(*pgmiddle))
 		goto bad_pmd;
 	pgtable = pte_offset(pgmiddle, addr);
@@ -66,6 +66,40 @@ extern void mem_use(void);
 
 #define NICE_TO_TICKS(nice)	(TICK_SCALE(20-(nice))+1)
 
+/*
+ * Priorities. RT tasks use 0..MAX_RT_PRIO-1, SCHED_OTHER tasks
+ * MAX_RT_PRIO..MAX_PRIO-1, a lower value means a higher priority.
+ * The nice value of a SCHED_OTHER task sets its static priority;
+ * how much it slept recently (p->sleep_avg) moves its dynamic
+ * priority up to +-5 around that, so that interactive tasks stay
+ * responsive next to CPU hogs of the same nice level.
+ */
+#define NICE_TO_PRIO(nice)	(MAX_RT_PRIO + (nice) + 20)
+#define MAX_USER_PRIO		(MAX_PRIO - MAX_RT_PRIO)
+#define PRIO_BONUS_RATIO	25
+#define INTERACTIVE_DELTA	2
+#define MAX_SLEEP_AVG		(2*HZ)
+#define STARVATION_LIMIT	(2*HZ)
+
+#define rt_task(p)		(((p)->policy & ~SCHED_YIELD) != SCHED_OTHER)
+
+/*
+ * A task is 'interactive' if its dynamic priority is at least
+ * INTERACTIVE_DELTA (scaled by nice) better than its static one.
+ * Interactive tasks get their timeslice refilled in the active
+ * array instead of being expired - unless the expired tasks have
+ * been waiting for too long.
+ */
+#define TASK_INTERACTIVE(p) \
+	((p)->prio <= NICE_TO_PRIO((p)->nice) - \
+		((p)->nice * MAX_USER_PRIO * PRIO_BONUS_RATIO / 100 / 40 + \
+		 INTERACTIVE_DELTA))
+
+#define EXPIRED_STARVING(rq) \
+	((rq)->expired_timestamp && \
+	 (jiffies - (rq)->expired_timestamp >= \
+		STARVATION_LIMIT * ((rq)->nr_running + 1)))
+
 
 /*
  *	Init task must be ok at boot for the ix86 as we will check its signals
@@ -77,33 +111,62 @@ struct task_struct * init_tasks[NR_CPUS] = {&init_task, };
 /*
  * The tasklist_lock protects the linked list of processes.
  *
- * The runqueue_lock locks the parts that actually access
- * and change the run-queues, and have to be interrupt-safe.
+ * Every CPU has a runqueue of its own, protected by its own
+ * interrupt-safe spinlock. A runnable task sits on the runqueue
+ * of the CPU it last ran on (p->processor) and only that CPU will
+ * pick it in schedule(); tasks change queues only at wakeup time
+ * (while they are on no queue at all) or via load_balance().
  *
- * If both locks are to be concurrently held, the runqueue_lock
- * nests inside the tasklist_lock.
+ * p->processor of a queued or running task may only be changed
+ * while holding the lock of the runqueue it is on. If two runqueue
+ * locks are needed they are taken in address order, and runqueue
+ * locks nest inside the tasklist_lock.
  */
-spinlock_t runqueue_lock __cacheline_aligned = SPIN_LOCK_UNLOCKED;  /* inner */
 rwlock_t tasklist_lock __cacheline_aligned = RW_LOCK_UNLOCKED;	/* outer */
 
-static LIST_HEAD(runqueue_head);
+/*
+ * A priority array holds one list of runnable tasks per priority
+ * level, plus a bitmap of the non-empty lists. Bit MAX_PRIO is
+ * always set, so a bitmap search always terminates.
+ *
+ * Each runqueue has two of them: tasks with timeslice left are in
+ * the 'active' array, tasks that used up their timeslice wait in
+ * the 'expired' array with a freshly refilled one. When the active
+ * array runs empty the two are switched - there is no pass over
+ * all tasks to recalculate timeslices.
+ */
+#define BITMAP_SIZE ((MAX_PRIO+1+BITS_PER_LONG-1)/BITS_PER_LONG)
+
+struct prio_array {
+	int nr_active;
+	unsigned long bitmap[BITMAP_SIZE];
+	struct list_head queue[MAX_PRIO];
+};
 
 /*
  * We align per-CPU scheduling data on cacheline boundaries,
  * to prevent cacheline ping-pong.
  */
-static union {
-	struct schedule_data {
-		struct task_struct * curr;
-		cycles_t last_schedule;
-	} schedule_data;
-	char __pad [SMP_CACHE_BYTES];
-} aligned_data [NR_CPUS] __cacheline_aligned = { {{&init_task,0}}};
-
-#define cpu_curr(cpu) aligned_data[(cpu)].schedule_data.curr
-#define last_schedule(cpu) aligned_data[(cpu)].schedule_data.last_schedule
+struct runqueue {
+	spinlock_t lock;
+	unsigned long nr_running;
+	struct task_struct * curr;
+	cycles_t last_schedule;
+	struct prio_array *active, *expired, arrays[2];
+	unsigned long expired_timestamp;
+	int prev_nr_running[NR_CPUS];
+} ____cacheline_aligned;
+
+static struct runqueue runqueues [NR_CPUS] __cacheline_aligned;
+
+#define cpu_rq(cpu)		(runqueues + (cpu))
+#define this_rq()		cpu_rq(smp_processor_id())
+#define task_rq(p)		cpu_rq((p)->processor)
+#define cpu_curr(cpu)		(cpu_rq(cpu)->curr)
+#define last_schedule(cpu)	(cpu_rq(cpu)->last_schedule)
 
 struct kernel_stat kstat;
+struct kernel_stat_cpu kstat_cpu[NR_CPUS];
 
 #ifdef CONFIG_SMP
 
@@ -111,211 +174,278 @@ struct kernel_stat kstat;
 #define can_schedule(p,cpu) ((!(p)->has_cpu) && \
 				((p)->cpus_allowed & (1 << cpu)))
 
+/*
+ * A task that left its CPU less than this many ticks ago still has
+ * a warm cache there and is not migrated by the load balancer unless
+ * the destination CPU would otherwise idle. PROC_CHANGE_PENALTY
+ * is the architecture's estimate of what a CPU change costs.
+ */
+#define CACHE_DECAY_TICKS	(TICK_SCALE(PROC_CHANGE_PENALTY) ? : 1)
+#define task_hot(p, now)	((long) ((now) - (p)->sleep_time) < CACHE_DECAY_TICKS)
+
+/*
+ * Idle CPUs look for work every tick, busy ones rebalance
+ * every 200 msecs.
+ */
+#define IDLE_REBALANCE_TICK	1
+#define BUSY_REBALANCE_TICK	(HZ/5 ? : 1)
+
 #else
 
 #define idle_task(cpu) (&init_task)
-#define can_schedule(p,cpu) (1)
 
 #endif
 
+/*
+ * Lock the runqueue the task is on. p->processor can change
+ * under us until we hold that lock, so recheck it afterwards.
+ */
+static inline struct runqueue *task_rq_lock(struct task_struct *p, unsigned long *flags)
+{
+	struct runqueue *rq;
+
+repeat:
+	rq = task_rq(p);
+	spin_lock_irqsave(&rq->lock, *flags);
+	if (rq != task_rq(p)) {
+		spin_unlock_irqrestore(&rq->lock, *flags);
+		goto repeat;
+	}
+	return rq;
+}
+
+static inline void task_rq_unlock(struct runqueue *rq, unsigned long *flags)
+{
+	spin_unlock_irqrestore(&rq->lock, *flags);
+}
+
+/*
+ * Number of runnable tasks in the system. Only used for
+ * statistics, so the unlocked sum is good enough.
+ */
+unsigned long nr_running(void)
+{
+	unsigned long sum = 0;
+	int i;
+
+	for (i = 0; i < smp_num_cpus; i++)
+		sum += cpu_rq(cpu_logical_map(i))->nr_running;
+	return sum;
+}
+
 void scheduling_functions_start_here(void) { }
 
 /*
- * This is the function that decides how desirable a process is..
- * You can weigh different processes against each other depending
- * on what CPU they've run on lately etc to try to handle cache
- * and TLB miss penalties.
- *
- * Return values:
- *	 -1000: never select this
- *	     0: out of time, recalculate counters (but it might still be
- *		selected)
- *	   +ve: "goodness" value (the larger, the better)
- *	 +1000: realtime process, select this.
+ * Find the first set bit at or after 'offset' in a priority
+ * bitmap. The delimiter bit makes the search finite, and with
+ * MAX_PRIO = 140 it looks at no more than five words.
  */
+static inline int sched_find_next_bit(unsigned long *bitmap, int offset)
+{
+	unsigned long *p = bitmap + offset / BITS_PER_LONG;
+	unsigned long word = *p & (~0UL << (offset % BITS_PER_LONG));
 
-static inline int goodness(struct task_struct * p, int this_cpu, struct mm_struct *this_mm)
+	while (!word)
+		word = *++p;
+	return (p - bitmap) * BITS_PER_LONG + ffz(~word);
+}
+
+#define sched_find_first_bit(bitmap)	sched_find_next_bit(bitmap, 0)
+
+static inline void dequeue_task(struct task_struct * p, struct prio_array *array)
 {
-	int weight;
+	array->nr_active--;
+	list_del(&p->run_list);
+	if (list_empty(array->queue + p->prio))
+		__clear_bit(p->prio, array->bitmap);
+}
 
-	/*
-	 * select the current process after every other
-	 * runnable process, but before the idle thread.
-	 * Also, dont trigger a counter recalculation.
-	 */
-	weight = -1;
-	if (p->policy & SCHED_YIELD)
-		goto out;
+static inline void enqueue_task(struct task_struct * p, struct prio_array *array)
+{
+	list_add_tail(&p->run_list, array->queue + p->prio);
+	__set_bit(p->prio, array->bitmap);
+	array->nr_active++;
+	p->array = array;
+}
 
-	/*
-	 * Non-RT process - normal case first.
-	 */
-	if (p->policy == SCHED_OTHER) {
-		/*
-		 * Give the process a first-approximation goodness value
-		 * according to the number of clock-ticks it has left.
-		 *
-		 * Don't do any other calculations if the time slice is
-		 * over..
-		 */
-		weight = p->counter;
-		if (!weight)
-			goto out;
-			
-#ifdef CONFIG_SMP
-		/* Give a largish advantage to the same processor...   */
-		/* (this is equivalent to penalizing other processors) */
-		if (p->processor == this_cpu)
-			weight += PROC_CHANGE_PENALTY;
-#endif
+/*
+ * The dynamic priority of a task: RT tasks are ordered by
+ * rt_priority, SCHED_OTHER tasks get a bonus or penalty of up
+ * to MAX_USER_PRIO*PRIO_BONUS_RATIO/200 depending on how much
+ * of the last MAX_SLEEP_AVG ticks they spent sleeping.
+ */
+static inline int effective_prio(struct task_struct * p)
+{
+	int bonus, prio;
 
-		/* .. and a slight advantage to the current MM */
-		if (p->mm == this_mm || !p->mm)
-			weight += 1;
-		weight += 20 - p->nice;
-		goto out;
+	if (rt_task(p))
+		return MAX_RT_PRIO - 1 - p->rt_priority;
+
+	bonus = MAX_USER_PRIO*PRIO_BONUS_RATIO*p->sleep_avg/MAX_SLEEP_AVG/100 -
+			MAX_USER_PRIO*PRIO_BONUS_RATIO/100/2;
+
+	prio = NICE_TO_PRIO(p->nice) - bonus;
+	if (prio < MAX_RT_PRIO)
+		prio = MAX_RT_PRIO;
+	if (prio > MAX_PRIO-1)
+		prio = MAX_PRIO-1;
+	return prio;
+}
+
+/*
+ * Put a task that was not runnable onto a runqueue. The time it
+ * spent sleeping counts towards its interactivity bonus.
+ */
+static inline void add_to_runqueue(struct task_struct * p, struct runqueue *rq)
+{
+	unsigned long sleep_time = jiffies - p->sleep_time;
+
+	if (!rt_task(p) && sleep_time) {
+		p->sleep_avg += sleep_time;
+		if (p->sleep_avg > MAX_SLEEP_AVG)
+			p->sleep_avg = MAX_SLEEP_AVG;
 	}
+	p->prio = effective_prio(p);
+	enqueue_task(p, rq->active);
+	rq->nr_running++;
+}
 
-	/*
-	 * Realtime process, select the first one on the
-	 * runqueue (taking priorities within processes
-	 * into account).
-	 */
-	weight = 1000 + p->rt_priority;
-out:
-	return weight;
+static inline void __del_from_runqueue(struct task_struct * p, struct runqueue *rq)
+{
+	rq->nr_running--;
+	p->sleep_time = jiffies;
+	dequeue_task(p, p->array);
+	p->array = NULL;
+	p->run_list.next = NULL;
 }
 
 /*
- * the 'goodness value' of replacing a process on a given CPU.
- * positive value means 'replace', zero or negative means 'dont'.
+ * Move a task to the end of its priority list, behind all
+ * other tasks of the same priority.
  */
-static inline int preemption_goodness(struct task_struct * prev, struct task_struct * p, int cpu)
+static inline void move_last_runqueue(struct task_struct * p)
 {
-	return goodness(p, cpu, prev->active_mm) - goodness(prev, cpu, prev->active_mm);
+	struct prio_array *array = p->array;
+
+	dequeue_task(p, array);
+	enqueue_task(p, array);
 }
 
 /*
- * This is ugly, but reschedule_idle() is very timing-critical.
- * We are called with the runqueue spinlock held and we must
- * not claim the tasklist_lock.
+ * Take a task off whatever runqueue it is on. Used by the
+ * SMP boot code to park the freshly forked idle threads.
  */
-static FASTCALL(void reschedule_idle(struct task_struct * p));
+void del_from_runqueue(struct task_struct * p)
+{
+	unsigned long flags;
+	struct runqueue *rq;
+
+	rq = task_rq_lock(p, &flags);
+	if (task_on_runqueue(p))
+		__del_from_runqueue(p, rq);
+	task_rq_unlock(rq, &flags);
+}
 
-static void reschedule_idle(struct task_struct * p)
+/*
+ * Flags for try_to_wake_up(): what the waker wants ...
+ */
+#define WAKE_SYNC	0x01	/* waker is about to sleep, don't preempt */
+#define WAKE_AFFINE	0x02	/* keep the task on its or the waker's CPU */
+/* ... and what it took. */
+#define WAKE_MIGRATED	0x04	/* queued on a CPU other than its last one */
+#define WAKE_IPI	0x08	/* another CPU had to be interrupted */
+
+/*
+ * Ask a CPU to reschedule. If its need_resched is -1 then we can
+ * skip sending the IPI altogether, tsk->need_resched is actively
+ * watched by the idle thread. Returns WAKE_IPI if an IPI was sent.
+ */
+static inline int resched_cpu(int cpu)
 {
+	struct task_struct *tsk = cpu_curr(cpu);
 #ifdef CONFIG_SMP
-	int this_cpu = smp_processor_id();
-	struct task_struct *tsk, *target_tsk;
-	int cpu, best_cpu, i, max_prio;
+	int need_resched = tsk->need_resched;
+
+	tsk->need_resched = 1;
+	if ((cpu != smp_processor_id()) && !need_resched) {
+		smp_send_reschedule(cpu);
+		return WAKE_IPI;
+	}
+#else
+	tsk->need_resched = 1;
+#endif
+	return 0;
+}
+
+#ifdef CONFIG_SMP
+/*
+ * Pick the CPU a woken-up task should be queued on. The
+ * task's last CPU wins if it is idle now, because that
+ * one has the task's cache context. Otherwise select the
+ * least recently active idle CPU (that one will have the
+ * least active cache context). If no allowed CPU is idle
+ * the task stays where it was and the load balancer will
+ * move it if the imbalance persists.
+ */
+static int wake_cpu(struct task_struct * p)
+{
+	int cpu, best_cpu, i;
 	cycles_t oldest_idle;
 
-	/*
-	 * shortcut if the woken up task's last CPU is
-	 * idle now.
-	 */
 	best_cpu = p->processor;
-	if (can_schedule(p, best_cpu)) {
-		tsk = idle_task(best_cpu);
-		if (cpu_curr(best_cpu) == tsk) {
-			int need_resched;
-send_now_idle:
-			/*
-			 * If need_resched == -1 then we can skip sending
-			 * the IPI altogether, tsk->need_resched is
-			 * actively watched by the idle thread.
-			 */
-			need_resched = tsk->need_resched;
-			tsk->need_resched = 1;
-			if ((best_cpu != this_cpu) && !need_resched)
-				smp_send_reschedule(best_cpu);
-			return;
-		}
-	}
+	if ((p->cpus_allowed & (1 << best_cpu)) &&
+			cpu_curr(best_cpu) == idle_task(best_cpu))
+		return best_cpu;
 
-	/*
-	 * We know that the preferred CPU has a cache-affine current
-	 * process, lets try to find a new idle CPU for the woken-up
-	 * process. Select the least recently active idle CPU. (that
-	 * one will have the least active cache context.) Also find
-	 * the executing process which has the least priority.
-	 */
 	oldest_idle = (cycles_t) -1;
-	target_tsk = NULL;
-	max_prio = 1;
-
 	for (i = 0; i < smp_num_cpus; i++) {
 		cpu = cpu_logical_map(i);
-		if (!can_schedule(p, cpu))
+		if (!(p->cpus_allowed & (1 << cpu)))
 			continue;
-		tsk = cpu_curr(cpu);
-		/*
-		 * We use the first available idle CPU. This creates
-		 * a priority list between idle CPUs, but this is not
-		 * a problem.
-		 */
-		if (tsk == idle_task(cpu)) {
-			if (last_schedule(cpu) < oldest_idle) {
-				oldest_idle = last_schedule(cpu);
-				target_tsk = tsk;
-			}
-		} else {
-			if (oldest_idle == -1ULL) {
-				int prio = preemption_goodness(tsk, p, cpu);
-
-				if (prio > max_prio) {
-					max_prio = prio;
-					target_tsk = tsk;
-				}
-			}
-		}
-	}
-	tsk = target_tsk;
-	if (tsk) {
-		if (oldest_idle != -1ULL) {
-			best_cpu = tsk->processor;
-			goto send_now_idle;
+		if (!(p->cpus_allowed & (1 << best_cpu)))
+			best_cpu = cpu;
+		if (cpu_curr(cpu) == idle_task(cpu) &&
+				last_schedule(cpu) < oldest_idle) {
+			oldest_idle = last_schedule(cpu);
+			best_cpu = cpu;
 		}
-		tsk->need_resched = 1;
-		if (tsk->processor != this_cpu)
-			smp_send_reschedule(tsk->processor);
 	}
-	return;
-		
-
-#else /* UP */
-	int this_cpu = smp_processor_id();
-	struct task_struct *tsk;
-
-	tsk = cpu_curr(this_cpu);
-	if (preemption_goodness(tsk, p, this_cpu) > 1)
-		tsk->need_resched = 1;
-#endif
+	return best_cpu;
 }
 
 /*
- * Careful!
- *
- * This has to add the process to the _beginning_ of the
- * run-queue, not the end. See the comment about "This is
- * subtle" in the scheduler proper..
+ * CPU choice for affine wakeups: the task's last CPU if it is
+ * idle, else the waker's CPU - whose cache holds the data the
+ * waker just produced for the task. Never another idle CPU, as
+ * that one would start out with a cold cache.
  */
-static inline void add_to_runqueue(struct task_struct * p)
+static inline int wake_cpu_affine(struct task_struct * p)
 {
-	list_add(&p->run_list, &runqueue_head);
-	nr_running++;
-}
+	int cpu = p->processor, this_cpu = smp_processor_id();
 
-static inline void move_last_runqueue(struct task_struct * p)
-{
-	list_del(&p->run_list);
-	list_add_tail(&p->run_list, &runqueue_head);
+	if ((p->cpus_allowed & (1 << cpu)) && cpu_curr(cpu) == idle_task(cpu))
+		return cpu;
+	if (p->cpus_allowed & (1 << this_cpu))
+		return this_cpu;
+	return wake_cpu(p);
 }
+#endif
 
-static inline void move_first_runqueue(struct task_struct * p)
+/*
+ * This is ugly, but reschedule_idle() is very timing-critical.
+ * We are called with the runqueue lock of p's CPU held, after
+ * p has been queued there, and we must not claim the
+ * tasklist_lock. Preempt the CPU's current task if p has a
+ * higher priority.
+ */
+static inline int reschedule_idle(struct task_struct * p)
 {
-	list_del(&p->run_list);
-	list_add(&p->run_list, &runqueue_head);
+	int cpu = p->processor;
+	struct task_struct *tsk = cpu_curr(cpu);
+
+	if (tsk == idle_task(cpu) || p->prio < tsk->prio)
+		return resched_cpu(cpu);
+	return 0;
 }
 
 /*
@@ -325,38 +455,293 @@ static inline void move_first_runqueue(struct task_struct * p)
  * progress), and as such you're allowed to do the simpler
  * "current->state = TASK_RUNNING" to mark yourself runnable
  * without the overhead of this.
+ *
+ * A WAKE_SYNC wakeup comes from a waker that is about to sleep
+ * itself, so the task is queued on its old CPU and no preemption
+ * is attempted. Returns the WAKE_MIGRATED and WAKE_IPI costs of
+ * the wakeup, for the wait queue statistics.
  */
-inline void wake_up_process(struct task_struct * p)
+static inline int try_to_wake_up(struct task_struct * p, int flags)
 {
-	unsigned long flags;
+	unsigned long irqflags;
+	struct runqueue *rq;
+	int ret = 0;
 
 	/*
 	 * We want the common case fall through straight, thus the goto.
 	 */
-	spin_lock_irqsave(&runqueue_lock, flags);
+	rq = task_rq_lock(p, &irqflags);
 	p->state = TASK_RUNNING;
 	if (task_on_runqueue(p))
 		goto out;
-	add_to_runqueue(p);
-	reschedule_idle(p);
+#ifdef CONFIG_SMP
+	/*
+	 * A task that is neither queued nor running belongs to no
+	 * runqueue, so we may move it while holding its old queue's
+	 * lock. Another waker might beat us to the new queue; the
+	 * recheck under that lock catches it.
+	 */
+	if (!(flags & WAKE_SYNC) && !p->has_cpu) {
+		int cpu;
+
+		if (flags & WAKE_AFFINE)
+			cpu = wake_cpu_affine(p);
+		else
+			cpu = wake_cpu(p);
+		if (cpu != p->processor) {
+			p->processor = cpu;
+			task_rq_unlock(rq, &irqflags);
+			rq = task_rq_lock(p, &irqflags);
+			p->state = TASK_RUNNING;
+			if (task_on_runqueue(p))
+				goto out;
+			ret |= WAKE_MIGRATED;
+		}
+	}
+#endif
+	add_to_runqueue(p, rq);
+	if (!(flags & WAKE_SYNC))
+		ret |= reschedule_idle(p);
 out:
-	spin_unlock_irqrestore(&runqueue_lock, flags);
+	task_rq_unlock(rq, &irqflags);
+	return ret;
+}
+
+inline void wake_up_process(struct task_struct * p)
+{
+	try_to_wake_up(p, 0);
+}
+
+#ifdef CONFIG_SMP
+/*
+ * Kick a task that is running on another CPU so that it
+ * notices new signals quickly.
+ */
+void kick_if_running(struct task_struct * p)
+{
+	if (p->has_cpu && p->processor != smp_processor_id())
+		smp_send_reschedule(p->processor);
 }
 
-static inline void wake_up_process_synchronous(struct task_struct * p)
+/*
+ * Move a runnable task that has just been switched out, and that is
+ * not allowed on this CPU any more, to a CPU it may run on. schedule()
+ * took it off our runqueue already unless a wakeup raced with it and
+ * queued it here again. Once it is off, it is neither queued nor
+ * running, so the wakeup path does the placement.
+ */
+static void migrate_task(struct task_struct * p)
 {
 	unsigned long flags;
+	struct runqueue *rq;
+
+	rq = task_rq_lock(p, &flags);
+	if (task_on_runqueue(p))
+		__del_from_runqueue(p, rq);
+	task_rq_unlock(rq, &flags);
+
+	try_to_wake_up(p, 0);
+}
+
+/*
+ * Lock the busiest runqueue as well. We hold this_rq->lock, so
+ * to respect the lock ordering we may have to drop it first,
+ * in which case the number of our runnable tasks may have
+ * changed.
+ */
+static inline unsigned long double_lock_balance(struct runqueue *this_rq,
+	struct runqueue *busiest, unsigned long nr_running)
+{
+	if (!spin_trylock(&busiest->lock)) {
+		if (busiest < this_rq) {
+			spin_unlock(&this_rq->lock);
+			spin_lock(&busiest->lock);
+			spin_lock(&this_rq->lock);
+			nr_running = this_rq->nr_running;
+		} else
+			spin_lock(&busiest->lock);
+	}
+	return nr_running;
+}
+
+static inline int can_migrate_task(struct task_struct * p, int this_cpu,
+	unsigned long now, int hot_ok)
+{
+	if (!can_schedule(p, this_cpu))
+		return 0;
+	return hot_ok || !task_hot(p, now);
+}
 
+/*
+ * Pull tasks from the busiest runqueue to ours if the imbalance
+ * is large enough. Called with this_rq->lock held and interrupts
+ * disabled.
+ *
+ * To avoid bouncing tasks around on short-lived load spikes a
+ * busy CPU only reacts to loads that were seen on two consecutive
+ * calls (prev_nr_running[]) and to imbalances of at least 25%. An
+ * idle CPU takes any work it can get, including cache-hot tasks
+ * if there is nothing colder to steal.
+ */
+static void load_balance(struct runqueue *this_rq, int idle)
+{
+	int imbalance, this_cpu, i, hot_ok;
+	unsigned long nr_running, load, max_load, now;
+	struct runqueue *busiest, *rq_src;
+	struct prio_array *array;
+	struct list_head *head, *tmp;
+	struct task_struct *p;
+	int idx;
+
+	this_cpu = smp_processor_id();
+	nr_running = this_rq->nr_running;
+
+	busiest = NULL;
+	max_load = 1;
+	for (i = 0; i < smp_num_cpus; i++) {
+		int cpu = cpu_logical_map(i);
+
+		rq_src = cpu_rq(cpu);
+		if (idle || rq_src->nr_running < this_rq->prev_nr_running[cpu])
+			load = rq_src->nr_running;
+		else
+			load = this_rq->prev_nr_running[cpu];
+		this_rq->prev_nr_running[cpu] = rq_src->nr_running;
+
+		if (load > max_load && rq_src != this_rq) {
+			max_load = load;
+			busiest = rq_src;
+		}
+	}
+	if (!busiest)
+		return;
+
+	imbalance = (max_load - nr_running) / 2;
+	if (!idle && imbalance < (max_load + 3) / 4)
+		return;
+
+	nr_running = double_lock_balance(this_rq, busiest, nr_running);
 	/*
-	 * We want the common case fall through straight, thus the goto.
+	 * Make sure nothing changed since we checked the
+	 * runqueue length.
 	 */
-	spin_lock_irqsave(&runqueue_lock, flags);
-	p->state = TASK_RUNNING;
-	if (task_on_runqueue(p))
+	if (busiest->nr_running <= nr_running + 1)
+		goto out_unlock;
+	if (imbalance < 1)
+		imbalance = 1;
+
+	/*
+	 * Expired tasks will not run on the busiest CPU for a while
+	 * and are the coldest ones, so they are considered first.
+	 * Within a priority list the tasks at the tail were queued
+	 * last and have waited the shortest; start from there.
+	 */
+	now = jiffies;
+	for (hot_ok = 0; hot_ok <= idle; hot_ok++) {
+		array = busiest->expired->nr_active ? busiest->expired : busiest->active;
+new_array:
+		idx = sched_find_first_bit(array->bitmap);
+		while (imbalance && idx < MAX_PRIO) {
+			head = array->queue + idx;
+			tmp = head->prev;
+			while (imbalance && tmp != head) {
+				p = list_entry(tmp, struct task_struct, run_list);
+				tmp = tmp->prev;
+				if (!can_migrate_task(p, this_cpu, now, hot_ok))
+					continue;
+
+				dequeue_task(p, array);
+				busiest->nr_running--;
+				p->processor = this_cpu;
+				enqueue_task(p, this_rq->active);
+				this_rq->nr_running++;
+				if (p->prio < this_rq->curr->prio)
+					this_rq->curr->need_resched = 1;
+				imbalance--;
+			}
+			idx = sched_find_next_bit(array->bitmap, idx + 1);
+		}
+		if (imbalance && array == busiest->expired) {
+			array = busiest->active;
+			goto new_array;
+		}
+		if (nr_running != this_rq->nr_running)
+			break;
+	}
+out_unlock:
+	spin_unlock(&busiest->lock);
+}
+
+static inline void rebalance_tick(struct runqueue *rq, int idle)
+{
+	if (jiffies % (idle ? IDLE_REBALANCE_TICK : BUSY_REBALANCE_TICK))
+		return;
+	spin_lock(&rq->lock);
+	load_balance(rq, idle);
+	spin_unlock(&rq->lock);
+}
+#endif /* CONFIG_SMP */
+
+/*
+ * Called from the timer tick to charge one tick to the current
+ * process. When its timeslice runs out it is refilled right away
+ * and the task moves to the expired array (or stays active if it
+ * is interactive), so there is never a global recalculation.
+ */
+void scheduler_tick(void)
+{
+	struct task_struct *p = current;
+	struct runqueue *rq = this_rq();
+	unsigned long flags;
+
+	local_irq_save(flags);
+	if (!p->pid) {
+#ifdef CONFIG_SMP
+		rebalance_tick(rq, 1);
+#endif
 		goto out;
-	add_to_runqueue(p);
+	}
+
+	spin_lock(&rq->lock);
+	/* Task might have expired already, but not scheduled off yet */
+	if (p->array != rq->active) {
+		p->need_resched = 1;
+		goto out_unlock;
+	}
+	if (rt_task(p)) {
+		/*
+		 * RR tasks go to the end of their priority list
+		 * when their slice is used up, FIFO tasks run
+		 * until they give up the CPU.
+		 */
+		if ((p->policy & ~SCHED_YIELD) == SCHED_RR && --p->counter <= 0) {
+			p->counter = NICE_TO_TICKS(p->nice);
+			p->need_resched = 1;
+			move_last_runqueue(p);
+		}
+		goto out_unlock;
+	}
+	if (p->sleep_avg)
+		p->sleep_avg--;
+	if (--p->counter <= 0) {
+		dequeue_task(p, rq->active);
+		p->need_resched = 1;
+		p->prio = effective_prio(p);
+		p->counter = NICE_TO_TICKS(p->nice);
+		if (!TASK_INTERACTIVE(p) || EXPIRED_STARVING(rq)) {
+			if (!rq->expired_timestamp)
+				rq->expired_timestamp = jiffies;
+			enqueue_task(p, rq->expired);
+		} else
+			enqueue_task(p, rq->active);
+	}
+out_unlock:
+	spin_unlock(&rq->lock);
+#ifdef CONFIG_SMP
+	rebalance_tick(rq, 0);
+#endif
 out:
-	spin_unlock_irqrestore(&runqueue_lock, flags);
+	local_irq_restore(flags);
 }
 
 static void process_timeout(unsigned long __data)
@@ -458,31 +843,28 @@ out_unlock:
 	return;
 
 	/*
-	 * Slow path - we 'push' the previous process and
-	 * reschedule_idle() will attempt to find a new
-	 * processor for it. (but it might preempt the
-	 * current process as well.) We must take the runqueue
-	 * lock and re-check prev->state to be correct. It might
-	 * still happen that this process has a preemption
-	 * 'in progress' already - but this is not a problem and
-	 * might happen in other circumstances as well.
+	 * Slow path - the previous process is still runnable but
+	 * got preempted. It stays on our runqueue; if there is an
+	 * idle CPU it may run on, kick that CPU so that its idle
+	 * load_balance() pulls it over. This is only a hint, so no
+	 * runqueue lock is needed: it might still happen that prev
+	 * gets picked up by us again first, which does no harm.
 	 */
 needs_resched:
 	{
-		unsigned long flags;
+		int cpu;
 
-		/*
-		 * Avoid taking the runqueue lock in cases where
-		 * no preemption-check is necessery:
-		 */
+		if (!(prev->cpus_allowed & (1 << smp_processor_id()))) {
+			migrate_task(prev);
+			goto out_unlock;
+		}
 		if ((prev == idle_task(smp_processor_id())) ||
 						(policy & SCHED_YIELD))
 			goto out_unlock;
 
-		spin_lock_irqsave(&runqueue_lock, flags);
-		if (prev->state == TASK_RUNNING)
-			reschedule_idle(prev);
-		spin_unlock_irqrestore(&runqueue_lock, flags);
+		cpu = wake_cpu(prev);
+		if (cpu != prev->processor)
+			resched_cpu(cpu);
 		goto out_unlock;
 	}
 #else
@@ -507,10 +889,10 @@ void schedule_tail(struct task_struct *prev)
  */
 asmlinkage void schedule(void)
 {
-	struct schedule_data * sched_data;
-	struct task_struct *prev, *next, *p;
-	struct list_head *tmp;
-	int this_cpu, c;
+	struct runqueue *rq;
+	struct prio_array *array;
+	struct task_struct *prev, *next;
+	int this_cpu, idx;
 
 	if (!current->active_mm) BUG();
 need_resched_back:
@@ -528,17 +910,11 @@ need_resched_back:
 handle_softirq_back:
 
 	/*
-	 * 'sched_data' is protected by the fact that we can run
-	 * only one process per CPU.
+	 * Only this CPU picks tasks from its runqueue, but wakeups
+	 * and the load balancers of other CPUs modify it too.
 	 */
-	sched_data = & aligned_data[this_cpu].schedule_data;
-
-	spin_lock_irq(&runqueue_lock);
-
-	/* move an exhausted RR process to be last.. */
-	if (prev->policy == SCHED_RR)
-		goto move_rr_last;
-move_rr_back:
+	rq = cpu_rq(this_cpu);
+	spin_lock_irq(&rq->lock);
 
 	switch (prev->state) {
 		case TASK_INTERRUPTIBLE:
@@ -547,52 +923,81 @@ move_rr_back:
 				break;
 			}
 		default:
-			del_from_runqueue(prev);
+			__del_from_runqueue(prev, rq);
 		case TASK_RUNNING:
+			/*
+			 * A yielding task goes behind every other runnable
+			 * task: RT tasks to the end of their priority list,
+			 * others to the expired array.
+			 */
+			if ((prev->policy & SCHED_YIELD) && prev->array)
+				goto yield_task;
 	}
-	prev->need_resched = 0;
+yield_back:
 
+#ifdef CONFIG_SMP
 	/*
-	 * this is the scheduler proper:
+	 * prev may no longer run on this CPU (its cpus_allowed changed).
+	 * Keep it from being picked again; once it is switched out
+	 * __schedule_tail() queues it on a CPU it is allowed on.
 	 */
+	if (prev->array && !(prev->cpus_allowed & (1 << this_cpu)))
+		__del_from_runqueue(prev, rq);
 
-repeat_schedule:
 	/*
-	 * Default process to select..
+	 * Nothing left to run here - see whether
+	 * another CPU has work to spare.
 	 */
-	next = idle_task(this_cpu);
-	c = -1000;
-	if (prev->state == TASK_RUNNING)
-		goto still_running;
-
-still_running_back:
-	list_for_each(tmp, &runqueue_head) {
-		p = list_entry(tmp, struct task_struct, run_list);
-		if (can_schedule(p, this_cpu)) {
-			int weight = goodness(p, this_cpu, prev->active_mm);
-			if (weight > c)
-				c = weight, next = p;
-		}
+	if (!rq->nr_running)
+		load_balance(rq, 1);
+#endif
+	prev->need_resched = 0;
+
+	/*
+	 * this is the scheduler proper: take the first task of the
+	 * highest priority list of the active array. If the active
+	 * array is empty, all runnable tasks have used up their
+	 * timeslices and the expired array becomes the active one.
+	 */
+	if (!rq->nr_running) {
+		next = idle_task(this_cpu);
+		rq->expired_timestamp = 0;
+		goto switch_tasks;
 	}
 
-	/* Do we need to re-calculate counters? */
-	if (!c)
-		goto recalculate;
+	array = rq->active;
+	if (!array->nr_active) {
+		rq->active = rq->expired;
+		rq->expired = array;
+		array = rq->active;
+		rq->expired_timestamp = 0;
+	}
+
+	idx = sched_find_first_bit(array->bitmap);
+	next = list_entry(array->queue[idx].next, struct task_struct, run_list);
+
+switch_tasks:
 	/*
 	 * from this point on nothing can prevent us from
 	 * switching to the next task, save this fact in
-	 * sched_data.
+	 * the runqueue.
 	 */
-	sched_data->curr = next;
+	rq->curr = next;
 #ifdef CONFIG_SMP
  	next->has_cpu = 1;
 	next->processor = this_cpu;
 #endif
-	spin_unlock_irq(&runqueue_lock);
+	spin_unlock_irq(&rq->lock);
 
 	if (prev == next)
 		goto same_process;
 
+	/*
+	 * Remember when prev left the CPU: the load balancer
+	 * leaves cache-hot tasks alone.
+	 */
+	prev->sleep_time = jiffies;
+
 #ifdef CONFIG_SMP
  	/*
  	 * maintain the per-process 'last schedule' value.
@@ -601,17 +1006,17 @@ still_running_back:
 	 * and it's approximate, so we do not have to maintain
 	 * it while holding the runqueue spinlock.
  	 */
- 	sched_data->last_schedule = get_cycles();
+ 	rq->last_schedule = get_cycles();
 
 	/*
-	 * We drop the scheduler lock early (it's a global spinlock),
-	 * thus we have to lock the previous process from getting
-	 * rescheduled during switch_to().
+	 * We drop the runqueue lock early, thus we have to lock
+	 * the previous process from getting rescheduled during
+	 * switch_to().
 	 */
 
 #endif /* CONFIG_SMP */
 
-	kstat.context_swtch++;
+	kstat_inc(context_swtch);
 	/*
 	 * there are 3 processes which are affected by a context switch:
 	 *
@@ -655,33 +1060,20 @@ same_process:
 
 	return;
 
-recalculate:
-	{
-		struct task_struct *p;
-		spin_unlock_irq(&runqueue_lock);
-		read_lock(&tasklist_lock);
-		for_each_task(p)
-			p->counter = (p->counter >> 1) + NICE_TO_TICKS(p->nice);
-		read_unlock(&tasklist_lock);
-		spin_lock_irq(&runqueue_lock);
-	}
-	goto repeat_schedule;
-
-still_running:
-	c = goodness(prev, this_cpu, prev->active_mm);
-	next = prev;
-	goto still_running_back;
-
 handle_softirq:
 	do_softirq();
 	goto handle_softirq_back;
 
-move_rr_last:
-	if (!prev->counter) {
-		prev->counter = NICE_TO_TICKS(prev->nice);
+yield_task:
+	if (rt_task(prev))
 		move_last_runqueue(prev);
+	else {
+		dequeue_task(prev, prev->array);
+		if (!rq->expired_timestamp)
+			rq->expired_timestamp = jiffies;
+		enqueue_task(prev, rq->expired);
 	}
-	goto move_rr_back;
+	goto yield_back;
 
 scheduling_in_interrupt:
 	printk("Scheduling in interrupt\n");
@@ -689,19 +1081,119 @@ scheduling_in_interrupt:
 	return;
 }
 
+#ifdef CONFIG_WAITQUEUE_STATS
+/*
+ * The totals of every CPU, and a copy of the stats of the wait queues
+ * with the most wakeups, taken every WQ_HOT_SAMPLE wakeups of a queue.
+ * The copies are only printed, so a queue may go away meanwhile.
+ */
+#define WQ_HOT_QUEUES	16
+#define WQ_HOT_SAMPLE	256
+
+static union {
+	struct wait_queue_stats stats;
+	char __pad[SMP_CACHE_BYTES];
+} wq_cpu_stats[NR_CPUS] __cacheline_aligned;
+
+static struct wq_hot {
+	wait_queue_head_t *q;
+	struct wait_queue_stats stats;
+} wq_hot[WQ_HOT_QUEUES];
+static spinlock_t wq_hot_lock = SPIN_LOCK_UNLOCKED;
+
+static void wq_hot_sample(wait_queue_head_t *q)
+{
+	struct wq_hot *hot, *min = wq_hot;
+
+	spin_lock(&wq_hot_lock);
+	for (hot = wq_hot; hot < wq_hot + WQ_HOT_QUEUES; hot++) {
+		if (hot->q == q)
+			break;
+		if (hot->stats.wakeups < min->stats.wakeups)
+			min = hot;
+	}
+	if (hot == wq_hot + WQ_HOT_QUEUES)
+		hot = min;
+	if (hot->q == q || hot->stats.wakeups < q->stats.wakeups) {
+		hot->q = q;
+		hot->stats = q->stats;
+	}
+	spin_unlock(&wq_hot_lock);
+}
+
+/* called with q->lock held and interrupts off */
+static inline void wq_account(wait_queue_head_t *q, int ret)
+{
+	struct wait_queue_stats *cpu = &wq_cpu_stats[smp_processor_id()].stats;
+
+	q->stats.wakeups++;
+	cpu->wakeups++;
+	if (ret & WAKE_IPI) {
+		q->stats.ipis++;
+		cpu->ipis++;
+	}
+	if (ret & WAKE_MIGRATED) {
+		q->stats.migrations++;
+		cpu->migrations++;
+	}
+	if (!(q->stats.wakeups % WQ_HOT_SAMPLE))
+		wq_hot_sample(q);
+}
+
+/*
+ * /proc/wqstat: the wakeups of every CPU, and of the busiest wait
+ * queues by address (look them up in System.map). Read without the
+ * locks.
+ */
+int get_wait_queue_stats(char *buf)
+{
+	char *p = buf;
+	int i;
+
+	p += sprintf(p, "%-10s %10s %10s %10s\n",
+		     "", "wakeups", "ipis", "migrations");
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct wait_queue_stats *cpu =
+			&wq_cpu_stats[cpu_logical_map(i)].stats;
+
+		p += sprintf(p, "cpu%-7d %10lu %10lu %10lu\n", i,
+			     cpu->wakeups, cpu->ipis, cpu->migrations);
+	}
+	for (i = 0; i < WQ_HOT_QUEUES; i++) {
+		struct wq_hot *hot = wq_hot + i;
+
+		if (!hot->q)
+			continue;
+		p += sprintf(p, "%p %10lu %10lu %10lu\n", hot->q,
+			     hot->stats.wakeups, hot->stats.ipis,
+			     hot->stats.migrations);
+	}
+	return p - buf;
+}
+#else
+static inline void wq_account(wait_queue_head_t *q, int ret)
+{
+}
+#endif
+
 static inline void __wake_up_common (wait_queue_head_t *q, unsigned int mode,
 				     unsigned int wq_mode, const int sync)
 {
 	struct list_head *tmp, *head;
 	struct task_struct *p, *best_exclusive;
 	unsigned long flags;
-	int best_cpu, irq;
+	int best_cpu, affine, ret;
 
 	if (!q)
 		goto out;
 
 	best_cpu = smp_processor_id();
-	irq = in_interrupt();
+	/*
+	 * If waking up from an interrupt context then prefer
+	 * exclusive waiters which are affine to this CPU, as
+	 * do affine wakeups from any context.
+	 */
+	affine = in_interrupt() || (wq_mode & WQ_FLAG_AFFINE);
 	best_exclusive = NULL;
 	wq_write_lock_irqsave(&q->lock, flags);
 
@@ -730,12 +1222,7 @@ static inline void __wake_up_common (wait_queue_head_t *q, unsigned int mode,
 #if WAITQUEUE_DEBUG
 			curr->__waker = (long)__builtin_return_address(0);
 #endif
-			/*
-			 * If waking up from an interrupt context then
-			 * prefer processes which are affine to this
-			 * CPU.
-			 */
-			if (irq && (curr->flags & wq_mode & WQ_FLAG_EXCLUSIVE)) {
+			if (affine && (curr->flags & wq_mode & WQ_FLAG_EXCLUSIVE)) {
 				if (!best_exclusive)
 					best_exclusive = p;
 				if (p->processor == best_cpu) {
@@ -743,20 +1230,22 @@ static inline void __wake_up_common (wait_queue_head_t *q, unsigned int mode,
 					break;
 				}
 			} else {
-				if (sync)
-					wake_up_process_synchronous(p);
-				else
-					wake_up_process(p);
+				ret = try_to_wake_up(p, sync ? WAKE_SYNC : 0);
+				wq_account(q, ret);
 				if (curr->flags & wq_mode & WQ_FLAG_EXCLUSIVE)
 					break;
 			}
 		}
 	}
 	if (best_exclusive) {
-		if (sync)
-			wake_up_process_synchronous(best_exclusive);
-		else
-			wake_up_process(best_exclusive);
+		/*
+		 * Only explicit affine wakeups pull the task over
+		 * to this CPU; plain wakeups from interrupts just
+		 * pick the waiter.
+		 */
+		affine = (wq_mode & WQ_FLAG_AFFINE) ? WAKE_AFFINE : 0;
+		ret = try_to_wake_up(best_exclusive, (sync ? WAKE_SYNC : 0) | affine);
+		wq_account(q, ret);
 	}
 	wq_write_unlock_irqrestore(&q->lock, flags);
 out:
@@ -889,6 +1378,9 @@ static int setscheduler(pid_t pid, int policy,
 {
 	struct sched_param lp;
 	struct task_struct *p;
+	struct runqueue *rq;
+	struct prio_array *array;
+	unsigned long flags;
 	int retval;
 
 	retval = -EINVAL;
@@ -903,13 +1395,14 @@ static int setscheduler(pid_t pid, int policy,
 	 * We play safe to avoid deadlocks.
 	 */
 	read_lock_irq(&tasklist_lock);
-	spin_lock(&runqueue_lock);
 
 	p = find_process_by_pid(pid);
 
 	retval = -ESRCH;
 	if (!p)
-		goto out_unlock;
+		goto out_unlock_tasklist;
+
+	rq = task_rq_lock(p, &flags);
 			
 	if (policy < 0)
 		policy = p->policy;
@@ -939,15 +1432,20 @@ static int setscheduler(pid_t pid, int policy,
 		goto out_unlock;
 
 	retval = 0;
+	array = p->array;
+	if (array)
+		dequeue_task(p, array);
 	p->policy = policy;
 	p->rt_priority = lp.sched_priority;
-	if (task_on_runqueue(p))
-		move_first_runqueue(p);
+	p->prio = effective_prio(p);
+	if (array)
+		enqueue_task(p, rt_task(p) ? rq->active : array);
 
 	current->need_resched = 1;
 
 out_unlock:
-	spin_unlock(&runqueue_lock);
+	task_rq_unlock(rq, &flags);
+out_unlock_tasklist:
 	read_unlock_irq(&tasklist_lock);
 
 out_nounlock:
@@ -1026,20 +1524,13 @@ asmlinkage long sys_sched_yield(void)
 	 * gets triggered quite often.
 	 */
 
-	int nr_pending = nr_running;
-
-#if CONFIG_SMP
-	int i;
+	/*
+	 * Only our own runqueue matters: other CPUs run their own
+	 * tasks and this process is on our runqueue as well.
+	 */
+	int nr_pending = this_rq()->nr_running - 1;
 
-	// Substract non-idle processes running on other CPUs.
-	for (i = 0; i < smp_num_cpus; i++)
-		if (aligned_data[i].schedule_data.curr != idle_task(i))
-			nr_pending--;
-#else
-	// on UP this process is on the runqueue as well
-	nr_pending--;
-#endif
-	if (nr_pending) {
+	if (nr_pending > 0) {
 		/*
 		 * This process can only be rescheduled by us,
 		 * so this is safe without any locking.
@@ -1211,8 +1702,7 @@ void daemonize(void)
 	 */
 	exit_mm(current);
 
-	current->session = 1;
-	current->pgrp = 1;
+	change_pids(current, 1, 1);
 
 	/* Become as one with the init task */
 
@@ -1227,16 +1717,15 @@ void daemonize(void)
 
 void __init init_idle(void)
 {
-	struct schedule_data * sched_data;
-	sched_data = &aligned_data[smp_processor_id()].schedule_data;
+	struct runqueue *rq = this_rq();
 
 	if (current != &init_task && task_on_runqueue(current)) {
 		printk("UGH! (%d:%d) was on the runqueue, removing.\n",
 			smp_processor_id(), current->pid);
 		del_from_runqueue(current);
 	}
-	sched_data->curr = current;
-	sched_data->last_schedule = get_cycles();
+	rq->curr = current;
+	rq->last_schedule = get_cycles();
 }
 
 extern void init_timervecs (void);
@@ -1253,11 +1742,33 @@ void __init sched_init(void)
 
 	init_task.processor = cpu;
 
+	for (nr = 0; nr < NR_CPUS; nr++) {
+		struct runqueue *rq = cpu_rq(nr);
+		int i, j;
+
+		spin_lock_init(&rq->lock);
+		rq->active = rq->arrays;
+		rq->expired = rq->arrays + 1;
+		for (i = 0; i < 2; i++) {
+			struct prio_array *array = rq->arrays + i;
+
+			for (j = 0; j < MAX_PRIO; j++)
+				INIT_LIST_HEAD(array->queue + j);
+			memset(array->bitmap, 0, sizeof(array->bitmap));
+			/* delimiter for bitsearch */
+			__set_bit(MAX_PRIO, array->bitmap);
+		}
+	}
+	cpu_rq(cpu)->curr = &init_task;
+
 	for(nr = 0; nr < PIDHASH_SZ; nr++)
 		pidhash[nr] = NULL;
 
 	//定时器初始化
 	init_timervecs();
+#ifdef CONFIG_HIGH_RES_TIMERS
+	init_hrtimers();
+#endif
 
 	//挂载后半段处理函数
 	init_bh(TIMER_BH, timer_bh);
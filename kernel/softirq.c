@@ -47,9 +47,37 @@ irq_cpustat_t irq_stat[NR_CPUS];
 
 static struct softirq_action softirq_vec[32] __cacheline_aligned;
 
+/*
+ * do_softirq() handles softirqs raised while it runs by going round
+ * again, but only MAX_SOFTIRQ_RESTART times. Whatever is still pending
+ * then is left to this CPU's ksoftirqd, which runs at the lowest
+ * priority, so a softirq flood (NET_RX at line rate) can't starve
+ * user space.
+ */
+#define MAX_SOFTIRQ_RESTART 10
+
+static struct task_struct * ksoftirqd_task[NR_CPUS];
+
+static struct softirq_stat {
+	unsigned long restarts;		/* passes beyond the first */
+	unsigned long deferred;		/* handed over to ksoftirqd */
+	unsigned long runs[32];
+	cycles_t cycles[32];
+} softirq_stat[NR_CPUS] __cacheline_aligned;
+
+static inline void wakeup_softirqd(int cpu)
+{
+	struct task_struct * tsk = ksoftirqd_task[cpu];
+
+	if (tsk && tsk->state != TASK_RUNNING)
+		wake_up_process(tsk);
+}
+
 asmlinkage void do_softirq()
 {
 	int cpu = smp_processor_id();
+	int max_restart = MAX_SOFTIRQ_RESTART;
+	struct softirq_stat *stat = softirq_stat + cpu;
 	__u32 active, mask;
 
 	if (in_interrupt())
@@ -76,23 +104,32 @@ restart:
 		local_irq_enable();
 
 		h = softirq_vec;
-		mask &= ~active;
 
 		/*
 		 * 通过active 掩码执行对应软中断
 		 */
 		do {
-			if (active & 1)
+			if (active & 1) {
+				int nr = h - softirq_vec;
+				cycles_t t0 = get_cycles();
+
 				h->action(h);
+				stat->runs[nr]++;
+				stat->cycles[nr] += get_cycles() - t0;
+			}
 			h++;
 			active >>= 1;
 		} while (active);
 
 		local_irq_disable();
 
-		active = softirq_active(cpu);
-		if ((active &= mask) != 0)
-			goto retry;
+		active = softirq_active(cpu) & mask;
+		if (active) {
+			if (--max_restart)
+				goto retry;
+			stat->deferred++;
+			wakeup_softirqd(cpu);
+		}
 	}
 
 	/* 递减local_bh_count() */
@@ -105,6 +142,7 @@ restart:
 	return;
 
 retry:
+	stat->restarts++;
 	goto restart;
 }
 
@@ -329,6 +367,91 @@ void __init softirq_init()
 	open_softirq(HI_SOFTIRQ, tasklet_hi_action, NULL);
 }
 
+/*
+ * /proc/softirqs: per CPU, the passes do_softirq() went round again
+ * and the times it gave up to ksoftirqd, then for each softirq that
+ * ran on it the number of runs and the cycles spent in them.
+ */
+int get_softirq_list(char *buf)
+{
+	char *p = buf;
+	int i, nr;
+
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct softirq_stat *stat = softirq_stat + cpu_logical_map(i);
+
+		p += sprintf(p, "cpu%d restarts %lu deferred %lu\n",
+			     i, stat->restarts, stat->deferred);
+		for (nr = 0; nr < 32; nr++) {
+			if (!stat->runs[nr])
+				continue;
+			p += sprintf(p, "%3d: %10lu %20Lu\n", nr,
+				     stat->runs[nr],
+				     (unsigned long long) stat->cycles[nr]);
+		}
+	}
+	return p - buf;
+}
+
+static int ksoftirqd(void * __bind_cpu)
+{
+	int bind_cpu = (int) (long) __bind_cpu;
+	int cpu = cpu_logical_map(bind_cpu);
+
+	daemonize();
+	current->nice = 19;
+	sigfillset(&current->blocked);
+
+	/* Migrate to the right CPU */
+	current->cpus_allowed = 1UL << cpu;
+	while (smp_processor_id() != cpu)
+		schedule();
+
+	sprintf(current->comm, "ksoftirqd_CPU%d", bind_cpu);
+
+	__set_current_state(TASK_INTERRUPTIBLE);
+	mb();
+
+	ksoftirqd_task[cpu] = current;
+
+	for (;;) {
+		if (!(softirq_active(cpu) & softirq_mask(cpu)))
+			schedule();
+
+		__set_current_state(TASK_RUNNING);
+
+		while (softirq_active(cpu) & softirq_mask(cpu)) {
+			do_softirq();
+			if (current->need_resched)
+				schedule();
+		}
+
+		__set_current_state(TASK_INTERRUPTIBLE);
+	}
+	return 0;	/* not reached */
+}
+
+static __init int spawn_ksoftirqd(void)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < smp_num_cpus; cpu++) {
+		if (kernel_thread(ksoftirqd, (void *) (long) cpu,
+				  CLONE_FS | CLONE_FILES | CLONE_SIGNAL) < 0)
+			printk("spawn_ksoftirqd() failed for cpu %d\n", cpu);
+		else {
+			while (!ksoftirqd_task[cpu_logical_map(cpu)]) {
+				current->policy |= SCHED_YIELD;
+				schedule();
+			}
+		}
+	}
+
+	return 0;
+}
+
+__initcall(spawn_ksoftirqd);
+
 void __run_task_queue(task_queue *list)
 {
 	struct list_head head, *next;
@@ -806,7 +806,7 @@ asmlinkage long sys_setpgid(pid_t pid, pid_t pgid)
 	}
 
 ok_pgid:
-	p->pgrp = pgid;
+	change_pids(p, p->session, pgid);
 	err = 0;
 out:
 	/* All paths lead to here, thus we are safe. -DaveM */
@@ -870,7 +870,7 @@ asmlinkage long sys_setsid(void)
 	}
 
 	current->leader = 1;
-	current->session = current->pgrp = current->pid;
+	change_pids(current, current->pid, current->pid);
 	current->tty = NULL;
 	current->tty_old_pgrp = 0;
 	err = current->pgrp;
@@ -30,6 +30,8 @@
 #include <linux/init.h>
 #include <linux/sysrq.h>
 #include <linux/highuid.h>
+#include <linux/hugetlb.h>
+#include <linux/compswap.h>
 
 #include <asm/uaccess.h>
 
@@ -257,6 +259,14 @@ static ctl_table vm_table[] = {
 	 &pgt_cache_water, 2*sizeof(int), 0644, NULL, &proc_dointvec},
 	{VM_PAGE_CLUSTER, "page-cluster", 
 	 &page_cluster, sizeof(int), 0644, NULL, &proc_dointvec},
+#ifdef CONFIG_HUGETLB_PAGE
+	{VM_HUGETLB_PAGES, "nr_hugepages",
+	 &nr_huge_pages, sizeof(int), 0644, NULL, &hugetlb_sysctl_handler},
+#endif
+#ifdef CONFIG_COMPSWAP
+	{VM_COMPSWAP_PAGES, "compswap_pages",
+	 &sysctl_compswap_pages, sizeof(int), 0644, NULL, &proc_dointvec},
+#endif
 	{0}
 };
 
@@ -91,64 +91,104 @@ struct timer_vec_root {
 	struct list_head vec[TVR_SIZE];
 };
 
-static struct timer_vec tv5;
-static struct timer_vec tv4;
-static struct timer_vec tv3;
-static struct timer_vec tv2;
-static struct timer_vec_root tv1;
-
-static struct timer_vec * const tvecs[] = {
-	(struct timer_vec *)&tv1, &tv2, &tv3, &tv4, &tv5
-};
+#define NOOF_TVECS 5
+
+/*
+ * Every CPU has its own timer wheel. A timer lives on the base of the
+ * CPU that last armed it and is run from that CPU's TIMER_SOFTIRQ, so
+ * add_timer()/mod_timer()/del_timer() only ever take one base lock and
+ * the wheel stays in the local cache.
+ *
+ * timer->base is the base the timer was last queued on, it stays set
+ * while the handler runs. It is only changed with the lock of the base
+ * it points to held. A timer whose handler is running is re-armed on
+ * the base it runs on, so it never runs on two CPUs at once.
+ *
+ * Handlers of different CPUs run in parallel and, unlike TIMER_BH,
+ * are not serialized against the BHs. cli() still excludes them.
+ */
+struct timer_base {
+	spinlock_t lock;
+	unsigned long timer_jiffies;
+	struct timer_list * volatile running_timer;
+	int blocked;			/* see block_timers() */
+	struct timer_vec * tvecs[NOOF_TVECS];
+
+	/* statistics, see get_timer_stats() */
+	unsigned long ticks;		/* wheel ticks processed */
+	unsigned long expired;		/* handlers run */
+	unsigned long cascaded;		/* timers moved down a level */
+	unsigned long cascade_max;	/* most timers moved in one tick */
 
-#define NOOF_TVECS (sizeof(tvecs) / sizeof(tvecs[0]))
+	struct timer_vec_root tv1;
+	struct timer_vec tv2;
+	struct timer_vec tv3;
+	struct timer_vec tv4;
+	struct timer_vec tv5;
+} ____cacheline_aligned;
+
+static struct timer_base timer_bases[NR_CPUS];
+
+#define this_timer_base()	(timer_bases + smp_processor_id())
+
+static void run_timer_softirq(struct softirq_action *h);
 
 //定时器初始化
 void init_timervecs (void)
 {
-	int i;
-
-	for (i = 0; i < TVN_SIZE; i++) {
-		INIT_LIST_HEAD(tv5.vec + i);
-		INIT_LIST_HEAD(tv4.vec + i);
-		INIT_LIST_HEAD(tv3.vec + i);
-		INIT_LIST_HEAD(tv2.vec + i);
+	int cpu, i;
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		struct timer_base *base = timer_bases + cpu;
+
+		spin_lock_init(&base->lock);
+		base->tvecs[0] = (struct timer_vec *)&base->tv1;
+		base->tvecs[1] = &base->tv2;
+		base->tvecs[2] = &base->tv3;
+		base->tvecs[3] = &base->tv4;
+		base->tvecs[4] = &base->tv5;
+		for (i = 0; i < TVN_SIZE; i++) {
+			INIT_LIST_HEAD(base->tv5.vec + i);
+			INIT_LIST_HEAD(base->tv4.vec + i);
+			INIT_LIST_HEAD(base->tv3.vec + i);
+			INIT_LIST_HEAD(base->tv2.vec + i);
+		}
+		for (i = 0; i < TVR_SIZE; i++)
+			INIT_LIST_HEAD(base->tv1.vec + i);
 	}
-	for (i = 0; i < TVR_SIZE; i++)
-		INIT_LIST_HEAD(tv1.vec + i);
+	open_softirq(TIMER_SOFTIRQ, run_timer_softirq, NULL);
 }
 
-static unsigned long timer_jiffies;
-
-static inline void internal_add_timer(struct timer_list *timer)
+static inline void internal_add_timer(struct timer_base *base, struct timer_list *timer)
 {
 	/*
-	 * must be cli-ed when calling this
+	 * must be called with base->lock held
 	 */
 	unsigned long expires = timer->expires;
-	unsigned long idx = expires - timer_jiffies;
+	unsigned long idx = expires - base->timer_jiffies;
 	struct list_head * vec;
 
+	timer->base = base;
 	if (idx < TVR_SIZE) {
 		int i = expires & TVR_MASK;
-		vec = tv1.vec + i;
+		vec = base->tv1.vec + i;
 	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
 		int i = (expires >> TVR_BITS) & TVN_MASK;
-		vec = tv2.vec + i;
+		vec = base->tv2.vec + i;
 	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
 		int i = (expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
-		vec =  tv3.vec + i;
+		vec = base->tv3.vec + i;
 	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
 		int i = (expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
-		vec = tv4.vec + i;
+		vec = base->tv4.vec + i;
 	} else if ((signed long) idx < 0) {
 		/* can happen if you add a timer with expires == jiffies,
 		 * or you set a timer to go off in the past
 		 */
-		vec = tv1.vec + tv1.index;
+		vec = base->tv1.vec + base->tv1.index;
 	} else if (idx <= 0xffffffffUL) {
 		int i = (expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
-		vec = tv5.vec + i;
+		vec = base->tv5.vec + i;
 	} else {
 		/* Can only get here on architectures with 64-bit jiffies */
 		INIT_LIST_HEAD(&timer->list);
@@ -160,73 +200,177 @@ static inline void internal_add_timer(struct timer_list *timer)
 	list_add(&timer->list, vec->prev);
 }
 
-/* Initialize both explicitly - let's try to have them in the same cache line */
-spinlock_t timerlist_lock = SPIN_LOCK_UNLOCKED;
-
 #ifdef CONFIG_SMP
-volatile struct timer_list * volatile running_timer;
-#define timer_enter(t) do { running_timer = t; mb(); } while (0)
-#define timer_exit() do { running_timer = NULL; } while (0)
-#define timer_is_running(t) (running_timer == t)
-#define timer_synchronize(t) while (timer_is_running(t)) barrier()
+#define timer_enter(b, t) do { (b)->running_timer = t; mb(); } while (0)
+#define timer_exit(b) do { (b)->running_timer = NULL; } while (0)
 #else
-#define timer_enter(t)		do { } while (0)
-#define timer_exit()		do { } while (0)
+#define timer_enter(b, t)	do { } while (0)
+#define timer_exit(b)		do { } while (0)
 #endif
 
-void add_timer(struct timer_list *timer)
+/*
+ * Lock the base a timer was last queued on. The timer may be moved to
+ * another base by mod_timer() while we spin, so recheck once we
+ * hold the lock. Returns NULL if the timer was never queued.
+ */
+static struct timer_base *lock_timer_base(struct timer_list *timer,
+					  unsigned long *flags)
 {
-	unsigned long flags;
+	struct timer_base *base;
 
-	spin_lock_irqsave(&timerlist_lock, flags);
-	if (timer_pending(timer))
-		goto bug;
-	internal_add_timer(timer);
-	spin_unlock_irqrestore(&timerlist_lock, flags);
-	return;
-bug:
-	spin_unlock_irqrestore(&timerlist_lock, flags);
-	printk("bug: kernel timer added twice at %p.\n",
-			__builtin_return_address(0));
+	for (;;) {
+		base = timer->base;
+		if (!base)
+			return NULL;
+		spin_lock_irqsave(&base->lock, *flags);
+		if (base == timer->base)
+			return base;
+		spin_unlock_irqrestore(&base->lock, *flags);
+	}
 }
 
-static inline int detach_timer (struct timer_list *timer)
+static inline void detach_timer(struct timer_list *timer)
 {
-	if (!timer_pending(timer))
-		return 0;
 	list_del(&timer->list);
-	return 1;
+	timer->list.next = timer->list.prev = NULL;
 }
 
-int mod_timer(struct timer_list *timer, unsigned long expires)
+/*
+ * Queue @timer to expire at @expires on this CPU's base, or on the
+ * base its handler is running on. Returns whether it was pending; an
+ * add_timer() of a pending timer leaves it alone.
+ */
+static int __mod_timer(struct timer_list *timer, unsigned long expires,
+		       int add)
 {
-	int ret;
+	struct timer_base *old_base, *new_base;
 	unsigned long flags;
+	int ret = 0;
+
+	local_irq_save(flags);
+	new_base = this_timer_base();
+repeat:
+	old_base = timer->base;
+	/*
+	 * Moving a timer between bases needs both locks; take them
+	 * in address order so two CPUs can't deadlock on each other.
+	 */
+	if (old_base && old_base != new_base) {
+		if (old_base < new_base) {
+			spin_lock(&old_base->lock);
+			spin_lock(&new_base->lock);
+		} else {
+			spin_lock(&new_base->lock);
+			spin_lock(&old_base->lock);
+		}
+		if (timer->base != old_base) {
+			spin_unlock(&old_base->lock);
+			spin_unlock(&new_base->lock);
+			goto repeat;
+		}
+	} else {
+		spin_lock(&new_base->lock);
+		if (timer->base != old_base) {
+			spin_unlock(&new_base->lock);
+			goto repeat;
+		}
+	}
 
-	spin_lock_irqsave(&timerlist_lock, flags);
+	if (timer_pending(timer)) {
+		ret = 1;
+		if (add)
+			goto out;
+		list_del(&timer->list);
+	}
+	if (old_base && old_base != new_base &&
+	    old_base->running_timer == timer) {
+		spin_unlock(&new_base->lock);
+		new_base = old_base;
+	}
 	timer->expires = expires;
-	ret = detach_timer(timer);
-	internal_add_timer(timer);
-	spin_unlock_irqrestore(&timerlist_lock, flags);
+	internal_add_timer(new_base, timer);
+out:
+	if (old_base && old_base != new_base)
+		spin_unlock(&old_base->lock);
+	spin_unlock_irqrestore(&new_base->lock, flags);
 	return ret;
 }
 
+void add_timer(struct timer_list *timer)
+{
+	if (__mod_timer(timer, timer->expires, 1))
+		printk("bug: kernel timer added twice at %p.\n",
+				__builtin_return_address(0));
+}
+
+int mod_timer(struct timer_list *timer, unsigned long expires)
+{
+	return __mod_timer(timer, expires, 0);
+}
+
 int del_timer(struct timer_list * timer)
 {
-	int ret;
+	struct timer_base *base;
 	unsigned long flags;
+	int ret = 0;
 
-	spin_lock_irqsave(&timerlist_lock, flags);
-	ret = detach_timer(timer);
-	timer->list.next = timer->list.prev = NULL;
-	spin_unlock_irqrestore(&timerlist_lock, flags);
+	base = lock_timer_base(timer, &flags);
+	if (!base)
+		return 0;
+	if (timer_pending(timer)) {
+		detach_timer(timer);
+		ret = 1;
+	}
+	spin_unlock_irqrestore(&base->lock, flags);
 	return ret;
 }
 
+/*
+ * Keep timer handlers from running on any CPU until unblock_timers(),
+ * and wait for those running now. For code that still expects to be
+ * serialized against timers the way TIMER_BH was, see net/core/dev.c.
+ * Must not be called from a timer handler.
+ */
+void block_timers(void)
+{
+	int i;
+
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct timer_base *base = timer_bases + cpu_logical_map(i);
+
+		spin_lock_irq(&base->lock);
+		base->blocked++;
+		spin_unlock_irq(&base->lock);
+		while (base->running_timer)
+			barrier();
+	}
+}
+
+void unblock_timers(void)
+{
+	int i;
+
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct timer_base *base = timer_bases + cpu_logical_map(i);
+
+		spin_lock_irq(&base->lock);
+		base->blocked--;
+		spin_unlock_irq(&base->lock);
+	}
+}
+
 #ifdef CONFIG_SMP
+/* Wait for the timer handlers running on other CPUs to finish */
 void sync_timers(void)
 {
-	spin_unlock_wait(&global_bh_lock);
+	int i;
+
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct timer_base *base = timer_bases + cpu_logical_map(i);
+
+		while (base->running_timer)
+			barrier();
+	}
 }
 
 /*
@@ -242,30 +386,44 @@ int del_timer_sync(struct timer_list * timer)
 	int ret = 0;
 
 	for (;;) {
-		unsigned long flags;
-		int running;
+		struct timer_base *base = NULL;
+		int i;
 
-		spin_lock_irqsave(&timerlist_lock, flags);
-		ret += detach_timer(timer);
-		timer->list.next = timer->list.prev = 0;
-		running = timer_is_running(timer);
-		spin_unlock_irqrestore(&timerlist_lock, flags);
+		ret += del_timer(timer);
 
-		if (!running)
+		for (i = 0; i < smp_num_cpus; i++) {
+			base = timer_bases + cpu_logical_map(i);
+			if (base->running_timer == timer)
+				break;
+		}
+		if (i == smp_num_cpus)
 			break;
 
-		timer_synchronize(timer);
+		while (base->running_timer == timer)
+			barrier();
 	}
 
 	return ret;
 }
 #endif
 
+/*
+ * Bring all timer base locks back to a sane state so that an oops
+ * can still get its message out.
+ */
+void timer_bust_locks(void)
+{
+	int cpu;
 
-static inline void cascade_timers(struct timer_vec *tv)
+	for (cpu = 0; cpu < NR_CPUS; cpu++)
+		spin_lock_init(&timer_bases[cpu].lock);
+}
+
+static inline int cascade_timers(struct timer_base *base, struct timer_vec *tv)
 {
 	/* cascade all the timers from tv up one level */
 	struct list_head *head, *curr, *next;
+	int count = 0;
 
 	head = tv->vec + tv->index;
 	curr = head->next;
@@ -279,49 +437,102 @@ static inline void cascade_timers(struct timer_vec *tv)
 		tmp = list_entry(curr, struct timer_list, list);
 		next = curr->next;
 		list_del(curr); // not needed
-		internal_add_timer(tmp);
+		internal_add_timer(base, tmp);
 		curr = next;
+		count++;
 	}
 	INIT_LIST_HEAD(head);
 	tv->index = (tv->index + 1) & TVN_MASK;
+	return count;
 }
 
-static inline void run_timer_list(void)
+static inline void run_timer_list(struct timer_base *base)
 {
-	spin_lock_irq(&timerlist_lock);
-	while ((long)(jiffies - timer_jiffies) >= 0) {
+	int cpu = smp_processor_id();
+
+	spin_lock_irq(&base->lock);
+	while ((long)(jiffies - base->timer_jiffies) >= 0) {
 		struct list_head *head, *curr;
-		if (!tv1.index) {
+		if (!base->tv1.index) {
+			unsigned long cascaded = 0;
 			int n = 1;
 			do {
-				cascade_timers(tvecs[n]);
-			} while (tvecs[n]->index == 1 && ++n < NOOF_TVECS);
+				cascaded += cascade_timers(base, base->tvecs[n]);
+			} while (base->tvecs[n]->index == 1 && ++n < NOOF_TVECS);
+			base->cascaded += cascaded;
+			if (cascaded > base->cascade_max)
+				base->cascade_max = cascaded;
 		}
 repeat:
-		head = tv1.vec + tv1.index;
+		head = base->tv1.vec + base->tv1.index;
 		curr = head->next;
 		if (curr != head) {
 			struct timer_list *timer;
 			void (*fn)(unsigned long);
 			unsigned long data;
 
+			/*
+			 * Handlers only exclude cli() and block_timers(). If
+			 * either is in the way, leave the timer queued (so
+			 * del_timer() still finds it) and retry on the next
+			 * softirq pass.
+			 */
+			if (base->blocked)
+				goto resched;
+			if (!hardirq_trylock(cpu))
+				goto resched;
+
 			timer = list_entry(curr, struct timer_list, list);
  			fn = timer->function;
  			data= timer->data;
 
 			detach_timer(timer);
-			timer->list.next = timer->list.prev = NULL;
-			timer_enter(timer);
-			spin_unlock_irq(&timerlist_lock);
+			timer_enter(base, timer);
+			spin_unlock_irq(&base->lock);
 			fn(data);
-			spin_lock_irq(&timerlist_lock);
-			timer_exit();
+			spin_lock_irq(&base->lock);
+			timer_exit(base);
+			base->expired++;
+
+			hardirq_endlock(cpu);
 			goto repeat;
 		}
-		++timer_jiffies; 
-		tv1.index = (tv1.index + 1) & TVR_MASK;
+		++base->timer_jiffies; 
+		base->tv1.index = (base->tv1.index + 1) & TVR_MASK;
+		base->ticks++;
+	}
+	spin_unlock_irq(&base->lock);
+	return;
+
+resched:
+	__cpu_raise_softirq(cpu, TIMER_SOFTIRQ);
+	spin_unlock_irq(&base->lock);
+}
+
+static void run_timer_softirq(struct softirq_action *h)
+{
+	run_timer_list(this_timer_base());
+}
+
+/*
+ * /proc/timer_stats: per-CPU wheel ticks, handlers run, timers
+ * cascaded down a level and the worst cascade seen in one tick.
+ */
+int get_timer_stats(char *buf)
+{
+	char *p = buf;
+	int i;
+
+	p += sprintf(p, "     %10s %10s %10s %10s\n",
+		     "ticks", "expired", "cascaded", "max/tick");
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct timer_base *base = timer_bases + cpu_logical_map(i);
+
+		p += sprintf(p, "cpu%-2d%10lu %10lu %10lu %10lu\n", i,
+			     base->ticks, base->expired,
+			     base->cascaded, base->cascade_max);
 	}
-	spin_unlock_irq(&timerlist_lock);
+	return p - buf;
 }
 
 spinlock_t tqueue_lock = SPIN_LOCK_UNLOCKED;
@@ -583,18 +794,16 @@ void update_process_times(int user_tick)
 	int cpu = smp_processor_id(), system = user_tick ^ 1;
 
 	update_one_process(p, user_tick, system, cpu);
+	scheduler_tick();
+	raise_softirq(TIMER_SOFTIRQ);
 	if (p->pid) {
-		if (--p->counter <= 0) {
-			p->counter = 0;
-			p->need_resched = 1;
-		}
 		if (p->nice > 0)
-			kstat.per_cpu_nice[cpu] += user_tick;
+			kstat_cpu[cpu].nice += user_tick;
 		else
-			kstat.per_cpu_user[cpu] += user_tick;
-		kstat.per_cpu_system[cpu] += system;
+			kstat_cpu[cpu].user += user_tick;
+		kstat_cpu[cpu].system += system;
 	} else if (local_bh_count(cpu) || local_irq_count(cpu) > 1)
-		kstat.per_cpu_system[cpu] += system;
+		kstat_cpu[cpu].system += system;
 }
 
 /*
@@ -669,7 +878,6 @@ static inline void update_times(void)
 void timer_bh(void)
 {
 	update_times();
-	run_timer_list();
 }
 
 void do_timer(struct pt_regs *regs)
@@ -806,6 +1014,10 @@ asmlinkage long sys_nanosleep(struct timespec *rqtp, struct timespec *rmtp)
 	if (t.tv_nsec >= 1000000000L || t.tv_nsec < 0 || t.tv_sec < 0)
 		return -EINVAL;
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+	if (hrtimer_active)
+		return hrtimer_nanosleep(&t, rmtp);
+#endif
 
 	if (t.tv_sec == 0 && t.tv_nsec <= 2000000L &&
 	    current->policy != SCHED_OTHER)
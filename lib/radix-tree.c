@@ -0,0 +1,578 @@
+/*
+ *  linux/lib/radix-tree.c
+ *
+ *  Radix tree, an array of pointers indexed by an unsigned long that
+ *  only has memory for the parts of the index space in use.
+ *
+ *  Every node has RADIX_TREE_MAP_SIZE slots and covers
+ *  RADIX_TREE_MAP_SHIFT bits of the index, the tree grows in height
+ *  as larger indices are inserted. Lookups take no lock of their own,
+ *  the user serialises them against inserts and deletes.
+ *
+ *  Every item can have RADIX_TREE_MAX_TAGS tags. A node has a bit per
+ *  slot and tag, set if the item in the slot - or some item below it -
+ *  has the tag, so the tagged items can be found without looking at
+ *  the subtrees that have none.
+ */
+
+#include <linux/config.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/cache.h>
+#include <linux/radix-tree.h>
+
+#include <asm/types.h>
+#include <asm/bitops.h>
+
+#define RADIX_TREE_MAP_SHIFT	6
+#define RADIX_TREE_MAP_SIZE	(1UL << RADIX_TREE_MAP_SHIFT)
+#define RADIX_TREE_MAP_MASK	(RADIX_TREE_MAP_SIZE-1)
+
+/* the deepest tree needed for the whole index space */
+#define RADIX_TREE_MAX_PATH \
+	((BITS_PER_LONG + RADIX_TREE_MAP_SHIFT - 1) / RADIX_TREE_MAP_SHIFT)
+
+#define RADIX_TREE_TAG_LONGS \
+	((RADIX_TREE_MAP_SIZE + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+struct radix_tree_node {
+	unsigned int	count;		/* slots in use */
+	void		*slots[RADIX_TREE_MAP_SIZE];
+	unsigned long	tags[RADIX_TREE_MAX_TAGS][RADIX_TREE_TAG_LONGS];
+};
+
+struct radix_tree_path {
+	struct radix_tree_node *node, **slot;
+	int offset;
+};
+
+static unsigned long height_to_maxindex[RADIX_TREE_MAX_PATH + 1];
+
+static kmem_cache_t *radix_tree_node_cachep;
+
+/*
+ * Per-CPU pool of nodes, enough for one insert at any depth. It is
+ * filled by radix_tree_preload(), which may sleep, so that the insert
+ * can be done under a spinlock without failing.
+ */
+struct radix_tree_preload {
+	int nr;
+	struct radix_tree_node *nodes[RADIX_TREE_MAX_PATH];
+} ____cacheline_aligned;
+
+static struct radix_tree_preload radix_tree_preloads[NR_CPUS];
+
+/*
+ * Nodes are zeroed by the constructor and handed back to the slab
+ * cache empty, so they never need clearing on allocation.
+ */
+static struct radix_tree_node *radix_tree_node_alloc(void)
+{
+	struct radix_tree_preload *rtp = radix_tree_preloads + smp_processor_id();
+
+	if (rtp->nr)
+		return rtp->nodes[--rtp->nr];
+	return kmem_cache_alloc(radix_tree_node_cachep, SLAB_ATOMIC);
+}
+
+static inline void radix_tree_node_free(struct radix_tree_node *node)
+{
+	kmem_cache_free(radix_tree_node_cachep, node);
+}
+
+/**
+ * radix_tree_preload - make sure the next insert can't run out of memory
+ * @gfp_mask: how to allocate the nodes
+ *
+ * Fills the node pool of this CPU. Returns 0 or -ENOMEM. The pool is
+ * only good for inserts on this CPU, so the caller must not sleep
+ * between this and the insert.
+ */
+int radix_tree_preload(int gfp_mask)
+{
+	struct radix_tree_preload *rtp = radix_tree_preloads + smp_processor_id();
+	struct radix_tree_node *node;
+
+	while (rtp->nr < RADIX_TREE_MAX_PATH) {
+		node = kmem_cache_alloc(radix_tree_node_cachep, gfp_mask);
+		if (!node)
+			return -ENOMEM;
+		/* we may have slept and changed CPUs */
+		rtp = radix_tree_preloads + smp_processor_id();
+		if (rtp->nr < RADIX_TREE_MAX_PATH)
+			rtp->nodes[rtp->nr++] = node;
+		else
+			radix_tree_node_free(node);
+	}
+	return 0;
+}
+
+static inline unsigned long radix_tree_maxindex(unsigned int height)
+{
+	return height_to_maxindex[height];
+}
+
+static inline int tag_get(struct radix_tree_node *node, int tag, int offset)
+{
+	return test_bit(offset, node->tags[tag]);
+}
+
+static inline void tag_set(struct radix_tree_node *node, int tag, int offset)
+{
+	set_bit(offset, node->tags[tag]);
+}
+
+static inline void tag_clear(struct radix_tree_node *node, int tag, int offset)
+{
+	clear_bit(offset, node->tags[tag]);
+}
+
+static inline int any_tag_set(struct radix_tree_node *node, int tag)
+{
+	int i;
+
+	for (i = 0; i < RADIX_TREE_TAG_LONGS; i++)
+		if (node->tags[tag][i])
+			return 1;
+	return 0;
+}
+
+/*
+ * Grow the tree until @index fits, by putting new nodes on top.
+ */
+static int radix_tree_extend(struct radix_tree_root *root, unsigned long index)
+{
+	struct radix_tree_node *node;
+	unsigned int height;
+
+	height = root->height + 1;
+	while (index > radix_tree_maxindex(height))
+		height++;
+
+	if (!root->rnode) {
+		root->height = height;
+		return 0;
+	}
+	do {
+		int tag;
+
+		node = radix_tree_node_alloc();
+		if (!node)
+			return -ENOMEM;
+		node->slots[0] = root->rnode;
+		node->count = 1;
+		/* the old root becomes slot 0, and keeps its tags */
+		for (tag = 0; tag < RADIX_TREE_MAX_TAGS; tag++)
+			if (any_tag_set(root->rnode, tag))
+				tag_set(node, tag, 0);
+		root->rnode = node;
+		root->height++;
+	} while (height > root->height);
+	return 0;
+}
+
+/**
+ * radix_tree_insert - insert an item
+ * @root: the tree
+ * @index: where to put it
+ * @item: the item, not NULL
+ *
+ * Returns 0, -EEXIST if the slot is taken, or -ENOMEM.
+ */
+int radix_tree_insert(struct radix_tree_root *root, unsigned long index, void *item)
+{
+	struct radix_tree_node *node = NULL, *tmp, **slot;
+	unsigned int height, shift;
+	int error;
+
+	if (!root->height || index > radix_tree_maxindex(root->height)) {
+		error = radix_tree_extend(root, index);
+		if (error)
+			return error;
+	}
+
+	slot = &root->rnode;
+	height = root->height;
+	shift = (height-1) * RADIX_TREE_MAP_SHIFT;
+
+	while (height > 0) {
+		if (!*slot) {
+			tmp = radix_tree_node_alloc();
+			if (!tmp) {
+				/* don't leave a height over an empty tree */
+				if (!root->rnode)
+					root->height = 0;
+				return -ENOMEM;
+			}
+			*slot = tmp;
+			if (node)
+				node->count++;
+		}
+		node = *slot;
+		slot = (struct radix_tree_node **)
+			(node->slots + ((index >> shift) & RADIX_TREE_MAP_MASK));
+		shift -= RADIX_TREE_MAP_SHIFT;
+		height--;
+	}
+
+	if (*slot)
+		return -EEXIST;
+	node->count++;
+	*slot = item;
+	return 0;
+}
+
+/**
+ * radix_tree_lookup_slot - find the slot of an item
+ * @root: the tree
+ * @index: the index
+ *
+ * Returns the slot, so that the item can be replaced in place, or
+ * NULL if there is no item at @index.
+ */
+void **radix_tree_lookup_slot(struct radix_tree_root *root, unsigned long index)
+{
+	struct radix_tree_node **slot;
+	unsigned int height, shift;
+
+	height = root->height;
+	if (!height || index > radix_tree_maxindex(height))
+		return NULL;
+
+	slot = &root->rnode;
+	shift = (height-1) * RADIX_TREE_MAP_SHIFT;
+
+	while (height > 0) {
+		if (!*slot)
+			return NULL;
+		slot = (struct radix_tree_node **)
+			((*slot)->slots + ((index >> shift) & RADIX_TREE_MAP_MASK));
+		shift -= RADIX_TREE_MAP_SHIFT;
+		height--;
+	}
+	return *slot ? (void **) slot : NULL;
+}
+
+/**
+ * radix_tree_lookup - find an item
+ * @root: the tree
+ * @index: the index
+ *
+ * Returns the item, or NULL.
+ */
+void *radix_tree_lookup(struct radix_tree_root *root, unsigned long index)
+{
+	void **slot = radix_tree_lookup_slot(root, index);
+
+	return slot ? *slot : NULL;
+}
+
+/*
+ * Walk down to the slot of @index, recording the nodes on the way in
+ * @path. Returns the path entry of the slot, or NULL if there is no
+ * item at @index.
+ */
+static struct radix_tree_path *radix_tree_walk(struct radix_tree_root *root,
+	unsigned long index, struct radix_tree_path *pathp)
+{
+	unsigned int height, shift;
+
+	height = root->height;
+	if (!height || index > radix_tree_maxindex(height))
+		return NULL;
+
+	shift = (height-1) * RADIX_TREE_MAP_SHIFT;
+	pathp->node = NULL;
+	pathp->slot = &root->rnode;
+
+	while (height > 0) {
+		int offset;
+
+		if (!*pathp->slot)
+			return NULL;
+		offset = (index >> shift) & RADIX_TREE_MAP_MASK;
+		pathp[1].node = *pathp->slot;
+		pathp[1].slot = (struct radix_tree_node **)
+			(pathp[1].node->slots + offset);
+		pathp[1].offset = offset;
+		pathp++;
+		shift -= RADIX_TREE_MAP_SHIFT;
+		height--;
+	}
+	return *pathp->slot ? pathp : NULL;
+}
+
+/**
+ * radix_tree_tag_set - tag an item
+ * @root: the tree
+ * @index: the index of the item
+ * @tag: the tag
+ *
+ * Returns the item, or NULL if there is none at @index.
+ */
+void *radix_tree_tag_set(struct radix_tree_root *root, unsigned long index, int tag)
+{
+	struct radix_tree_path path[RADIX_TREE_MAX_PATH + 1], *pathp;
+	void *item;
+
+	pathp = radix_tree_walk(root, index, path);
+	if (!pathp)
+		return NULL;
+
+	item = *pathp->slot;
+	for ( ; pathp->node; pathp--) {
+		if (tag_get(pathp->node, tag, pathp->offset))
+			break;
+		tag_set(pathp->node, tag, pathp->offset);
+	}
+	return item;
+}
+
+/*
+ * Clear the tag of the slot at @pathp, and of the nodes above it that
+ * have no other tagged slot left.
+ */
+static void radix_tree_clear_path_tag(struct radix_tree_path *pathp, int tag)
+{
+	for ( ; pathp->node; pathp--) {
+		if (!tag_get(pathp->node, tag, pathp->offset))
+			break;
+		tag_clear(pathp->node, tag, pathp->offset);
+		if (any_tag_set(pathp->node, tag))
+			break;
+	}
+}
+
+/**
+ * radix_tree_tag_clear - untag an item
+ * @root: the tree
+ * @index: the index of the item
+ * @tag: the tag
+ *
+ * Returns the item, or NULL if there is none at @index.
+ */
+void *radix_tree_tag_clear(struct radix_tree_root *root, unsigned long index, int tag)
+{
+	struct radix_tree_path path[RADIX_TREE_MAX_PATH + 1], *pathp;
+
+	pathp = radix_tree_walk(root, index, path);
+	if (!pathp)
+		return NULL;
+
+	radix_tree_clear_path_tag(pathp, tag);
+	return *pathp->slot;
+}
+
+/**
+ * radix_tree_tag_get - test the tag of an item
+ * @root: the tree
+ * @index: the index of the item
+ * @tag: the tag
+ *
+ * Returns 1 if there is an item at @index and it has the tag.
+ */
+int radix_tree_tag_get(struct radix_tree_root *root, unsigned long index, int tag)
+{
+	struct radix_tree_path path[RADIX_TREE_MAX_PATH + 1], *pathp;
+
+	pathp = radix_tree_walk(root, index, path);
+	if (!pathp)
+		return 0;
+	return tag_get(pathp->node, tag, pathp->offset);
+}
+
+/**
+ * radix_tree_tagged - test whether any item in the tree has a tag
+ * @root: the tree
+ * @tag: the tag
+ */
+int radix_tree_tagged(struct radix_tree_root *root, int tag)
+{
+	return root->rnode && any_tag_set(root->rnode, tag);
+}
+
+/*
+ * A slot worth looking at: one with an item, or with the tag if @tag
+ * isn't negative.
+ */
+static inline int slot_wanted(struct radix_tree_node *node, int tag, int offset)
+{
+	if (tag < 0)
+		return node->slots[offset] != NULL;
+	return tag_get(node, tag, offset);
+}
+
+/*
+ * Collect up to @max_items items from @index on, in the leaf node
+ * that holds the first one. *next_index is where the next search
+ * has to start, 0 if we wrapped around the top of the index space.
+ */
+static unsigned int __lookup(struct radix_tree_root *root, void **results,
+	unsigned long index, unsigned int max_items, unsigned long *next_index,
+	int tag)
+{
+	unsigned int nr_found = 0;
+	unsigned int height = root->height;
+	unsigned int shift = (height-1) * RADIX_TREE_MAP_SHIFT;
+	struct radix_tree_node *node = root->rnode;
+
+	if (!node) {
+		index = 0;
+		goto out;
+	}
+	while (height > 0) {
+		unsigned long i = (index >> shift) & RADIX_TREE_MAP_MASK;
+
+		/* skip the empty subtrees */
+		for ( ; i < RADIX_TREE_MAP_SIZE; i++) {
+			if (slot_wanted(node, tag, i))
+				break;
+			index &= ~((1UL << shift) - 1);
+			index += 1UL << shift;
+			if (!index)
+				goto out;
+		}
+		if (i == RADIX_TREE_MAP_SIZE)
+			goto out;
+
+		height--;
+		if (!height) {
+			/* a leaf node, grab what we can */
+			for ( ; i < RADIX_TREE_MAP_SIZE; i++) {
+				index++;
+				if (!slot_wanted(node, tag, i))
+					continue;
+				results[nr_found++] = node->slots[i];
+				if (nr_found == max_items)
+					break;
+			}
+			break;
+		}
+		shift -= RADIX_TREE_MAP_SHIFT;
+		node = node->slots[i];
+	}
+out:
+	*next_index = index;
+	return nr_found;
+}
+
+static unsigned int __gang_lookup(struct radix_tree_root *root, void **results,
+	unsigned long first_index, unsigned int max_items, int tag)
+{
+	unsigned long max_index = radix_tree_maxindex(root->height);
+	unsigned long cur_index = first_index;
+	unsigned int ret = 0;
+
+	if (!root->height || !root->rnode)
+		return 0;
+
+	while (ret < max_items && cur_index <= max_index) {
+		unsigned long next_index;
+
+		ret += __lookup(root, results + ret, cur_index,
+				max_items - ret, &next_index, tag);
+		if (!next_index)
+			break;
+		cur_index = next_index;
+	}
+	return ret;
+}
+
+/**
+ * radix_tree_gang_lookup - find several items at once
+ * @root: the tree
+ * @results: where to put the items
+ * @first_index: the lowest index to look at
+ * @max_items: the size of @results
+ *
+ * Returns the number of items found, in index order. The items have
+ * the lowest indices from @first_index on, but they need not be
+ * contiguous.
+ */
+unsigned int radix_tree_gang_lookup(struct radix_tree_root *root, void **results,
+	unsigned long first_index, unsigned int max_items)
+{
+	return __gang_lookup(root, results, first_index, max_items, -1);
+}
+
+/**
+ * radix_tree_gang_lookup_tag - find several tagged items at once
+ * @root: the tree
+ * @results: where to put the items
+ * @first_index: the lowest index to look at
+ * @max_items: the size of @results
+ * @tag: the tag
+ *
+ * Like radix_tree_gang_lookup(), but only returns the items with the
+ * tag, and skips the subtrees without any.
+ */
+unsigned int radix_tree_gang_lookup_tag(struct radix_tree_root *root, void **results,
+	unsigned long first_index, unsigned int max_items, int tag)
+{
+	if (!radix_tree_tagged(root, tag))
+		return 0;
+	return __gang_lookup(root, results, first_index, max_items, tag);
+}
+
+/**
+ * radix_tree_delete - remove an item
+ * @root: the tree
+ * @index: the index
+ *
+ * Clears the tags of the item and frees the nodes that became empty.
+ * Returns the item, or NULL if there was none.
+ */
+void *radix_tree_delete(struct radix_tree_root *root, unsigned long index)
+{
+	struct radix_tree_path path[RADIX_TREE_MAX_PATH + 1], *pathp;
+	void *item;
+	int tag;
+
+	pathp = radix_tree_walk(root, index, path);
+	if (!pathp)
+		return NULL;
+
+	item = *pathp->slot;
+	/* nodes go back to the slab cache with their tags clear */
+	for (tag = 0; tag < RADIX_TREE_MAX_TAGS; tag++)
+		radix_tree_clear_path_tag(pathp, tag);
+
+	*pathp->slot = NULL;
+	while (pathp->node && --pathp->node->count == 0) {
+		pathp--;
+		*pathp->slot = NULL;
+		radix_tree_node_free(pathp[1].node);
+	}
+	if (!root->rnode)
+		root->height = 0;
+	return item;
+}
+
+static void radix_tree_node_ctor(void *node, kmem_cache_t *cachep, unsigned long flags)
+{
+	memset(node, 0, sizeof(struct radix_tree_node));
+}
+
+void __init radix_tree_init(void)
+{
+	unsigned int i;
+
+	radix_tree_node_cachep = kmem_cache_create("radix_tree_node",
+			sizeof(struct radix_tree_node), 0,
+			SLAB_HWCACHE_ALIGN, radix_tree_node_ctor, NULL);
+	if (!radix_tree_node_cachep)
+		panic("Cannot create radix_tree_node SLAB cache");
+
+	for (i = 0; i <= RADIX_TREE_MAX_PATH; i++) {
+		unsigned int bits = i * RADIX_TREE_MAP_SHIFT;
+
+		if (bits >= BITS_PER_LONG)
+			height_to_maxindex[i] = ~0UL;
+		else
+			height_to_maxindex[i] = (1UL << bits) - 1;
+	}
+}
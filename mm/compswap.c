@@ -0,0 +1,447 @@
+/*
+ *  linux/mm/compswap.c
+ *
+ *  A compressed cache in memory for swapped out pages.
+ *
+ *  rw_swap_page() hands every page written to swap to compswap_store()
+ *  first. A page that compresses to less than half its size is kept in
+ *  memory, indexed by its swap entry, and the write to the device is
+ *  skipped; a read of the entry is then served from memory. The copy
+ *  is dropped when the swap entry is freed, or when the page is written
+ *  to the device later because it didn't compress that time.
+ *
+ *  The memory used is limited by /proc/sys/vm/compswap_pages (the
+ *  "compswap=" boot option), 1/16 of the memory by default; 0 turns
+ *  the cache off. When the cache is full, the oldest pages are written
+ *  back to their swap slots: each is decompressed into a page of the
+ *  swap cache, so that a fault on it during the write finds it there,
+ *  and written like any other swap page.
+ *
+ *  The codec is a small LZ77 variant, much faster than deflate.
+ *
+ *  Hits, misses and the compression ratio are shown in /proc/swaps.
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/highmem.h>
+#include <linux/pagemap.h>
+#include <linux/swap.h>
+#include <linux/compswap.h>
+
+int sysctl_compswap_pages = -1;		/* -1: not set at boot */
+
+struct compswap_entry {
+	struct list_head	lru;		/* the oldest entry is last */
+	swp_entry_t		entry;
+	unsigned int		length;
+	u8			data[0];
+};
+
+/* Compressed pages must fit in half a page with their entry */
+#define COMPSWAP_MAX_LEN	(PAGE_SIZE / 2 - sizeof(struct compswap_entry))
+
+/* all protected by compswap_lock, which nests inside swap_device_lock */
+static struct radix_tree_root compswap_tree[MAX_SWAPFILES];
+static LIST_HEAD(compswap_lru);
+static unsigned long compswap_nr_pages;
+static unsigned long compswap_nr_bytes;
+static unsigned long compswap_hits, compswap_misses;
+static unsigned long compswap_stores, compswap_rejects, compswap_writebacks;
+static spinlock_t compswap_lock = SPIN_LOCK_UNLOCKED;
+
+/* the codec work area */
+static u8 compswap_buf[PAGE_SIZE];
+static spinlock_t compswap_codec_lock = SPIN_LOCK_UNLOCKED;
+
+#define HASH_BITS	12
+#define HASH_SIZE	(1 << HASH_BITS)
+#define MAX_LIT		32			/* literals in a run */
+#define MAX_OFF		(1 << 13)		/* distance of a match */
+#define MAX_MATCH	(2 + 7 + 255)		/* length of a match */
+
+static unsigned short lz_hash[HASH_SIZE];
+
+static inline unsigned int lz_hash_of(const u8 *p)
+{
+	unsigned int v = (p[0] << 16) | (p[1] << 8) | p[2];
+
+	return ((v * 2654435761U) >> (32 - HASH_BITS)) & (HASH_SIZE - 1);
+}
+
+/*
+ * Compress @in_len bytes at @in into at most @out_len bytes at @out.
+ * Returns the compressed length, or 0 if it doesn't fit.
+ *
+ * The output is a sequence of literal runs and matches, each starting
+ * with a control byte: 000nnnnn is followed by n + 1 literal bytes,
+ * lllooooo by the low byte of the match distance (minus one), with an
+ * extra length byte first if lll is 7. The match is lll + 2 bytes long,
+ * or 9 plus the extra byte.
+ */
+static unsigned int lz_compress(const u8 *in, unsigned int in_len,
+	u8 *out, unsigned int out_len)
+{
+	const u8 *ip = in, *in_end = in + in_len;
+	u8 *op = out, *out_end = out + out_len;
+	u8 *ctrl;
+	unsigned int lit = 0;
+
+	if (out_len < 2)
+		return 0;
+	memset(lz_hash, 0, sizeof(lz_hash));
+	ctrl = op++;
+	while (ip < in_end) {
+		if (ip + 2 < in_end) {
+			unsigned int h = lz_hash_of(ip);
+			const u8 *ref = in + lz_hash[h];
+			unsigned int off = ip - ref - 1;
+
+			lz_hash[h] = ip - in;
+			if (ref < ip && off < MAX_OFF &&
+			    ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2]) {
+				unsigned int len = 3, max = in_end - ip;
+
+				if (max > MAX_MATCH)
+					max = MAX_MATCH;
+				while (len < max && ref[len] == ip[len])
+					len++;
+				/* end the literal run, or drop its empty control byte */
+				if (lit)
+					*ctrl = lit - 1;
+				else
+					op--;
+				if (op + 4 > out_end)
+					return 0;
+				ip += len;
+				len -= 2;
+				if (len < 7)
+					*op++ = (len << 5) | (off >> 8);
+				else {
+					*op++ = (7 << 5) | (off >> 8);
+					*op++ = len - 7;
+				}
+				*op++ = off;
+				lit = 0;
+				ctrl = op++;
+				continue;
+			}
+		}
+		if (op >= out_end)
+			return 0;
+		*op++ = *ip++;
+		if (++lit == MAX_LIT) {
+			*ctrl = lit - 1;
+			lit = 0;
+			if (op >= out_end)
+				return 0;
+			ctrl = op++;
+		}
+	}
+	if (lit)
+		*ctrl = lit - 1;
+	else
+		op--;
+	return op - out;
+}
+
+/* Returns the decompressed length, or -1 if @in is corrupt */
+static int lz_decompress(const u8 *in, unsigned int in_len,
+	u8 *out, unsigned int out_len)
+{
+	const u8 *ip = in, *in_end = in + in_len;
+	u8 *op = out, *out_end = out + out_len;
+
+	while (ip < in_end) {
+		unsigned int c = *ip++;
+
+		if (c < MAX_LIT) {
+			c++;
+			if (ip + c > in_end || op + c > out_end)
+				return -1;
+			memcpy(op, ip, c);
+			ip += c;
+			op += c;
+		} else {
+			unsigned int len = c >> 5;
+			const u8 *ref;
+
+			if (len == 7) {
+				if (ip >= in_end)
+					return -1;
+				len += *ip++;
+			}
+			if (ip >= in_end)
+				return -1;
+			ref = op - (((c & 0x1f) << 8) | *ip++) - 1;
+			len += 2;
+			if (ref < out || op + len > out_end)
+				return -1;
+			while (len--)
+				*op++ = *ref++;
+		}
+	}
+	return op - out;
+}
+
+static inline int compswap_full(void)
+{
+	return compswap_nr_bytes >= (unsigned long) sysctl_compswap_pages << PAGE_SHIFT;
+}
+
+/* Take @ce out of the cache. Called with compswap_lock held. */
+static void compswap_unlink(struct compswap_entry *ce)
+{
+	radix_tree_delete(&compswap_tree[SWP_TYPE(ce->entry)],
+			  SWP_OFFSET(ce->entry));
+	list_del(&ce->lru);
+	compswap_nr_pages--;
+	compswap_nr_bytes -= sizeof(*ce) + ce->length;
+}
+
+static void compswap_unpack(struct compswap_entry *ce, struct page *page)
+{
+	u8 *dst = kmap(page);
+
+	if (lz_decompress(ce->data, ce->length, dst, PAGE_SIZE) != PAGE_SIZE)
+		BUG();
+	kunmap(page);
+}
+
+/*
+ * Write the oldest page of the cache back to its swap slot. Returns 1
+ * if that made room.
+ */
+static int compswap_writeback(void)
+{
+	struct compswap_entry *ce;
+	struct swap_info_struct *p;
+	unsigned long offset;
+	swp_entry_t entry;
+	struct page *page;
+	int used;
+
+	spin_lock(&compswap_lock);
+	if (list_empty(&compswap_lru)) {
+		spin_unlock(&compswap_lock);
+		return 0;
+	}
+	ce = list_entry(compswap_lru.prev, struct compswap_entry, lru);
+	entry = ce->entry;
+	/* if we fail, try another one next time */
+	list_del(&ce->lru);
+	list_add(&ce->lru, &compswap_lru);
+	spin_unlock(&compswap_lock);
+
+	/*
+	 * Take the reference of the swap cache on the entry, unless it
+	 * has just been freed.
+	 */
+	p = swap_info + SWP_TYPE(entry);
+	offset = SWP_OFFSET(entry);
+	swap_device_lock(p);
+	used = p->swap_map && p->swap_map[offset];
+	if (used && p->swap_map[offset] < SWAP_MAP_MAX)
+		p->swap_map[offset]++;
+	swap_device_unlock(p);
+	if (!used)
+		return 0;
+
+	page = alloc_page(GFP_USER);
+	if (!page)
+		goto out_free_swap;
+	lock_page(page);
+	if (radix_tree_preload(GFP_USER) || add_to_swap_cache(page, entry)) {
+		/* a page in the swap cache is the copy to keep */
+		UnlockPage(page);
+		page_cache_release(page);
+		goto out_free_swap;
+	}
+
+	spin_lock(&compswap_lock);
+	ce = radix_tree_lookup(&compswap_tree[SWP_TYPE(entry)], offset);
+	if (ce)
+		compswap_unlink(ce);
+	spin_unlock(&compswap_lock);
+	if (!ce) {
+		/* it went to the device meanwhile */
+		rw_swap_page(READ, page, 0);
+		page_cache_release(page);
+		return 0;
+	}
+
+	compswap_unpack(ce, page);
+	kfree(ce);
+	compswap_writebacks++;
+	if (!rw_swap_page_base(WRITE, entry, page, 0))
+		UnlockPage(page);
+	page_cache_release(page);
+	return 1;
+
+out_free_swap:
+	swap_free(entry);
+	return 0;
+}
+
+/*
+ * Called from rw_swap_page() with the swap cache page locked. Returns 1
+ * if the page was kept compressed, 0 if it must go to the device.
+ */
+int compswap_store(swp_entry_t entry, struct page *page)
+{
+	struct compswap_entry *ce = NULL, *old = NULL;
+	struct radix_tree_root *root = &compswap_tree[SWP_TYPE(entry)];
+	unsigned long offset = SWP_OFFSET(entry);
+	unsigned int len;
+	u8 *src;
+
+	if (sysctl_compswap_pages <= 0)
+		goto out_drop;
+	while (compswap_full())
+		if (!compswap_writeback())
+			goto out_drop;
+
+	src = kmap(page);
+	spin_lock(&compswap_codec_lock);
+	len = lz_compress(src, PAGE_SIZE, compswap_buf, COMPSWAP_MAX_LEN);
+	if (len) {
+		ce = kmalloc(sizeof(*ce) + len, GFP_ATOMIC);
+		if (ce)
+			memcpy(ce->data, compswap_buf, len);
+	}
+	spin_unlock(&compswap_codec_lock);
+	kunmap(page);
+	if (!len)
+		compswap_rejects++;
+	if (!ce)
+		goto out_drop;
+	ce->entry = entry;
+	ce->length = len;
+
+	if (radix_tree_preload(GFP_BUFFER)) {
+		kfree(ce);
+		goto out_drop;
+	}
+	spin_lock(&compswap_lock);
+	old = radix_tree_lookup(root, offset);
+	if (old)
+		compswap_unlink(old);
+	radix_tree_insert(root, offset, ce);
+	list_add(&ce->lru, &compswap_lru);
+	compswap_nr_pages++;
+	compswap_nr_bytes += sizeof(*ce) + len;
+	compswap_stores++;
+	spin_unlock(&compswap_lock);
+	if (old)
+		kfree(old);
+	return 1;
+
+out_drop:
+	/* an older copy would be more recent than the one on the device */
+	compswap_invalidate(entry);
+	return 0;
+}
+
+/*
+ * Called from rw_swap_page() with the swap cache page locked. Returns 1
+ * if the page was read from the cache.
+ */
+int compswap_load(swp_entry_t entry, struct page *page)
+{
+	struct compswap_entry *ce;
+
+	spin_lock(&compswap_lock);
+	ce = radix_tree_lookup(&compswap_tree[SWP_TYPE(entry)], SWP_OFFSET(entry));
+	if (!ce) {
+		compswap_misses++;
+		spin_unlock(&compswap_lock);
+		return 0;
+	}
+	/*
+	 * The locked swap cache page keeps the entry from being freed,
+	 * stored again or written back while we decompress it.
+	 */
+	list_del(&ce->lru);
+	list_add(&ce->lru, &compswap_lru);
+	compswap_hits++;
+	spin_unlock(&compswap_lock);
+
+	compswap_unpack(ce, page);
+	SetPageUptodate(page);
+	return 1;
+}
+
+/* The swap entry is free, or its page goes to the device. */
+void compswap_invalidate(swp_entry_t entry)
+{
+	struct compswap_entry *ce;
+
+	spin_lock(&compswap_lock);
+	ce = radix_tree_lookup(&compswap_tree[SWP_TYPE(entry)], SWP_OFFSET(entry));
+	if (ce)
+		compswap_unlink(ce);
+	spin_unlock(&compswap_lock);
+	if (ce)
+		kfree(ce);
+}
+
+/* Called by swapoff, for the entries that try_to_unuse() cleared itself */
+void compswap_invalidate_area(unsigned int type)
+{
+	struct compswap_entry *ces[16];
+	unsigned int i, nr;
+
+	spin_lock(&compswap_lock);
+	while ((nr = radix_tree_gang_lookup(&compswap_tree[type],
+					    (void **) ces, 0, 16)) != 0) {
+		for (i = 0; i < nr; i++) {
+			compswap_unlink(ces[i]);
+			kfree(ces[i]);
+		}
+	}
+	spin_unlock(&compswap_lock);
+}
+
+/* The last lines of /proc/swaps */
+int compswap_report(char *buf)
+{
+	unsigned long pages, bytes, ratio;
+
+	if (sysctl_compswap_pages <= 0 && !compswap_nr_pages)
+		return 0;
+	spin_lock(&compswap_lock);
+	pages = compswap_nr_pages;
+	bytes = compswap_nr_bytes;
+	spin_unlock(&compswap_lock);
+	/* uncompressed size / compressed size, times 100 */
+	ratio = (pages << (PAGE_SHIFT - 10)) * 100 / ((bytes >> 10) + 1);
+	return sprintf(buf,
+			"Compressed: %lu pages in %lu kB of %lu kB, ratio %lu.%02lu\n"
+			"Compressed: hits %lu misses %lu stores %lu rejects %lu writebacks %lu\n",
+			pages, bytes >> 10,
+			(unsigned long) sysctl_compswap_pages << (PAGE_SHIFT - 10),
+			ratio / 100, ratio % 100,
+			compswap_hits, compswap_misses, compswap_stores,
+			compswap_rejects, compswap_writebacks);
+}
+
+static int __init compswap_setup(char *str)
+{
+	sysctl_compswap_pages = simple_strtoul(str, &str, 0);
+	return 1;
+}
+
+__setup("compswap=", compswap_setup);
+
+static int __init compswap_init(void)
+{
+	if (sysctl_compswap_pages < 0)
+		sysctl_compswap_pages = num_physpages / 16;
+	printk(KERN_INFO "Compressed swap cache: up to %d kB\n",
+	       sysctl_compswap_pages << (PAGE_SHIFT - 10));
+	return 0;
+}
+
+module_init(compswap_init)
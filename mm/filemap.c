@@ -15,6 +15,7 @@
 #include <linux/locks.h>
 #include <linux/pagemap.h>
 #include <linux/swap.h>
+#include <linux/pagevec.h>
 #include <linux/smp_lock.h>
 #include <linux/blkdev.h>
 #include <linux/file.h>
@@ -22,6 +23,8 @@
 #include <linux/slab.h>
 #include <linux/init.h>
 #include <linux/mm.h>
+#include <linux/hugetlb.h>
+#include <linux/ptshare.h>
 
 #include <asm/pgalloc.h>
 #include <asm/uaccess.h>
@@ -42,34 +45,21 @@
  */
 
 atomic_t page_cache_size = ATOMIC_INIT(0);
-unsigned int page_hash_bits;
-struct page **page_hash_table;
 
-spinlock_t pagecache_lock = SPIN_LOCK_UNLOCKED;
 /*
+ * The pages of a mapping are indexed by the radix tree in the mapping,
+ * protected by mapping->page_lock. Lookups only take the page_lock;
+ * the pagecache_lock protects the inode page lists and is held, outside
+ * the page_lock, to add pages to or remove them from a mapping.
+ *
  * NOTE: to avoid deadlocking you must never acquire the pagecache_lock with
- *       the pagemap_lru_lock held.
+ *       the lru_lock of a zone held, nor the lru_lock with a page_lock held.
  */
-spinlock_t pagemap_lru_lock = SPIN_LOCK_UNLOCKED;
+spinlock_t pagecache_lock = SPIN_LOCK_UNLOCKED;
 
 #define CLUSTER_PAGES		(1 << page_cluster)
 #define CLUSTER_OFFSET(x)	(((x) >> page_cluster) << page_cluster)
 
-//添加到hash 表中
-static void add_page_to_hash_queue(struct page * page, struct page **p)
-{
-	struct page *next = *p;
-
-	*p = page;
-	page->next_hash = next;
-	page->pprev_hash = p;
-	if (next)
-		next->pprev_hash = &page->next_hash;
-	if (page->buffers)
-		PAGE_BUG(page);
-	atomic_inc(&page_cache_size);
-}
-
 static inline void add_page_to_inode_queue(struct address_space *mapping, struct page * page)
 {
 	struct list_head *head = &mapping->clean_pages;
@@ -88,15 +78,13 @@ static inline void remove_page_from_inode_queue(struct page * page)
 	page->mapping = NULL;
 }
 
-static inline void remove_page_from_hash_queue(struct page * page)
+static inline void remove_page_from_tree(struct page * page)
 {
-	struct page *next = page->next_hash;
-	struct page **pprev = page->pprev_hash;
+	struct address_space * mapping = page->mapping;
 
-	if (next)
-		next->pprev_hash = pprev;
-	*pprev = next;
-	page->pprev_hash = NULL;
+	spin_lock(&mapping->page_lock);
+	radix_tree_delete(&mapping->page_tree, page->index);
+	spin_unlock(&mapping->page_lock);
 	atomic_dec(&page_cache_size);
 }
 
@@ -108,9 +96,96 @@ static inline void remove_page_from_hash_queue(struct page * page)
 void __remove_inode_page(struct page *page)
 {
 	if (PageDirty(page)) BUG();
+	remove_page_from_tree(page);
 	remove_page_from_inode_queue(page);
-	remove_page_from_hash_queue(page);
+}
+
+/*
+ * Move the contents and the page cache identity of @page to @newpage,
+ * a freshly allocated page. Only clean page cache and swap cache
+ * pages that nobody else holds a reference to - no mappings, no
+ * buffers - can be moved. On success the cache reference is
+ * transferred to @newpage and @page is left with a zero count, for
+ * the caller to free. Returns 0 or -EBUSY.
+ *
+ * The page lock keeps writers out while we copy; the count and dirty
+ * bit are checked again under the locks to catch a mapping that came
+ * and went in the meantime.
+ */
+#define MIGRATE_FLAGS	((1 << PG_uptodate) | (1 << PG_referenced) | \
+			 (1 << PG_error) | (1 << PG_swap_cache) | (1 << PG_arch_1))
+
+static inline int page_migratable(struct page *page)
+{
+	return page->mapping && !page->buffers && !PageDirty(page) &&
+		page_count(page) == 1;
+}
+
+int migrate_page_cache(struct page *page, struct page *newpage)
+{
+	zone_t *zone = page->zone;
+	struct address_space *mapping;
+	void **slot;
+
+	/* the lists of only one zone are locked */
+	if (newpage->zone != zone)
+		BUG();
+	if (TryLockPage(page))
+		return -EBUSY;
+	if (!page_migratable(page))
+		goto busy;
+
+	copy_highpage(newpage, page);
+
+	spin_lock(&pagecache_lock);
+	spin_lock(&zone->lru_lock);
+	if (!page_migratable(page)) {
+		spin_unlock(&zone->lru_lock);
+		spin_unlock(&pagecache_lock);
+		goto busy;
+	}
+
+	newpage->flags = (newpage->flags & ~MIGRATE_FLAGS) |
+			 (page->flags & MIGRATE_FLAGS);
+	newpage->age = page->age;
+	newpage->index = page->index;
+	newpage->mapping = page->mapping;
+
+	/* inode queue, in place */
+	list_add(&newpage->list, &page->list);
+	list_del(&page->list);
+
+	/* radix tree slot, in place */
+	mapping = page->mapping;
+	spin_lock(&mapping->page_lock);
+	slot = radix_tree_lookup_slot(&mapping->page_tree, page->index);
+	if (!slot || *slot != page)
+		BUG();
+	*slot = newpage;
+	spin_unlock(&mapping->page_lock);
+
+	if (PageActive(page)) {
+		del_page_from_active_list(page);
+		add_page_to_active_list(newpage);
+	} else if (PageInactiveDirty(page)) {
+		del_page_from_inactive_dirty_list(page);
+		add_page_to_inactive_dirty_list(newpage);
+	} else if (PageInactiveClean(page)) {
+		del_page_from_inactive_clean_list(page);
+		add_page_to_inactive_clean_list(newpage);
+	}
+
 	page->mapping = NULL;
+	PageClearSwapCache(page);
+	put_page_testzero(page);
+	spin_unlock(&zone->lru_lock);
+	spin_unlock(&pagecache_lock);
+	UnlockPage(page);
+	return 0;
+
+busy:
+	UnlockPage(page);
+	return -EBUSY;
 }
 
 void remove_inode_page(struct page *page)
@@ -134,7 +209,7 @@ static inline int sync_page(struct page *page)
 }
 
 /*
- * Add a page to the dirty page list.
+ * Add a page to the dirty page list, and tag it dirty.
  */
 void __set_page_dirty(struct page *page)
 {
@@ -143,6 +218,10 @@ void __set_page_dirty(struct page *page)
 	spin_lock(&pagecache_lock);
 	list_del(&page->list);
 	list_add(&page->list, &mapping->dirty_pages);
+	spin_lock(&mapping->page_lock);
+	radix_tree_tag_clear(&mapping->page_tree, page->index, PAGECACHE_TAG_WRITEBACK);
+	radix_tree_tag_set(&mapping->page_tree, page->index, PAGECACHE_TAG_DIRTY);
+	spin_unlock(&mapping->page_lock);
 	spin_unlock(&pagecache_lock);
 
 	mark_inode_dirty_pages(mapping->host);
@@ -163,8 +242,10 @@ void invalidate_inode_pages(struct inode * inode)
 
 	head = &inode->i_mapping->clean_pages;	//只扫描干净页面
 
+	/* pages waiting in our pagevec have an extra reference */
+	lru_add_drain();
+
 	spin_lock(&pagecache_lock);
-	spin_lock(&pagemap_lru_lock);
 	curr = head->next;
 
 	while (curr != head) {
@@ -183,13 +264,14 @@ void invalidate_inode_pages(struct inode * inode)
 		if (TryLockPage(page))
 			continue;
 
+		spin_lock(&page->zone->lru_lock);
 		__lru_cache_del(page);
+		spin_unlock(&page->zone->lru_lock);
 		__remove_inode_page(page);
 		UnlockPage(page);		//唤醒所有等待该页面的进程
 		page_cache_release(page);	//释放页面
 	}
 
-	spin_unlock(&pagemap_lru_lock);
 	spin_unlock(&pagecache_lock);
 }
 
@@ -222,52 +304,6 @@ static inline void truncate_complete_page(struct page *page)
 	page_cache_release(page);
 }
 
-static int FASTCALL(truncate_list_pages(struct list_head *, unsigned long, unsigned *));
-static int truncate_list_pages(struct list_head *head, unsigned long start, unsigned *partial)
-{
-	struct list_head *curr;
-	struct page * page;
-
-	curr = head->next;
-	while (curr != head) {		//是否为空
-		unsigned long offset;
-
-		page = list_entry(curr, struct page, list);
-		curr = curr->next;
-		offset = page->index;
-
-		/* Is one of the pages to truncate? */
-		if ((offset >= start) || (*partial && (offset + 1) == start)) {
-			if (TryLockPage(page)) {
-				page_cache_get(page);
-				spin_unlock(&pagecache_lock);
-				wait_on_page(page);
-				page_cache_release(page);
-				return 1;
-			}
-			page_cache_get(page);
-			spin_unlock(&pagecache_lock);
-
-			if (*partial && (offset + 1) == start) {
-				//截断部分页面
-				truncate_partial_page(page, *partial);
-				*partial = 0;
-			} else {
-				//截断全部页面
-				truncate_complete_page(page);
-			}
-
-			UnlockPage(page);
-			page_cache_release(page);
-			return 1;
-		}
-	}
-
-	//只有当为空或页面全部都truncate 之后才返回 0
-	return 0;
-}
-
-
 /**
  * truncate_inode_pages - truncate *all* the pages from an offset
  * @mapping: mapping to truncate
@@ -276,6 +312,9 @@ static int truncate_list_pages(struct list_head *head, unsigned long start, unsi
  * Truncate the page cache at a set offset, removing the pages
  * that are beyond that offset (and zeroing out partial pages).
  * If any page is locked we wait for it to become unlocked.
+ *
+ * The pages are found in index order through the radix tree, a batch
+ * at a time, so we only look at the pages past the offset.
  */
 void truncate_inode_pages(struct address_space * mapping, loff_t lstart)
 {
@@ -283,42 +322,66 @@ void truncate_inode_pages(struct address_space * mapping, loff_t lstart)
 	unsigned long start = (lstart + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
 	//页内偏移量
 	unsigned partial = lstart & (PAGE_CACHE_SIZE - 1);
+	struct page * pages[PAGEVEC_SIZE];
+	unsigned long next = start;
+	unsigned int i, nr;
 
-repeat:
-	//将相应页面从mapping 中删除
-	spin_lock(&pagecache_lock);
-	if (truncate_list_pages(&mapping->clean_pages, start, &partial))
-		goto repeat;
-	if (truncate_list_pages(&mapping->dirty_pages, start, &partial))
-		goto repeat;
-	if (truncate_list_pages(&mapping->locked_pages, start, &partial))
-		goto repeat;
-	spin_unlock(&pagecache_lock);
-}
+	if (partial) {
+		//截断部分页面
+		struct page * page = find_lock_page(mapping, start - 1);
 
-static inline struct page * __find_page_nolock(struct address_space *mapping, unsigned long offset, struct page *page)
-{
-	goto inside;	//洋气啊...
+		if (page) {
+			truncate_partial_page(page, partial);
+			UnlockPage(page);
+			page_cache_release(page);
+		}
+	}
 
-	for (;;) {
-		page = page->next_hash;
-inside:
-		if (!page)
-			goto not_found;
-		if (page->mapping != mapping)
-			continue;
-		if (page->index == offset)
+	//截断全部页面
+	while ((nr = find_get_pages(mapping, next, PAGEVEC_SIZE, pages)) != 0) {
+		for (i = 0; i < nr; i++) {
+			struct page * page = pages[i];
+
+			/* the index can't be trusted until we have the lock */
+			if (page->index >= next)
+				next = page->index + 1;
+			lock_page(page);
+			if (page->mapping == mapping && page->index >= start)
+				truncate_complete_page(page);
+			UnlockPage(page);
+			page_cache_release(page);
+		}
+		if (!next)
 			break;
 	}
-	/*
-	 * Touching the page may move it to the active list.
-	 * If we end up with too few inactive pages, we wake
-	 * up kswapd.
-	 */
+}
+
+/*
+ * Touching the page may move it to the active list.
+ * If we end up with too few inactive pages, we wake
+ * up kswapd. The caller holds a reference, but not the
+ * page_lock: the lru_lock nests outside of it.
+ */
+static inline void touch_page(struct page * page)
+{
 	age_page_up(page);
 	if (inactive_shortage() > inactive_target / 2 && free_shortage())
 			wakeup_kswapd(0);
-not_found:
+}
+
+/*
+ * Find the page and take a reference to it, without touching it.
+ */
+static struct page * __find_get_page(struct address_space *mapping,
+				     unsigned long offset)
+{
+	struct page *page;
+
+	spin_lock(&mapping->page_lock);
+	page = radix_tree_lookup(&mapping->page_tree, offset);
+	if (page)
+		page_cache_get(page);
+	spin_unlock(&mapping->page_lock);
 	return page;
 }
 
@@ -357,38 +420,39 @@ static int waitfor_one_page(struct page *page)
 	return error;
 }
 
-static int do_buffer_fdatasync(struct list_head *head, unsigned long start, unsigned long end, int (*fn)(struct page *))
+/*
+ * Walk the pages of the mapping in [start, end) in index order, a
+ * batch at a time, and call fn() on the ones with buffers.
+ */
+static int do_buffer_fdatasync(struct address_space *mapping, unsigned long start, unsigned long end, int (*fn)(struct page *))
 {
-	struct list_head *curr;
-	struct page *page;
+	struct page *pages[PAGEVEC_SIZE];
+	unsigned int i, nr;
 	int retval = 0;
 
-	spin_lock(&pagecache_lock);
-	curr = head->next;
-	while (curr != head) {
-		page = list_entry(curr, struct page, list);
-		curr = curr->next;
-		if (!page->buffers)
-			continue;
-		if (page->index >= end)
-			continue;
-		if (page->index < start)
-			continue;
+	while (start < end &&
+	       (nr = find_get_pages(mapping, start, PAGEVEC_SIZE, pages)) != 0) {
+		for (i = 0; i < nr; i++) {
+			struct page *page = pages[i];
 
-		page_cache_get(page);
-		spin_unlock(&pagecache_lock);
-		lock_page(page);
+			if (page->index >= end) {
+				start = end;
+			} else {
+				if (page->index >= start)
+					start = page->index + 1;
+				if (page->buffers) {
+					lock_page(page);
 
-		/* The buffers could have been free'd while we waited for the page lock */
-		if (page->buffers)
-			retval |= fn(page);
+					/* The buffers could have been free'd while we waited for the page lock */
+					if (page->buffers)
+						retval |= fn(page);
 
-		UnlockPage(page);
-		spin_lock(&pagecache_lock);
-		curr = page->list.next;
-		page_cache_release(page);
+					UnlockPage(page);
+				}
+			}
+			page_cache_release(page);
+		}
 	}
-	spin_unlock(&pagecache_lock);
 
 	return retval;
 }
@@ -401,94 +465,193 @@ int generic_buffer_fdatasync(struct inode *inode, unsigned long start_idx, unsig
 {
 	int retval;
 
-	/* writeout dirty buffers on pages from both clean and dirty lists */
-	retval = do_buffer_fdatasync(&inode->i_mapping->dirty_pages, start_idx, end_idx, writeout_one_page);
-	retval |= do_buffer_fdatasync(&inode->i_mapping->clean_pages, start_idx, end_idx, writeout_one_page);
-	retval |= do_buffer_fdatasync(&inode->i_mapping->locked_pages, start_idx, end_idx, writeout_one_page);
+	/* writeout dirty buffers on the pages in the range */
+	retval = do_buffer_fdatasync(inode->i_mapping, start_idx, end_idx, writeout_one_page);
 
-	/* now wait for locked buffers on pages from both clean and dirty lists */
-	retval |= do_buffer_fdatasync(&inode->i_mapping->dirty_pages, start_idx, end_idx, writeout_one_page);
-	retval |= do_buffer_fdatasync(&inode->i_mapping->clean_pages, start_idx, end_idx, waitfor_one_page);
-	retval |= do_buffer_fdatasync(&inode->i_mapping->locked_pages, start_idx, end_idx, waitfor_one_page);
+	/* now wait for locked buffers on the pages in the range */
+	retval |= do_buffer_fdatasync(inode->i_mapping, start_idx, end_idx, waitfor_one_page);
 
 	return retval;
 }
 
+/*
+ * Gang lookup of the pages with @tag in [*start, end], with a
+ * reference taken. Moves each page to the list @head of the mapping
+ * and retags it from @tag to @newtag (if not negative), so that the
+ * tags follow the lists. *start is set past the last page found.
+ * Returns the number of pages, fewer than PAGEVEC_SIZE when there are
+ * no more in the range. Called with the pagecache_lock held.
+ */
+static unsigned int find_get_tagged_pages(struct address_space *mapping,
+	unsigned long *start, unsigned long end, int tag,
+	struct list_head *head, int newtag, struct page **pages)
+{
+	unsigned int i, nr;
+
+	spin_lock(&mapping->page_lock);
+	nr = radix_tree_gang_lookup_tag(&mapping->page_tree, (void **)pages,
+					*start, PAGEVEC_SIZE, tag);
+	for (i = 0; i < nr; i++) {
+		struct page *page = pages[i];
+
+		if (page->index > end)
+			break;
+		radix_tree_tag_clear(&mapping->page_tree, page->index, tag);
+		if (newtag >= 0)
+			radix_tree_tag_set(&mapping->page_tree, page->index, newtag);
+		list_del(&page->list);
+		list_add(&page->list, head);
+		page_cache_get(page);
+	}
+	if (i)
+		*start = pages[i-1]->index + 1;
+	spin_unlock(&mapping->page_lock);
+	return i;
+}
+
 /**
- *      filemap_fdatasync - walk the list of dirty pages of the given address space
- *     	and writepage() all of them.
- * 
+ *      filemap_fdatasync_range - writepage() the dirty pages of a range
+ *      of the given address space
+ *
  *      @mapping: address space structure to write
+ *      @start: index of the first page
+ *      @end: index of the last page
  *
+ *      The dirty pages are found through the dirty tag of the radix
+ *      tree, so only the dirty pages in the range are looked at.
  */
 /*
  *	遍历给定地址范围内的脏页面，调用writepage()函数
  */
-void filemap_fdatasync(struct address_space * mapping)
+void filemap_fdatasync_range(struct address_space * mapping,
+	unsigned long start, unsigned long end)
 {
 	int (*writepage)(struct page *) = mapping->a_ops->writepage;
+	struct page *pages[PAGEVEC_SIZE];
+	unsigned int i, nr;
 
 	spin_lock(&pagecache_lock);
 
 	//遍历所有的脏页面
-        while (!list_empty(&mapping->dirty_pages)) {
-		struct page *page = list_entry(mapping->dirty_pages.next, struct page, list);
-
-		list_del(&page->list);
-		list_add(&page->list, &mapping->locked_pages);
-
-		if (!PageDirty(page))
-			continue;
-
-		page_cache_get(page);
+	do {
+		nr = find_get_tagged_pages(mapping, &start, end,
+				PAGECACHE_TAG_DIRTY, &mapping->locked_pages,
+				PAGECACHE_TAG_WRITEBACK, pages);
+		if (!nr)
+			break;
 		spin_unlock(&pagecache_lock);
 
-		lock_page(page);
+		for (i = 0; i < nr; i++) {
+			struct page *page = pages[i];
 
-		if (PageDirty(page)) {
-			ClearPageDirty(page);
-			writepage(page);
-		} else
-			UnlockPage(page);
+			if (PageDirty(page)) {
+				lock_page(page);
 
-		page_cache_release(page);
+				if (PageDirty(page)) {
+					ClearPageDirty(page);
+					writepage(page);
+				} else
+					UnlockPage(page);
+			}
+			page_cache_release(page);
+		}
 		spin_lock(&pagecache_lock);
-	}
+		/* start wraps to 0 after the last possible index */
+	} while (nr == PAGEVEC_SIZE && start && start <= end);
 	spin_unlock(&pagecache_lock);
 }
 
 /**
- *      filemap_fdatawait - walk the list of locked pages of the given address space
- *     	and wait for all of them.
- * 
- *      @mapping: address space structure to wait for
+ *      filemap_fdatawait_range - wait for the pages of a range of the
+ *      given address space that filemap_fdatasync_range() started
  *
+ *      @mapping: address space structure to wait for
+ *      @start: index of the first page
+ *      @end: index of the last page
  */
 /*
  *	遍历给定地址范围内的locked页面，等待他们操作完毕
  */
-void filemap_fdatawait(struct address_space * mapping)
+void filemap_fdatawait_range(struct address_space * mapping,
+	unsigned long start, unsigned long end)
 {
+	struct page *pages[PAGEVEC_SIZE];
+	unsigned int i, nr;
+
 	spin_lock(&pagecache_lock);
 
-        while (!list_empty(&mapping->locked_pages)) {
-		struct page *page = list_entry(mapping->locked_pages.next, struct page, list);
+	do {
+		nr = find_get_tagged_pages(mapping, &start, end,
+				PAGECACHE_TAG_WRITEBACK, &mapping->clean_pages,
+				-1, pages);
+		if (!nr)
+			break;
+		spin_unlock(&pagecache_lock);
 
-		list_del(&page->list);
-		list_add(&page->list, &mapping->clean_pages);
+		for (i = 0; i < nr; i++) {
+			wait_on_page(pages[i]);
+			page_cache_release(pages[i]);
+		}
+		spin_lock(&pagecache_lock);
+	} while (nr == PAGEVEC_SIZE && start && start <= end);
+	spin_unlock(&pagecache_lock);
+}
 
-		if (!PageLocked(page))
-			continue;
+/**
+ *      filemap_fdatasync - walk the dirty pages of the given address space
+ *     	and writepage() all of them.
+ * 
+ *      @mapping: address space structure to write
+ *
+ */
+void filemap_fdatasync(struct address_space * mapping)
+{
+	filemap_fdatasync_range(mapping, 0, ~0UL);
+}
 
-		page_cache_get(page);
-		spin_unlock(&pagecache_lock);
+/**
+ *      filemap_fdatawait - walk the locked pages of the given address space
+ *     	and wait for all of them.
+ * 
+ *      @mapping: address space structure to wait for
+ *
+ */
+void filemap_fdatawait(struct address_space * mapping)
+{
+	filemap_fdatawait_range(mapping, 0, ~0UL);
+}
+
+/*
+ * Index the page in the radix tree and put it on the clean list of
+ * the mapping. Lookups only take the page_lock, so the page is set
+ * up completely before we drop it. Called with the pagecache_lock
+ * held, returns 0, -EEXIST if there is a page at @index already or
+ * -ENOMEM.
+ */
+static int add_page_to_mapping(struct page * page,
+	struct address_space *mapping, unsigned long index, unsigned long flags)
+{
+	int error;
 
-		___wait_on_page(page);
+	if (page->buffers)
+		PAGE_BUG(page);
 
-		page_cache_release(page);
-		spin_lock(&pagecache_lock);
+	spin_lock(&mapping->page_lock);
+	error = radix_tree_insert(&mapping->page_tree, index, page);
+	if (!error) {
+		page->flags = flags;
+		page_cache_get(page);		//增加page->count引用计数
+		page->index = index;
+		//添加page 到mapping->clean_pages 链表中
+		add_page_to_inode_queue(mapping, page);
+		atomic_inc(&page_cache_size);
 	}
-	spin_unlock(&pagecache_lock);
+	spin_unlock(&mapping->page_lock);
+
+	//添加page 到active_list 链表中
+	if (!error)
+		lru_cache_add(page);
+	return error;
 }
 
 /*
@@ -499,22 +662,21 @@ void filemap_fdatawait(struct address_space * mapping)
  *
  * 将page 添加到inode page 缓存中.
  * 调用者必须要锁定页面并且正确设置page的标识位.
+ *
+ * This can't sleep, it fails with -ENOMEM if it can't get a radix
+ * tree node - unless the caller did a radix_tree_preload() first.
  */
-void add_to_page_cache_locked(struct page * page, struct address_space *mapping, unsigned long index)
+int add_to_page_cache_locked(struct page * page, struct address_space *mapping, unsigned long index)
 {
+	int error;
+
 	if (!PageLocked(page))
 		BUG();
 
-	page_cache_get(page);		//增加page->count引用计数
 	spin_lock(&pagecache_lock);
-	page->index = index;
-	//添加page 到mapping->clean_pages 链表中
-	add_page_to_inode_queue(mapping, page);
-	//添加page 到page_hash_table+hash 中
-	add_page_to_hash_queue(page, page_hash(mapping, index));
-	//添加page 到active_list 链表中
-	lru_cache_add(page);
+	error = add_page_to_mapping(page, mapping, index, page->flags);
 	spin_unlock(&pagecache_lock);
+	return error;
 }
 
 /*
@@ -522,9 +684,8 @@ void add_to_page_cache_locked(struct page * page, struct address_space *mapping,
  * owned by us, but unreferenced, not uptodate and with no errors.
  */
 /* 添加页面到缓存 */
-static inline void __add_to_page_cache(struct page * page,
-	struct address_space *mapping, unsigned long offset,
-	struct page **hash)
+static inline int __add_to_page_cache(struct page * page,
+	struct address_space *mapping, unsigned long offset)
 {
 	unsigned long flags;
 
@@ -532,39 +693,33 @@ static inline void __add_to_page_cache(struct page * page,
 		BUG();
 
 	flags = page->flags & ~((1 << PG_uptodate) | (1 << PG_error) | (1 << PG_dirty) | (1 << PG_referenced) | (1 << PG_arch_1));
-	page->flags = flags | (1 << PG_locked);
-	page_cache_get(page);
-	page->index = offset;
-	add_page_to_inode_queue(mapping, page);	//添加到mapping中
-	add_page_to_hash_queue(page, hash);	//添加到hash表中
-	lru_cache_add(page);			//添加到active list中
+	return add_page_to_mapping(page, mapping, offset, flags | (1 << PG_locked));
 }
 
-void add_to_page_cache(struct page * page, struct address_space * mapping, unsigned long offset)
+int add_to_page_cache(struct page * page, struct address_space * mapping, unsigned long offset)
 {
+	int error;
+
 	spin_lock(&pagecache_lock);
-	__add_to_page_cache(page, mapping, offset, page_hash(mapping, offset));
+	error = __add_to_page_cache(page, mapping, offset);
 	spin_unlock(&pagecache_lock);
+	return error;
 }
 
+/*
+ * Add a new page for a caller that can sleep. The radix tree nodes
+ * are allocated first, so that this only fails if somebody raced with
+ * us and added a page at @offset already (-EEXIST), or if we are out
+ * of memory.
+ */
 static int add_to_page_cache_unique(struct page * page,
-	struct address_space *mapping, unsigned long offset,
-	struct page **hash)
+	struct address_space *mapping, unsigned long offset)
 {
 	int err;
-	struct page *alias;
-
-	spin_lock(&pagecache_lock);
-	//加锁之后再找一遍
-	alias = __find_page_nolock(mapping, offset, *hash);
 
-	err = 1;
-	if (!alias) {
-		__add_to_page_cache(page,mapping,offset,hash);
-		err = 0;
-	}
-
-	spin_unlock(&pagecache_lock);
+	err = radix_tree_preload(GFP_KERNEL);
+	if (!err)
+		err = add_to_page_cache(page, mapping, offset);
 	return err;
 }
 
@@ -579,22 +734,24 @@ static inline int page_cache_read(struct file * file, unsigned long offset)
 {
 	struct inode *inode = file->f_dentry->d_inode;
 	struct address_space *mapping = inode->i_mapping;
-	struct page **hash = page_hash(mapping, offset);
 	struct page *page; 
+	int error;
 
-	spin_lock(&pagecache_lock);
+	spin_lock(&mapping->page_lock);
 	//查找对应mapping中的页面缓存
-	page = __find_page_nolock(mapping, offset, *hash);
-	spin_unlock(&pagecache_lock);
+	page = radix_tree_lookup(&mapping->page_tree, offset);
+	spin_unlock(&mapping->page_lock);
 	if (page)
 		return 0;
 
-	page = page_cache_alloc();	//申请一个内存页面
+	/* the I/O fills it, the CPU won't touch it for a while */
+	page = page_cache_alloc_cold();	//申请一个内存页面
 	if (!page)
 		return -ENOMEM;
 
-	if (!add_to_page_cache_unique(page, mapping, offset, hash)) {
-		int error = mapping->a_ops->readpage(file, page);
+	error = add_to_page_cache_unique(page, mapping, offset);
+	if (!error) {
+		error = mapping->a_ops->readpage(file, page);
 		page_cache_release(page);
 		return error;
 	}
@@ -603,7 +760,7 @@ static inline int page_cache_read(struct file * file, unsigned long offset)
 	 * raced with us and added our page to the cache first.
 	 */
 	page_cache_free(page);
-	return 0;
+	return error == -EEXIST ? 0 : error;
 }
 
 /*
@@ -692,49 +849,33 @@ void lock_page(struct page *page)
 
 /*
  * a rather lightweight function, finding and getting a reference to a
- * hashed page atomically, waiting for it if it's locked.
+ * page in the page cache atomically.
  */
 /* 一个轻量级的查找函数，查找并获取一个页面的引用 */
-struct page * __find_get_page(struct address_space *mapping,
-			      unsigned long offset, struct page **hash)
+struct page * find_get_page(struct address_space *mapping, unsigned long offset)
 {
 	struct page *page;
 
-	/*
-	 * We scan the hash list read-only. Addition to and removal from
-	 * the hash-list needs a held write-lock.
-	 */
-	spin_lock(&pagecache_lock);
-	page = __find_page_nolock(mapping, offset, *hash);
+	page = __find_get_page(mapping, offset);
 	if (page)
-		page_cache_get(page);
-	spin_unlock(&pagecache_lock);
+		touch_page(page);
 	return page;
 }
 
 /*
  * Get the lock to a page atomically.
  */
-struct page * __find_lock_page (struct address_space *mapping,
-				unsigned long offset, struct page **hash)
+struct page * find_lock_page(struct address_space *mapping, unsigned long offset)
 {
 	struct page *page;
 
-	/*
-	 * We scan the hash list read-only. Addition to and removal from
-	 * the hash-list needs a held write-lock.
-	 */
 repeat:
-	spin_lock(&pagecache_lock);
-	page = __find_page_nolock(mapping, offset, *hash);
+	page = find_get_page(mapping, offset);
 	if (page) {
-		page_cache_get(page);
-		spin_unlock(&pagecache_lock);
-
 		lock_page(page);
 
-		/* Is the page still hashed? Ok, good.. */
-		if (page->mapping)
+		/* Is the page still in the cache? Ok, good.. */
+		if (page->mapping == mapping && page->index == offset)
 			return page;
 
 		/* Nope: we raced. Release and try again.. */
@@ -742,179 +883,66 @@ repeat:
 		page_cache_release(page);
 		goto repeat;
 	}
-	spin_unlock(&pagecache_lock);
 	return NULL;
 }
 
-#if 0
-#define PROFILE_READAHEAD
-#define DEBUG_READAHEAD
-#endif
-
-/*
- * We combine this with read-ahead to deactivate pages when we
- * think there's sequential IO going on. Note that this is
- * harmless since we don't actually evict the pages from memory
- * but just move them to the inactive list.
- *
- * TODO:
- * - make the readahead code smarter
- * - move readahead to the VMA level so we can do the same
- *   trick with mmap()
+/**
+ * find_get_pages - gang page cache lookup
+ * @mapping: the address_space to search
+ * @start: the starting page index
+ * @nr_pages: the maximum number of pages
+ * @pages: where the resulting pages are placed
  *
- * Rik van Riel, 2000
+ * Takes a reference to up to @nr_pages pages of @mapping, the ones
+ * with the lowest indices from @start on, and returns the number of
+ * pages found. The pages are in index order, but there may be holes
+ * between them.
  */
-static void drop_behind(struct file * file, unsigned long index)
+unsigned int find_get_pages(struct address_space *mapping, unsigned long start,
+			    unsigned int nr_pages, struct page **pages)
 {
-	struct inode *inode = file->f_dentry->d_inode;
-	struct address_space *mapping = inode->i_mapping;
-	struct page **hash;
-	struct page *page;
-	unsigned long start;
-
-	/* Nothing to drop-behind if we're on the first page. */
-	if (!index)
-		return;
+	unsigned int i, ret;
 
-	if (index > file->f_rawin)
-		start = index - file->f_rawin;
-	else
-		start = 0;
-
-	/*
-	 * Go backwards from index-1 and drop all pages in the
-	 * readahead window. Since the readahead window may have
-	 * been increased since the last time we were called, we
-	 * stop when the page isn't there.
-	 */
-	spin_lock(&pagecache_lock);
-	while (--index >= start) {
-		hash = page_hash(mapping, index);
-		page = __find_page_nolock(mapping, index, *hash);
-		if (!page)
-			break;
-		deactivate_page(page);	//将页面移动到inactive表中
-	}
-	spin_unlock(&pagecache_lock);
+	spin_lock(&mapping->page_lock);
+	ret = radix_tree_gang_lookup(&mapping->page_tree, (void **)pages,
+				     start, nr_pages);
+	for (i = 0; i < ret; i++)
+		page_cache_get(pages[i]);
+	spin_unlock(&mapping->page_lock);
+	return ret;
 }
 
 /*
- * Read-ahead profiling information
- * --------------------------------
- * Every PROFILE_MAXREADCOUNT, the following information is written 
- * to the syslog:
- *   Percentage of asynchronous read-ahead.
- *   Average of read-ahead fields context value.
- * If DEBUG_READAHEAD is defined, a snapshot of these fields is written 
- * to the syslog.
- */
-
-#ifdef PROFILE_READAHEAD
-
-#define PROFILE_MAXREADCOUNT 1000
-
-static unsigned long total_reada;
-static unsigned long total_async;
-static unsigned long total_ramax;
-static unsigned long total_ralen;
-static unsigned long total_rawin;
-
-static void profile_readahead(int async, struct file *filp)
-{
-	unsigned long flags;
-
-	++total_reada;
-	if (async)
-		++total_async;
-
-	total_ramax	+= filp->f_ramax;
-	total_ralen	+= filp->f_ralen;
-	total_rawin	+= filp->f_rawin;
-
-	if (total_reada > PROFILE_MAXREADCOUNT) {
-		save_flags(flags);
-		cli();
-		if (!(total_reada > PROFILE_MAXREADCOUNT)) {
-			restore_flags(flags);
-			return;
-		}
-
-		printk("Readahead average:  max=%ld, len=%ld, win=%ld, async=%ld%%\n",
-			total_ramax/total_reada,
-			total_ralen/total_reada,
-			total_rawin/total_reada,
-			(total_async*100)/total_reada);
-#ifdef DEBUG_READAHEAD
-		printk("Readahead snapshot: max=%ld, len=%ld, win=%ld, raend=%Ld\n",
-			filp->f_ramax, filp->f_ralen, filp->f_rawin, filp->f_raend);
-#endif
-
-		total_reada	= 0;
-		total_async	= 0;
-		total_ramax	= 0;
-		total_ralen	= 0;
-		total_rawin	= 0;
-
-		restore_flags(flags);
-	}
-}
-#endif  /* defined PROFILE_READAHEAD */
-
-/*
- * Read-ahead context:
- * -------------------
- * The read ahead context fields of the "struct file" are the following:
- * - f_raend : position of the first byte after the last page we tried to
- *	       read ahead.
- * - f_ramax : current read-ahead maximum size.
- * - f_ralen : length of the current IO read block we tried to read-ahead.
- * - f_rawin : length of the current read-ahead window.
- *		if last read-ahead was synchronous then
- *			f_rawin = f_ralen
- *		otherwise (was asynchronous)
- *			f_rawin = previous value of f_ralen + f_ralen
+ * Read-ahead
+ * ----------
+ * A file can have several sequential readers at once: a program that
+ * merges two parts of it, or read() and the pages of a mapping. The
+ * f_ra state of the file keeps up to RA_STREAMS of them apart, each
+ * with its own pair of windows:
  *
- * Read-ahead limits:
- * ------------------
- * MIN_READAHEAD   : minimum read-ahead size when read-ahead.
- * MAX_READAHEAD   : maximum read-ahead size when read-ahead.
+ *  - start, size: the window the reader is in. Its pages have been
+ *    submitted for reading.
+ *  - ahead_start, ahead_size: the window after it. It is submitted
+ *    as soon as the reader enters the current one, so that the I/O
+ *    overlaps with the work of the reader.
  *
- * Synchronous read-ahead benefits:
- * --------------------------------
- * Using reasonable IO xfer length from peripheral devices increase system 
- * performances.
- * Reasonable means, in this context, not too large but not too small.
- * The actual maximum value is:
- *	MAX_READAHEAD + PAGE_CACHE_SIZE = 76k is CONFIG_READA_SMALL is undefined
- *      and 32K if defined (4K page size assumed).
+ * When the reader gets to the ahead window, that becomes the current
+ * one, the pages of the old one are moved to the inactive list, and
+ * a new ahead window twice as large is submitted, up to the
+ * max_readahead of the device.
  *
- * Asynchronous read-ahead benefits:
- * ---------------------------------
- * Overlapping next read request and user process execution increase system 
- * performance.
+ * If a page of the windows is missing when the reader gets to it, it
+ * was reclaimed before it was used: we read further ahead than the
+ * memory allows. The window is halved then, and the limit on its size
+ * only grows back one page per window.
  *
- * Read-ahead risks:
- * -----------------
- * We have to guess which further data are needed by the user process.
- * If these data are often not really needed, it's bad for system 
- * performances.
- * However, we know that files are often accessed sequentially by 
- * application programs and it seems that it is possible to have some good 
- * strategy in that guessing.
- * We only try to read-ahead files that seems to be read sequentially.
+ * A read that doesn't follow any of the streams replaces the least
+ * recently used one, and only reads what was asked for.
  *
- * Asynchronous read-ahead risks:
- * ------------------------------
- * In order to maximize overlapping, we must start some asynchronous read 
- * request from the device, as soon as possible.
- * We must be very careful about:
- * - The number of effective pending IO read requests.
- *   ONE seems to be the only reasonable value.
- * - The total memory pool usage for the file access stream.
- *   This maximum memory usage is implicitly 2 IO read chunks:
- *   2*(MAX_READAHEAD + PAGE_CACHE_SIZE) = 156K if CONFIG_READA_SMALL is undefined,
- *   64k if defined (4K page size assumed).
+ * The state is changed without any locks. Readers of the same file
+ * can confuse it, but only the amount of read-ahead suffers.
  */
+
 /* 获取最大预读的个数 */
 static inline int get_max_readahead(struct inode * inode)
 {
@@ -923,116 +951,207 @@ static inline int get_max_readahead(struct inode * inode)
 	return max_readahead[MAJOR(inode->i_dev)][MINOR(inode->i_dev)];
 }
 
-static void generic_file_readahead(int reada_ok,
-	struct file * filp, struct inode * inode,
-	struct page * page)
+/*
+ * Move the pages of a read-ahead window the reader has left to the
+ * inactive list. This is harmless, since we don't actually evict the
+ * pages from memory. Pages that are still mapped are left alone by
+ * deactivate_page().
+ */
+static void drop_behind(struct address_space * mapping, unsigned long start,
+	unsigned long size)
 {
-	unsigned long end_index = inode->i_size >> PAGE_CACHE_SHIFT;
-	unsigned long index = page->index;
-	unsigned long max_ahead, ahead;
-	unsigned long raend;
-	int max_readahead = get_max_readahead(inode);
+	struct page *page;
 
-	raend = filp->f_raend;
-	max_ahead = 0;
+	while (size--) {
+		page = __find_get_page(mapping, start++);
+		if (!page)
+			continue;
+		deactivate_page(page);	//将页面移动到inactive表中
+		page_cache_release(page);
+	}
+}
 
-/*
- * The current page is locked.
- * If the current position is inside the previous read IO request, do not
- * try to reread previously read ahead pages.
- * Otherwise decide or not to read ahead some pages synchronously.
- * If we are not going to read ahead, set the read ahead context for this 
- * page only.
- */
-	if (PageLocked(page)) {
-		if (!filp->f_ralen || index >= raend || index + filp->f_rawin < raend) {
-			raend = index;
-			if (raend < end_index)
-				max_ahead = filp->f_ramax;
-			filp->f_rawin = 0;
-			filp->f_ralen = 1;
-			if (!max_ahead) {
-				filp->f_raend  = index + filp->f_ralen;
-				filp->f_rawin += filp->f_ralen;
-			}
-		}
+static void ra_submit(struct file * filp, unsigned long start,
+	unsigned long size, unsigned long end_index)
+{
+	while (size-- && start < end_index) {
+		if (page_cache_read(filp, start++) < 0)
+			break;
 	}
-/*
- * The current page is not locked.
- * If we were reading ahead and,
- * if the current max read ahead size is not zero and,
- * if the current position is inside the last read-ahead IO request,
- *   it is the moment to try to read ahead asynchronously.
- * We will later force unplug device in order to force asynchronous read IO.
- */
-	else if (reada_ok && filp->f_ramax && raend >= 1 &&
-		 index <= raend && index + filp->f_ralen >= raend) {
-/*
- * Add ONE page to max_ahead in order to try to have about the same IO max size
- * as synchronous read-ahead (MAX_READAHEAD + 1)*PAGE_CACHE_SIZE.
- * Compute the position of the last page we have tried to read in order to 
- * begin to read ahead just at the next page.
- */
-		raend -= 1;
-		if (raend < end_index)
-			max_ahead = filp->f_ramax + 1;
-
-		if (max_ahead) {
-			filp->f_rawin = filp->f_ralen;
-			filp->f_ralen = 0;
-			reada_ok      = 2;
-		}
+}
+
+static inline unsigned long ra_end(struct file_ra_stream * s)
+{
+	if (s->ahead_size)
+		return s->ahead_start + s->ahead_size;
+	return s->start + s->size;
+}
+
+static struct file_ra_stream * ra_find_stream(struct file_ra_state * ra,
+	unsigned long index)
+{
+	struct file_ra_stream *s;
+
+	for (s = ra->streams; s < ra->streams + RA_STREAMS; s++) {
+		if (!s->size)
+			continue;
+		if (index == s->prev_page || index == s->prev_page + 1)
+			return s;
+		if (index >= s->start && index < ra_end(s))
+			return s;
 	}
-/*
- * Try to read ahead pages.
- * We hope that ll_rw_blk() plug/unplug, coalescence, requests sort and the
- * scheduler, will work enough for us to avoid too bad actuals IO requests.
- */
-	ahead = 0;
-	while (ahead < max_ahead) {
-		ahead ++;
-		if ((raend + ahead) >= end_index)
-			break;
-		if (page_cache_read(filp, raend + ahead) < 0)
-			break;
+	return NULL;
+}
+
+static struct file_ra_stream * ra_new_stream(struct file_ra_state * ra)
+{
+	struct file_ra_stream *s, *lru = ra->streams;
+
+	for (s = ra->streams; s < ra->streams + RA_STREAMS; s++) {
+		if (!s->size)
+			return s;
+		if (s->stamp < lru->stamp)
+			lru = s;
 	}
+	return lru;
+}
+
 /*
- * If we tried to read ahead some pages,
- * If we tried to read ahead asynchronously,
- *   Try to force unplug of the device in order to start an asynchronous
- *   read IO request.
- * Update the read-ahead context.
- * Store the length of the current read-ahead window.
- * Double the current max read ahead size.
- *   That heuristic avoid to do some large IO for files that are not really
- *   accessed sequentially.
+ * Called for every page a reader gets to, read() or a page fault.
+ * @nr is the number of pages it has asked for, from @index on, and
+ * @hit tells whether the page was in the page cache.
  */
-	if (ahead) {
-		if (reada_ok == 2) {
-			run_task_queue(&tq_disk);
-		}
+static void page_cache_readahead(struct file * filp, unsigned long index,
+	unsigned long nr, int hit)
+{
+	struct inode *inode = filp->f_dentry->d_inode;
+	struct file_ra_state *ra = &filp->f_ra;
+	struct file_ra_stream *s;
+	unsigned long end_index, max, size;
 
-		filp->f_ralen += ahead;
-		filp->f_rawin += filp->f_ralen;
-		filp->f_raend = raend + ahead + 1;
+	s = ra_find_stream(ra, index);
+	/* the rest of a page we have already seen */
+	if (s && index == s->prev_page)
+		return;
 
-		filp->f_ramax += filp->f_ramax;
+	if (hit)
+		ra->hits++;
+	else
+		ra->misses++;
 
-		if (filp->f_ramax > max_readahead)
-			filp->f_ramax = max_readahead;
+	end_index = (inode->i_size + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	max = get_max_readahead(inode);
+	if (ra->max_size && ra->max_size < max)
+		max = ra->max_size;
 
+	if (!s || index < s->start || index >= ra_end(s)) {
 		/*
-		 * Move the pages that have already been passed
-		 * to the inactive list.
+		 * A new reader, or a sequential one that went past its
+		 * windows: read what was asked for. A sequential reader
+		 * gets an ahead window below.
 		 */
-		drop_behind(filp, index);
+		int sequential = s != NULL;
+
+		if (!s)
+			s = ra_new_stream(ra);
+		size = nr < max ? nr : max;
+		if (!size)
+			size = 1;
+		s->start = index;
+		s->size = size;
+		s->ahead_size = 0;
+		ra_submit(filp, index, size, end_index);
+		if (!sequential)
+			goto out;
+	} else if (!hit) {
+		/* our own read-ahead was reclaimed before we got to it */
+		ra->thrashed++;
+		size = s->size >> 1;
+		if (!size)
+			size = 1;
+		ra->max_size = size;
+		s->start = index;
+		s->size = size;
+		s->ahead_size = 0;
+		ra_submit(filp, index, size, end_index);
+		goto out;
+	}
+
+	if (!max)
+		goto out;
 
-#ifdef PROFILE_READAHEAD
-		profile_readahead((reada_ok == 2), filp);
-#endif
+	if (s->ahead_size && index >= s->ahead_start) {
+		/* Move the pages the reader has passed to the inactive list */
+		drop_behind(inode->i_mapping, s->start, s->size);
+		s->start = s->ahead_start;
+		s->size = s->ahead_size;
+		s->ahead_size = 0;
+		if (ra->max_size && ++ra->max_size >= get_max_readahead(inode))
+			ra->max_size = 0;
 	}
 
-	return;
+	if (!s->ahead_size) {
+		size = s->size << 1;
+		if (size < MIN_READAHEAD)
+			size = MIN_READAHEAD;
+		if (size > max)
+			size = max;
+		s->ahead_start = s->start + s->size;
+		s->ahead_size = size;
+		if (s->ahead_start < end_index) {
+			ra_submit(filp, s->ahead_start, size, end_index);
+			/* start the I/O, the reader doesn't wait for it */
+			run_task_queue(&tq_disk);
+			ra->windows++;
+		}
+	}
+out:
+	s->prev_page = index;
+	s->stamp = ++ra->stamp;
+}
+
+/*
+ * /proc/rastat: the read-ahead statistics of the open files that have
+ * read anything through the page cache, see page_cache_readahead().
+ * The counters are read without any locks.
+ */
+int get_rastat(char *page)
+{
+	struct super_block *sb;
+	struct list_head *p;
+	int len;
+
+	len = sprintf(page, "%-8s %10s %10s %10s %10s %10s %7s\n",
+		      "dev", "ino", "hits", "misses", "thrashed", "windows",
+		      "streams");
+	lock_kernel();
+	for (sb = sb_entry(super_blocks.next);
+	     sb != sb_entry(&super_blocks) && len < PAGE_SIZE - 80;
+	     sb = sb_entry(sb->s_list.next)) {
+		file_list_lock();
+		for (p = sb->s_files.next;
+		     p != &sb->s_files && len < PAGE_SIZE - 80;
+		     p = p->next) {
+			struct file *file = list_entry(p, struct file, f_list);
+			struct inode *inode = file->f_dentry->d_inode;
+			struct file_ra_state *ra = &file->f_ra;
+			int i, streams = 0;
+
+			if (!ra->hits && !ra->misses)
+				continue;
+			for (i = 0; i < RA_STREAMS; i++)
+				if (ra->streams[i].size)
+					streams++;
+			len += sprintf(page + len,
+				"%-8s %10lu %10lu %10lu %10lu %10lu %7d\n",
+				kdevname(inode->i_dev), inode->i_ino,
+				ra->hits, ra->misses, ra->thrashed,
+				ra->windows, streams);
+		}
+		file_list_unlock();
+	}
+	unlock_kernel();
+	return len;
 }
 
 
@@ -1049,56 +1168,17 @@ void do_generic_file_read(struct file * filp, loff_t *ppos, read_descriptor_t *
 	struct inode *inode = filp->f_dentry->d_inode;
 	struct address_space *mapping = inode->i_mapping;
 	unsigned long index, offset;
+	unsigned long last_index;
 	struct page *cached_page;
-	int reada_ok;
 	int error;
-	int max_readahead = get_max_readahead(inode);
 
 	cached_page = NULL;
 	index = *ppos >> PAGE_CACHE_SHIFT;
 	offset = *ppos & ~PAGE_CACHE_MASK;
-
-/*
- * If the current position is outside the previous read-ahead window, 
- * we reset the current read-ahead context and set read ahead max to zero
- * (will be set to just needed value later),
- * otherwise, we assume that the file accesses are sequential enough to
- * continue read-ahead.
- */
-	if (index > filp->f_raend || index + filp->f_rawin < filp->f_raend) {
-		reada_ok = 0;
-		filp->f_raend = 0;
-		filp->f_ralen = 0;
-		filp->f_ramax = 0;
-		filp->f_rawin = 0;
-	} else {
-		reada_ok = 1;
-	}
-/*
- * Adjust the current value of read-ahead max.
- * If the read operation stay in the first half page, force no readahead.
- * Otherwise try to increase read ahead max just enough to do the read request.
- * Then, at least MIN_READAHEAD if read ahead is ok,
- * and at most MAX_READAHEAD in all cases.
- */
-	if (!index && offset + desc->count <= (PAGE_CACHE_SIZE >> 1)) {
-		filp->f_ramax = 0;
-	} else {
-		unsigned long needed;
-
-		needed = ((offset + desc->count) >> PAGE_CACHE_SHIFT) + 1;
-
-		if (filp->f_ramax < needed)
-			filp->f_ramax = needed;
-
-		if (reada_ok && filp->f_ramax < MIN_READAHEAD)
-				filp->f_ramax = MIN_READAHEAD;
-		if (filp->f_ramax > max_readahead)
-			filp->f_ramax = max_readahead;
-	}
+	last_index = (*ppos + desc->count + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
 
 	for (;;) {
-		struct page *page, **hash;
+		struct page *page;
 		unsigned long end_index, nr;
 
 		end_index = inode->i_size >> PAGE_CACHE_SHIFT;
@@ -1116,19 +1196,13 @@ void do_generic_file_read(struct file * filp, loff_t *ppos, read_descriptor_t *
 		/*
 		 * Try to find the data in the page cache..
 		 */
-		hash = page_hash(mapping, index);
-
-		spin_lock(&pagecache_lock);
-		page = __find_page_nolock(mapping, index, *hash);
+		page = find_get_page(mapping, index);
+		page_cache_readahead(filp, index, last_index - index, page != NULL);
 		if (!page)
 			goto no_cached_page;
-found_page:
-		page_cache_get(page);
-		spin_unlock(&pagecache_lock);
 
 		if (!Page_Uptodate(page))
 			goto page_not_up_to_date;
-		generic_file_readahead(reada_ok, filp, inode, page);
 page_ok:
 		/* If users can be writing to this page using arbitrary
 		 * virtual addresses, take care about potential aliasing
@@ -1158,11 +1232,10 @@ page_ok:
 		break;
 
 /*
- * Ok, the page was not immediately readable, so let's try to read ahead while we're at it..
+ * Ok, the page was not immediately readable, the read-ahead above has
+ * been started while we're at it..
  */
 page_not_up_to_date:
-		generic_file_readahead(reada_ok, filp, inode, page);
-
 		if (Page_Uptodate(page))
 			goto page_ok;
 
@@ -1190,8 +1263,6 @@ readpage:
 			if (Page_Uptodate(page))
 				goto page_ok;
 
-			/* Again, try some read-ahead while waiting for the page to finish.. */
-			generic_file_readahead(reada_ok, filp, inode, page);
 			wait_on_page(page);
 			if (Page_Uptodate(page))
 				goto page_ok;
@@ -1207,33 +1278,28 @@ no_cached_page:
 		/*
 		 * Ok, it wasn't cached, so we need to create a new
 		 * page..
-		 *
-		 * We get here with the page cache lock held.
 		 */
 		if (!cached_page) {
-			spin_unlock(&pagecache_lock);
 			cached_page = page_cache_alloc();
 			if (!cached_page) {
 				desc->error = -ENOMEM;
 				break;
 			}
-
-			/*
-			 * Somebody may have added the page while we
-			 * dropped the page cache lock. Check for that.
-			 */
-			spin_lock(&pagecache_lock);
-			page = __find_page_nolock(mapping, index, *hash);
-			if (page)
-				goto found_page;
 		}
 
 		/*
-		 * Ok, add the new page to the hash-queues...
+		 * Ok, add the new page to the page cache. Somebody
+		 * may have added the page while we slept, then we
+		 * go and look again.
 		 */
+		error = add_to_page_cache_unique(cached_page, mapping, index);
+		if (error) {
+			if (error == -EEXIST)
+				continue;
+			desc->error = error;
+			break;
+		}
 		page = cached_page;
-		__add_to_page_cache(page, mapping, index, hash);
-		spin_unlock(&pagecache_lock);
 		cached_page = NULL;
 
 		goto readpage;
@@ -1403,62 +1469,6 @@ out:
 	return retval;
 }
 
-/*
- * Read-ahead and flush behind for MADV_SEQUENTIAL areas.  Since we are
- * sure this is sequential access, we don't need a flexible read-ahead
- * window size -- we can always use a large fixed size window.
- */
-static void nopage_sequential_readahead(struct vm_area_struct * vma,
-	unsigned long pgoff, unsigned long filesize)
-{
-	unsigned long ra_window;
-
-	ra_window = get_max_readahead(vma->vm_file->f_dentry->d_inode);
-	ra_window = CLUSTER_OFFSET(ra_window + CLUSTER_PAGES - 1);
-
-	/* vm_raend is zero if we haven't read ahead in this area yet.  */
-	/* vm_raend 为0 表示该区域中没有预读 */
-	if (vma->vm_raend == 0)
-		vma->vm_raend = vma->vm_pgoff + ra_window;
-
-	/*
-	 * If we've just faulted the page half-way through our window,
-	 * then schedule reads for the next window, and release the
-	 * pages in the previous window.
-	 */
-	if ((pgoff + (ra_window >> 1)) == vma->vm_raend) {
-		unsigned long start = vma->vm_pgoff + vma->vm_raend;
-		unsigned long end = start + ra_window;
-
-		if (end > ((vma->vm_end >> PAGE_SHIFT) + vma->vm_pgoff))
-			end = (vma->vm_end >> PAGE_SHIFT) + vma->vm_pgoff;
-		if (start > end)
-			return;
-
-		while ((start < end) && (start < filesize)) {
-			if (read_cluster_nonblocking(vma->vm_file,
-							start, filesize) < 0)
-				break;
-			start += CLUSTER_PAGES;
-		}
-		run_task_queue(&tq_disk);
-
-		/* if we're far enough past the beginning of this area,
-		   recycle pages that are in the previous window. */
-		if (vma->vm_raend > (vma->vm_pgoff + ra_window + ra_window)) {
-			unsigned long window = ra_window << PAGE_SHIFT;
-
-			end = vma->vm_start + (vma->vm_raend << PAGE_SHIFT);
-			end -= window + window;
-			filemap_sync(vma, end - window, window, MS_INVALIDATE);
-		}
-
-		vma->vm_raend += ra_window;
-	}
-
-	return;
-}
-
 /*
  * filemap_nopage() is invoked via the vma operations vector for a
  * mapped memory region to read in file data during a page fault.
@@ -1477,7 +1487,7 @@ struct page * filemap_nopage(struct vm_area_struct * area,
 	struct file *file = area->vm_file;
 	struct inode *inode = file->f_dentry->d_inode;
 	struct address_space *mapping = inode->i_mapping;
-	struct page *page, **hash, *old_page;
+	struct page *page, *old_page;
 	unsigned long size, pgoff;
 
 	//获取地址所在的页号
@@ -1496,9 +1506,12 @@ retry_all:
 	/*
 	 * Do we have something in the page cache already?
 	 */
-	hash = page_hash(mapping, pgoff);
 retry_find:
-	page = __find_get_page(mapping, pgoff, hash);
+	page = find_get_page(mapping, pgoff);
+	/* Follow the sequential readers of the file, unless told not to */
+	if (!VM_RandomReadHint(area) && pgoff < size)
+		page_cache_readahead(file, pgoff,
+			VM_SequentialReadHint(area) ? ~0UL : 1, page != NULL);
 	if (!page)
 		goto no_cached_page;
 
@@ -1511,13 +1524,6 @@ retry_find:
 		goto page_not_uptodate;
 
 success:
- 	/*
-	 * Try read-ahead for sequential areas.
-	 */
-	/* 如果找到了，看看页面的策略，尝试预读 */
-	if (VM_SequentialReadHint(area))
-		nopage_sequential_readahead(area, pgoff, size);
-
 	/*
 	 * Found the page and have a reference on it, need to check sharing
 	 * and possibly copy it over to another page..
@@ -1533,6 +1539,7 @@ success:
 		if (new_page) {
 			copy_user_highpage(new_page, old_page, address);
 			flush_page_to_ram(new_page);
+			lru_cache_add_anon(new_page);
 		} else
 			new_page = NOPAGE_OOM;
 		page_cache_release(page);
@@ -1651,10 +1658,13 @@ static inline int filemap_sync_pte_range(pmd_t * pmd,
 {
 	pte_t * pte;
 	unsigned long end;
-	int error;
+	int error, shared;
 
 	if (pmd_none(*pmd))
 		return 0;
+	/* a huge page has no backing store to write back to */
+	if (pmd_huge(*pmd))
+		return 0;
 	if (pmd_bad(*pmd)) {
 		pmd_ERROR(*pmd);
 		pmd_clear(pmd);
@@ -1666,12 +1676,16 @@ static inline int filemap_sync_pte_range(pmd_t * pmd,
 	end = address + size;
 	if (end > PMD_SIZE)
 		end = PMD_SIZE;
+	shared = PagePtShared(virt_to_page(pte));
 	error = 0;
 	do {
 		error |= filemap_sync_pte(pte, vma, address + offset, flags);
 		address += PAGE_SIZE;
 		pte++;
 	} while (address && (address < end));
+	/* the other processes sharing the table may cache the dirty ptes */
+	if (shared)
+		flush_tlb_all();
 	return error;
 }
 
@@ -1788,11 +1802,15 @@ static int msync_interval(struct vm_area_struct * vma,
 		//遍历所有脏页面，写到磁盘，并等待执行结束
 		if (!error && (flags & MS_SYNC)) {
 			struct inode * inode = file->f_dentry->d_inode;
+			/* only the pages of the file this interval maps */
+			unsigned long first = ((start - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+			unsigned long last = first + ((end - start - 1) >> PAGE_SHIFT);
+
 			down(&inode->i_sem);
-			filemap_fdatasync(inode->i_mapping);
+			filemap_fdatasync_range(inode->i_mapping, first, last);
 			if (file->f_op && file->f_op->fsync)
 				error = file->f_op->fsync(file, file->f_dentry, 1);
-			filemap_fdatawait(inode->i_mapping);
+			filemap_fdatawait_range(inode->i_mapping, first, last);
 			up(&inode->i_sem);
 		}
 		return error;
@@ -2077,9 +2095,12 @@ static long madvise_dontneed(struct vm_area_struct * vma,
 	if (vma->vm_flags & VM_LOCKED)
 		return -EINVAL;
 
+	/* don't zap the ptes of the other users of a shared table */
+	if (unshare_page_range(vma->vm_mm, start, end))
+		return -ENOMEM;
+
 	flush_cache_range(vma->vm_mm, start, end);
 	zap_page_range(vma->vm_mm, start, end - start);
-	flush_tlb_range(vma->vm_mm, start, end);
 	return 0;
 }
 
@@ -2089,6 +2110,10 @@ static long madvise_vma(struct vm_area_struct * vma, unsigned long start,
 {
 	long error = -EBADF;
 
+	/* huge pages are neither read ahead nor zapped in part */
+	if (is_vm_hugetlb_page(vma))
+		return -EINVAL;
+
 	switch (behavior) {
 	case MADV_NORMAL:
 	case MADV_SEQUENTIAL:
@@ -2225,13 +2250,13 @@ static unsigned char mincore_page(struct vm_area_struct * vma,
 {
 	unsigned char present = 0;
 	struct address_space * as = &vma->vm_file->f_dentry->d_inode->i_data;
-	struct page * page, ** hash = page_hash(as, pgoff);
+	struct page * page;
 
-	spin_lock(&pagecache_lock);
-	page = __find_page_nolock(as, pgoff, *hash);
+	spin_lock(&as->page_lock);
+	page = radix_tree_lookup(&as->page_tree, pgoff);
 	if ((page) && (Page_Uptodate(page)))
 		present = 1;
-	spin_unlock(&pagecache_lock);
+	spin_unlock(&as->page_lock);
 
 	return present;
 }
@@ -2386,11 +2411,10 @@ struct page *__read_cache_page(struct address_space *mapping,
 				int (*filler)(void *,struct page*),
 				void *data)
 {
-	struct page **hash = page_hash(mapping, index);
 	struct page *page, *cached_page = NULL;
 	int err;
 repeat:
-	page = __find_get_page(mapping, index, hash);
+	page = find_get_page(mapping, index);
 	if (!page) {
 		if (!cached_page) {
 			cached_page = page_cache_alloc();
@@ -2398,8 +2422,13 @@ repeat:
 				return ERR_PTR(-ENOMEM);
 		}
 		page = cached_page;
-		if (add_to_page_cache_unique(page, mapping, index, hash))
+		err = add_to_page_cache_unique(page, mapping, index);
+		if (err == -EEXIST)
 			goto repeat;
+		if (err) {
+			page_cache_free(cached_page);
+			return ERR_PTR(err);
+		}
 		cached_page = NULL;
 		err = filler(data, page);
 		if (err < 0) {
@@ -2454,10 +2483,11 @@ retry:
 static inline struct page * __grab_cache_page(struct address_space *mapping,
 				unsigned long index, struct page **cached_page)
 {
-	struct page *page, **hash = page_hash(mapping, index);
+	struct page *page;
+	int err;
 repeat:
 	//查找缓存页面
-	page = __find_lock_page(mapping, index, hash);
+	page = find_lock_page(mapping, index);
 	if (!page) {
 		if (!*cached_page) {
 			*cached_page = page_cache_alloc();
@@ -2465,8 +2495,11 @@ repeat:
 				return NULL;
 		}
 		page = *cached_page;
-		if (add_to_page_cache_unique(page, mapping, index, hash))
+		err = add_to_page_cache_unique(page, mapping, index);
+		if (err == -EEXIST)
 			goto repeat;
+		if (err)
+			return NULL;
 		*cached_page = NULL;
 	}
 	return page;
@@ -2669,29 +2702,4 @@ fail_write:
 	goto unlock;
 }
 
-void __init page_cache_init(unsigned long mempages)
-{
-	unsigned long htable_size, order;
-
-	htable_size = mempages;
-	htable_size *= sizeof(struct page *);
-	for (order = 0; (PAGE_SIZE << order) < htable_size; order++)
-		;
-
-	do {
-		unsigned long tmp = (PAGE_SIZE << order) / sizeof(struct page *);
-
-		page_hash_bits = 0;
-		while((tmp >>= 1UL) != 0UL)
-			page_hash_bits++;
-
-		page_hash_table = (struct page **)
-			__get_free_pages(GFP_ATOMIC, order);
-	} while(page_hash_table == NULL && --order > 0);
 
-	printk("Page-cache hash table entries: %d (order: %ld, %ld bytes)\n",
-	       (1 << page_hash_bits), order, (PAGE_SIZE << order));
-	if (!page_hash_table)
-		panic("Failed to allocate page hash table\n");
-	memset((void *)page_hash_table, 0, PAGE_HASH_SIZE * sizeof(struct page *));
-}
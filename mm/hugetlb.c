@@ -0,0 +1,380 @@
+/*
+ *  linux/mm/hugetlb.c
+ *
+ *  Huge pages for shared memory and anonymous mappings.
+ *
+ *  A pool of huge pages is set aside at boot ("hugepages=N") or later
+ *  through /proc/sys/vm/nr_hugepages. The pages of the pool are taken
+ *  out of the buddy allocator whole and marked reserved; they are never
+ *  on the LRU lists, so the reclaim code doesn't see them.
+ *
+ *  A file backed by huge pages (hugetlb_file_setup() in mm/shmem.c)
+ *  reserves all the pages it can need when it is created, so that a
+ *  page fault on it can't fail. The pages are taken from the pool on
+ *  the first fault, kept in the huge_tree of the shmem inode, and
+ *  mapped by a single pmd entry in every process that maps them. They
+ *  go back to the pool when the inode is deleted.
+ *
+ *  A huge page mapping can't be split: munmap() must be huge page
+ *  aligned, and mprotect() and mremap() refuse it.
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/init.h>
+#include <linux/highmem.h>
+#include <linux/sysctl.h>
+#include <linux/hugetlb.h>
+#include <linux/ptshare.h>
+
+#include <asm/pgalloc.h>
+
+#define HPAGE_NR	(1UL << HUGETLB_PAGE_ORDER)
+
+int nr_huge_pages;
+
+/* all protected by hugetlb_lock */
+static LIST_HEAD(huge_page_freelist);
+static unsigned long total_huge_pages;	/* in the pool */
+static unsigned long free_huge_pages;	/* not used by any file */
+static unsigned long resv_huge_pages;	/* free, but promised to a file */
+static spinlock_t hugetlb_lock = SPIN_LOCK_UNLOCKED;
+
+struct inode_operations hugetlb_inode_operations;
+
+static struct page * alloc_fresh_huge_page(void)
+{
+	struct page *page;
+	int i;
+
+	page = alloc_pages(GFP_USER | __GFP_HIGHMEM, HUGETLB_PAGE_ORDER);
+	if (!page)
+		return NULL;
+
+	/* The buddy allocator aligns to the start of the zone only */
+	if ((page - mem_map) & (HPAGE_NR - 1)) {
+		__free_pages(page, HUGETLB_PAGE_ORDER);
+		return NULL;
+	}
+
+	/*
+	 * Every page gets a count and PG_reserved, so that a reference
+	 * taken on a part of the huge page (map_user_kiobuf()) never
+	 * frees it.
+	 */
+	for (i = 0; i < HPAGE_NR; i++) {
+		SetPageReserved(page + i);
+		set_page_count(page + i, 1);
+	}
+	return page;
+}
+
+static void free_huge_page_to_buddy(struct page *page)
+{
+	int i;
+
+	for (i = 0; i < HPAGE_NR; i++) {
+		ClearPageReserved(page + i);
+		set_page_count(page + i, 0);
+	}
+	set_page_count(page, 1);
+	__free_pages(page, HUGETLB_PAGE_ORDER);
+}
+
+/*
+ * Grow or shrink the pool towards @count pages. Pages in use or
+ * reserved by a file are not given back. Returns the new size.
+ */
+static unsigned long set_max_huge_pages(unsigned long count)
+{
+	struct page *page;
+
+	while (count > total_huge_pages) {
+		page = alloc_fresh_huge_page();
+		if (!page)
+			break;
+		spin_lock(&hugetlb_lock);
+		list_add(&page->list, &huge_page_freelist);
+		free_huge_pages++;
+		total_huge_pages++;
+		spin_unlock(&hugetlb_lock);
+	}
+
+	spin_lock(&hugetlb_lock);
+	while (count < total_huge_pages && free_huge_pages > resv_huge_pages) {
+		page = list_entry(huge_page_freelist.next, struct page, list);
+		list_del(&page->list);
+		free_huge_pages--;
+		total_huge_pages--;
+		spin_unlock(&hugetlb_lock);
+		free_huge_page_to_buddy(page);
+		spin_lock(&hugetlb_lock);
+	}
+	count = total_huge_pages;
+	spin_unlock(&hugetlb_lock);
+	return count;
+}
+
+/*
+ * Reserve @nr pages of the pool for a new file. Fails with -ENOMEM
+ * if there aren't that many free pages left.
+ */
+int hugetlb_reserve(unsigned long nr)
+{
+	int error = -ENOMEM;
+
+	spin_lock(&hugetlb_lock);
+	if (free_huge_pages - resv_huge_pages >= nr) {
+		resv_huge_pages += nr;
+		error = 0;
+	}
+	spin_unlock(&hugetlb_lock);
+	return error;
+}
+
+void hugetlb_unreserve(unsigned long nr)
+{
+	spin_lock(&hugetlb_lock);
+	resv_huge_pages -= nr;
+	spin_unlock(&hugetlb_lock);
+}
+
+/* Take a page from the pool against a reservation */
+static struct page * alloc_huge_page(void)
+{
+	struct page *page;
+
+	spin_lock(&hugetlb_lock);
+	if (!resv_huge_pages || list_empty(&huge_page_freelist))
+		BUG();
+	page = list_entry(huge_page_freelist.next, struct page, list);
+	list_del(&page->list);
+	free_huge_pages--;
+	resv_huge_pages--;
+	spin_unlock(&hugetlb_lock);
+	return page;
+}
+
+/* Give a page back to the pool, and its reservation if @resv */
+static void free_huge_page(struct page *page, int resv)
+{
+	spin_lock(&hugetlb_lock);
+	list_add(&page->list, &huge_page_freelist);
+	free_huge_pages++;
+	if (resv)
+		resv_huge_pages++;
+	spin_unlock(&hugetlb_lock);
+}
+
+/*
+ * Find the page at huge page index @idx of a file, allocating and
+ * clearing it on first use. The huge_tree of the inode is protected
+ * by i_sem.
+ */
+static struct page * hugetlb_get_page(struct inode *inode, unsigned long idx)
+{
+	struct shmem_inode_info *info = &inode->u.shmem_i;
+	struct page *page;
+	int i;
+
+	down(&inode->i_sem);
+	page = radix_tree_lookup(&info->huge_tree, idx);
+	if (page)
+		goto out;
+
+	page = NOPAGE_SIGBUS;
+	if (idx >= (inode->i_size + HPAGE_SIZE - 1) >> HPAGE_SHIFT)
+		goto out;
+
+	if (!info->huge_reserved)
+		BUG();
+	page = alloc_huge_page();
+	info->huge_reserved--;
+	for (i = 0; i < HPAGE_NR; i++)
+		clear_highpage(page + i);
+
+	if (radix_tree_preload(GFP_KERNEL)) {
+		free_huge_page(page, 1);
+		info->huge_reserved++;
+		page = NOPAGE_OOM;
+		goto out;
+	}
+	page->index = idx;
+	if (radix_tree_insert(&info->huge_tree, idx, page))
+		BUG();
+out:
+	up(&inode->i_sem);
+	return page;
+}
+
+/*
+ * Called from shmem_delete_inode(): give all pages of the file and
+ * the reservations it didn't use back to the pool.
+ */
+void hugetlb_truncate(struct inode *inode)
+{
+	struct shmem_inode_info *info = &inode->u.shmem_i;
+	struct page *pages[16];
+	unsigned int i, nr;
+
+	while ((nr = radix_tree_gang_lookup(&info->huge_tree,
+					    (void **) pages, 0, 16)) != 0) {
+		for (i = 0; i < nr; i++) {
+			radix_tree_delete(&info->huge_tree, pages[i]->index);
+			free_huge_page(pages[i], 0);
+		}
+	}
+	hugetlb_unreserve(info->huge_reserved);
+	info->huge_reserved = 0;
+}
+
+/*
+ * Called from handle_mm_fault() for a VM_HUGETLB area, with the
+ * mmap_sem held. The whole huge page is mapped at once.
+ */
+int hugetlb_fault(struct mm_struct *mm, struct vm_area_struct *vma,
+	unsigned long address, int write_access)
+{
+	struct inode *inode = vma->vm_file->f_dentry->d_inode;
+	unsigned long idx;
+	struct page *page;
+	pte_t *stale = NULL;
+	pgd_t *pgd;
+	pmd_t *pmd;
+
+	/* the area may have been split by mlock() or madvise() */
+	address &= HPAGE_MASK;
+	idx = (address - vma->vm_start + (vma->vm_pgoff << PAGE_SHIFT)) >>
+		HPAGE_SHIFT;
+	page = hugetlb_get_page(inode, idx);
+	if (page == NOPAGE_SIGBUS)
+		return 0;
+	if (page == NOPAGE_OOM)
+		return -1;
+
+	pgd = pgd_offset(mm, address);
+	pmd = pmd_alloc(pgd, address);
+	if (!pmd)
+		return -1;
+
+	spin_lock(&mm->page_table_lock);
+	/*
+	 * Page tables are not freed by munmap(): a small page mapping
+	 * that was here before may have left one. The huge page area
+	 * covers all of it, so it has no ptes of ours any more.
+	 */
+	if (!pmd_none(*pmd) && !pmd_huge(*pmd)) {
+		stale = pte_offset(pmd, 0);
+		pmd_clear(pmd);
+		flush_tlb_range(mm, address, address + HPAGE_SIZE);
+	}
+	if (pmd_none(*pmd)) {
+		set_pmd(pmd, mk_huge_pmd(page, vma->vm_page_prot));
+		mm->rss += HPAGE_NR;
+	}
+	spin_unlock(&mm->page_table_lock);
+	if (stale)
+		pte_table_free(stale);
+	return 1;
+}
+
+struct page * follow_huge_pmd(pmd_t *pmd, unsigned long address)
+{
+	return huge_pmd_page(*pmd) + ((address & ~HPAGE_MASK) >> PAGE_SHIFT);
+}
+
+/*
+ * Find room for a huge page mapping of @len bytes, which is already
+ * huge page aligned. Returns the address, or an error.
+ */
+unsigned long hugetlb_get_unmapped_area(unsigned long addr,
+	unsigned long len, unsigned long pgoff, unsigned long flags)
+{
+	struct vm_area_struct *vmm;
+
+	if (pgoff & (HPAGE_NR - 1))
+		return -EINVAL;
+	if (len > TASK_SIZE)
+		return -ENOMEM;
+
+	if (flags & MAP_FIXED) {
+		if ((addr & ~HPAGE_MASK) || addr > TASK_SIZE - len)
+			return -EINVAL;
+		return addr;
+	}
+
+	if (!addr)
+		addr = TASK_UNMAPPED_BASE;
+	addr = HPAGE_ALIGN(addr);
+
+	for (vmm = find_vma(current->mm, addr); ; vmm = vmm->vm_next) {
+		/* At this point:  (!vmm || addr < vmm->vm_end). */
+		if (TASK_SIZE - len < addr)
+			return -ENOMEM;
+		if (!vmm || addr + len <= vmm->vm_start)
+			return addr;
+		addr = HPAGE_ALIGN(vmm->vm_end);
+	}
+}
+
+/*
+ * do_munmap() can't unmap part of a huge page: check that the range
+ * is huge page aligned if it touches a huge page area.
+ */
+int hugetlb_check_unmap(struct vm_area_struct *vma, unsigned long addr,
+	unsigned long len)
+{
+	for ( ; vma && vma->vm_start < addr + len; vma = vma->vm_next)
+		if (is_vm_hugetlb_page(vma) && ((addr | len) & ~HPAGE_MASK))
+			return -EINVAL;
+	return 0;
+}
+
+int hugetlb_report_meminfo(char *buf)
+{
+	return sprintf(buf,
+			"HugePages_Total: %5lu\n"
+			"HugePages_Free:  %5lu\n"
+			"HugePages_Rsvd:  %5lu\n"
+			"Hugepagesize:    %5lu kB\n",
+			total_huge_pages, free_huge_pages, resv_huge_pages,
+			HPAGE_SIZE >> 10);
+}
+
+/* /proc/sys/vm/nr_hugepages */
+int hugetlb_sysctl_handler(ctl_table *table, int write, struct file *file,
+	void *buffer, size_t *length)
+{
+	int error;
+
+	error = proc_dointvec(table, write, file, buffer, length);
+	if (error || !write)
+		return error;
+	if (nr_huge_pages < 0 || !huge_page_supported())
+		nr_huge_pages = 0;
+	nr_huge_pages = set_max_huge_pages(nr_huge_pages);
+	return 0;
+}
+
+static int __init hugetlb_setup(char *str)
+{
+	nr_huge_pages = simple_strtoul(str, &str, 0);
+	return 1;
+}
+
+__setup("hugepages=", hugetlb_setup);
+
+static int __init hugetlb_init(void)
+{
+	if (!huge_page_supported()) {
+		nr_huge_pages = 0;
+		return 0;
+	}
+	if (nr_huge_pages > 0)
+		nr_huge_pages = set_max_huge_pages(nr_huge_pages);
+	printk(KERN_INFO "Huge pages: %d of %lu kB\n",
+	       nr_huge_pages, HPAGE_SIZE >> 10);
+	return 0;
+}
+
+module_init(hugetlb_init)
@@ -44,8 +44,11 @@
 #include <linux/iobuf.h>
 #include <asm/uaccess.h>
 #include <asm/pgalloc.h>
+#include <asm/tlb.h>
 #include <linux/highmem.h>
 #include <linux/pagemap.h>
+#include <linux/hugetlb.h>
+#include <linux/ptshare.h>
 
 
 unsigned long max_mapnr;
@@ -53,6 +56,9 @@ unsigned long num_physpages;
 void * high_memory;
 struct page *highmem_start_page;
 
+mmu_gather_t mmu_gathers[NR_CPUS];
+struct tlb_stat tlb_stat[NR_CPUS];
+
 /*
  * We special-case the C-O-W ZERO_PAGE, because it's such
  * a common occurrence (no need to read the page to know
@@ -87,7 +93,7 @@ static inline void free_one_pmd(pmd_t * dir)
 	}
 	pte = pte_offset(dir, 0);
 	pmd_clear(dir);
-	pte_free(pte);
+	pte_table_free(pte);
 }
 
 //释放pgd 及其下属的页面映射
@@ -161,6 +167,12 @@ int copy_page_range(struct mm_struct *dst, struct mm_struct *src,
 	unsigned long address = vma->vm_start;
 	unsigned long end = vma->vm_end;
 	unsigned long cow = (vma->vm_flags & (VM_SHARED | VM_MAYWRITE)) == VM_MAYWRITE;
+	struct pte_chain *pte_chain = NULL;
+	int ret = 0;
+
+	/* The child faults the huge pages in from the file when it needs them */
+	if (is_vm_hugetlb_page(vma))
+		return 0;
 
 	//此处减了1，后边处理的时候首先递增一次
 	src_pgd = pgd_offset(src, address)-1;
@@ -208,6 +220,8 @@ skip_copy_pte_range:		address = (address + PMD_SIZE) & PMD_MASK;
 				goto cont_copy_pmd_range;
 			}
 			if (pmd_none(*dst_pmd)) {
+				if (pte_share_fork(src, vma, src_pmd, dst_pmd, address))
+					goto skip_copy_pte_range;
 				if (!pte_alloc(dst_pmd, 0))
 					goto nomem;
 			}
@@ -216,11 +230,16 @@ skip_copy_pte_range:		address = (address + PMD_SIZE) & PMD_MASK;
 			dst_pte = pte_offset(dst_pmd, address);
 			
 			do {
-				pte_t pte = *src_pte;
+				pte_t pte;
 				struct page *ptepage;
 				
 				/* copy_one_pte */
 
+				/* before the pte is read: this may sleep */
+				if (!pte_chain && pte_chain_alloc(&pte_chain, 1, GFP_KERNEL))
+					goto nomem;
+				pte = *src_pte;
+
 				if (pte_none(pte))
 					goto cont_copy_pte_range_noset;
 				if (!pte_present(pte)) {
@@ -243,6 +262,9 @@ skip_copy_pte_range:		address = (address + PMD_SIZE) & PMD_MASK;
 					pte = pte_mkclean(pte);
 				pte = pte_mkold(pte);
 				get_page(ptepage);
+				set_pte(dst_pte, pte);
+				page_add_rmap(ptepage, dst_pte, dst, address, &pte_chain);
+				goto cont_copy_pte_range_noset;
 
 cont_copy_pte_range:		set_pte(dst_pte, pte);
 cont_copy_pte_range_noset:	address += PAGE_SIZE;
@@ -257,22 +279,25 @@ cont_copy_pmd_range:	src_pmd++;
 		} while ((unsigned long)src_pmd & PMD_TABLE_MASK);
 	}
 out:
-	return 0;
+	pte_chain_free(pte_chain);
+	return ret;
 
 nomem:
-	return -ENOMEM;
+	ret = -ENOMEM;
+	goto out;
 }
 
 /*
  * Return indicates whether a page was freed so caller can adjust rss
  */
-static inline int free_pte(pte_t pte)
+static inline int free_pte(pte_t pte, pte_t *ptep)
 {
 	//真正的页面
 	if (pte_present(pte)) {
 		struct page *page = pte_page(pte);
 		if ((!VALID_PAGE(page)) || PageReserved(page))
 			return 0;
+		page_remove_rmap(page, ptep);
 		/* 
 		 * free_page() used to be able to clear swap cache
 		 * entries.  We may now have to do it manually.  
@@ -287,21 +312,46 @@ static inline int free_pte(pte_t pte)
 	return 0;
 }
 
-static inline void forget_pte(pte_t page)
+static inline void forget_pte(pte_t page, pte_t *ptep)
 {
 	if (!pte_none(page)) {
 		printk("forget_pte: old mapping existed!\n");
-		free_pte(page);
+		free_pte(page, ptep);
 	}
 }
 
-static inline int zap_pte_range(struct mm_struct *mm, pmd_t * pmd, unsigned long address, unsigned long size)
+/*
+ * Like free_pte(), but the page is only freed once the TLBs have been
+ * flushed, see <asm-generic/tlb.h>.
+ */
+static inline int zap_pte(mmu_gather_t *tlb, pte_t pte, pte_t *ptep)
 {
-	pte_t * pte;
-	int freed;
+	if (pte_present(pte)) {
+		struct page *page = pte_page(pte);
+		if ((!VALID_PAGE(page)) || PageReserved(page))
+			return 0;
+		page_remove_rmap(page, ptep);
+		if (pte_dirty(pte) && page->mapping)
+			set_page_dirty(page);
+		tlb_remove_page(tlb, page);
+		return 1;
+	}
+	swap_free(pte_to_swp_entry(pte));
+	return 0;
+}
+
+static inline int zap_pte_range(mmu_gather_t *tlb, pmd_t * pmd, unsigned long address, unsigned long size)
+{
+	pte_t * pte, * table;
+	int freed, shared;
 
 	if (pmd_none(*pmd))
 		return 0;
+	if (pmd_huge(*pmd)) {
+		/* the page itself stays with its hugetlb file */
+		pmd_clear(pmd);
+		return PMD_SIZE >> PAGE_SHIFT;
+	}
 	if (pmd_bad(*pmd)) {
 		pmd_ERROR(*pmd);
 		pmd_clear(pmd);
@@ -311,6 +361,15 @@ static inline int zap_pte_range(struct mm_struct *mm, pmd_t * pmd, unsigned long
 	address &= ~PMD_MASK;
 	if (address + size > PMD_SIZE)
 		size = PMD_SIZE - address;
+	table = pte;
+	shared = pte_table_lock(table);
+	if (shared && size == PMD_SIZE && page_count(virt_to_page(table)) > 1) {
+		/* the others still use the table: just let go of it */
+		pmd_clear(pmd);
+		atomic_dec(&virt_to_page(table)->count);
+		pte_table_unlock(table, shared);
+		return 0;
+	}
 	size >>= PAGE_SHIFT;
 	freed = 0;
 	for (;;) {
@@ -318,16 +377,16 @@ static inline int zap_pte_range(struct mm_struct *mm, pmd_t * pmd, unsigned long
 		if (!size)
 			break;
 		page = ptep_get_and_clear(pte);		//清空页表项
+		if (!pte_none(page))
+			freed += zap_pte(tlb, page, pte);	//释放页面
 		pte++;
 		size--;
-		if (pte_none(page))
-			continue;
-		freed += free_pte(page);		//释放页面
 	}
+	pte_table_unlock(table, shared);
 	return freed;
 }
 
-static inline int zap_pmd_range(struct mm_struct *mm, pgd_t * dir, unsigned long address, unsigned long size)
+static inline int zap_pmd_range(mmu_gather_t *tlb, pgd_t * dir, unsigned long address, unsigned long size)
 {
 	pmd_t * pmd;
 	unsigned long end;
@@ -347,13 +406,32 @@ static inline int zap_pmd_range(struct mm_struct *mm, pgd_t * dir, unsigned long
 		end = PGDIR_SIZE;
 	freed = 0;
 	do {
-		freed += zap_pte_range(mm, pmd, address, end - address);
+		freed += zap_pte_range(tlb, pmd, address, end - address);
 		address = (address + PMD_SIZE) & PMD_MASK; 
 		pmd++;
 	} while (address < end);
 	return freed;
 }
 
+/*
+ * Clear the ptes of a range into @tlb, with the page_table_lock held.
+ * Returns the number of pages unmapped.
+ */
+int unmap_page_range(mmu_gather_t *tlb, struct mm_struct *mm, unsigned long address, unsigned long size)
+{
+	pgd_t * dir;
+	unsigned long end = address + size;
+	int freed = 0;
+
+	dir = pgd_offset(mm, address);
+	do {
+		freed += zap_pmd_range(tlb, dir, address, end - address);
+		address = (address + PGDIR_SIZE) & PGDIR_MASK;
+		dir++;
+	} while (address && (address < end));
+	return freed;
+}
+
 /*
  * remove user pages in a given range.
  */
@@ -362,11 +440,9 @@ static inline int zap_pmd_range(struct mm_struct *mm, pgd_t * dir, unsigned long
  */
 void zap_page_range(struct mm_struct *mm, unsigned long address, unsigned long size)
 {
-	pgd_t * dir;
+	mmu_gather_t *tlb;
 	unsigned long end = address + size;
-	int freed = 0;
-
-	dir = pgd_offset(mm, address);
+	int freed;
 
 	/*
 	 * This is a long-lived spinlock. That's fine.
@@ -378,11 +454,10 @@ void zap_page_range(struct mm_struct *mm, unsigned long address, unsigned long s
 	if (address >= end)
 		BUG();
 	spin_lock(&mm->page_table_lock);
-	do {
-		freed += zap_pmd_range(mm, dir, address, end - address);
-		address = (address + PGDIR_SIZE) & PGDIR_MASK;
-		dir++;
-	} while (address && (address < end));
+	tlb = tlb_gather_mmu(mm, address, end);
+	freed = unmap_page_range(tlb, mm, address, size);
+	/* flushes the TLBs for the range, then frees the pages */
+	tlb_finish_mmu(tlb);
 	spin_unlock(&mm->page_table_lock);
 	/*
 	 * Update rss for the mm_struct (not necessarily current->mm)
@@ -394,6 +469,26 @@ void zap_page_range(struct mm_struct *mm, unsigned long address, unsigned long s
 		mm->rss = 0;
 }
 
+/*
+ * /proc/tlbstat: how many flush IPIs each CPU sent, against how many
+ * batches it flushed and pages it unmapped. Read without any locks.
+ */
+int get_tlb_stats(char *page)
+{
+	int i, len;
+
+	len = sprintf(page, "%-4s %10s %10s %10s\n",
+		      "cpu", "ipis", "flushes", "pages");
+	for (i = 0; i < smp_num_cpus; i++) {
+		struct tlb_stat *stat = &tlb_stat[cpu_logical_map(i)];
+
+		len += sprintf(page + len, "%-4d %10lu %10lu %10lu\n",
+			       cpu_logical_map(i), stat->ipis,
+			       stat->flushes, stat->pages);
+	}
+	return len;
+}
+
 
 /*
  * Do a quick page-table lookup for a single page. 
@@ -409,7 +504,11 @@ static struct page * follow_page(unsigned long address)
 	pgd = pgd_offset(current->mm, address);
 	pmd = pmd_offset(pgd, address);
 	if (pmd) {
-		pte_t * pte = pte_offset(pmd, address);
+		pte_t * pte;
+
+		if (pmd_huge(*pmd))
+			return follow_huge_pmd(pmd, address);
+		pte = pte_offset(pmd, address);
 		if (pte && pte_present(*pte))
 			return pte_page(*pte);
 	}
@@ -666,7 +765,7 @@ static inline void zeromap_pte_range(pte_t * pte, unsigned long address,
 		pte_t zero_pte = pte_wrprotect(mk_pte(ZERO_PAGE(address), prot));
 		pte_t oldpage = ptep_get_and_clear(pte);
 		set_pte(pte, zero_pte);		//设置页表项为zero_pte
-		forget_pte(oldpage);		//释放old_page
+		forget_pte(oldpage, pte);	//释放old_page
 		address += PAGE_SIZE;
 		pte++;
 	} while (address && (address < end));
@@ -741,7 +840,7 @@ static inline void remap_pte_range(pte_t * pte, unsigned long address, unsigned
 		if ((!VALID_PAGE(page)) || PageReserved(page))
 			//通过物理地址生成页表项放到页表中
  			set_pte(pte, mk_pte_phys(phys_addr, prot));
-		forget_pte(oldpage);
+		forget_pte(oldpage, pte);
 		address += PAGE_SIZE;
 		phys_addr += PAGE_SIZE;
 		pte++;
@@ -812,12 +911,15 @@ static inline void establish_pte(struct vm_area_struct * vma, unsigned long addr
 
 //cow: copy on write
 static inline void break_cow(struct vm_area_struct * vma, struct page *	old_page, struct page * new_page, unsigned long address, 
-		pte_t *page_table)
+		pte_t *page_table, struct pte_chain **pte_chain)
 {
 	copy_cow_page(old_page,new_page,address);
 	flush_page_to_ram(new_page);
 	flush_cache_page(vma, address);
+	page_remove_rmap(old_page, page_table);
 	establish_pte(vma, address, page_table, pte_mkwrite(pte_mkdirty(mk_pte(new_page, vma->vm_page_prot))));
+	lru_cache_add_anon(new_page);
+	page_add_rmap(new_page, page_table, vma->vm_mm, address, pte_chain);
 }
 
 /*
@@ -844,6 +946,7 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct * vma,
 	unsigned long address, pte_t *page_table, pte_t pte)
 {
 	struct page *old_page, *new_page;
+	struct pte_chain *pte_chain = NULL;
 
 	old_page = pte_page(pte);
 	if (!VALID_PAGE(old_page))
@@ -887,6 +990,10 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct * vma,
 	new_page = page_cache_alloc();
 	if (!new_page)
 		return -1;
+	if (pte_chain_alloc(&pte_chain, 1, GFP_KERNEL)) {
+		page_cache_release(new_page);
+		return -1;
+	}
 	spin_lock(&mm->page_table_lock);
 
 	/*
@@ -895,12 +1002,13 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct * vma,
 	if (pte_same(*page_table, pte)) {
 		if (PageReserved(old_page))
 			++mm->rss;
-		break_cow(vma, old_page, new_page, address, page_table);
+		break_cow(vma, old_page, new_page, address, page_table, &pte_chain);
 
 		/* Free the old page.. */
 		new_page = old_page;
 	}
 	spin_unlock(&mm->page_table_lock);
+	pte_chain_free(pte_chain);
 	page_cache_release(new_page);
 	return 1;	/* Minor fault */
 
@@ -925,7 +1033,6 @@ static void vmtruncate_list(struct vm_area_struct *mpnt,
 		if (mpnt->vm_pgoff >= pgoff) {
 			flush_cache_range(mm, start, end);	//i386中为空
 			zap_page_range(mm, start, len);
-			flush_tlb_range(mm, start, end);
 			continue;
 		}
 
@@ -942,7 +1049,6 @@ static void vmtruncate_list(struct vm_area_struct *mpnt,
 		len = (len - diff) << PAGE_SHIFT;
 		flush_cache_range(mm, start, end);
 		zap_page_range(mm, start, len);
-		flush_tlb_range(mm, start, end);
 	} while ((mpnt = mpnt->vm_next_share) != NULL);
 }
 			      
@@ -1053,16 +1159,22 @@ static int do_swap_page(struct mm_struct * mm,
 	struct vm_area_struct * vma, unsigned long address,
 	pte_t * page_table, swp_entry_t entry, int write_access)
 {
-	struct page *page = lookup_swap_cache(entry);	//从swap_address中寻找对应的page
+	struct page *page;
+	struct pte_chain *pte_chain = NULL;
 	pte_t pte;
 
+	if (pte_chain_alloc(&pte_chain, 1, GFP_KERNEL))
+		return -1;
+	page = lookup_swap_cache(entry);	//从swap_address中寻找对应的page
 	if (!page) {	//swap_address 中没找到
 		lock_kernel();
 		swapin_readahead(entry);	//将磁盘中内容读取到内存中，并添加到相应链表
 		page = read_swap_cache(entry);
 		unlock_kernel();
-		if (!page)
+		if (!page) {
+			pte_chain_free(pte_chain);
 			return -1;
+		}
 
 		flush_page_to_ram(page);	//i386中为空
 		flush_icache_page(vma, page);	//i386中为空
@@ -1086,6 +1198,8 @@ static int do_swap_page(struct mm_struct * mm,
 
 	//设置页表项
 	set_pte(page_table, pte);
+	page_add_rmap(page, page_table, mm, address, &pte_chain);
+	pte_chain_free(pte_chain);
 	/* No need to invalidate - it was non-present before */
 	update_mmu_cache(vma, address, pte);	//i386中为空
 	return 1;	/* Minor fault */
@@ -1097,18 +1211,26 @@ static int do_swap_page(struct mm_struct * mm,
 static int do_anonymous_page(struct mm_struct * mm, struct vm_area_struct * vma, pte_t *page_table, int write_access, unsigned long addr)
 {
 	struct page *page = NULL;
+	struct pte_chain *pte_chain = NULL;
 	pte_t entry = pte_wrprotect(mk_pte(ZERO_PAGE(addr), vma->vm_page_prot));
 	if (write_access) {
+		if (pte_chain_alloc(&pte_chain, 1, GFP_KERNEL))
+			return -1;
 		page = alloc_page(GFP_HIGHUSER);
-		if (!page)
+		if (!page) {
+			pte_chain_free(pte_chain);
 			return -1;
+		}
 		clear_user_highpage(page, addr);
 		entry = pte_mkwrite(pte_mkdirty(mk_pte(page, vma->vm_page_prot)));
 		mm->rss++;
 		flush_page_to_ram(page);
+		lru_cache_add_anon(page);
 	}
 	//设置页表项
 	set_pte(page_table, entry);
+	if (page)
+		page_add_rmap(page, page_table, mm, addr, &pte_chain);
 	/* No need to invalidate - it was non-present before */
 	update_mmu_cache(vma, addr, entry);
 	return 1;	/* Minor fault */
@@ -1129,7 +1251,9 @@ static int do_no_page(struct mm_struct * mm, struct vm_area_struct * vma,
 	unsigned long address, int write_access, pte_t *page_table)
 {
 	struct page * new_page;
+	struct pte_chain *pte_chain = NULL;
 	pte_t entry;
+	int shared;
 
 	if (!vma->vm_ops || !vma->vm_ops->nopage)
 		return do_anonymous_page(mm, vma, page_table, write_access, address);
@@ -1144,7 +1268,10 @@ static int do_no_page(struct mm_struct * mm, struct vm_area_struct * vma,
 		return 0;
 	if (new_page == NOPAGE_OOM)
 		return -1;
-	++mm->rss;
+	if (pte_chain_alloc(&pte_chain, 1, GFP_KERNEL)) {
+		page_cache_release(new_page);
+		return -1;
+	}
 	/*
 	 * This silly early PAGE_DIRTY setting removes a race
 	 * due to the bad i386 page protection. But it's valid
@@ -1163,7 +1290,26 @@ static int do_no_page(struct mm_struct * mm, struct vm_area_struct * vma,
 	} else if (page_count(new_page) > 1 &&
 		   !(vma->vm_flags & VM_SHARED))
 		entry = pte_wrprotect(entry);
+
+	/*
+	 * Another process may have faulted the page in meanwhile, through
+	 * a page table we share with it.
+	 */
+	spin_lock(&mm->page_table_lock);
+	shared = pte_table_lock(page_table);
+	if (!pte_none(*page_table)) {
+		pte_table_unlock(page_table, shared);
+		spin_unlock(&mm->page_table_lock);
+		pte_chain_free(pte_chain);
+		page_cache_release(new_page);
+		return 1;
+	}
+	++mm->rss;
 	set_pte(page_table, entry);
+	page_add_rmap(new_page, page_table, mm, address, &pte_chain);
+	pte_table_unlock(page_table, shared);
+	spin_unlock(&mm->page_table_lock);
+	pte_chain_free(pte_chain);
 	/* no need to invalidate: a not-present page shouldn't be cached */
 	update_mmu_cache(vma, address, entry);
 	return 2;	/* Major fault */
@@ -1192,12 +1338,14 @@ static inline int handle_pte_fault(struct mm_struct *mm,
 	int write_access, pte_t * pte)
 {
 	pte_t entry;
+	int shared;
 
 	/*
 	 * We need the page table lock to synchronize with kswapd
 	 * and the SMP-safe atomic PTE updates.
 	 */
 	spin_lock(&mm->page_table_lock);
+	shared = pte_table_lock(pte);
 	entry = *pte;
 	if (!pte_present(entry)) {
 		/*
@@ -1205,6 +1353,7 @@ static inline int handle_pte_fault(struct mm_struct *mm,
 		 * and the PTE updates will not touch it later. So
 		 * drop the lock.
 		 */
+		pte_table_unlock(pte, shared);
 		spin_unlock(&mm->page_table_lock);
 		if (pte_none(entry))
 			return do_no_page(mm, vma, address, write_access, pte);
@@ -1212,13 +1361,17 @@ static inline int handle_pte_fault(struct mm_struct *mm,
 	}
 
 	if (write_access) {
-		if (!pte_write(entry))
+		/* not in a shared page table, see handle_mm_fault() */
+		if (!pte_write(entry)) {
+			pte_table_unlock(pte, shared);
 			return do_wp_page(mm, vma, address, pte, entry);
+		}
 
 		entry = pte_mkdirty(entry);
 	}
 	entry = pte_mkyoung(entry);
 	establish_pte(vma, address, pte, entry);
+	pte_table_unlock(pte, shared);
 	spin_unlock(&mm->page_table_lock);
 	return 1;
 }
@@ -1236,12 +1389,28 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct * vma,
 	pgd_t *pgd;
 	pmd_t *pmd;
 
+	if (is_vm_hugetlb_page(vma))
+		return hugetlb_fault(mm, vma, address, write_access);
+
 	//mm->pgd 为虚拟地址，设置到cr3时改为物理地址
 	pgd = pgd_offset(mm, address);
 	pmd = pmd_alloc(pgd, address);
 
 	if (pmd) {
-		pte_t * pte = pte_alloc(pmd, address);
+		pte_t * pte;
+
+		/*
+		 * ptrace writing to a read-only mapping COWs the page: that
+		 * must be done in a page table of our own.
+		 */
+		if (write_access && !(vma->vm_flags & VM_WRITE)) {
+			if (!pmd_none(*pmd) &&
+			    unshare_page_range(mm, address & PAGE_MASK,
+					       (address & PAGE_MASK) + PAGE_SIZE))
+				return -1;
+		} else if (pmd_none(*pmd))
+			pte_try_to_share(mm, vma, pmd, address);
+		pte = pte_alloc(pmd, address);
 		if (pte)
 			ret = handle_pte_fault(mm, vma, address, write_access, pte);
 	}
@@ -8,6 +8,7 @@
 #include <linux/mman.h>
 #include <linux/smp_lock.h>
 #include <linux/pagemap.h>
+#include <linux/ptshare.h>
 
 #include <asm/uaccess.h>
 #include <asm/pgtable.h>
@@ -124,6 +125,11 @@ static int mlock_fixup(struct vm_area_struct * vma,
 	if (newflags == vma->vm_flags)
 		return 0;
 
+	/* the page tables of locked areas are not shared */
+	if ((newflags & VM_LOCKED) &&
+	    unshare_page_range(vma->vm_mm, start, end))
+		return -ENOMEM;
+
 	if (start == vma->vm_start) {
 		if (end == vma->vm_end)
 			retval = mlock_fixup_all(vma, newflags);
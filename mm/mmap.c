@@ -12,9 +12,12 @@
 #include <linux/smp_lock.h>
 #include <linux/init.h>
 #include <linux/file.h>
+#include <linux/hugetlb.h>
+#include <linux/ptshare.h>
 
 #include <asm/uaccess.h>
 #include <asm/pgalloc.h>
+#include <asm/tlb.h>
 
 /* description of effects of mapping type and prot in current implementation.
  * this is due to the limited x86 page protection hardware.  The expected
@@ -196,6 +199,7 @@ unsigned long do_mmap_pgoff(struct file * file, unsigned long addr, unsigned lon
 	struct mm_struct * mm = current->mm;
 	struct vm_area_struct * vma;
 	int correct_wcount = 0;
+	int hugetlb = 0;
 	int error;
 
 	if (file && (!file->f_op || !file->f_op->mmap))
@@ -261,6 +265,26 @@ unsigned long do_mmap_pgoff(struct file * file, unsigned long addr, unsigned lon
 	/* Obtain the address to map to. we verify (or select) it and ensure
 	 * that it represents a valid section of the address space.
 	 */
+#ifdef CONFIG_HUGETLB_PAGE
+	if ((flags & MAP_HUGETLB) || (file && is_file_hugepages(file))) {
+		/*
+		 * Huge pages are mapped whole, at huge page boundaries.
+		 * Anonymous ones are always shared, also with children.
+		 */
+		if (flags & MAP_HUGETLB) {
+			if (file)
+				return -EINVAL;
+			flags = (flags & ~MAP_TYPE) | MAP_SHARED;
+		}
+		len = HPAGE_ALIGN(len);
+		if (!len)
+			return -EINVAL;
+		addr = hugetlb_get_unmapped_area(addr, len, pgoff, flags);
+		if (addr & ~PAGE_MASK)
+			return addr;
+		hugetlb = 1;
+	} else
+#endif
 	if (flags & MAP_FIXED) {
 		if (addr & ~PAGE_MASK)
 			return -EINVAL;
@@ -282,6 +306,8 @@ unsigned long do_mmap_pgoff(struct file * file, unsigned long addr, unsigned lon
 	vma->vm_start = addr;	//设置对应的虚拟地址
 	vma->vm_end = addr + len;
 	vma->vm_flags = vm_flags(prot,flags) | mm->def_flags;
+	if (hugetlb)
+		vma->vm_flags |= VM_HUGETLB | VM_RESERVED | VM_DONTEXPAND;
 
 	if (file) {
 		VM_ClearReadHint(vma);
@@ -343,6 +369,10 @@ unsigned long do_mmap_pgoff(struct file * file, unsigned long addr, unsigned lon
 		error = file->f_op->mmap(file, vma);
 		if (error)
 			goto unmap_and_free_vma;
+	} else if (hugetlb) {
+		error = hugetlb_zero_setup(vma);
+		if (error)
+			goto free_vma;
 	} else if (flags & MAP_SHARED) {
 		error = shmem_zero_setup(vma);
 		if (error)
@@ -376,7 +406,6 @@ unmap_and_free_vma:
 	/* Undo any partial mapping done by a device driver. */
 	flush_cache_range(mm, vma->vm_start, vma->vm_end);
 	zap_page_range(mm, vma->vm_start, vma->vm_end - vma->vm_start);
-	flush_tlb_range(mm, vma->vm_start, vma->vm_end);
 free_vma:
 	kmem_cache_free(vm_area_cachep, vma);
 	return error;
@@ -722,6 +751,14 @@ int do_munmap(struct mm_struct *mm, unsigned long addr, size_t len)
 	if (mpnt->vm_start >= addr+len)
 		return 0;
 
+	/* Huge pages can't be split */
+	if (hugetlb_check_unmap(mpnt, addr, len))
+		return -EINVAL;
+
+	/* Nor can page tables shared with other processes */
+	if (unshare_page_range(mm, addr, addr + len))
+		return -ENOMEM;
+
 	/* If we'll make "hole", check the vm areas limit */
 	/* 如果会要弄成一个洞，检查虚拟映射的限制 */
 	if ((mpnt->vm_start < addr && mpnt->vm_end > addr+len)
@@ -777,7 +814,6 @@ int do_munmap(struct mm_struct *mm, unsigned long addr, size_t len)
 
 		flush_cache_range(mm, st, end);
 		zap_page_range(mm, st, size);
-		flush_tlb_range(mm, st, end);
 
 		/*
 		 * Fix the mapping, and free the old area if it wasn't reused.
@@ -918,21 +954,26 @@ void build_mmap_avl(struct mm_struct * mm)
 /* 释放所有的映射 */
 void exit_mmap(struct mm_struct * mm)
 {
-	struct vm_area_struct * mpnt;
+	struct vm_area_struct * mpnt, * vma;
+	mmu_gather_t *tlb;
 
 	release_segments(mm);
 	spin_lock(&mm->page_table_lock);
 	mpnt = mm->mmap;
 	mm->mmap = mm->mmap_avl = mm->mmap_cache = NULL;
+
+	/* Unmap all areas at once, with one TLB flush per batch of pages */
+	flush_cache_mm(mm);
+	tlb = tlb_gather_mmu(mm, 0, 0);
+	for (vma = mpnt; vma; vma = vma->vm_next)
+		unmap_page_range(tlb, mm, vma->vm_start, vma->vm_end - vma->vm_start);
+	tlb_finish_mmu(tlb);
 	spin_unlock(&mm->page_table_lock);
 	mm->rss = 0;
 	mm->total_vm = 0;
 	mm->locked_vm = 0;
 	while (mpnt) {
 		struct vm_area_struct * next = mpnt->vm_next;
-		unsigned long start = mpnt->vm_start;
-		unsigned long end = mpnt->vm_end;
-		unsigned long size = end - start;
 
 		if (mpnt->vm_ops) {
 			if (mpnt->vm_ops->close)
@@ -940,8 +981,6 @@ void exit_mmap(struct mm_struct * mm)
 		}
 		mm->map_count--;
 		remove_shared_vm_struct(mpnt);
-		flush_cache_range(mm, start, end);
-		zap_page_range(mm, start, size);
 		if (mpnt->vm_file)
 			fput(mpnt->vm_file);
 		kmem_cache_free(vm_area_cachep, mpnt);	//内存释放
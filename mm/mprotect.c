@@ -10,6 +10,8 @@
 #include <linux/smp_lock.h>
 #include <linux/shm.h>
 #include <linux/mman.h>
+#include <linux/hugetlb.h>
+#include <linux/ptshare.h>
 
 #include <asm/uaccess.h>
 #include <asm/pgalloc.h>
@@ -215,6 +217,11 @@ static int mprotect_fixup(struct vm_area_struct * vma,
 
 	if (newflags == vma->vm_flags)
 		return 0;
+	/* the huge pmds are set up by mm/hugetlb.c only */
+	if (is_vm_hugetlb_page(vma))
+		return -EINVAL;
+	if (unshare_page_range(vma->vm_mm, start, end))
+		return -ENOMEM;
 	newprot = protection_map[newflags & 0xf];
 	if (start == vma->vm_start) {
 		if (end == vma->vm_end)
@@ -9,6 +9,8 @@
 #include <linux/shm.h>
 #include <linux/mman.h>
 #include <linux/swap.h>
+#include <linux/hugetlb.h>
+#include <linux/ptshare.h>
 
 #include <asm/uaccess.h>
 #include <asm/pgalloc.h>
@@ -57,7 +59,8 @@ static inline pte_t *alloc_one_pte(struct mm_struct *mm, unsigned long addr)
 	return pte;
 }
 
-static inline int copy_one_pte(struct mm_struct *mm, pte_t * src, pte_t * dst)
+static inline int copy_one_pte(struct mm_struct *mm, pte_t * src, pte_t * dst,
+	unsigned long old_addr, unsigned long new_addr)
 {
 	int error = 0;
 	pte_t pte;
@@ -68,9 +71,15 @@ static inline int copy_one_pte(struct mm_struct *mm, pte_t * src, pte_t * dst)
 		if (!dst) {
 			/* No dest?  We must put it back. */
 			dst = src;
+			new_addr = old_addr;
 			error++;
 		}
 		set_pte(dst, pte);
+		if (pte_present(pte) && dst != src) {
+			struct page *page = pte_page(pte);
+
+			page_move_rmap(page, src, dst, mm, new_addr);
+		}
 	}
 	spin_unlock(&mm->page_table_lock);
 	return error;
@@ -83,7 +92,8 @@ static int move_one_page(struct mm_struct *mm, unsigned long old_addr, unsigned
 
 	src = get_one_pte(mm, old_addr);
 	if (src)
-		error = copy_one_pte(mm, src, alloc_one_pte(mm, new_addr));
+		error = copy_one_pte(mm, src, alloc_one_pte(mm, new_addr),
+				     old_addr, new_addr);
 	return error;
 }
 
@@ -119,7 +129,6 @@ oops_we_failed:
 	while ((offset += PAGE_SIZE) < len)
 		move_one_page(mm, new_addr + offset, old_addr + offset);
 	zap_page_range(mm, new_addr, len);
-	flush_tlb_range(mm, new_addr, new_addr + len);
 	return -1;
 }
 
@@ -129,6 +138,10 @@ static inline unsigned long move_vma(struct vm_area_struct * vma,
 {
 	struct vm_area_struct * new_vma;
 
+	/* the ptes are moved one by one out of private page tables */
+	if (unshare_page_range(current->mm, addr, addr + old_len))
+		return -ENOMEM;
+
 	//申请一个新的vma结构体
 	new_vma = kmem_cache_alloc(vm_area_cachep, SLAB_KERNEL);
 	if (new_vma) {
@@ -181,6 +194,11 @@ unsigned long do_mremap(unsigned long addr,
 	old_len = PAGE_ALIGN(old_len);
 	new_len = PAGE_ALIGN(new_len);
 
+	/* Huge page areas can't be split or moved */
+	vma = find_vma(current->mm, addr);
+	if (vma && vma->vm_start <= addr && is_vm_hugetlb_page(vma))
+		goto out;
+
 	/* new_addr is only valid if MREMAP_FIXED is specified */
 	if (flags & MREMAP_FIXED) {
 		if (new_addr & ~PAGE_MASK)
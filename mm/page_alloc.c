@@ -18,18 +18,12 @@
 #include <linux/bootmem.h>
 
 int nr_swap_pages;
-int nr_active_pages;
-int nr_inactive_dirty_pages;
 pg_data_t *pgdat_list;
 
 static char *zone_names[MAX_NR_ZONES] = { "DMA", "Normal", "HighMem" };
 static int zone_balance_ratio[MAX_NR_ZONES] = { 32, 128, 128, };
 static int zone_balance_min[MAX_NR_ZONES] = { 10 , 10, 10, };
 static int zone_balance_max[MAX_NR_ZONES] = { 255 , 255, 255, };
-
-//全局链表
-struct list_head active_list;		//活跃链表
-struct list_head inactive_dirty_list;	//不活跃脏链表
 /*
  * Free_page() adds the page to the free lists. This is optimized for
  * fast normal cases (no error jumps taken normally).
@@ -61,14 +55,31 @@ struct list_head inactive_dirty_list;	//不活跃脏链表
  * Hint: -mask = 1+~mask
  */
 
-static void FASTCALL(__free_pages_ok (struct page *page, unsigned long order));
-static void __free_pages_ok (struct page *page, unsigned long order)
+/*
+ * Anti-fragmentation, see <linux/mmzone.h>.
+ */
+static inline int gfp_migratetype(unsigned int gfp_mask)
 {
-	unsigned long index, page_idx, mask, flags;
-	free_area_t *area;
-	struct page *base;
-	zone_t *zone;
+	return (gfp_mask & __GFP_MOVABLE) ? MIGRATE_MOVABLE : MIGRATE_UNMOVABLE;
+}
+
+static inline unsigned long pageblock_index(zone_t *zone, struct page *page)
+{
+	return (page - (mem_map + zone->offset)) >> PAGEBLOCK_ORDER;
+}
+
+static inline int get_pageblock_type(zone_t *zone, struct page *page)
+{
+	return zone->pageblock_type[pageblock_index(zone, page)];
+}
+
+static inline void set_pageblock_type(zone_t *zone, struct page *page, int type)
+{
+	zone->pageblock_type[pageblock_index(zone, page)] = type;
+}
 
+static inline void free_pages_check(struct page *page)
+{
 	if (page->buffers)
 		BUG();
 	if (page->mapping)
@@ -88,11 +99,21 @@ static void __free_pages_ok (struct page *page, unsigned long order)
 		BUG();
 	if (PageInactiveClean(page))
 		BUG();
+	if (page->pte_chain)
+		BUG();
 
-	page->flags &= ~((1<<PG_referenced) | (1<<PG_dirty));
+	page->flags &= ~((1<<PG_referenced) | (1<<PG_dirty) | (1<<PG_ptshared));
 	page->age = PAGE_AGE_START;
+}
 
-	zone = page->zone;
+/*
+ * Give a block back to the buddy lists. zone->lock must be held.
+ */
+static void __free_one_page(zone_t *zone, struct page *page, unsigned long order)
+{
+	unsigned long index, page_idx, mask;
+	free_area_t *area;
+	struct page *base;
 
 	mask = (~0UL) << order;
 	base = mem_map + zone->offset;
@@ -104,8 +125,6 @@ static void __free_pages_ok (struct page *page, unsigned long order)
 						//同一个位图下，如果存在则需要升入(order+1)中
 	area = zone->free_area + order;
 
-	spin_lock_irqsave(&zone->lock, flags);
-
 	zone->free_pages -= mask;		//-mask = (1+~mask)
 
 	while (mask + (1 << (MAX_ORDER-1))) {
@@ -137,8 +156,21 @@ static void __free_pages_ok (struct page *page, unsigned long order)
 		page_idx &= mask;
 	}
 	//添加到新的链表中...
-	memlist_add_head(&(base + page_idx)->list, &area->free_list);
+	page = base + page_idx;
+	memlist_add_head(&page->list,
+			&area->free_list[get_pageblock_type(zone, page)]);
+}
+
+static void FASTCALL(__free_pages_ok (struct page *page, unsigned long order));
+static void __free_pages_ok (struct page *page, unsigned long order)
+{
+	zone_t *zone = page->zone;
+	unsigned long flags;
 
+	free_pages_check(page);
+
+	spin_lock_irqsave(&zone->lock, flags);
+	__free_one_page(zone, page, order);
 	spin_unlock_irqrestore(&zone->lock, flags);
 
 	/*
@@ -154,7 +186,7 @@ static void __free_pages_ok (struct page *page, unsigned long order)
 	change_bit((index) >> (1+(order)), (area)->map)
 
 static inline struct page * expand (zone_t *zone, struct page *page,
-	 unsigned long index, int low, int high, free_area_t * area)
+	 unsigned long index, int low, int high, free_area_t * area, int type)
 {
 	unsigned long size = 1 << high;
 
@@ -165,7 +197,7 @@ static inline struct page * expand (zone_t *zone, struct page *page,
 		high--;
 		size >>= 1;
 		//将第一个页面的list 链接到(area)->free_list 中
-		memlist_add_head(&(page)->list, &(area)->free_list);
+		memlist_add_head(&(page)->list, &(area)->free_list[type]);
 		MARK_USED(index, high, area);
 		index += size;
 		page += size;
@@ -175,49 +207,419 @@ static inline struct page * expand (zone_t *zone, struct page *page,
 	return page;
 }
 
-/* 从一个zone 中分配2^order 连续页面 */
-static FASTCALL(struct page * rmqueue(zone_t *zone, unsigned long order));
-static struct page * rmqueue(zone_t *zone, unsigned long order)
+/*
+ * Take the first block of the list of @curr_order and split it down
+ * to @order, the remainders going to the lists of @type.
+ */
+static inline struct page * take_block(zone_t *zone, unsigned long order,
+	unsigned long curr_order, struct list_head *curr, int type)
+{
+	free_area_t * area = zone->free_area + curr_order;
+	unsigned int index;
+	struct page *page;
+
+	//通过list找到对应的page页面
+	page = memlist_entry(curr, struct page, list);
+	if (BAD_RANGE(zone,page))
+		BUG();
+	memlist_del(curr);
+	//(page-mem_map) 说明所有页面都在mem_map 数组中有一个唯一的下标
+	index = (page - mem_map) - zone->offset;
+	MARK_USED(index, curr_order, area);
+	zone->free_pages -= 1 << order;
+
+	page = expand(zone, page, index, order, curr_order, area, type);
+	if (BAD_RANGE(zone,page))
+		BUG();
+	return page;
+}
+
+/*
+ * Take a 2^order block off the buddy lists. zone->lock must be held.
+ *
+ * The smallest block of our own type is used first. Failing that we
+ * steal from the other type, and then the largest block there is:
+ * it is better to hand a whole pageblock over to the other type than
+ * to leave a few pages of it in every one. A steal of half a pageblock
+ * or more changes the type of the block, so that its pages come back
+ * to our lists when they are freed.
+ */
+static struct page * __rmqueue(zone_t *zone, unsigned long order, int type)
 {
 	free_area_t * area = zone->free_area + order;
 	unsigned long curr_order = order;
 	struct list_head *head, *curr;
-	unsigned long flags;
 	struct page *page;
+	int other;
 
-	spin_lock_irqsave(&zone->lock, flags);
 	do {
-		head = &area->free_list;
+		head = &area->free_list[type];
 		curr = memlist_next(head);
 
-		if (curr != head) {		//非空
-			unsigned int index;
+		if (curr != head)		//非空
+			return take_block(zone, order, curr_order, curr, type);
+		//继续找较大的空闲页面拆开
+		curr_order++;
+		area++;
+	} while (curr_order < MAX_ORDER);
+
+	for (other = 0; other < MIGRATE_TYPES; other++) {
+		if (other == type)
+			continue;
+		curr_order = MAX_ORDER;
+		while (curr_order-- > order) {
+			head = &zone->free_area[curr_order].free_list[other];
+			curr = memlist_next(head);
+			if (curr == head)
+				continue;
 
-			//通过list找到对应的page页面
 			page = memlist_entry(curr, struct page, list);
-			if (BAD_RANGE(zone,page))
-				BUG();
-			memlist_del(curr);
-			//(page-mem_map) 说明所有页面都在mem_map 数组中有一个唯一的下标
-			index = (page - mem_map) - zone->offset;
-			MARK_USED(index, curr_order, area);
-			zone->free_pages -= 1 << order;
+			if (curr_order >= PAGEBLOCK_ORDER/2)
+				set_pageblock_type(zone, page, type);
+			return take_block(zone, order, curr_order, curr, type);
+		}
+	}
 
-			page = expand(zone, page, index, order, curr_order, area);
-			spin_unlock_irqrestore(&zone->lock, flags);
+	return NULL;
+}
 
-			set_page_count(page, 1);	//设置page引用计数
-			if (BAD_RANGE(zone,page))
-				BUG();
-			DEBUG_ADD_PAGE
-			return page;	
+/*
+ * Per-CPU page lists.
+ *
+ * Most allocations and frees are single pages, and every one of them
+ * used to take zone->lock. Each CPU now keeps two short lists of free
+ * order-0 pages per zone and only goes to the buddy lists, under the
+ * lock, to move a whole batch in or out. The "hot" list gets the pages
+ * freed by __free_page() and hands back the most recently freed page
+ * first, whose cache lines are likely still in this CPU's cache. The
+ * "cold" list is for pages nobody will touch with the CPU soon -
+ * __GFP_COLD allocations (readahead, DMA) and free_cold_page() - so
+ * that they don't use up the hot ones.
+ *
+ * The lists belong to their CPU and are only touched with interrupts
+ * off. Pages on them are not counted in zone->free_pages; the buddy
+ * allocator sees them as allocated.
+ */
+
+/*
+ * Move up to @count pages of @type from the buddy lists to @list.
+ * A page stolen from a block of the other type that kept its type
+ * would never be picked by pcp_take(): it goes back, and the caller
+ * takes it from the buddy lists itself if it must.
+ */
+static int rmqueue_bulk(zone_t *zone, int count, struct list_head *list, int type)
+{
+	struct page *page;
+	int i;
+
+	spin_lock(&zone->lock);
+	for (i = 0; i < count; i++) {
+		page = __rmqueue(zone, 0, type);
+		if (!page)
+			break;
+		if (get_pageblock_type(zone, page) != type) {
+			__free_one_page(zone, page, 0);
+			break;
 		}
-		//继续找较大的空闲页面拆开
-		curr_order++;
-		area++;
-	} while (curr_order < MAX_ORDER);
-	spin_unlock_irqrestore(&zone->lock, flags);
+		list_add_tail(&page->list, list);
+	}
+	spin_unlock(&zone->lock);
+	return i;
+}
+
+/* Give the @count pages at the tail of @list, the oldest, back to the buddy. */
+static int free_pages_bulk(zone_t *zone, int count, struct list_head *list)
+{
+	struct page *page;
+	int i;
+
+	spin_lock(&zone->lock);
+	for (i = 0; i < count && !list_empty(list); i++) {
+		page = list_entry(list->prev, struct page, list);
+		list_del(&page->list);
+		__free_one_page(zone, page, 0);
+	}
+	spin_unlock(&zone->lock);
+	return i;
+}
+
+/*
+ * Drop a reference. Pages on the LRU lists (anonymous memory, see
+ * lru_cache_add_anon()) come off them with the last one.
+ */
+static inline int free_pages_testzero(struct page *page)
+{
+	if (PageReserved(page))
+		return 0;
+	if (PageLRU(page))
+		return lru_put_page_testzero(page);
+	return put_page_testzero(page);
+}
+
+static void free_hot_cold_page(struct page *page, int cold)
+{
+	zone_t *zone = page->zone;
+	struct per_cpu_pages *pcp;
+	unsigned long flags;
+
+	free_pages_check(page);
+
+	local_irq_save(flags);
+	pcp = &zone->pageset[smp_processor_id()].pcp[cold];
+	if (pcp->count >= pcp->high)
+		pcp->count -= free_pages_bulk(zone, pcp->batch, &pcp->list);
+	list_add(&page->list, &pcp->list);
+	pcp->count++;
+	local_irq_restore(flags);
+
+	if (memory_pressure > NR_CPUS)
+		memory_pressure--;
+}
+
+/*
+ * For pages that have just been reclaimed or are about to be DMA'd
+ * into: don't push them in front of the cache hot ones.
+ */
+void free_cold_page(struct page *page)
+{
+	if (free_pages_testzero(page))
+		free_hot_cold_page(page, 1);
+}
+
+/* Give this CPU's lists back to the buddy lists. */
+static void drain_local_pages(void *unused)
+{
+	unsigned long flags;
+	pg_data_t *pgdat;
+	int i;
+
+	local_irq_save(flags);
+	for (pgdat = pgdat_list; pgdat; pgdat = pgdat->node_next) {
+		zone_t *zone;
+
+		for (zone = pgdat->node_zones; zone < pgdat->node_zones + MAX_NR_ZONES; zone++) {
+			struct per_cpu_pageset *pset = zone->pageset + smp_processor_id();
+
+			for (i = 0; i < 2; i++)
+				pset->pcp[i].count -= free_pages_bulk(zone,
+						pset->pcp[i].count, &pset->pcp[i].list);
+		}
+	}
+	local_irq_restore(flags);
+}
+
+/*
+ * Pages on the per-CPU lists can't coalesce. A higher order allocation
+ * that is about to fail wants them back from every CPU.
+ */
+static void drain_all_pages(void)
+{
+	smp_call_function(drain_local_pages, NULL, 0, 1);
+	drain_local_pages(NULL);
+}
+
+/*
+ * The per-CPU lists hold pages of both types. Take the first one that
+ * lives in a pageblock of @type, so that a kernel allocation doesn't
+ * pin down a page of a movable block or the other way round.
+ */
+static struct page * pcp_take(zone_t *zone, struct per_cpu_pages *pcp, int type)
+{
+	struct list_head *curr;
+
+	for (curr = pcp->list.next; curr != &pcp->list; curr = curr->next) {
+		struct page *page = list_entry(curr, struct page, list);
 
+		if (get_pageblock_type(zone, page) == type) {
+			list_del(curr);
+			pcp->count--;
+			return page;
+		}
+	}
+	return NULL;
+}
+
+/* 从一个zone 中分配2^order 连续页面 */
+static FASTCALL(struct page * rmqueue(zone_t *zone, unsigned long order, unsigned int gfp_mask));
+static struct page * rmqueue(zone_t *zone, unsigned long order, unsigned int gfp_mask)
+{
+	int type = gfp_migratetype(gfp_mask);
+	struct page *page = NULL;
+	unsigned long flags;
+
+	if (order == 0) {
+		struct per_cpu_pages *pcp;
+
+		local_irq_save(flags);
+		pcp = &zone->pageset[smp_processor_id()].pcp[!!(gfp_mask & __GFP_COLD)];
+		page = pcp_take(zone, pcp, type);
+		if (!page) {
+			pcp->count += rmqueue_bulk(zone, pcp->batch, &pcp->list, type);
+			page = pcp_take(zone, pcp, type);
+		}
+		local_irq_restore(flags);
+	}
+
+	if (!page) {
+		spin_lock_irqsave(&zone->lock, flags);
+		page = __rmqueue(zone, order, type);
+		spin_unlock_irqrestore(&zone->lock, flags);
+		if (!page)
+			return NULL;
+	}
+
+	set_page_count(page, 1);	//设置page引用计数
+	DEBUG_ADD_PAGE
+	return page;
+}
+
+/*
+ * Compaction.
+ *
+ * When a higher order allocation fails although there is plenty of
+ * memory free, look for an aligned block in a movable pageblock whose
+ * pages are all either free or clean, unmapped page cache, migrate
+ * the latter elsewhere in the zone and let the block coalesce. This
+ * is tried before page_launder(), which throws away a lot of page
+ * cache to maybe get the same result.
+ */
+static unsigned long compact_stall, compact_success, compact_fail;
+static unsigned long compact_migrated;
+
+/* Racy check that every page of the block is free or can be migrated. */
+static int block_compactable(struct page *page, unsigned long nr)
+{
+	for (; nr; nr--, page++) {
+		if (PageReserved(page))
+			return 0;
+		if (!page_count(page))
+			continue;
+		if (!page->mapping || page->buffers || PageDirty(page) ||
+				PageLocked(page) || page_count(page) != 1)
+			return 0;
+	}
+	return 1;
+}
+
+static void release_held_pages(struct list_head *held)
+{
+	while (!list_empty(held)) {
+		struct page *page = list_entry(held->next, struct page, list);
+
+		list_del(&page->list);
+		if (put_page_testzero(page))
+			__free_pages_ok(page, 0);
+	}
+}
+
+/*
+ * Get a page to migrate to, outside of the block [start, start+nr).
+ * Free pages of the block that we are handed on the way are held on
+ * to, so that we don't get them again, and marked in @held_map. The
+ * pages come straight from the buddy lists: going through the per-CPU
+ * lists would refill them with pages of the block, which then can't
+ * coalesce.
+ */
+static struct page * compact_alloc(zone_t *zone, struct page *start,
+	unsigned long nr, struct list_head *held, unsigned long *held_map)
+{
+	struct page *page;
+	unsigned long flags;
+
+	for (;;) {
+		spin_lock_irqsave(&zone->lock, flags);
+		page = __rmqueue(zone, 0, MIGRATE_MOVABLE);
+		spin_unlock_irqrestore(&zone->lock, flags);
+		if (!page)
+			return NULL;
+		set_page_count(page, 1);
+		if (page < start || page >= start + nr)
+			return page;
+		list_add(&page->list, held);
+		set_bit(page - start, held_map);
+	}
+}
+
+static int compact_block(zone_t *zone, struct page *start, unsigned long nr)
+{
+	unsigned long held_map[(1UL << (MAX_ORDER-1)) / BITS_PER_LONG];
+	LIST_HEAD(held);
+	unsigned long i;
+	int ret = 0;
+
+	memset(held_map, 0, sizeof(held_map));
+	for (i = 0; i < nr; i++) {
+		struct page *page = start + i, *newpage;
+
+		/* free, or free and held by us */
+		if (!page_count(page) || test_bit(i, held_map))
+			continue;
+		newpage = compact_alloc(zone, start, nr, &held, held_map);
+		if (!newpage) {
+			ret = -ENOMEM;
+			break;
+		}
+		if (migrate_page_cache(page, newpage)) {
+			if (put_page_testzero(newpage))
+				__free_pages_ok(newpage, 0);
+			ret = -EBUSY;
+			break;
+		}
+		__free_pages_ok(page, 0);
+		compact_migrated++;
+	}
+	release_held_pages(&held);
+	return ret;
+}
+
+static struct page * compact_zone(zone_t *zone, unsigned long order,
+	unsigned int gfp_mask)
+{
+	unsigned long nr = 1UL << order, start;
+	struct page *base = mem_map + zone->offset;
+
+	for (start = 0; start + nr <= zone->size; start += nr) {
+		struct page *page = base + start;
+
+		if (get_pageblock_type(zone, page) != MIGRATE_MOVABLE) {
+			/* on to the next pageblock */
+			start |= (1UL << PAGEBLOCK_ORDER) - 1;
+			start -= nr - 1;
+			continue;
+		}
+		if (!block_compactable(page, nr))
+			continue;
+		if (zone->free_pages < zone->pages_low + nr)
+			break;
+		if (compact_block(zone, page, nr) == -ENOMEM)
+			break;
+		page = rmqueue(zone, order, gfp_mask);
+		if (page)
+			return page;
+	}
+	return NULL;
+}
+
+static struct page * try_to_compact_pages(zonelist_t *zonelist,
+	unsigned long order)
+{
+	zone_t **zone = zonelist->zones;
+	struct page *page;
+
+	compact_stall++;
+	for (;;) {
+		zone_t *z = *(zone++);
+		if (!z)
+			break;
+		if (z->free_pages < z->pages_low + (1UL << order))
+			continue;
+		page = compact_zone(z, order, zonelist->gfp_mask);
+		if (page) {
+			compact_success++;
+			return page;
+		}
+	}
+	compact_fail++;
 	return NULL;
 }
 
@@ -236,6 +638,7 @@ static struct page * __alloc_pages_limit(zonelist_t *zonelist,
 			unsigned long order, int limit, int direct_reclaim)
 {
 	zone_t **zone = zonelist->zones;
+	unsigned int gfp_mask = zonelist->gfp_mask;
 
 	for (;;) {
 		zone_t *z = *(zone++);
@@ -270,7 +673,7 @@ static struct page * __alloc_pages_limit(zonelist_t *zonelist,
 				page = reclaim_page(z);
 			/* If that fails, fall back to rmqueue. */
 			if (!page)
-				page = rmqueue(z, order);
+				page = rmqueue(z, order, gfp_mask);
 			if (page)
 				return page;
 		}
@@ -329,8 +732,8 @@ struct page * __alloc_pages(zonelist_t *zonelist, unsigned long order)
 	/*
 	 * free page 少了需要唤醒bdflush.
 	 */
-	else if (free_shortage() && nr_inactive_dirty_pages > free_shortage()
-			&& nr_inactive_dirty_pages >= freepages.high)
+	else if (free_shortage() && nr_inactive_dirty_pages() > free_shortage()
+			&& nr_inactive_dirty_pages() >= freepages.high)
 		wakeup_bdflush(0);
 
 try_again:
@@ -349,7 +752,7 @@ try_again:
 			BUG();
 
 		if (z->free_pages >= z->pages_low) {
-			page = rmqueue(z, order);
+			page = rmqueue(z, order, gfp_mask);
 			if (page)
 				return page;
 		} else if (z->free_pages < z->pages_min && waitqueue_active(&kreclaimd_wait)) {
@@ -439,12 +842,19 @@ try_again:
 		 * 一个大的物理上连续的空闲内存。
 		 */
 		if (order > 0 && (gfp_mask & __GFP_WAIT)) {
+			/* Rebuild a free block by moving pages, if we can. */
+			drain_all_pages();
+			page = try_to_compact_pages(zonelist, order);
+			if (page)
+				return page;
+
 			zone = zonelist->zones;
 			/* First, clean some dirty pages. */
 			current->flags |= PF_MEMALLOC;
 			//将脏页面洗干净，然后回收
 			page_launder(gfp_mask, 1);
 			current->flags &= ~PF_MEMALLOC;
+			drain_all_pages();
 			for (;;) {
 				zone_t *z = *(zone++);
 				if (!z)
@@ -459,9 +869,11 @@ try_again:
 					page = reclaim_page(z);
 					if (!page)
 						break;
-					__free_page(page);
+					/* Straight to the buddy lists, so it can coalesce. */
+					if (put_page_testzero(page))
+						__free_pages_ok(page, 0);
 					/* Try if the allocation succeeds. */
-					page = rmqueue(z, order);
+					page = rmqueue(z, order, gfp_mask);
 					if (page)
 						return page;
 				}
@@ -537,7 +949,7 @@ try_again:
 		if (z->free_pages < z->pages_min / 4 &&
 				!(current->flags & PF_MEMALLOC))
 			continue;
-		page = rmqueue(z, order);
+		page = rmqueue(z, order, gfp_mask);
 		if (page)
 			return page;
 	}
@@ -578,8 +990,12 @@ unsigned long get_zeroed_page(int gfp_mask)
 void __free_pages(struct page *page, unsigned long order)
 {
 	//如果不是保留页面，且引用计数为 0
-	if (!PageReserved(page) && put_page_testzero(page))
-		__free_pages_ok(page, order);
+	if (free_pages_testzero(page)) {
+		if (order == 0)
+			free_hot_cold_page(page, 0);
+		else
+			__free_pages_ok(page, order);
+	}
 }
 
 void free_pages(unsigned long addr, unsigned long order)
@@ -631,6 +1047,40 @@ unsigned int nr_inactive_clean_pages (void)
 	return sum;
 }
 
+/*
+ * Total amount of active and inactive_dirty pages, the lists are
+ * per zone as well.
+ */
+unsigned int nr_active_pages (void)
+{
+	unsigned int sum;
+	zone_t *zone;
+	pg_data_t *pgdat = pgdat_list;
+
+	sum = 0;
+	while (pgdat) {
+		for (zone = pgdat->node_zones; zone < pgdat->node_zones + MAX_NR_ZONES; zone++)
+			sum += zone->active_pages;
+		pgdat = pgdat->node_next;
+	}
+	return sum;
+}
+
+unsigned int nr_inactive_dirty_pages (void)
+{
+	unsigned int sum;
+	zone_t *zone;
+	pg_data_t *pgdat = pgdat_list;
+
+	sum = 0;
+	while (pgdat) {
+		for (zone = pgdat->node_zones; zone < pgdat->node_zones + MAX_NR_ZONES; zone++)
+			sum += zone->inactive_dirty_pages;
+		pgdat = pgdat->node_next;
+	}
+	return sum;
+}
+
 /*
  * Amount of free RAM allocatable as buffer memory:
  */
@@ -641,7 +1091,7 @@ unsigned int nr_free_buffer_pages (void)
 
 	sum = nr_free_pages();
 	sum += nr_inactive_clean_pages();
-	sum += nr_inactive_dirty_pages;
+	sum += nr_inactive_dirty_pages();
 
 	/*
 	 * Keep our write behind queue filled, even if
@@ -655,7 +1105,7 @@ unsigned int nr_free_buffer_pages (void)
 	 * to be possible to have some dirty pages in the
 	 * working set without upsetting the writebehind logic.
 	 */
-	sum += nr_active_pages >> 4;
+	sum += nr_active_pages() >> 4;
 
 	return sum;
 }
@@ -690,9 +1140,9 @@ void show_free_areas_core(pg_data_t *pgdat)
 		nr_free_highpages() << (PAGE_SHIFT-10));
 
 	printk("( Active: %d, inactive_dirty: %d, inactive_clean: %d, free: %d (%d %d %d) )\n",
-		nr_active_pages,		//全局
-		nr_inactive_dirty_pages,	//全局
-		nr_inactive_clean_pages(),	//每个zone自己维护
+		nr_active_pages(),
+		nr_inactive_dirty_pages(),
+		nr_inactive_clean_pages(),
 		nr_free_pages(),
 		freepages.min,
 		freepages.low,
@@ -702,30 +1152,58 @@ void show_free_areas_core(pg_data_t *pgdat)
 	for (type = 0; type < MAX_NR_ZONES; type++) {
 		struct list_head *head, *curr;
 		zone_t *zone = pgdat->node_zones + type;
- 		unsigned long nr, total, flags;
+ 		unsigned long nr[MIGRATE_TYPES][MAX_ORDER];
+ 		unsigned long blocks[MIGRATE_TYPES];
+ 		unsigned long i, total, flags;
+		int t;
 
 		total = 0;
 		if (zone->size) {
+			memset(blocks, 0, sizeof(blocks));
 			spin_lock_irqsave(&zone->lock, flags);
 			//按照order顺序显示zone中的每个free_area
 		 	for (order = 0; order < MAX_ORDER; order++) {
-				head = &(zone->free_area + order)->free_list;
-				curr = head;
-				nr = 0;
-				for (;;) {
-					curr = memlist_next(curr);
-					if (curr == head)
-						break;
-					nr++;
+				for (t = 0; t < MIGRATE_TYPES; t++) {
+					head = &(zone->free_area + order)->free_list[t];
+					curr = head;
+					nr[t][order] = 0;
+					for (;;) {
+						curr = memlist_next(curr);
+						if (curr == head)
+							break;
+						nr[t][order]++;
+					}
 				}
-				total += nr * (1 << order);
-				printk("%lu*%lukB ", nr,
-						(PAGE_SIZE>>10) << order);
 			}
+			for (i = 0; i < zone->size; i += 1UL << PAGEBLOCK_ORDER)
+				blocks[zone->pageblock_type[i >> PAGEBLOCK_ORDER]]++;
 			spin_unlock_irqrestore(&zone->lock, flags);
-		}
-		printk("= %lukB)\n", total * (PAGE_SIZE>>10));
+
+		 	for (order = 0; order < MAX_ORDER; order++) {
+				unsigned long n = 0;
+
+				for (t = 0; t < MIGRATE_TYPES; t++)
+					n += nr[t][order];
+				total += n * (1 << order);
+				printk("%lu*%lukB ", n,
+						(PAGE_SIZE>>10) << order);
+			}
+			printk("= %lukB)\n", total * (PAGE_SIZE>>10));
+
+			/* how the free blocks are spread over the pageblock types */
+			for (t = 0; t < MIGRATE_TYPES; t++) {
+				printk("  %s %s: %lu blocks, free ", zone->name,
+					t == MIGRATE_MOVABLE ? "movable" : "unmovable",
+					blocks[t]);
+			 	for (order = 0; order < MAX_ORDER; order++)
+					printk("%lu ", nr[t][order]);
+				printk("\n");
+			}
+		} else
+			printk("= %lukB)\n", total * (PAGE_SIZE>>10));
 	}
+	printk("Compaction: %lu stalls, %lu succeeded, %lu failed, %lu pages migrated\n",
+		compact_stall, compact_success, compact_fail, compact_migrated);
 
 #ifdef SWAP_CACHE_INFO
 	show_swap_cache_info();
@@ -819,10 +1297,6 @@ void __init free_area_init_core(int nid, pg_data_t *pgdat, struct page **gmap,
 
 	printk("On node %d totalpages: %lu\n", nid, realtotalpages);
 
-	/* 初始化全局的活跃链表、不活跃脏链表 */
-	memlist_init(&active_list);
-	memlist_init(&inactive_dirty_list);
-
 	/*
 	 * Some architectures (with lots of mem and discontinous memory
 	 * maps) have to search for a good mem_map area:
@@ -861,7 +1335,7 @@ void __init free_area_init_core(int nid, pg_data_t *pgdat, struct page **gmap,
 	offset = lmem_map - mem_map;
 	for (j = 0; j < MAX_NR_ZONES; j++) {
 		zone_t *zone = pgdat->node_zones + j;
-		unsigned long mask;
+		unsigned long mask, batch, nr_blocks;
 		unsigned long size, realsize;
 
 		realsize = size = zones_size[j];
@@ -876,7 +1350,38 @@ void __init free_area_init_core(int nid, pg_data_t *pgdat, struct page **gmap,
 		zone->free_pages = 0;		//此时全部初始化为0
 		zone->inactive_clean_pages = 0;
 		zone->inactive_dirty_pages = 0;
+		zone->active_pages = 0;
+		zone->lru_lock = SPIN_LOCK_UNLOCKED;
+		memlist_init(&zone->active_list);
+		memlist_init(&zone->inactive_dirty_list);
 		memlist_init(&zone->inactive_clean_list);
+		memset(zone->lru_stat, 0, sizeof(zone->lru_stat));
+
+		/*
+		 * Per-CPU lists: a batch of realsize/4096 pages, between
+		 * 1 and 16, so that a small DMA zone doesn't get parked
+		 * on the lists of all CPUs.
+		 */
+		batch = realsize / 4096;
+		if (batch < 1)
+			batch = 1;
+		else if (batch > 16)
+			batch = 16;
+		for (i = 0; i < NR_CPUS; i++) {
+			struct per_cpu_pages *pcp;
+
+			pcp = &zone->pageset[i].pcp[0];		/* hot */
+			pcp->count = 0;
+			pcp->batch = batch;
+			pcp->high = 6 * batch;
+			INIT_LIST_HEAD(&pcp->list);
+
+			pcp = &zone->pageset[i].pcp[1];		/* cold */
+			pcp->count = 0;
+			pcp->batch = batch;
+			pcp->high = 2 * batch;
+			INIT_LIST_HEAD(&pcp->list);
+		}
 		if (!size)
 			continue;
 
@@ -919,11 +1424,21 @@ void __init free_area_init_core(int nid, pg_data_t *pgdat, struct page **gmap,
 
 		offset += size;		//偏移量累加
 		mask = -1;
+		/*
+		 * Everything starts out movable: the pageblocks that the
+		 * kernel takes from are relabelled as it goes.
+		 */
+		nr_blocks = (size + (1UL << PAGEBLOCK_ORDER) - 1) >> PAGEBLOCK_ORDER;
+		zone->pageblock_type = (unsigned char *) alloc_bootmem_node(pgdat, nr_blocks);
+		memset(zone->pageblock_type, MIGRATE_MOVABLE, nr_blocks);
+
 		for (i = 0; i < MAX_ORDER; i++) {
 			unsigned long bitmap_size;
+			int t;
 
 			//构造free_area{}
-			memlist_init(&zone->free_area[i].free_list);
+			for (t = 0; t < MIGRATE_TYPES; t++)
+				memlist_init(&zone->free_area[i].free_list[t]);
 			mask += mask;
 			size = (size + ~mask) & mask;
 			bitmap_size = size >> i;	//位图是整个zone的位图
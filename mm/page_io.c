@@ -15,6 +15,7 @@
 #include <linux/swap.h>
 #include <linux/locks.h>
 #include <linux/swapctl.h>
+#include <linux/compswap.h>
 
 #include <asm/pgtable.h>
 
@@ -33,7 +34,7 @@
  * that shared pages stay shared while being swapped.
  */
 /* 读写交换页面 */
-static int rw_swap_page_base(int rw, swp_entry_t entry, struct page *page, int wait)
+int rw_swap_page_base(int rw, swp_entry_t entry, struct page *page, int wait)
 {
 	unsigned long offset;
 	int zones[PAGE_SIZE/512];	//512是磁盘块大小
@@ -49,9 +50,9 @@ static int rw_swap_page_base(int rw, swp_entry_t entry, struct page *page, int w
 
 	if (rw == READ) {
 		ClearPageUptodate(page);
-		kstat.pswpin++;
+		kstat_inc(pswpin);
 	} else
-		kstat.pswpout++;
+		kstat_inc(pswpout);
 
 	get_swaphandle_info(entry, &offset, &dev, &swapf);
 	if (dev) {
@@ -60,15 +61,16 @@ static int rw_swap_page_base(int rw, swp_entry_t entry, struct page *page, int w
 		block_size = PAGE_SIZE;
 	} else if (swapf) {
 		int i, j;
-		unsigned int block = offset
-			<< (PAGE_SHIFT - swapf->i_sb->s_blocksize_bits);
+		/* the blocks of a page are contiguous, see setup_swap_extents() */
+		unsigned int block = offset;
 
+		if (!block) {
+			printk("rw_swap_page: bad swap file\n");
+			return 0;
+		}
 		block_size = swapf->i_sb->s_blocksize;
 		for (i=0, j=0; j< PAGE_SIZE ; i++, j += block_size)
-			if (!(zones[i] = bmap(swapf,block++))) {
-				printk("rw_swap_page: bad swap file\n");
-				return 0;
-			}
+			zones[i] = block++;
 		zones_used = i;
 		dev = swapf->i_dev;
 	} else {
@@ -118,6 +120,11 @@ void rw_swap_page(int rw, struct page *page, int wait)
 		PAGE_BUG(page);
 	if (page->mapping != &swapper_space)
 		PAGE_BUG(page);
+	/* the compressed cache in memory comes before the device */
+	if (rw == READ ? compswap_load(entry, page) : compswap_store(entry, page)) {
+		UnlockPage(page);
+		return;
+	}
 	if (!rw_swap_page_base(rw, entry, page, wait))
 		UnlockPage(page);
 }
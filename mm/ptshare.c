@@ -0,0 +1,331 @@
+/*
+ *  linux/mm/ptshare.c
+ *
+ *  Page tables shared between processes.
+ *
+ *  When hundreds of processes map the same large shm segment or file,
+ *  each of them faults in page tables of its own, all holding the same
+ *  ptes. Instead, a page table that lies completely inside a shared
+ *  file mapping is used by every process that maps the same part of
+ *  the file at a page table boundary with the same flags: a process
+ *  that faults on an empty pmd looks for such a table in the other
+ *  mappings of the file, and fork() hands the tables of the shared
+ *  mappings to the child.
+ *
+ *  A shared table is marked PG_ptshared and counted by the count of its
+ *  page. Its ptes are set and cleared with its own lock held (the
+ *  PG_chainlock bit of its page), as well as the page_table_lock of
+ *  the process doing it. The pte chains of the pages it maps have no
+ *  mm, since the process that faulted a page in may go away before the
+ *  others: the reclaim code unmaps them with the lock of the table
+ *  held and flushes the TLBs of all CPUs.
+ *
+ *  A process that is going to change its part of a shared table
+ *  (munmap, mprotect, mlock, mremap, madvise) first makes a private
+ *  copy of it, or simply drops it if the change covers all of the
+ *  table. The last process using a table takes it over as a private
+ *  one again. All of them hold the mmap_sem of the process from the
+ *  unsharing until they are done with the table, so a private table
+ *  is only ever shared with the mmap_sem of its owner taken too: it
+ *  can't turn shared under a change that has found it private.
+ *
+ *  The rss of processes sharing page tables is only approximate.
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/hugetlb.h>
+#include <linux/ptshare.h>
+
+#include <asm/pgalloc.h>
+
+/* Can @vma share the page table that maps @base? */
+static inline int pte_shareable(struct vm_area_struct *vma, unsigned long base)
+{
+	if (!vma->vm_file || !vma->vm_ops || !vma->vm_ops->nopage)
+		return 0;
+	if ((vma->vm_flags & (VM_SHARED | VM_LOCKED | VM_IO | VM_RESERVED)) != VM_SHARED)
+		return 0;
+	return vma->vm_start <= base && base + PMD_SIZE <= vma->vm_end;
+}
+
+/*
+ * Turn the private table of a process into a shared one. Called with
+ * the page_table_lock of that process and the lock of the table held.
+ */
+static void pte_table_set_shared(struct page *ptepage)
+{
+	pte_t *pte = (pte_t *) page_address(ptepage);
+	int i;
+
+	for (i = 0; i < PTRS_PER_PTE; i++, pte++)
+		if (pte_present(*pte))
+			page_rmap_set_owner(pte_page(*pte), pte, NULL, 0);
+	SetPagePtShared(ptepage);
+}
+
+/* The last user of a shared table takes it over */
+static void pte_table_set_owner(struct page *ptepage, struct mm_struct *mm,
+	unsigned long base)
+{
+	pte_t *pte = (pte_t *) page_address(ptepage);
+	int i;
+
+	for (i = 0; i < PTRS_PER_PTE; i++, pte++)
+		if (pte_present(*pte))
+			page_rmap_set_owner(pte_page(*pte), pte, mm,
+					    base + i * PAGE_SIZE);
+	ClearPagePtShared(ptepage);
+}
+
+/*
+ * Look through the other shared mappings of the file for a table that
+ * maps the same part of it as @base in @vma. Returns the table with a
+ * reference taken, or NULL.
+ */
+static struct page * pte_find_shared(struct mm_struct *mm,
+	struct vm_area_struct *vma, unsigned long base)
+{
+	struct address_space *mapping = vma->vm_file->f_dentry->d_inode->i_mapping;
+	unsigned long pgoff = vma->vm_pgoff + ((base - vma->vm_start) >> PAGE_SHIFT);
+	struct vm_area_struct *svma;
+	struct page *ptepage = NULL;
+
+	spin_lock(&mapping->i_shared_lock);
+	for (svma = mapping->i_mmap_shared; svma && !ptepage; svma = svma->vm_next_share) {
+		struct mm_struct *smm = svma->vm_mm;
+		unsigned long sbase;
+		pgd_t *pgd;
+		pmd_t *pmd;
+
+		if (smm == mm || svma->vm_flags != vma->vm_flags ||
+		    pgprot_val(svma->vm_page_prot) != pgprot_val(vma->vm_page_prot))
+			continue;
+		if (pgoff < svma->vm_pgoff ||
+		    pgoff - svma->vm_pgoff >= (svma->vm_end - svma->vm_start) >> PAGE_SHIFT)
+			continue;
+		sbase = svma->vm_start + ((pgoff - svma->vm_pgoff) << PAGE_SHIFT);
+		if ((sbase & ~PMD_MASK) || !pte_shareable(svma, sbase))
+			continue;
+
+		/*
+		 * i_shared_lock keeps svma, and so its page tables, around.
+		 * Leave smm alone if it holds its mmap_sem: it may be about
+		 * to change a table it has found private.
+		 */
+		if (down_trylock(&smm->mmap_sem))
+			continue;
+		spin_lock(&smm->page_table_lock);
+		pgd = pgd_offset(smm, sbase);
+		if (!pgd_none(*pgd) && !pgd_bad(*pgd)) {
+			pmd = pmd_offset(pgd, sbase);
+			if (!pmd_none(*pmd) && !pmd_bad(*pmd) && !pmd_huge(*pmd)) {
+				ptepage = virt_to_page(pmd_page(*pmd));
+				pte_chain_lock(ptepage);
+				if (!PagePtShared(ptepage))
+					pte_table_set_shared(ptepage);
+				get_page(ptepage);
+				pte_chain_unlock(ptepage);
+			}
+		}
+		spin_unlock(&smm->page_table_lock);
+		up(&smm->mmap_sem);
+	}
+	spin_unlock(&mapping->i_shared_lock);
+	return ptepage;
+}
+
+/*
+ * Called from handle_mm_fault(), with the mmap_sem held, when there is
+ * no page table for @address yet.
+ */
+void pte_try_to_share(struct mm_struct *mm, struct vm_area_struct *vma,
+	pmd_t *pmd, unsigned long address)
+{
+	unsigned long base = address & PMD_MASK;
+	struct page *ptepage;
+
+	if (!pte_shareable(vma, base))
+		return;
+	ptepage = pte_find_shared(mm, vma, base);
+	if (!ptepage)
+		return;
+
+	spin_lock(&mm->page_table_lock);
+	if (pmd_none(*pmd)) {
+		pmd_populate(pmd, page_address(ptepage));
+		ptepage = NULL;
+	}
+	spin_unlock(&mm->page_table_lock);
+	if (ptepage)
+		pte_table_free((pte_t *) page_address(ptepage));
+}
+
+/*
+ * Called from copy_page_range() for a present pmd of the parent: let
+ * the child use the table instead of copying it, if it belongs to a
+ * shared mapping. Returns 1 if it did.
+ */
+int pte_share_fork(struct mm_struct *src, struct vm_area_struct *vma,
+	pmd_t *src_pmd, pmd_t *dst_pmd, unsigned long address)
+{
+	struct page *ptepage;
+
+	if (!pte_shareable(vma, address & PMD_MASK))
+		return 0;
+
+	spin_lock(&src->page_table_lock);
+	ptepage = virt_to_page(pmd_page(*src_pmd));
+	pte_chain_lock(ptepage);
+	if (!PagePtShared(ptepage))
+		pte_table_set_shared(ptepage);
+	get_page(ptepage);
+	pte_chain_unlock(ptepage);
+	set_pmd(dst_pmd, *src_pmd);
+	spin_unlock(&src->page_table_lock);
+	return 1;
+}
+
+/*
+ * Make the shared table at @pmd private to @mm: take it over if no one
+ * else uses it any more, copy it otherwise.
+ */
+static int pte_unshare(struct mm_struct *mm, pmd_t *pmd, unsigned long base)
+{
+	struct page *ptepage = virt_to_page(pmd_page(*pmd));
+	struct pte_chain *pte_chain = NULL;
+	int i, need, have = 0;
+	pte_t *new, *pte;
+
+	new = (pte_t *) __get_free_page(GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+	clear_page(new);
+
+again:
+	spin_lock(&mm->page_table_lock);
+	pte_chain_lock(ptepage);
+	if (page_count(ptepage) == 1) {
+		pte_table_set_owner(ptepage, mm, base);
+		pte_chain_unlock(ptepage);
+		spin_unlock(&mm->page_table_lock);
+		pte_chain_free(pte_chain);
+		free_page((unsigned long) new);
+		return 0;
+	}
+
+	/*
+	 * Every page mapped needs a chain entry for our copy of its pte.
+	 * The other users may map more pages while we allocate them.
+	 */
+	need = 0;
+	pte = (pte_t *) page_address(ptepage);
+	for (i = 0; i < PTRS_PER_PTE; i++, pte++)
+		if (pte_present(*pte))
+			need++;
+	if (need > have) {
+		pte_chain_unlock(ptepage);
+		spin_unlock(&mm->page_table_lock);
+		if (pte_chain_alloc(&pte_chain, need - have, GFP_KERNEL)) {
+			pte_chain_free(pte_chain);
+			free_page((unsigned long) new);
+			return -ENOMEM;
+		}
+		have = need;
+		goto again;
+	}
+
+	pte = (pte_t *) page_address(ptepage);
+	for (i = 0; i < PTRS_PER_PTE; i++, pte++) {
+		pte_t entry = *pte;
+		struct page *page;
+
+		if (pte_none(entry))
+			continue;
+		set_pte(new + i, entry);
+		if (!pte_present(entry)) {
+			swap_duplicate(pte_to_swp_entry(entry));
+			continue;
+		}
+		page = pte_page(entry);
+		if (!VALID_PAGE(page) || PageReserved(page))
+			continue;
+		get_page(page);
+		page_add_rmap(page, new + i, mm, base + i * PAGE_SIZE, &pte_chain);
+		mm->rss++;
+	}
+	pmd_populate(pmd, new);
+	atomic_dec(&ptepage->count);
+	pte_chain_unlock(ptepage);
+	flush_tlb_range(mm, base, base + PMD_SIZE);
+	spin_unlock(&mm->page_table_lock);
+	pte_chain_free(pte_chain);
+	return 0;
+}
+
+/*
+ * Make sure that no page table in [start, end) is shared, before the
+ * caller changes or unmaps that range. A table that lies in the range
+ * completely is just dropped; its pages are faulted in again if need
+ * be. The caller holds the mmap_sem of @mm, which keeps the tables
+ * found private here from being shared until it is done.
+ */
+int unshare_page_range(struct mm_struct *mm, unsigned long start, unsigned long end)
+{
+	unsigned long base;
+
+	for (base = start & PMD_MASK; base < end; base += PMD_SIZE) {
+		struct page *ptepage;
+		int dropped = 0;
+		pgd_t *pgd;
+		pmd_t *pmd;
+
+		pgd = pgd_offset(mm, base);
+		if (pgd_none(*pgd) || pgd_bad(*pgd))
+			continue;
+		pmd = pmd_offset(pgd, base);
+		if (pmd_none(*pmd) || pmd_bad(*pmd) || pmd_huge(*pmd))
+			continue;
+		ptepage = virt_to_page(pmd_page(*pmd));
+		if (!PagePtShared(ptepage))
+			continue;
+
+		if (start <= base && base + PMD_SIZE <= end) {
+			spin_lock(&mm->page_table_lock);
+			pte_chain_lock(ptepage);
+			if (page_count(ptepage) > 1) {
+				pmd_clear(pmd);
+				atomic_dec(&ptepage->count);
+				dropped = 1;
+			}
+			pte_chain_unlock(ptepage);
+			if (dropped)
+				flush_tlb_range(mm, base, base + PMD_SIZE);
+			spin_unlock(&mm->page_table_lock);
+		}
+		if (!dropped && pte_unshare(mm, pmd, base))
+			return -ENOMEM;
+	}
+	return 0;
+}
+
+/*
+ * Called instead of pte_free() for a table that may be shared: only
+ * the last user frees it.
+ */
+void pte_table_free(pte_t *pte)
+{
+	struct page *ptepage = virt_to_page(pte);
+
+	if (PagePtShared(ptepage)) {
+		pte_chain_lock(ptepage);
+		if (page_count(ptepage) > 1) {
+			atomic_dec(&ptepage->count);
+			pte_chain_unlock(ptepage);
+			return;
+		}
+		pte_chain_unlock(ptepage);
+	}
+	pte_free(pte);
+}
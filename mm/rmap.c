@@ -0,0 +1,349 @@
+/*
+ *  linux/mm/rmap.c
+ *
+ *  Reverse mapping of user pages.
+ *
+ *  Every page that is mapped into a process keeps a chain of the ptes
+ *  that map it. The page reclaim code can then look at, and unmap, one
+ *  page at a time, instead of walking all page tables of all processes
+ *  (the old swap_out()) to find the few ptes that map the pages it
+ *  wants to get rid of.
+ *
+ *  The chain of a page is protected by the PG_chainlock bit in its
+ *  flags. The code that sets up and tears down ptes changes the chain
+ *  with the page_table_lock of the mm held, so the unmap side, which
+ *  comes from the page, can only trylock the page_table_lock.
+ *
+ *  A pte in a page table shared by several processes (mm/ptshare.c)
+ *  has a chain entry without an mm. It is unmapped under the lock of
+ *  the table instead.
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/swapctl.h>
+#include <linux/pagemap.h>
+#include <linux/init.h>
+
+#include <asm/pgalloc.h>
+
+/*
+ * One entry for every pte that maps the page. The mm and address are
+ * kept here since we can't get at them from the pte on all
+ * architectures.
+ */
+struct pte_chain {
+	struct pte_chain * next;
+	pte_t * ptep;
+	struct mm_struct * mm;
+	unsigned long address;
+};
+
+static kmem_cache_t *pte_chain_cache;
+
+/*
+ * Allocate @nr chain entries for page_add_rmap(), in front of the list
+ * at *@pcp. The ptes are set up with the page_table_lock held, so the
+ * entries are allocated before it is taken, and a fault that can't get
+ * them fails with OOM instead of leaving a pte the reclaim code can't
+ * find. Returns -ENOMEM if it could not get all of them.
+ */
+int pte_chain_alloc(struct pte_chain ** pcp, int nr, int gfp_mask)
+{
+	while (nr-- > 0) {
+		struct pte_chain * pc = kmem_cache_alloc(pte_chain_cache, gfp_mask);
+
+		if (!pc)
+			return -ENOMEM;
+		pc->next = *pcp;
+		*pcp = pc;
+	}
+	return 0;
+}
+
+/* Free a list of chain entries that page_add_rmap() didn't use */
+void pte_chain_free(struct pte_chain * pc)
+{
+	while (pc) {
+		struct pte_chain * next = pc->next;
+
+		kmem_cache_free(pte_chain_cache, pc);
+		pc = next;
+	}
+}
+
+/*
+ * Called after the pte has been set up, with an entry taken off the
+ * list at *@pcp.
+ */
+void page_add_rmap(struct page * page, pte_t * ptep, struct mm_struct * mm,
+	unsigned long address, struct pte_chain ** pcp)
+{
+	struct pte_chain * pc;
+
+	if (!VALID_PAGE(page) || PageReserved(page))
+		return;
+
+	pc = *pcp;
+	if (!pc)
+		BUG();
+	*pcp = pc->next;
+	if (PagePtShared(virt_to_page(ptep)))
+		mm = NULL;
+	pc->ptep = ptep;
+	pc->mm = mm;
+	pc->address = address & PAGE_MASK;
+
+	pte_chain_lock(page);
+	pc->next = page->pte_chain;
+	page->pte_chain = pc;
+	pte_chain_unlock(page);
+}
+
+/*
+ * Called with the page_table_lock held, when the pte is cleared or
+ * about to be.
+ */
+void page_remove_rmap(struct page * page, pte_t * ptep)
+{
+	struct pte_chain * pc, ** pprev;
+
+	if (!VALID_PAGE(page) || PageReserved(page))
+		return;
+
+	pte_chain_lock(page);
+	for (pprev = &page->pte_chain; (pc = *pprev) != NULL; pprev = &pc->next) {
+		if (pc->ptep == ptep) {
+			*pprev = pc->next;
+			break;
+		}
+	}
+	pte_chain_unlock(page);
+
+	if (pc)
+		kmem_cache_free(pte_chain_cache, pc);
+}
+
+/*
+ * Called by mremap() with the page_table_lock held, when the pte at
+ * @old has been moved to @new.
+ */
+void page_move_rmap(struct page * page, pte_t * old, pte_t * new,
+	struct mm_struct * mm, unsigned long address)
+{
+	struct pte_chain * pc;
+
+	if (!VALID_PAGE(page) || PageReserved(page))
+		return;
+
+	if (PagePtShared(virt_to_page(new)))
+		mm = NULL;
+	pte_chain_lock(page);
+	for (pc = page->pte_chain; pc; pc = pc->next) {
+		if (pc->ptep == old) {
+			pc->ptep = new;
+			pc->mm = mm;
+			pc->address = address & PAGE_MASK;
+			break;
+		}
+	}
+	pte_chain_unlock(page);
+}
+
+/*
+ * Change the mm and address of the chain entry for @ptep, when its
+ * page table becomes shared, or private again.
+ */
+void page_rmap_set_owner(struct page * page, pte_t * ptep, struct mm_struct * mm,
+	unsigned long address)
+{
+	struct pte_chain * pc;
+
+	if (!VALID_PAGE(page) || PageReserved(page))
+		return;
+
+	pte_chain_lock(page);
+	for (pc = page->pte_chain; pc; pc = pc->next) {
+		if (pc->ptep == ptep) {
+			pc->mm = mm;
+			pc->address = address & PAGE_MASK;
+			break;
+		}
+	}
+	pte_chain_unlock(page);
+}
+
+/*
+ * Test and clear the accessed bit of all the ptes mapping the page.
+ * Returns the number of ptes that had it set.
+ */
+int page_referenced(struct page * page)
+{
+	struct pte_chain * pc;
+	int referenced = 0;
+
+	if (!page->pte_chain)
+		return 0;
+
+	pte_chain_lock(page);
+	for (pc = page->pte_chain; pc; pc = pc->next)
+		if (ptep_test_and_clear_young(pc->ptep))
+			referenced++;
+	pte_chain_unlock(page);
+	return referenced;
+}
+
+/*
+ * Unmap a pte in a shared page table. The table is never part of a
+ * locked area, and any CPU may have the pte in its TLB.
+ */
+static int try_to_unmap_shared(struct page * page, struct pte_chain * pc, int * dirty)
+{
+	struct page * ptepage = virt_to_page(pc->ptep);
+	pte_t pte;
+	int ret;
+
+	if (!pte_chain_trylock(ptepage))
+		return SWAP_AGAIN;
+
+	ret = SWAP_AGAIN;
+	if (!pte_present(*pc->ptep) || pte_page(*pc->ptep) != page)
+		goto out_unlock;
+	ret = SWAP_FAIL;
+	if (ptep_test_and_clear_young(pc->ptep))
+		goto out_unlock;
+
+	flush_cache_all();
+	pte = ptep_get_and_clear(pc->ptep);
+	flush_tlb_all();
+
+	if (PageSwapCache(page)) {
+		swp_entry_t entry;
+
+		entry.val = page->index;
+		swap_duplicate(entry);
+		set_pte(pc->ptep, swp_entry_to_pte(entry));
+	}
+	if (pte_dirty(pte))
+		*dirty = 1;
+
+	page_cache_release(page);
+	ret = SWAP_SUCCESS;
+
+out_unlock:
+	pte_chain_unlock(ptepage);
+	return ret;
+}
+
+/*
+ * Unmap one pte. The page is in the page cache or the swap cache, so
+ * the reference we drop here can't be the last one.
+ */
+static int try_to_unmap_one(struct page * page, struct pte_chain * pc, int * dirty)
+{
+	struct mm_struct * mm = pc->mm;
+	unsigned long address = pc->address;
+	struct vm_area_struct * vma;
+	pte_t pte;
+	int ret;
+
+	if (!mm)
+		return try_to_unmap_shared(page, pc, dirty);
+
+	if (!spin_trylock(&mm->page_table_lock))
+		return SWAP_AGAIN;
+
+	/* a fault may not have set the pte yet, or raced with us */
+	ret = SWAP_AGAIN;
+	if (!pte_present(*pc->ptep) || pte_page(*pc->ptep) != page)
+		goto out_unlock;
+
+	/* Don't unmap areas which are locked down, nor recently used pages */
+	ret = SWAP_FAIL;
+	vma = find_vma(mm, address);
+	if (!vma || (vma->vm_flags & (VM_LOCKED|VM_RESERVED)))
+		goto out_unlock;
+	if (ptep_test_and_clear_young(pc->ptep))
+		goto out_unlock;
+
+	flush_cache_page(vma, address);
+	pte = ptep_get_and_clear(pc->ptep);
+	flush_tlb_page(vma, address);
+
+	if (PageSwapCache(page)) {
+		swp_entry_t entry;
+
+		entry.val = page->index;
+		swap_duplicate(entry);
+		set_pte(pc->ptep, swp_entry_to_pte(entry));
+	}
+	if (pte_dirty(pte))
+		*dirty = 1;
+
+	mm->rss--;
+	page_cache_release(page);
+	ret = SWAP_SUCCESS;
+
+out_unlock:
+	spin_unlock(&mm->page_table_lock);
+	return ret;
+}
+
+/**
+ * try_to_unmap - unmap a page from all the processes that map it
+ * @page: the page, locked, in the page cache or the swap cache
+ *
+ * Returns SWAP_SUCCESS if all ptes are gone, SWAP_AGAIN if some could
+ * not be unmapped right now and SWAP_FAIL if the page is mlocked or
+ * still in use. Must not be called with a zone lru_lock held:
+ * set_page_dirty() takes the pagecache_lock, and that nests outside
+ * the lru_lock, which nests outside the chain lock.
+ */
+int try_to_unmap(struct page * page)
+{
+	struct pte_chain * pc, ** pprev, * free = NULL;
+	int ret = SWAP_SUCCESS, dirty = 0;
+
+	if (!PageLocked(page) || !page->mapping)
+		BUG();
+
+	pte_chain_lock(page);
+	pprev = &page->pte_chain;
+	while ((pc = *pprev) != NULL) {
+		switch (try_to_unmap_one(page, pc, &dirty)) {
+		case SWAP_SUCCESS:
+			*pprev = pc->next;
+			pc->next = free;
+			free = pc;
+			continue;
+		case SWAP_AGAIN:
+			if (ret == SWAP_SUCCESS)
+				ret = SWAP_AGAIN;
+			break;
+		case SWAP_FAIL:
+			ret = SWAP_FAIL;
+			break;
+		}
+		pprev = &pc->next;
+	}
+	pte_chain_unlock(page);
+
+	if (dirty)
+		set_page_dirty(page);
+	while (free) {
+		pc = free;
+		free = pc->next;
+		kmem_cache_free(pte_chain_cache, pc);
+	}
+	return ret;
+}
+
+void __init pte_chain_init(void)
+{
+	pte_chain_cache = kmem_cache_create("pte_chain", sizeof(struct pte_chain),
+					    0, 0, NULL, NULL);
+	if (!pte_chain_cache)
+		panic("Cannot create pte_chain SLAB cache");
+}
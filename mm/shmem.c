@@ -30,6 +30,7 @@
 #include <linux/pagemap.h>
 #include <linux/string.h>
 #include <linux/locks.h>
+#include <linux/hugetlb.h>
 #include <asm/smplock.h>
 
 #include <asm/uaccess.h>
@@ -187,6 +188,8 @@ static void shmem_delete_inode(struct inode * inode)
 	list_del (&inode->u.shmem_i.list);
 	spin_unlock (&shmem_ilock);
 	inode->i_size = 0;
+	if (is_hugetlb_inode(inode))
+		hugetlb_truncate(inode);
 	shmem_truncate (inode);
 	spin_lock (&info->stat_lock);
 	info->free_inodes++;
@@ -206,6 +209,9 @@ static int shmem_writepage(struct page * page)
 	info = &page->mapping->host->u.shmem_i;
 	if (info->locked)
 		return 1;
+	/* moving the page to the swap cache must not fail halfway */
+	if (radix_tree_preload(GFP_ATOMIC))
+		return 1;
 	swap = __get_swap_page(2);
 	if (!swap.val)
 		return 1;
@@ -227,7 +233,8 @@ static int shmem_writepage(struct page * page)
 	remove_inode_page(page);
 
 	/* Add it to the swap cache */
-	add_to_swap_cache(page, swap);
+	if (add_to_swap_cache(page, swap))
+		BUG();
 	page_cache_release(page);
 	set_page_dirty(page);
 	info->swapped++;
@@ -264,7 +271,7 @@ struct page * shmem_nopage(struct vm_area_struct * vma, unsigned long address, i
 		goto out;
 
 	/* retry, we may have slept */
-	page = __find_lock_page(mapping, idx, page_hash (mapping, idx));
+	page = find_lock_page(mapping, idx);
 	if (page)
 		goto cached_page;
 
@@ -287,14 +294,20 @@ struct page * shmem_nopage(struct vm_area_struct * vma, unsigned long address, i
 		}
 
 		/* We have to this with page locked to prevent races */
+		lock_page(page);
+		if (radix_tree_preload(GFP_KERNEL)) {
+			UnlockPage(page);
+			page_cache_release(page);
+			goto oom;
+		}
 		spin_lock (&info->lock);
 		swap_free(*entry);
-		lock_page(page);
 		delete_from_swap_cache_nolock(page);
 		*entry = (swp_entry_t) {0};
 		flags = page->flags & ~((1 << PG_uptodate) | (1 << PG_error) | (1 << PG_referenced) | (1 << PG_arch_1));
 		page->flags = flags | (1 << PG_dirty);
-		add_to_page_cache_locked(page, mapping, idx);
+		if (add_to_page_cache_locked(page, mapping, idx))
+			BUG();
 		info->swapped--;
 		spin_unlock (&info->lock);
 	} else {
@@ -308,8 +321,12 @@ struct page * shmem_nopage(struct vm_area_struct * vma, unsigned long address, i
 		if (!page)
 			goto oom;
 		clear_user_highpage(page, address);
+		if (radix_tree_preload(GFP_KERNEL) ||
+		    add_to_page_cache (page, mapping, idx)) {
+			page_cache_free(page);
+			goto oom;
+		}
 		inode->i_blocks++;
-		add_to_page_cache (page, mapping, idx);
 	}
 	/* We have the page */
 	SetPageUptodate (page);
@@ -324,6 +341,7 @@ cached_page:
 		if (new_page) {
 			copy_user_highpage(new_page, page, address);
 			flush_page_to_ram(new_page);
+			lru_cache_add_anon(new_page);
 		} else
 			new_page = NOPAGE_OOM;
 		page_cache_release(page);
@@ -772,7 +790,9 @@ out:
 	spin_unlock (&info->lock);
 	return 0;
 found:
-	add_to_page_cache(page, inode->i_mapping, offset + idx);
+	/* shmem_unuse() did the radix_tree_preload() */
+	if (add_to_page_cache(page, inode->i_mapping, offset + idx))
+		BUG();
 	set_page_dirty(page);
 	SetPageUptodate(page);
 	UnlockPage(page);
@@ -789,6 +809,11 @@ void shmem_unuse(swp_entry_t entry, struct page *page)
 	struct list_head *p;
 	struct inode * inode;
 
+	/* the page can't go back to the page cache halfway */
+	while (radix_tree_preload(GFP_KERNEL)) {
+		current->policy |= SCHED_YIELD;
+		schedule();
+	}
 	spin_lock (&shmem_ilock);
 	list_for_each(p, &shmem_inodes) {
 		inode = list_entry(p, struct inode, u.shmem_i.list);
@@ -800,26 +825,15 @@ void shmem_unuse(swp_entry_t entry, struct page *page)
 }
 
 
-/*
- * shmem_file_setup - get an unlinked file living in shmem fs
- *
- * @name: name for dentry (to be seen in /proc/<pid>/maps
- * @size: size to be set for the file
- *
- */
-struct file *shmem_file_setup(char * name, loff_t size)
+static struct file *__shmem_file_setup(char * name, loff_t size)
 {
 	int error;
 	struct file *file;
 	struct inode * inode;
 	struct dentry *dentry, *root;
 	struct qstr this;
-	int vm_enough_memory(long pages);
 
 	error = -ENOMEM;
-	if (!vm_enough_memory((size) >> PAGE_SHIFT))
-		goto out;
-
 	this.name = name;
 	this.len = strlen(name);
 	this.hash = 0; /* will go */
@@ -855,6 +869,72 @@ out:
 	return ERR_PTR(error);	
 }
 
+/*
+ * shmem_file_setup - get an unlinked file living in shmem fs
+ *
+ * @name: name for dentry (to be seen in /proc/<pid>/maps
+ * @size: size to be set for the file
+ *
+ */
+struct file *shmem_file_setup(char * name, loff_t size)
+{
+	int vm_enough_memory(long pages);
+
+	if (!vm_enough_memory((size) >> PAGE_SHIFT))
+		return ERR_PTR(-ENOMEM);
+	return __shmem_file_setup(name, size);
+}
+
+#ifdef CONFIG_HUGETLB_PAGE
+/*
+ * hugetlb_file_setup - get an unlinked shmem file backed by huge pages
+ *
+ * @name: name for dentry (to be seen in /proc/<pid>/maps
+ * @size: size to be set for the file
+ *
+ * The huge pages for the whole file are reserved from the pool here,
+ * see mm/hugetlb.c.
+ */
+struct file *hugetlb_file_setup(char * name, loff_t size)
+{
+	unsigned long nr = (size + HPAGE_SIZE - 1) >> HPAGE_SHIFT;
+	struct inode *inode;
+	struct file *file;
+
+	if (hugetlb_reserve(nr))
+		return ERR_PTR(-ENOMEM);
+	file = __shmem_file_setup(name, size);
+	if (IS_ERR(file)) {
+		hugetlb_unreserve(nr);
+		return file;
+	}
+	inode = file->f_dentry->d_inode;
+	inode->i_op = &hugetlb_inode_operations;
+	inode->u.shmem_i.huge_reserved = nr;
+	return file;
+}
+
+/*
+ * hugetlb_zero_setup - setup an anonymous mapping backed by huge pages
+ *
+ * @vma: the vma to be mmapped is prepared by do_mmap_pgoff
+ */
+int hugetlb_zero_setup(struct vm_area_struct *vma)
+{
+	struct file *file;
+	loff_t size = vma->vm_end - vma->vm_start;
+
+	file = hugetlb_file_setup("dev/zero", size);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	if (vma->vm_file)
+		fput (vma->vm_file);
+	vma->vm_file = file;
+	return 0;
+}
+#endif
+
 /*
  * shmem_zero_setup - setup a shared anonymous mapping
  *
@@ -45,6 +45,12 @@
  *
  * The c_cpuarray may not be read with enabled local interrupts.
  *
+ * Between the per-cpu arrays and the slab lists, each cache keeps a depot
+ * of full and empty magazines of batchcount objects. An array that runs
+ * empty or full exchanges a magazine with the depot, under the short held
+ * depot_lock, before it falls back to the slab lists and the cache
+ * spinlock.
+ *
  * SMP synchronization:
  *  constructors and destructors are called without any locking.
  *  Several members in kmem_cache_t and slab_t never change, they
@@ -176,6 +182,20 @@ typedef struct cpucache_s {
 /* cpucache_t{} 结构体后的指针数组 */
 #define cc_entry(cpucache) \
 	((void **)(((cpucache_t*)cpucache)+1))
+
+/*
+ * magazine_t
+ *
+ * A full magazine holds size objects, an empty one has room for them.
+ * The pointers follow the structure, as for cpucache_t.
+ */
+typedef struct magazine_s {
+	struct list_head	list;
+	unsigned int		size;
+} magazine_t;
+
+#define mag_entry(mag) \
+	((void **)(((magazine_t*)mag)+1))
 /* kmem_cache_t{} 中的cpudata 数组，每个CPU 占一个元素 */
 #define cc_data(cachep) \
 	((cachep)->cpudata[smp_processor_id()])
@@ -228,6 +248,19 @@ struct kmem_cache_s {
 #ifdef CONFIG_SMP
 /* 4) per-cpu data */
 	cpucache_t		*cpudata[NR_CPUS];
+
+/* 5) magazine depot, protected by depot_lock */
+	spinlock_t		depot_lock;
+	struct list_head	depot_full;
+	struct list_head	depot_empty;
+	unsigned int		depot_nfull;
+	unsigned int		depot_nempty;
+	unsigned int		depot_limit;	/* max # of full magazines */
+	unsigned int		depot_minfull;	/* fewest full since last reap */
+	unsigned int		depot_window;	/* accesses since last resize */
+	unsigned int		depot_wmiss;	/* misses since last resize */
+	unsigned long		depot_hits;
+	unsigned long		depot_misses;
 #endif
 #if STATS
 	unsigned long		num_active;
@@ -306,6 +339,18 @@ struct kmem_cache_s {
 
 #endif
 
+#ifdef CONFIG_SMP
+/*
+ * The number of full magazines a depot may hold grows by one whenever
+ * more than 1/DEPOT_MISS_RATIO of the last DEPOT_WINDOW depot accesses
+ * missed, up to DEPOT_MAX. The reaper shrinks it again.
+ */
+#define	DEPOT_MIN		2
+#define	DEPOT_MAX		16
+#define	DEPOT_WINDOW		64
+#define	DEPOT_MISS_RATIO	8
+#endif
+
 /* maximum size of an obj (in 2^order pages) */
 #define	MAX_OBJ_ORDER	5	/* 32 pages */
 
@@ -368,6 +413,12 @@ static kmem_cache_t cache_cache = {
 	spinlock:	SPIN_LOCK_UNLOCKED,
 	colour_off:	L1_CACHE_BYTES,
 	name:		"kmem_cache",
+#ifdef CONFIG_SMP
+	depot_lock:	SPIN_LOCK_UNLOCKED,
+	depot_full:	LIST_HEAD_INIT(cache_cache.depot_full),
+	depot_empty:	LIST_HEAD_INIT(cache_cache.depot_empty),
+	depot_limit:	DEPOT_MIN,
+#endif
 };
 
 /* Guard access to the cache-chain. */
@@ -833,6 +884,10 @@ next:
 	strcpy(cachep->name, name);
 
 #ifdef CONFIG_SMP
+	spin_lock_init(&cachep->depot_lock);
+	INIT_LIST_HEAD(&cachep->depot_full);
+	INIT_LIST_HEAD(&cachep->depot_empty);
+	cachep->depot_limit = DEPOT_MIN;
 	if (g_cpucache_up)
 		enable_cpucache(cachep);
 #endif
@@ -916,6 +971,161 @@ static void do_ccupdate_local(void *info)
 
 static void free_block (kmem_cache_t* cachep, void** objpp, int len);
 
+/* Count a depot access and resize the depot; depot_lock held */
+static inline void kmem_depot_account(kmem_cache_t *cachep, int hit)
+{
+	if (hit)
+		cachep->depot_hits++;
+	else {
+		cachep->depot_misses++;
+		cachep->depot_wmiss++;
+	}
+	if (++cachep->depot_window < DEPOT_WINDOW)
+		return;
+	if (cachep->depot_wmiss*DEPOT_MISS_RATIO > DEPOT_WINDOW &&
+	    cachep->depot_limit < DEPOT_MAX)
+		cachep->depot_limit++;
+	cachep->depot_window = 0;
+	cachep->depot_wmiss = 0;
+}
+
+/*
+ * The array of this cpu is empty: refill it from a full magazine.
+ * Returns 0 if the depot has none.
+ * called with disabled ints
+ */
+static int kmem_depot_get(kmem_cache_t *cachep, cpucache_t *cc)
+{
+	magazine_t *mag = NULL;
+
+	spin_lock(&cachep->depot_lock);
+	if (!list_empty(&cachep->depot_full)) {
+		mag = list_entry(cachep->depot_full.next, magazine_t, list);
+		if (mag->size > cc->limit - cc->avail)
+			mag = NULL;	/* left over from before a tune */
+	}
+	kmem_depot_account(cachep, mag != NULL);
+	if (mag) {
+		memcpy(&cc_entry(cc)[cc->avail], mag_entry(mag),
+		       mag->size*sizeof(void *));
+		cc->avail += mag->size;
+		list_del(&mag->list);
+		if (--cachep->depot_nfull < cachep->depot_minfull)
+			cachep->depot_minfull = cachep->depot_nfull;
+		list_add(&mag->list, &cachep->depot_empty);
+		cachep->depot_nempty++;
+	}
+	spin_unlock(&cachep->depot_lock);
+	return mag != NULL;
+}
+
+/*
+ * The array of this cpu is full: move batchcount objects from it into
+ * an empty magazine. Returns 0 if the depot has no room for them.
+ * called with disabled ints
+ */
+static int kmem_depot_put(kmem_cache_t *cachep, cpucache_t *cc)
+{
+	magazine_t *mag = NULL;
+
+	spin_lock(&cachep->depot_lock);
+	if (cachep->depot_nfull >= cachep->depot_limit)
+		goto out;
+	if (list_empty(&cachep->depot_empty)) {
+		/*
+		 * Grow the depot by one magazine. The array is still
+		 * consistent, in case the magazine comes from this cache.
+		 */
+		spin_unlock(&cachep->depot_lock);
+		mag = kmalloc(sizeof(magazine_t) +
+			      cachep->batchcount*sizeof(void *), GFP_ATOMIC);
+		spin_lock(&cachep->depot_lock);
+		if (!mag)
+			goto out;
+		mag->size = cachep->batchcount;
+	} else {
+		mag = list_entry(cachep->depot_empty.next, magazine_t, list);
+		list_del(&mag->list);
+		cachep->depot_nempty--;
+	}
+	if (mag->size > cc->avail) {
+		/* left over from before a tune */
+		list_add(&mag->list, &cachep->depot_empty);
+		cachep->depot_nempty++;
+		mag = NULL;
+		goto out;
+	}
+	cc->avail -= mag->size;
+	memcpy(mag_entry(mag), &cc_entry(cc)[cc->avail],
+	       mag->size*sizeof(void *));
+	list_add(&mag->list, &cachep->depot_full);
+	cachep->depot_nfull++;
+out:
+	kmem_depot_account(cachep, mag != NULL);
+	spin_unlock(&cachep->depot_lock);
+	return mag != NULL;
+}
+
+/*
+ * Give the objects of full magazines back to the slabs and free the
+ * magazines that aren't needed any more: all of them, or if @trim, the
+ * ones that weren't used since the last trim. In the latter case the
+ * depot shrinks accordingly.
+ */
+static void kmem_depot_shrink(kmem_cache_t *cachep, int trim)
+{
+	struct list_head full, empty;
+	unsigned int keep, keep_empty;
+
+	INIT_LIST_HEAD(&full);
+	INIT_LIST_HEAD(&empty);
+	spin_lock_irq(&cachep->depot_lock);
+	keep = keep_empty = 0;
+	if (trim) {
+		unsigned int unused = cachep->depot_minfull;
+
+		keep = cachep->depot_nfull - unused;
+		if (cachep->depot_limit >= unused + DEPOT_MIN)
+			cachep->depot_limit -= unused;
+		else
+			cachep->depot_limit = DEPOT_MIN;
+		if (cachep->depot_limit > keep)
+			keep_empty = cachep->depot_limit - keep;
+	}
+	while (cachep->depot_nfull > keep) {
+		struct list_head *p = cachep->depot_full.next;
+
+		list_del(p);
+		list_add(p, &full);
+		cachep->depot_nfull--;
+	}
+	while (cachep->depot_nempty > keep_empty) {
+		struct list_head *p = cachep->depot_empty.next;
+
+		list_del(p);
+		list_add(p, &empty);
+		cachep->depot_nempty--;
+	}
+	cachep->depot_minfull = cachep->depot_nfull;
+	spin_unlock_irq(&cachep->depot_lock);
+
+	while (!list_empty(&full)) {
+		magazine_t *mag = list_entry(full.next, magazine_t, list);
+
+		list_del(&mag->list);
+		local_irq_disable();
+		free_block(cachep, mag_entry(mag), mag->size);
+		local_irq_enable();
+		kfree(mag);
+	}
+	while (!list_empty(&empty)) {
+		magazine_t *mag = list_entry(empty.next, magazine_t, list);
+
+		list_del(&mag->list);
+		kfree(mag);
+	}
+}
+
 /*
  * 释放所有的CPU 缓存
  */
@@ -943,6 +1153,7 @@ static void drain_cpu_caches(kmem_cache_t *cachep)
 		ccold->avail = 0;
 	}
 	smp_call_function_all_cpus(do_ccupdate_local, (void *)&new);
+	kmem_depot_shrink(cachep, 0);
 	up(&cache_chain_sem);	//释放信号量
 }
 
@@ -1357,6 +1568,9 @@ void* kmem_cache_alloc_batch(kmem_cache_t* cachep, int flags)
 	int batchcount = cachep->batchcount;
 	cpucache_t* cc = cc_data(cachep);
 
+	if (kmem_depot_get(cachep, cc))
+		return cc_entry(cc)[--cc->avail];
+
 	spin_lock(&cachep->spinlock);
 	while (batchcount--) {
 		/* Get slab alloc is to come from. */
@@ -1580,9 +1794,11 @@ static inline void __kmem_cache_free (kmem_cache_t *cachep, void* objp)
 			return;
 		}
 		STATS_INC_FREEMISS(cachep);
-		batchcount = cachep->batchcount;
-		cc->avail -= batchcount;
-		free_block(cachep, &cc_entry(cc)[cc->avail], batchcount);
+		if (!kmem_depot_put(cachep, cc)) {
+			batchcount = cachep->batchcount;
+			cc->avail -= batchcount;
+			free_block(cachep, &cc_entry(cc)[cc->avail], batchcount);
+		}
 		cc_entry(cc)[cc->avail++] = objp;
 		return;
 	} else {
@@ -1764,6 +1980,8 @@ static int kmem_tune_cpucache (kmem_cache_t* cachep, int limit, int batchcount)
 		local_irq_enable();
 		kfree(ccold);
 	}
+	/* the magazines have the old batchcount */
+	kmem_depot_shrink(cachep, 0);
 	return 0;
 oom:
 	for (i--; i >= 0; i--)
@@ -1846,6 +2064,9 @@ void kmem_cache_reap (int gfp_mask)
 		/* It's safe to test this without holding the cache-lock. */
 		if (searchp->flags & SLAB_NO_REAP)
 			goto next;
+#ifdef CONFIG_SMP
+		kmem_depot_shrink(searchp, 1);
+#endif
 		spin_lock_irq(&searchp->spinlock);	//加锁
 		if (searchp->growing)
 			goto next_unlock;
@@ -1971,7 +2192,7 @@ static int proc_getdata (char*page, char**start, off_t off, int count)
 	/* Output format version, so at least we can change it without _too_
 	 * many complaints.
 	 */
-	len += sprintf(page+len, "slabinfo - version: 1.1"
+	len += sprintf(page+len, "slabinfo - version: 1.2"
 #if STATS
 				" (statistics)"
 #endif
@@ -2049,6 +2270,12 @@ static int proc_getdata (char*page, char**start, off_t off, int count)
 			len += sprintf(page+len, " : %6lu %6lu %6lu %6lu",
 					allochit, allocmiss, freehit, freemiss);
 		}
+#endif
+#ifdef CONFIG_SMP
+		/* 输出magazine depot 信息 */
+		len += sprintf(page+len, " : %4u %4u %8lu %8lu",
+				cachep->depot_limit, cachep->depot_nfull,
+				cachep->depot_hits, cachep->depot_misses);
 #endif
 		len += sprintf(page+len,"\n");
 		spin_unlock_irq(&cachep->spinlock);
@@ -2081,6 +2308,7 @@ got_data:
  * total-slabs
  * num-pages-per-slab
  * + further values on SMP and with statistics enabled
+ * + on SMP, the magazine depot limit, full magazines, hits and misses
  */
 int slabinfo_read_proc (char *page, char **start, off_t off,
 				 int count, int *eof, void *data)
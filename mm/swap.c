@@ -18,6 +18,7 @@
 #include <linux/swap.h>
 #include <linux/swapctl.h>
 #include <linux/pagemap.h>
+#include <linux/pagevec.h>
 #include <linux/init.h>
 
 #include <asm/dma.h>
@@ -81,10 +82,10 @@ pager_daemon_t pager_daemon = {
 /**
  * age_page_{up,down} -	page aging helper functions
  * @page - the page we want to age
- * @nolock - are we already holding the pagelist_lru_lock?
+ * @nolock - are we already holding the lru_lock of the page's zone?
  *
  * If the page is on one of the lists (active, inactive_dirty or
- * inactive_clean), we will grab the pagelist_lru_lock as needed.
+ * inactive_clean), we will grab the zone's lru_lock as needed.
  * If you're already holding the lock, call this function with the
  * nolock argument non-zero.
  */
@@ -158,7 +159,7 @@ void age_page_down(struct page * page)
  * (de)activate_page - move pages from/to active and inactive lists
  *                   - 将页面从active 移到inactive 表中
  * @page: the page we want to move
- * @nolock - are we already holding the pagemap_lru_lock?
+ * @nolock - are we already holding the lru_lock of the page's zone?
  *
  * Deactivate_page will move an active page to the right
  * inactive list, while activate_page will move a page back
@@ -184,7 +185,8 @@ void deactivate_page_nolock(struct page * page)
 	 * Don't touch it if it's not on the active list.
 	 * (some pages aren't on any list at all)
 	 */
-	if (PageActive(page) && page_count(page) <= maxcount && !page_ramdisk(page)) {
+	if (PageActive(page) && (page_count(page) <= maxcount || page->pte_chain) &&
+			!page_ramdisk(page)) {
 		del_page_from_active_list(page);
 		add_page_to_inactive_dirty_list(page);
 	}
@@ -192,9 +194,11 @@ void deactivate_page_nolock(struct page * page)
 
 void deactivate_page(struct page * page)
 {
-	spin_lock(&pagemap_lru_lock);
+	zone_t *zone = page->zone;
+
+	spin_lock(&zone->lru_lock);
 	deactivate_page_nolock(page);
-	spin_unlock(&pagemap_lru_lock);
+	spin_unlock(&zone->lru_lock);
 }
 
 /*
@@ -222,9 +226,75 @@ void activate_page_nolock(struct page * page)
 
 void activate_page(struct page * page)
 {
-	spin_lock(&pagemap_lru_lock);
+	zone_t *zone = page->zone;
+
+	spin_lock(&zone->lru_lock);
 	activate_page_nolock(page);
-	spin_unlock(&pagemap_lru_lock);
+	spin_unlock(&zone->lru_lock);
+}
+
+/*
+ * New pages are put on the lists a pagevec at a time, so that the
+ * lru_lock is taken once per batch. The pagevec holds a reference on
+ * each page until then. A page can be added twice, or freed from the
+ * cache, while it waits here; it is only put on the lists if it is
+ * not there yet, and the final page_cache_release() takes it off
+ * again.
+ */
+static struct lru_add_pvec {
+	struct pagevec pvec;
+} ____cacheline_aligned lru_add_pvecs[NR_CPUS];
+
+void __pagevec_lru_add(struct pagevec *pvec)
+{
+	zone_t *zone = NULL;
+	unsigned int i;
+
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		struct page *page = pvec->pages[i];
+
+		if (page->zone != zone) {
+			if (zone)
+				spin_unlock(&zone->lru_lock);
+			zone = page->zone;
+			spin_lock(&zone->lru_lock);
+		}
+		if (PageLRU(page))
+			continue;
+		add_page_to_active_list(page);
+		/* This should be relatively rare */
+		/* 页面老化时间为 0，页面已经老化 */
+		if (!page->age)
+			deactivate_page_nolock(page);
+	}
+	if (zone)
+		spin_unlock(&zone->lru_lock);
+
+	for (i = 0; i < pagevec_count(pvec); i++)
+		page_cache_release(pvec->pages[i]);
+	pagevec_init(pvec);
+}
+
+static inline void __lru_cache_add(struct page * page)
+{
+	struct pagevec *pvec = &lru_add_pvecs[smp_processor_id()].pvec;
+
+	page_cache_get(page);
+	if (!pagevec_add(pvec, page))
+		__pagevec_lru_add(pvec);
+}
+
+/**
+ * lru_add_drain: put the pages this CPU has batched on the lists
+ *
+ * Called by the reclaim code, so that it sees the most recent pages.
+ */
+void lru_add_drain(void)
+{
+	struct pagevec *pvec = &lru_add_pvecs[smp_processor_id()].pvec;
+
+	if (pagevec_count(pvec))
+		__pagevec_lru_add(pvec);
 }
 
 /**
@@ -233,16 +303,26 @@ void activate_page(struct page * page)
  */
 void lru_cache_add(struct page * page)
 {
-	spin_lock(&pagemap_lru_lock);
 	if (!PageLocked(page))
 		BUG();
-	DEBUG_ADD_PAGE
-	add_page_to_active_list(page);
-	/* This should be relatively rare */
-	/* 页面老化时间为 0，页面已经老化 */
-	if (!page->age)
-		deactivate_page_nolock(page);
-	spin_unlock(&pagemap_lru_lock);
+	/* Anonymous pages are on the lists already when they go to swap */
+	if (PageLRU(page))
+		return;
+	__lru_cache_add(page);
+}
+
+/**
+ * lru_cache_add_anon: add a new anonymous page to the page lists
+ * @page: the page to add
+ *
+ * Anonymous pages are put on the lists too, so that page_launder()
+ * can find them and unmap them through their pte chains. They are
+ * not in any cache yet, so nobody else can have them locked.
+ */
+void lru_cache_add_anon(struct page * page)
+{
+	page->age = PAGE_AGE_START;
+	__lru_cache_add(page);
 }
 
 /**
@@ -250,7 +330,7 @@ void lru_cache_add(struct page * page)
  * @page: the page to add
  *
  * This function is for when the caller already holds
- * the pagemap_lru_lock.
+ * the lru_lock of the page's zone.
  */
 void __lru_cache_del(struct page * page)
 {
@@ -260,9 +340,11 @@ void __lru_cache_del(struct page * page)
 		del_page_from_inactive_dirty_list(page);
 	} else if (PageInactiveClean(page)) {
 		del_page_from_inactive_clean_list(page);
-	} else {
-		printk("VM: __lru_cache_del, found unknown page ?!\n");
 	}
+	/*
+	 * Otherwise the page is still waiting in a pagevec, it will
+	 * come off the lists again on its final release.
+	 */
 	DEBUG_ADD_PAGE
 }
 
@@ -272,11 +354,55 @@ void __lru_cache_del(struct page * page)
  */
 void lru_cache_del(struct page * page)
 {
+	zone_t *zone = page->zone;
+
 	if (!PageLocked(page))
 		BUG();
-	spin_lock(&pagemap_lru_lock);
+	spin_lock(&zone->lru_lock);
 	__lru_cache_del(page);
-	spin_unlock(&pagemap_lru_lock);
+	spin_unlock(&zone->lru_lock);
+}
+
+/**
+ * lru_put_page_testzero: drop a reference to a page on the page lists
+ * @page: the page
+ *
+ * Anonymous pages stay on the lists until they are freed. The last
+ * reference is dropped under the zone's lru_lock, so that the list
+ * scanners can't pick the page up once it has gone to zero; the others
+ * go without the lock where the CPU can compare and exchange. Returns
+ * 1 if the count went to zero, with the page off the lists. Must not
+ * be called with the lru_lock held.
+ */
+int lru_put_page_testzero(struct page * page)
+{
+	zone_t *zone = page->zone;
+
+#ifdef __HAVE_ARCH_CMPXCHG
+	for (;;) {
+		int count = atomic_read(&page->count);
+
+		if (count == 1)
+			break;
+		if (cmpxchg(&page->count.counter, count, count - 1) == count)
+			return 0;
+	}
+#endif
+
+	/* someone may have taken a reference since, check again */
+	spin_lock(&zone->lru_lock);
+	if (!put_page_testzero(page)) {
+		spin_unlock(&zone->lru_lock);
+		return 0;
+	}
+	if (PageLRU(page)) {
+		/* the list macros insist on a reference */
+		set_page_count(page, 1);
+		__lru_cache_del(page);
+		set_page_count(page, 0);
+	}
+	spin_unlock(&zone->lru_lock);
+	return 1;
 }
 
 /**
@@ -30,11 +30,14 @@ static struct address_space_operations swap_aops = {
 };
 
 struct address_space swapper_space = {
-	LIST_HEAD_INIT(swapper_space.clean_pages),
-	LIST_HEAD_INIT(swapper_space.dirty_pages),
-	LIST_HEAD_INIT(swapper_space.locked_pages),
-	0,				/* nrpages	*/
-	&swap_aops,
+	clean_pages:	LIST_HEAD_INIT(swapper_space.clean_pages),
+	dirty_pages:	LIST_HEAD_INIT(swapper_space.dirty_pages),
+	locked_pages:	LIST_HEAD_INIT(swapper_space.locked_pages),
+	nrpages:	0,
+	a_ops:		&swap_aops,
+	i_shared_lock:	SPIN_LOCK_UNLOCKED,
+	page_tree:	RADIX_TREE_INIT(),
+	page_lock:	SPIN_LOCK_UNLOCKED,
 };
 
 #ifdef SWAP_CACHE_INFO
@@ -53,9 +56,14 @@ void show_swap_cache_info(void)
 #endif
 
 //将刚从磁盘换入的页面添加到相应的队列中
-void add_to_swap_cache(struct page *page, swp_entry_t entry)
+/*
+ * Returns 0, -EEXIST if the entry is in the swap cache already or
+ * -ENOMEM, see add_to_page_cache_locked().
+ */
+int add_to_swap_cache(struct page *page, swp_entry_t entry)
 {
 	unsigned long flags;
+	int error;
 
 #ifdef SWAP_CACHE_INFO
 	swap_cache_add_total++;
@@ -68,7 +76,36 @@ void add_to_swap_cache(struct page *page, swp_entry_t entry)
 		BUG();
 	flags = page->flags & ~((1 << PG_error) | (1 << PG_arch_1));
 	page->flags = flags | (1 << PG_uptodate);
-	add_to_page_cache_locked(page, &swapper_space, entry.val);
+	error = add_to_page_cache_locked(page, &swapper_space, entry.val);
+	if (error)
+		PageClearSwapCache(page);
+	return error;
+}
+
+/*
+ * Give a locked anonymous page a swap entry before the reclaim code
+ * unmaps it, the ptes get the swap entry in place of the page. The
+ * swap cache holds the reference from get_swap_page(). Returns 0 if
+ * swap is full, or if there is no memory for the swap cache index.
+ */
+int add_to_swap(struct page *page)
+{
+	swp_entry_t entry;
+
+	if (!PageLocked(page))
+		BUG();
+	/* reclaim is when the atomic node allocation is likely to fail */
+	if (radix_tree_preload(GFP_BUFFER))
+		return 0;
+	entry = get_swap_page();
+	if (!entry.val)
+		return 0;
+	if (add_to_swap_cache(page, entry)) {
+		swap_free(entry);
+		return 0;
+	}
+	set_page_dirty(page);
+	return 1;
 }
 
 static inline void remove_from_swap_cache(struct page *page)
@@ -111,7 +148,8 @@ void delete_from_swap_cache_nolock(struct page *page)
 	if (!PageLocked(page))
 		BUG();
 
-	if (block_flushpage(page, 0))
+	/* still mapped anonymous memory stays on the LRU */
+	if (block_flushpage(page, 0) && !page->pte_chain)
 		lru_cache_del(page);
 
 	spin_lock(&pagecache_lock);
@@ -221,6 +259,7 @@ struct page * read_swap_cache_async(swp_entry_t entry, int wait)
 {
 	struct page *found_page = 0, *new_page;
 	unsigned long new_page_addr;
+	int error;
 
 	/*
 	 * Make sure the swap entry is still in use.
@@ -235,7 +274,7 @@ struct page * read_swap_cache_async(swp_entry_t entry, int wait)
 		goto out_free_swap;
 
 	//获取空闲页面
-	new_page_addr = __get_free_page(GFP_USER);
+	new_page_addr = __get_free_page(GFP_USER | __GFP_MOVABLE);
 	if (!new_page_addr)
 		goto out_free_swap;	/* Out of memory */
 	//映射到虚拟地址对应的page{}
@@ -244,14 +283,24 @@ struct page * read_swap_cache_async(swp_entry_t entry, int wait)
 	/*
 	 * Check the swap cache again, in case we stalled above.
 	 */
+repeat:
 	found_page = lookup_swap_cache(entry);
 	if (found_page)
 		goto out_free_page;
 	/* 
-	 * Add it to the swap cache and read its contents.
+	 * Add it to the swap cache and read its contents. If somebody
+	 * beat us to it, use their page.
 	 */
 	lock_page(new_page);
-	add_to_swap_cache(new_page, entry);	//添加到对应链表中
+	error = radix_tree_preload(GFP_USER);
+	if (!error)
+		error = add_to_swap_cache(new_page, entry);	//添加到对应链表中
+	if (error) {
+		UnlockPage(new_page);
+		if (error == -EEXIST)
+			goto repeat;
+		goto out_free_page;
+	}
 	rw_swap_page(READ, new_page, wait);	//读取磁盘内容
 	return new_page;
 
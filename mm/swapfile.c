@@ -14,6 +14,8 @@
 #include <linux/vmalloc.h>
 #include <linux/pagemap.h>
 #include <linux/shm.h>
+#include <linux/hugetlb.h>
+#include <linux/compswap.h>
 
 #include <asm/pgtable.h>
 
@@ -30,9 +32,30 @@ struct swap_info_struct swap_info[MAX_SWAPFILES];
 
 #define SWAPFILE_CLUSTER 256
 
+/*
+ * Find SWAPFILE_CLUSTER free slots in a row that start in [offset, end).
+ * Returns the first one, or 0.
+ */
+static unsigned long scan_free_cluster(struct swap_info_struct *si,
+	unsigned long offset, unsigned long end)
+{
+	unsigned long nr;
+
+	while (offset < end && offset+SWAPFILE_CLUSTER-1 <= si->highest_bit) {
+		for (nr = offset; nr < offset+SWAPFILE_CLUSTER; nr++)
+			if (si->swap_map[nr])
+				break;
+		if (nr == offset+SWAPFILE_CLUSTER)
+			return offset;
+		offset = nr+1;
+	}
+	return 0;
+}
+
 static inline int scan_swap_map(struct swap_info_struct *si, unsigned short count)
 {
-	unsigned long offset;
+	struct swap_cluster *cluster = &si->cluster[smp_processor_id()];
+	unsigned long offset, start;
 	/* 
 	 * We try to cluster swap pages by allocating them
 	 * sequentially in swap.  Once we've allocated
@@ -41,36 +64,41 @@ static inline int scan_swap_map(struct swap_info_struct *si, unsigned short coun
 	 * prevents us from scattering swap pages all over the entire
 	 * swap partition, so that we reduce overall disk seek times
 	 * between swap pages.  -- sct
+	 *
+	 * Every cpu has a cluster of its own, so that the pages one
+	 * reclaim pass writes out end up next to each other even when
+	 * several cpus are swapping.
 	 */
-	if (si->cluster_nr) {
-		while (si->cluster_next <= si->highest_bit) {
-			offset = si->cluster_next++;
+	if (cluster->nr) {
+		while (cluster->next <= si->highest_bit) {
+			offset = cluster->next++;
 			if (si->swap_map[offset])
 				continue;
-			si->cluster_nr--;
+			cluster->nr--;
 			goto got_page;
 		}
 	}
-	si->cluster_nr = SWAPFILE_CLUSTER;
+	cluster->nr = SWAPFILE_CLUSTER;
 
-	/* try to find an empty (even not aligned) cluster. */
+	/*
+	 * try to find an empty (even not aligned) cluster, after the
+	 * last one that was handed out, so that it doesn't overlap
+	 * with what the other cpus still use of theirs.
+	 */
 	/* 尽量去找个空的集群 */
-	offset = si->lowest_bit;
- check_next_cluster:
-	if (offset+SWAPFILE_CLUSTER-1 <= si->highest_bit)
-	{
-		int nr;
-		for (nr = offset; nr < offset+SWAPFILE_CLUSTER; nr++)
-			if (si->swap_map[nr])
-			{
-				offset = nr+1;
-				goto check_next_cluster;
-			}
+	start = si->cluster_search;
+	if (start < si->lowest_bit || start > si->highest_bit)
+		start = si->lowest_bit;
+	offset = scan_free_cluster(si, start, si->highest_bit+1);
+	if (!offset)
+		offset = scan_free_cluster(si, si->lowest_bit, start);
+	if (offset) {
 		/*
 		 * We found a completly empty cluster, so start
 		 * using it.
 		 * 找到了一个完全为空的集群，所以开始使用它。
 		 */
+		si->cluster_search = offset+SWAPFILE_CLUSTER;
 		goto got_page;
 	}
 	/* No luck, so now go finegrined as usual. -Andrea */
@@ -84,12 +112,97 @@ static inline int scan_swap_map(struct swap_info_struct *si, unsigned short coun
 			si->highest_bit--;
 		si->swap_map[offset] = count;
 		nr_swap_pages--;
-		si->cluster_next = offset+1;
+		cluster->next = offset+1;
 		return offset;
 	}
 	return 0;
 }
 
+/*
+ * Map the pages of a swap file to their blocks once at swapon, so that
+ * swap I/O doesn't need bmap() and pages next to each other in swap are
+ * written together when they are next to each other on disk. A page
+ * whose blocks have a hole or aren't contiguous is left out of the map,
+ * it is marked bad once the swap map is set up.
+ */
+static int setup_swap_extents(struct swap_info_struct *p, struct inode *inode,
+	unsigned long npages)
+{
+	int bits = PAGE_SHIFT - inode->i_sb->s_blocksize_bits;
+	struct swap_extent *se = NULL, *last;
+	unsigned long page;
+	int nr = 0, size = 0;
+
+	for (page = 0; page < npages; page++) {
+		unsigned long block = page << bits;
+		unsigned long first = bmap(inode, block);
+		int i;
+
+		if (current->need_resched)
+			schedule();
+		if (!first)
+			continue;
+		for (i = 1; i < (1 << bits); i++)
+			if (bmap(inode, block + i) != first + i)
+				break;
+		if (i < (1 << bits))
+			continue;
+
+		last = se + nr - 1;
+		if (nr && last->start_page + last->nr_pages == page &&
+		    last->start_block + (last->nr_pages << bits) == first) {
+			last->nr_pages++;
+			continue;
+		}
+		if (nr == size) {
+			struct swap_extent *new;
+
+			size = size ? 2*size : PAGE_SIZE/sizeof(*se);
+			new = vmalloc(size * sizeof(*se));
+			if (!new) {
+				vfree(se);
+				return -ENOMEM;
+			}
+			if (nr)
+				memcpy(new, se, nr * sizeof(*se));
+			vfree(se);
+			se = new;
+		}
+		se[nr].start_page = page;
+		se[nr].nr_pages = 1;
+		se[nr].start_block = first;
+		nr++;
+	}
+	p->extents = se;
+	p->nr_extents = nr;
+	return 0;
+}
+
+/*
+ * The first block of the swap page @offset of a swap file, from its
+ * extent map. Returns 0 if the page isn't mapped.
+ */
+static unsigned long map_swap_page(struct swap_info_struct *p,
+	unsigned long offset)
+{
+	struct inode *inode = p->swap_file->d_inode;
+	int lo = 0, hi = p->nr_extents - 1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		struct swap_extent *se = p->extents + mid;
+
+		if (offset < se->start_page)
+			hi = mid - 1;
+		else if (offset >= se->start_page + se->nr_pages)
+			lo = mid + 1;
+		else
+			return se->start_block + ((offset - se->start_page) <<
+				(PAGE_SHIFT - inode->i_sb->s_blocksize_bits));
+	}
+	return 0;
+}
+
 swp_entry_t __get_swap_page(unsigned short count)
 {
 	struct swap_info_struct * p;
@@ -186,6 +299,7 @@ void __swap_free(swp_entry_t entry, unsigned short count)
 				p->highest_bit = offset;
 			//用于交换的页面数+1.
 			nr_swap_pages++;
+			compswap_invalidate(entry);
 		}
 	}
 	swap_device_unlock(p);
@@ -222,7 +336,8 @@ bad_count:
  * what to do if a write is requested later.
  */
 static inline void unuse_pte(struct vm_area_struct * vma, unsigned long address,
-	pte_t *dir, swp_entry_t entry, struct page* page)
+	pte_t *dir, swp_entry_t entry, struct page* page,
+	struct pte_chain **pte_chain)
 {
 	pte_t pte = *dir;
 
@@ -240,7 +355,11 @@ static inline void unuse_pte(struct vm_area_struct * vma, unsigned long address,
 	}
 	if (pte_to_swp_entry(pte).val != entry.val)
 		return;
+	/* out of chain entries: try_to_unuse() comes back for this one */
+	if (!*pte_chain)
+		return;
 	set_pte(dir, pte_mkdirty(mk_pte(page, vma->vm_page_prot)));
+	page_add_rmap(page, dir, vma->vm_mm, vma->vm_start + address, pte_chain);
 	swap_free(entry);
 	get_page(page);
 	++vma->vm_mm->rss;
@@ -248,7 +367,7 @@ static inline void unuse_pte(struct vm_area_struct * vma, unsigned long address,
 
 static inline void unuse_pmd(struct vm_area_struct * vma, pmd_t *dir,
 	unsigned long address, unsigned long size, unsigned long offset,
-	swp_entry_t entry, struct page* page)
+	swp_entry_t entry, struct page* page, struct pte_chain **pte_chain)
 {
 	pte_t * pte;
 	unsigned long end;
@@ -267,7 +386,8 @@ static inline void unuse_pmd(struct vm_area_struct * vma, pmd_t *dir,
 	if (end > PMD_SIZE)
 		end = PMD_SIZE;
 	do {
-		unuse_pte(vma, offset+address-vma->vm_start, pte, entry, page);
+		unuse_pte(vma, offset+address-vma->vm_start, pte, entry, page,
+			  pte_chain);
 		address += PAGE_SIZE;
 		pte++;
 	} while (address && (address < end));
@@ -275,7 +395,7 @@ static inline void unuse_pmd(struct vm_area_struct * vma, pmd_t *dir,
 
 static inline void unuse_pgd(struct vm_area_struct * vma, pgd_t *dir,
 	unsigned long address, unsigned long size,
-	swp_entry_t entry, struct page* page)
+	swp_entry_t entry, struct page* page, struct pte_chain **pte_chain)
 {
 	pmd_t * pmd;
 	unsigned long offset, end;
@@ -297,28 +417,30 @@ static inline void unuse_pgd(struct vm_area_struct * vma, pgd_t *dir,
 		BUG();
 	do {
 		unuse_pmd(vma, pmd, address, end - address, offset, entry,
-			  page);
+			  page, pte_chain);
 		address = (address + PMD_SIZE) & PMD_MASK;
 		pmd++;
 	} while (address && (address < end));
 }
 
 static void unuse_vma(struct vm_area_struct * vma, pgd_t *pgdir,
-			swp_entry_t entry, struct page* page)
+			swp_entry_t entry, struct page* page,
+			struct pte_chain **pte_chain)
 {
 	unsigned long start = vma->vm_start, end = vma->vm_end;
 
 	if (start >= end)
 		BUG();
 	do {
-		unuse_pgd(vma, pgdir, start, end - start, entry, page);
+		unuse_pgd(vma, pgdir, start, end - start, entry, page, pte_chain);
 		start = (start + PGDIR_SIZE) & PGDIR_MASK;
 		pgdir++;
 	} while (start && (start < end));
 }
 
 static void unuse_process(struct mm_struct * mm,
-			swp_entry_t entry, struct page* page)
+			swp_entry_t entry, struct page* page,
+			struct pte_chain **pte_chain)
 {
 	struct vm_area_struct* vma;
 
@@ -330,7 +452,11 @@ static void unuse_process(struct mm_struct * mm,
 	spin_lock(&mm->page_table_lock);
 	for (vma = mm->mmap; vma; vma = vma->vm_next) {
 		pgd_t * pgd = pgd_offset(mm, vma->vm_start);
-		unuse_vma(vma, pgd, entry, page);
+
+		/* huge pages are never swapped */
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		unuse_vma(vma, pgd, entry, page, pte_chain);
 	}
 	spin_unlock(&mm->page_table_lock);
 	return;
@@ -344,10 +470,11 @@ static void unuse_process(struct mm_struct * mm,
 static int try_to_unuse(unsigned int type)
 {
 	struct swap_info_struct * si = &swap_info[type];
+	struct pte_chain *pte_chain;
 	struct task_struct *p;
 	struct page *page;
 	swp_entry_t entry;
-	int i;
+	int i, count;
 
 	while (1) {
 		/*
@@ -365,6 +492,7 @@ static int try_to_unuse(unsigned int type)
 				 */
 				if (si->swap_map[i] != SWAP_MAP_MAX)
 					si->swap_map[i]++;
+				count = si->swap_map[i];
 				swap_device_unlock(si);
 				goto found_entry;
 			}
@@ -375,21 +503,48 @@ static int try_to_unuse(unsigned int type)
 	found_entry:
 		entry = SWP_ENTRY(type, i);
 
+		/*
+		 * Every pte that still refers to the entry holds a count
+		 * of it, so this is enough chain entries unless someone
+		 * forks meanwhile.
+		 */
+		pte_chain = NULL;
+		if (pte_chain_alloc(&pte_chain, count, GFP_KERNEL)) {
+			pte_chain_free(pte_chain);
+			swap_free(entry);
+			return -ENOMEM;
+		}
+
 		/* Get a page for the entry, using the existing swap
                    cache page if there is one.  Otherwise, get a clean
                    page and read the swap into it. */
 		page = read_swap_cache(entry);
 		if (!page) {
+			pte_chain_free(pte_chain);
 			swap_free(entry);
   			return -ENOMEM;
 		}
-		//如果是磁盘交换页面，从磁盘交换页面中删除
-		if (PageSwapCache(page))
-			delete_from_swap_cache(page);
+		/*
+		 * The page lock keeps the reclaim code from unmapping the
+		 * ptes again before the page leaves the swap cache.
+		 */
+		lock_page(page);
 		read_lock(&tasklist_lock);
 		for_each_task(p)
-			unuse_process(p->mm, entry, page);
+			unuse_process(p->mm, entry, page, &pte_chain);
 		read_unlock(&tasklist_lock);
+		if (!pte_chain) {
+			/* ran out of chain entries: do the rest again */
+			UnlockPage(page);
+			page_cache_release(page);
+			swap_free(entry);
+			continue;
+		}
+		pte_chain_free(pte_chain);
+		//如果是磁盘交换页面，从磁盘交换页面中删除
+		if (PageSwapCache(page))
+			delete_from_swap_cache_nolock(page);
+		UnlockPage(page);
 		shmem_unuse(entry, page);
 		/* Now get rid of the extra reference to the temporary
                    page we've been using. */
@@ -491,8 +646,12 @@ asmlinkage long sys_swapoff(const char * specialfile)
 	nd.mnt = p->swap_vfsmnt;
 	p->swap_vfsmnt = NULL;
 	p->swap_device = 0;
+	compswap_invalidate_area(type);
 	vfree(p->swap_map);
 	p->swap_map = NULL;
+	vfree(p->extents);
+	p->extents = NULL;
+	p->nr_extents = 0;
 	p->flags = 0;
 	err = 0;
 
@@ -542,6 +701,7 @@ int get_swaparea_info(char *buf)
 				usedswap << (PAGE_SHIFT - 10), ptr->prio);
 		}
 	}
+	len += compswap_report(buf + len);
 	free_page((unsigned long) page);
 	return len;
 }
@@ -603,7 +763,10 @@ asmlinkage long sys_swapon(const char * specialfile, int swap_flags)
 	p->swap_map = NULL;
 	p->lowest_bit = 0;
 	p->highest_bit = 0;
-	p->cluster_nr = 0;
+	memset(p->cluster, 0, sizeof(p->cluster));
+	p->cluster_search = 0;
+	p->extents = NULL;
+	p->nr_extents = 0;
 	p->sdev_lock = SPIN_LOCK_UNLOCKED;
 	p->max = 1;
 	p->next = -1;
@@ -662,6 +825,10 @@ asmlinkage long sys_swapon(const char * specialfile, int swap_flags)
 				goto bad_swap;
 		}
 		swapfilesize = swap_inode->i_size >> PAGE_SHIFT;
+		error = setup_swap_extents(p, swap_inode, swapfilesize);
+		if (error)
+			goto bad_swap;
+		error = -EINVAL;
 	} else
 		goto bad_swap;
 
@@ -769,6 +936,14 @@ asmlinkage long sys_swapon(const char * specialfile, int swap_flags)
 		error = -EINVAL;
 		goto bad_swap;
 	}
+	if (p->extents) {
+		/* the pages that couldn't be mapped can't be used */
+		for (i = 1 ; i < p->max ; i++)
+			if (!p->swap_map[i] && !map_swap_page(p, i)) {
+				p->swap_map[i] = SWAP_MAP_BAD;
+				nr_good_pages--;
+			}
+	}
 	if (!nr_good_pages) {
 		printk(KERN_WARNING "Empty swap-file\n");
 		error = -EINVAL;
@@ -781,6 +956,9 @@ asmlinkage long sys_swapon(const char * specialfile, int swap_flags)
 	nr_swap_pages += nr_good_pages;
 	printk(KERN_INFO "Adding Swap: %dk swap-space (priority %d)\n",
 	       nr_good_pages<<(PAGE_SHIFT-10), p->prio);
+	if (p->extents)
+		printk(KERN_INFO "Swap file mapped in %d extents\n",
+		       p->nr_extents);
 
 	/* insert swap space into swap_list: */
 	prev = -1;
@@ -805,6 +983,9 @@ bad_swap:
 bad_swap_2:
 	if (p->swap_map)
 		vfree(p->swap_map);
+	vfree(p->extents);
+	p->extents = NULL;
+	p->nr_extents = 0;
 	nd.mnt = p->swap_vfsmnt;
 	nd.dentry = p->swap_file;
 	p->swap_device = 0;
@@ -956,6 +1137,9 @@ bad_unused:
  */
 /*
  * 解析entry，获取到了offset、dev或swapf
+ *
+ * For a swap file, *offset is the first block of the page on disk,
+ * from the extent map, or 0 if the page has none.
  */
 void get_swaphandle_info(swp_entry_t entry, unsigned long *offset, 
 			kdev_t *dev, struct inode **swapf)
@@ -989,6 +1173,7 @@ void get_swaphandle_info(swp_entry_t entry, unsigned long *offset,
 		*dev = p->swap_device;
 	} else if (p->swap_file) {
 		*swapf = p->swap_file->d_inode;
+		*offset = map_swap_page(p, *offset);
 	} else {
 		printk(KERN_ERR "rw_swap_page: no swap file or device\n");
 	}
@@ -23,365 +23,7 @@
 #include <linux/file.h>
 
 #include <asm/pgalloc.h>
-
-/*
- * The swap-out functions return 1 if they successfully
- * threw something out, and we got a free page. It returns
- * zero if it couldn't do anything, and any other value
- * indicates it decreased rss, but the page was shared.
- *
- * NOTE! If it sleeps, it *must* return 1 to make sure we
- * don't continue with the swap-out. Otherwise we may be
- * using a process that no longer actually exists (it might
- * have died while we slept).
- */
-static int try_to_swap_out(struct mm_struct * mm, struct vm_area_struct* vma, unsigned long address, pte_t * page_table, int gfp_mask)
-{
-	pte_t pte;
-	swp_entry_t entry;
-	struct page * page;
-	int onlist;
-
-	pte = *page_table;
-	if (!pte_present(pte))
-		goto out_failed;
-	page = pte_page(pte);
-	if ((!VALID_PAGE(page)) || PageReserved(page))
-		goto out_failed;
-
-	if (!mm->swap_cnt)
-		return 1;
-
-	mm->swap_cnt--;
-
-	onlist = PageActive(page);
-	/* Don't look at this pte if it's been accessed recently. */
-	/* 跳过刚访问过的页面 */
-	if (ptep_test_and_clear_young(page_table)) {
-		age_page_up(page);
-		goto out_failed;
-	}
-	if (!onlist)
-		/* The page is still mapped, so it can't be freeable... */
-		age_page_down_ageonly(page);
-
-	/*
-	 * If the page is in active use by us, or if the page
-	 * is in active use by others, don't unmap it or
-	 * (worse) start unneeded IO.
-	 */
-	if (page->age > 0)
-		goto out_failed;
-
-	if (TryLockPage(page))
-		goto out_failed;
-
-	/* From this point on, the odds are that we're going to
-	 * nuke this pte, so read and clear the pte.  This hook
-	 * is needed on CPUs which update the accessed and dirty
-	 * bits in hardware.
-	 */
-	pte = ptep_get_and_clear(page_table);
-	flush_tlb_page(vma, address);
-
-	/*
-	 * Is the page already in the swap cache? If so, then
-	 * we can just drop our reference to it without doing
-	 * any IO - it's already up-to-date on disk.
-	 *
-	 * Return 0, as we didn't actually free any real
-	 * memory, and we should just continue our scan.
-	 */
-	if (PageSwapCache(page)) {
-		entry.val = page->index;
-		if (pte_dirty(pte))
-			set_page_dirty(page);
-set_swap_pte:
-		swap_duplicate(entry);
-		set_pte(page_table, swp_entry_to_pte(entry));
-drop_pte:
-		UnlockPage(page);
-		mm->rss--;
-		deactivate_page(page);
-		page_cache_release(page);
-out_failed:
-		return 0;
-	}
-
-	/*
-	 * Is it a clean page? Then it must be recoverable
-	 * by just paging it in again, and we can just drop
-	 * it..
-	 *
-	 * However, this won't actually free any real
-	 * memory, as the page will just be in the page cache
-	 * somewhere, and as such we should just continue
-	 * our scan.
-	 *
-	 * Basically, this just makes it possible for us to do
-	 * some real work in the future in "refill_inactive()".
-	 */
-	flush_cache_page(vma, address);
-	if (!pte_dirty(pte))
-		goto drop_pte;
-
-	/*
-	 * Ok, it's really dirty. That means that
-	 * we should either create a new swap cache
-	 * entry for it, or we should write it back
-	 * to its own backing store.
-	 */
-	if (page->mapping) {
-		set_page_dirty(page);
-		goto drop_pte;
-	}
-
-	/*
-	 * This is a dirty, swappable page.  First of all,
-	 * get a suitable swap entry for it, and make sure
-	 * we have the swap cache set up to associate the
-	 * page with that swap entry.
-	 */
-	entry = get_swap_page();
-	if (!entry.val)
-		goto out_unlock_restore; /* No swap space left */
-
-	/* Add it to the swap cache and mark it dirty */
-	add_to_swap_cache(page, entry);
-	set_page_dirty(page);
-	goto set_swap_pte;
-
-out_unlock_restore:
-	set_pte(page_table, pte);
-	UnlockPage(page);
-	return 0;
-}
-
-/*
- * A new implementation of swap_out().  We do not swap complete processes,
- * but only a small number of blocks, before we continue with the next
- * process.  The number of blocks actually swapped is determined on the
- * number of page faults, that this process actually had in the last time,
- * so we won't swap heavily used processes all the time ...
- *
- * Note: the priority argument is a hint on much CPU to waste with the
- *       swap block search, not a hint, of how much blocks to swap with
- *       each process.
- *
- * (C) 1993 Kai Petzke, wpp@marie.physik.tu-berlin.de
- */
-
-static inline int swap_out_pmd(struct mm_struct * mm, struct vm_area_struct * vma, pmd_t *dir, unsigned long address, unsigned long end, int gfp_mask)
-{
-	pte_t * pte;
-	unsigned long pmd_end;
-
-	if (pmd_none(*dir))
-		return 0;
-	if (pmd_bad(*dir)) {
-		pmd_ERROR(*dir);
-		pmd_clear(dir);
-		return 0;
-	}
-	
-	pte = pte_offset(dir, address);
-	
-	pmd_end = (address + PMD_SIZE) & PMD_MASK;
-	if (end > pmd_end)
-		end = pmd_end;
-
-	do {
-		int result;
-		mm->swap_address = address + PAGE_SIZE;
-		result = try_to_swap_out(mm, vma, address, pte, gfp_mask);
-		if (result)
-			return result;
-		address += PAGE_SIZE;
-		pte++;
-	} while (address && (address < end));
-	return 0;
-}
-
-static inline int swap_out_pgd(struct mm_struct * mm, struct vm_area_struct * vma, pgd_t *dir, unsigned long address, unsigned long end, int gfp_mask)
-{
-	pmd_t * pmd;
-	unsigned long pgd_end;
-
-	if (pgd_none(*dir))
-		return 0;
-	if (pgd_bad(*dir)) {
-		pgd_ERROR(*dir);
-		pgd_clear(dir);
-		return 0;
-	}
-
-	pmd = pmd_offset(dir, address);
-
-	pgd_end = (address + PGDIR_SIZE) & PGDIR_MASK;	
-	if (pgd_end && (end > pgd_end))
-		end = pgd_end;
-	
-	do {
-		int result = swap_out_pmd(mm, vma, pmd, address, end, gfp_mask);
-		if (result)
-			return result;
-		address = (address + PMD_SIZE) & PMD_MASK;
-		pmd++;
-	} while (address && (address < end));
-	return 0;
-}
-
-static int swap_out_vma(struct mm_struct * mm, struct vm_area_struct * vma, unsigned long address, int gfp_mask)
-{
-	pgd_t *pgdir;
-	unsigned long end;
-
-	/* Don't swap out areas which are locked down */
-	if (vma->vm_flags & (VM_LOCKED|VM_RESERVED))
-		return 0;
-
-	pgdir = pgd_offset(mm, address);
-
-	end = vma->vm_end;
-	if (address >= end)
-		BUG();
-	do {
-		int result = swap_out_pgd(mm, vma, pgdir, address, end, gfp_mask);
-		if (result)
-			return result;
-		address = (address + PGDIR_SIZE) & PGDIR_MASK;
-		pgdir++;
-	} while (address && (address < end));
-	return 0;
-}
-
-static int swap_out_mm(struct mm_struct * mm, int gfp_mask)
-{
-	int result = 0;
-	unsigned long address;
-	struct vm_area_struct* vma;
-
-	/*
-	 * Go through process' page directory.
-	 */
-
-	/*
-	 * Find the proper vm-area after freezing the vma chain 
-	 * and ptes.
-	 */
-	spin_lock(&mm->page_table_lock);
-	address = mm->swap_address;
-	vma = find_vma(mm, address);
-	if (vma) {
-		if (address < vma->vm_start)
-			address = vma->vm_start;
-
-		for (;;) {
-			result = swap_out_vma(mm, vma, address, gfp_mask);
-			if (result)
-				goto out_unlock;
-			vma = vma->vm_next;
-			if (!vma)
-				break;
-			address = vma->vm_start;
-		}
-	}
-	/* Reset to 0 when we reach the end of address space */
-	mm->swap_address = 0;
-	mm->swap_cnt = 0;
-
-out_unlock:
-	spin_unlock(&mm->page_table_lock);
-	return result;
-}
-
-/*
- * Select the task with maximal swap_cnt and try to swap out a page.
- * N.B. This function returns only 0 or 1.  Return values != 1 from
- * the lower level routines result in continued processing.
- */
-#define SWAP_SHIFT 5
-#define SWAP_MIN 8
-
-static int swap_out(unsigned int priority, int gfp_mask)
-{
-	int counter;
-	int __ret = 0;
-
-	/* 
-	 * We make one or two passes through the task list, indexed by 
-	 * assign = {0, 1}:
-	 *   Pass 1: select the swappable task with maximal RSS that has
-	 *         not yet been swapped out. 
-	 *   Pass 2: re-assign rss swap_cnt values, then select as above.
-	 *
-	 * With this approach, there's no need to remember the last task
-	 * swapped out.  If the swap-out fails, we clear swap_cnt so the 
-	 * task won't be selected again until all others have been tried.
-	 *
-	 * Think of swap_cnt as a "shadow rss" - it tells us which process
-	 * we want to page out (always try largest first).
-	 */
-	counter = (nr_threads << SWAP_SHIFT) >> priority;
-	if (counter < 1)
-		counter = 1;
-
-	//循环次数由进程数量和priority 来决定
-	for (; counter >= 0; counter--) {
-		struct list_head *p;
-		unsigned long max_cnt = 0;
-		struct mm_struct *best = NULL;
-		int assign = 0;		//通过assign 标识是第几遍扫描
-		int found_task = 0;
-	select:
-		spin_lock(&mmlist_lock);
-		p = init_mm.mmlist.next;
-		for (; p != &init_mm.mmlist; p = p->next) {
-			struct mm_struct *mm = list_entry(p, struct mm_struct, mmlist);
-	 		if (mm->rss <= 0)	//rss=resident set 驻内页面集合
-				continue;
-			found_task++;
-			/* Refresh swap_cnt? */
-	     		if (assign == 1) {
-				//重新设置swap_cnt
-				mm->swap_cnt = (mm->rss >> SWAP_SHIFT);
-				if (mm->swap_cnt < SWAP_MIN)
-					mm->swap_cnt = SWAP_MIN;
-			}
-			//寻找最优的mm_struct{}
-			if (mm->swap_cnt > max_cnt) {
-				max_cnt = mm->swap_cnt;
-				best = mm;
-			}
-		}
-
-		/* Make sure it doesn't disappear */
-		if (best)
-			atomic_inc(&best->mm_users);
-		spin_unlock(&mmlist_lock);
-
-		/*
-		 * We have dropped the tasklist_lock, but we
-		 * know that "mm" still exists: we are running
-		 * with the big kernel lock, and exit_mm()
-		 * cannot race with us.
-		 */
-		if (!best) {
-			if (!assign && found_task > 0) {
-				assign = 1;
-				goto select;
-			}
-			break;
-		} else {
-			//找到了，开始扫描
-			__ret = swap_out_mm(best, gfp_mask);
-			mmput(best);
-			break;
-		}
-	}
-	return __ret;
-}
-
+#include <asm/div64.h>
 
 /**
  * reclaim_page -	reclaims one page from the inactive_clean list
@@ -397,24 +39,26 @@ static int swap_out(unsigned int priority, int gfp_mask)
  */
 struct page * reclaim_page(zone_t * zone)
 {
+	struct zone_lru_stat * stat = zone->lru_stat + LRU_INACTIVE_CLEAN;
 	struct page * page = NULL;
 	struct list_head * page_lru;
 	int maxscan;
 
 	/*
-	 * We only need the pagemap_lru_lock if we don't reclaim the page,
-	 * but we have to grab the pagecache_lock before the pagemap_lru_lock
+	 * We only need the lru_lock if we don't reclaim the page,
+	 * but we have to grab the pagecache_lock before the lru_lock
 	 * to avoid deadlocks and most of the time we'll succeed anyway.
 	 */
 	/*
 	 * 遍历zone inactive_clean_list 中的页面
 	 */
 	spin_lock(&pagecache_lock);
-	spin_lock(&pagemap_lru_lock);
+	spin_lock(&zone->lru_lock);
 	maxscan = zone->inactive_clean_pages;
 	while ((page_lru = zone->inactive_clean_list.prev) !=
 			&zone->inactive_clean_list && maxscan--) {
 		page = list_entry(page_lru, struct page, lru);
+		stat->scanned++;
 
 		/* Wrong page on list?! (list corruption, should not happen) */
 		/* 类似代码有利于排错 */
@@ -428,9 +72,11 @@ struct page * reclaim_page(zone_t * zone)
 		/* Page is or was in use?  Move it to the active list. */
 		/* TODO: 此处为什么要清空引用 */
 		if (PageTestandClearReferenced(page) || page->age > 0 ||
-				(!page->buffers && page_count(page) > 1)) {
+				(!page->buffers && page_count(page) > 1) ||
+				page->pte_chain) {
 			del_page_from_inactive_clean_list(page);
 			add_page_to_active_list(page);
+			stat->rotated++;
 			continue;
 		}
 
@@ -438,6 +84,7 @@ struct page * reclaim_page(zone_t * zone)
 		if (page->buffers || PageDirty(page) || TryLockPage(page)) {
 			del_page_from_inactive_clean_list(page);
 			add_page_to_inactive_dirty_list(page);
+			stat->rotated++;
 			continue;
 		}
 
@@ -464,84 +111,66 @@ struct page * reclaim_page(zone_t * zone)
 
 found_page:
 	del_page_from_inactive_clean_list(page);
+	stat->reclaimed++;
 	UnlockPage(page);
 	page->age = PAGE_AGE_START;
 	if (page_count(page) != 1)
 		printk("VM: reclaim_page, found page with count %d!\n",
 				page_count(page));
 out:
-	spin_unlock(&pagemap_lru_lock);
+	spin_unlock(&zone->lru_lock);
 	spin_unlock(&pagecache_lock);
 	memory_pressure++;
 	return page;
 }
 
-/**
- * page_launder - clean dirty inactive pages, move to inactive_clean list
- * @gfp_mask: what operations we are allowed to do
- * @sync: should we wait synchronously for the cleaning of pages
- *
- * When this function is called, we are most likely low on free +
- * inactive_clean pages. Since we want to refill those pages as
- * soon as possible, we'll make two loops over the inactive list,
- * one to move the already cleaned pages to the inactive_clean lists
- * and one to (often asynchronously) clean the dirty inactive pages.
- *
- * In situations where kswapd cannot keep up, user processes will
- * end up calling this function. Since the user process needs to
- * have a page before it can continue with its allocation, we'll
- * do synchronous page flushing in that case.
- *
- * This code is heavily inspired by the FreeBSD source code. Thanks
- * go out to Matthew Dillon.
- */
+#define MAX_LAUNDER 		(4 * (1 << page_cluster))
+
 /*
- * 清空dirty_inactive 页面，将页面移动到inactive_clean 链表中。
- * page_cluster 在 swap_setup() 中根据内存大小设置。
+ * One pass over the inactive_dirty list of a zone, see page_launder().
+ * Returns the number of pages moved to the inactive_clean list or
+ * freed. *maxlaunder is the number of pages we may still start
+ * out-of-order IO on.
  */
-#define MAX_LAUNDER 		(4 * (1 << page_cluster))
-int page_launder(int gfp_mask, int sync)
+static int page_launder_zone(zone_t * zone, int launder_loop,
+	int * maxlaunder, int sync)
 {
-	int launder_loop, maxscan, cleaned_pages, maxlaunder;
-	int can_get_io_locks;
+	struct zone_lru_stat * stat = zone->lru_stat + LRU_INACTIVE_DIRTY;
+	int maxscan, cleaned_pages = 0;
 	struct list_head * page_lru;
 	struct page * page;
 
-	/*
-	 * We can only grab the IO locks (eg. for flushing dirty
-	 * buffers to disk) if __GFP_IO is set.
-	 */
-	can_get_io_locks = gfp_mask & __GFP_IO;
-
-	launder_loop = 0;
-	maxlaunder = 0;
-	cleaned_pages = 0;
-
-dirty_page_rescan:
-	spin_lock(&pagemap_lru_lock);
-	maxscan = nr_inactive_dirty_pages;
+	spin_lock(&zone->lru_lock);
+	maxscan = zone->inactive_dirty_pages;
 	//遍历整个不活跃脏链表
-	while ((page_lru = inactive_dirty_list.prev) != &inactive_dirty_list &&
-				maxscan-- > 0) {
+	while ((page_lru = zone->inactive_dirty_list.prev) !=
+			&zone->inactive_dirty_list && maxscan-- > 0) {
 		//page{} 通过lru 链接在inactive_dirty_list 表中
 		page = list_entry(page_lru, struct page, lru);
+		stat->scanned++;
 
 		/* Wrong page on list?! (list corruption, should not happen) */
 		if (!PageInactiveDirty(page)) {
 			printk("VM: page_launder, wrong page on list.\n");
 			list_del(page_lru);		//所以此时的页面不在任何list链表中
-			nr_inactive_dirty_pages--;
-			page->zone->inactive_dirty_pages--;
+			zone->inactive_dirty_pages--;
 			continue;
 		}
 
-		/* Page is or was in use?  Move it to the active list. */
+		/*
+		 * Page is or was in use?  Move it to the active list.
+		 * The ptes mapping the page hold references on it, they
+		 * are taken care of below.
+		 */
 		if (PageTestandClearReferenced(page) || page->age > 0 ||
-				(!page->buffers && page_count(page) > 1) ||	//没有用作读写缓冲区并且有别的进程在用这个页面
+				page_referenced(page) ||
+				(!page->buffers && page_count(page) > 1 &&
+				 !page->pte_chain) ||	//没有用作读写缓冲区并且有别的进程在用这个页面
 				page_ramdisk(page)) {
 			//将页面从 inactive_dirty_list 中删除，添加到 active_list 中
 			del_page_from_inactive_dirty_list(page);
 			add_page_to_active_list(page);
+			stat->rotated++;
 			continue;
 		}
 
@@ -551,7 +180,33 @@ dirty_page_rescan:
 		 */
 		if (TryLockPage(page)) {
 			list_del(page_lru);
-			list_add(page_lru, &inactive_dirty_list);
+			list_add(page_lru, &zone->inactive_dirty_list);
+			stat->rotated++;
+			continue;
+		}
+
+		/*
+		 * Mapped page? Anonymous memory gets a swap entry
+		 * first, then we unmap the page from all the ptes.
+		 * That needs the lock dropped, so it goes to the back
+		 * of the list and we find it unmapped next time round.
+		 */
+		if (page->pte_chain) {
+			int result = SWAP_FAIL;
+
+			list_del(page_lru);
+			list_add(page_lru, &zone->inactive_dirty_list);
+			page_cache_get(page);
+			spin_unlock(&zone->lru_lock);
+
+			if (page->mapping || add_to_swap(page))
+				result = try_to_unmap(page);
+			if (result == SWAP_FAIL)
+				activate_page(page);
+
+			UnlockPage(page);
+			page_cache_release(page);
+			spin_lock(&zone->lru_lock);
 			continue;
 		}
 
@@ -560,9 +215,13 @@ dirty_page_rescan:
 		 * last copy..
 		 */
 		if (PageDirty(page)) {
-			int (*writepage)(struct page *) = page->mapping->a_ops->writepage;
+			int (*writepage)(struct page *);
 			int result;
 
+			/* Truncated while it waited in a pagevec? */
+			if (!page->mapping)
+				goto page_active;
+			writepage = page->mapping->a_ops->writepage;
 			if (!writepage)
 				goto page_active;
 
@@ -570,15 +229,17 @@ dirty_page_rescan:
 			/* 第一次时仅将页面移到链表头 */
 			if (!launder_loop) {
 				list_del(page_lru);
-				list_add(page_lru, &inactive_dirty_list);
+				list_add(page_lru, &zone->inactive_dirty_list);
 				UnlockPage(page);
+				stat->rotated++;
 				continue;
 			}
 
 			/* OK, do a physical asynchronous write to swap.  */
 			ClearPageDirty(page);
 			page_cache_get(page);
-			spin_unlock(&pagemap_lru_lock);
+			stat->written++;
+			spin_unlock(&zone->lru_lock);
 
 			//将页面中内容同步到磁盘
 			//但是写成功之后没有将页面从inactive_dirty_list 中移除
@@ -586,7 +247,7 @@ dirty_page_rescan:
 			page_cache_release(page);
 
 			/* And re-start the thing.. */
-			spin_lock(&pagemap_lru_lock);
+			spin_lock(&zone->lru_lock);
 			if (result != 1)
 				continue;
 			/* writepage refused to do anything */
@@ -616,13 +277,13 @@ dirty_page_rescan:
 			 */
 			del_page_from_inactive_dirty_list(page);
 			page_cache_get(page);
-			spin_unlock(&pagemap_lru_lock);
+			spin_unlock(&zone->lru_lock);
 
 			/* Will we do (asynchronous) IO? */
 			/* 我们需要作异步I/O？ */
-			if (launder_loop && maxlaunder == 0 && sync)
+			if (launder_loop && *maxlaunder == 0 && sync)
 				wait = 2;	/* Synchrounous IO(同步IO) */
-			else if (launder_loop && maxlaunder-- > 0)
+			else if (launder_loop && (*maxlaunder)-- > 0)
 				wait = 1;	/* Async IO(异步IO) */
 			else
 				wait = 0;	/* No IO(不执行IO操作) */
@@ -635,26 +296,32 @@ dirty_page_rescan:
 			 * unlock the page yet since we're still
 			 * accessing the page_struct here...
 			 */
-			spin_lock(&pagemap_lru_lock);
+			spin_lock(&zone->lru_lock);
+			if (wait)
+				stat->written++;
 
 			/* The buffers were not freed. */
 			if (!clearedbuf) {
 				add_page_to_inactive_dirty_list(page);
+				stat->rotated++;
 
 			/* The page was only in the buffer cache. */
 			} else if (!page->mapping) {
 				atomic_dec(&buffermem_pages);
 				freed_page = 1;
 				cleaned_pages++;
+				stat->reclaimed++;
 
 			/* The page has more users besides the cache and us. */
 			} else if (page_count(page) > 2) {
 				add_page_to_active_list(page);
+				stat->rotated++;
 
 			/* OK, we "created" a freeable page. */
 			} else /* page->mapping && page_count(page) == 2 */ {
 				add_page_to_inactive_clean_list(page);
 				cleaned_pages++;
+				stat->reclaimed++;
 			}
 
 			/*
@@ -686,6 +353,7 @@ dirty_page_rescan:
 			add_page_to_inactive_clean_list(page);
 			UnlockPage(page);
 			cleaned_pages++;
+			stat->reclaimed++;
 		} else {
 page_active:
 			/*
@@ -701,9 +369,59 @@ page_active:
 			del_page_from_inactive_dirty_list(page);
 			add_page_to_active_list(page);
 			UnlockPage(page);
+			stat->rotated++;
 		}
 	}
-	spin_unlock(&pagemap_lru_lock);
+	spin_unlock(&zone->lru_lock);
+
+	return cleaned_pages;
+}
+
+/**
+ * page_launder - clean dirty inactive pages, move to inactive_clean list
+ * @gfp_mask: what operations we are allowed to do
+ * @sync: should we wait synchronously for the cleaning of pages
+ *
+ * When this function is called, we are most likely low on free +
+ * inactive_clean pages. Since we want to refill those pages as
+ * soon as possible, we'll make two loops over the inactive lists,
+ * one to move the already cleaned pages to the inactive_clean lists
+ * and one to (often asynchronously) clean the dirty inactive pages.
+ *
+ * In situations where kswapd cannot keep up, user processes will
+ * end up calling this function. Since the user process needs to
+ * have a page before it can continue with its allocation, we'll
+ * do synchronous page flushing in that case.
+ *
+ * This code is heavily inspired by the FreeBSD source code. Thanks
+ * go out to Matthew Dillon.
+ */
+/*
+ * 清空dirty_inactive 页面，将页面移动到inactive_clean 链表中。
+ * page_cluster 在 swap_setup() 中根据内存大小设置。
+ */
+int page_launder(int gfp_mask, int sync)
+{
+	int launder_loop, cleaned_pages, maxlaunder;
+	int can_get_io_locks;
+	pg_data_t *pgdat;
+	zone_t *zone;
+
+	/*
+	 * We can only grab the IO locks (eg. for flushing dirty
+	 * buffers to disk) if __GFP_IO is set.
+	 */
+	can_get_io_locks = gfp_mask & __GFP_IO;
+
+	launder_loop = 0;
+	maxlaunder = 0;
+	cleaned_pages = 0;
+
+dirty_page_rescan:
+	for (pgdat = pgdat_list; pgdat; pgdat = pgdat->node_next)
+		for (zone = pgdat->node_zones; zone < pgdat->node_zones + MAX_NR_ZONES; zone++)
+			cleaned_pages += page_launder_zone(zone, launder_loop,
+							   &maxlaunder, sync);
 
 	/*
 	 * If we don't have enough free pages, we loop back once
@@ -733,39 +451,37 @@ page_active:
 	return cleaned_pages;
 }
 
-/**
- * refill_inactive_scan - scan the active list and find pages to deactivate
- *                      - 扫描active 链表，将页面移到deactivate 中
- * @priority: the priority at which to scan
- * @oneshot: exit after deactivating one page
- *
- * This function will scan a portion of the active list to find
- * unused pages, those pages will then be moved to the inactive list.
+/*
+ * Scan the active list of one zone, see refill_inactive_scan().
  */
-int refill_inactive_scan(unsigned int priority, int oneshot)
+static int refill_inactive_scan_zone(zone_t * zone, unsigned int priority,
+	int oneshot)
 {
+	struct zone_lru_stat * stat = zone->lru_stat + LRU_ACTIVE;
 	struct list_head * page_lru;
 	struct page * page;
 	int maxscan, page_active = 0;
 	int ret = 0;
 
 	/* Take the lock while messing with the list... */
-	spin_lock(&pagemap_lru_lock);
+	spin_lock(&zone->lru_lock);
 	/* 优先级控制扫描的最大数量 */
-	maxscan = nr_active_pages >> priority;
-	while (maxscan-- > 0 && (page_lru = active_list.prev) != &active_list) {
+	maxscan = zone->active_pages >> priority;
+	while (maxscan-- > 0 && (page_lru = zone->active_list.prev) !=
+			&zone->active_list) {
 		page = list_entry(page_lru, struct page, lru);
+		stat->scanned++;
 
 		/* Wrong page on list?! (list corruption, should not happen) */
 		if (!PageActive(page)) {
 			printk("VM: refill_inactive, wrong page on list.\n");
 			list_del(page_lru);
-			nr_active_pages--;
+			zone->active_pages--;
 			continue;
 		}
 
-		/* Do aging on the pages. */
-		if (PageTestandClearReferenced(page)) {
+		/* Do aging on the pages, the ptes tell us about mapped ones. */
+		if (PageTestandClearReferenced(page) || page_referenced(page)) {
 			age_page_up_nolock(page);	//如果最近被访问了，增加页面的寿命
 			page_active = 1;
 		} else {
@@ -779,9 +495,10 @@ int refill_inactive_scan(unsigned int priority, int oneshot)
 			 * inactive_dirty list and back again...
 			 *
 			 * SUBTLE: we can have buffer pages with count 1.
+			 * Mapped pages are unmapped by page_launder().
 			 */
-			if (page->age == 0 && page_count(page) <=
-						(page->buffers ? 2 : 1)) {
+			if (page->age == 0 && (page->pte_chain ||
+				page_count(page) <= (page->buffers ? 2 : 1))) {
 				deactivate_page_nolock(page);
 				page_active = 0;
 			} else {
@@ -796,14 +513,56 @@ int refill_inactive_scan(unsigned int priority, int oneshot)
 		if (page_active || PageActive(page)) {
 			//移动到active lru 队列的后边
 			list_del(page_lru);
-			list_add(page_lru, &active_list);
+			list_add(page_lru, &zone->active_list);
+			stat->rotated++;
 		} else {
+			stat->reclaimed++;
 			ret = 1;
 			if (oneshot)
 				break;
 		}
 	}
-	spin_unlock(&pagemap_lru_lock);
+	spin_unlock(&zone->lru_lock);
+
+	return ret;
+}
+
+/**
+ * refill_inactive_scan - scan the active list and find pages to deactivate
+ *                      - 扫描active 链表，将页面移到deactivate 中
+ * @priority: the priority at which to scan
+ * @oneshot: exit after deactivating one page
+ *
+ * This function will scan a portion of the active list of every zone
+ * to find unused pages, those pages will then be moved to the inactive
+ * list. A oneshot scan starts with the zone that has the most active
+ * pages.
+ */
+int refill_inactive_scan(unsigned int priority, int oneshot)
+{
+	pg_data_t *pgdat;
+	zone_t *zone, *busiest = NULL;
+	int ret = 0;
+
+	if (oneshot) {
+		for (pgdat = pgdat_list; pgdat; pgdat = pgdat->node_next)
+			for (zone = pgdat->node_zones; zone < pgdat->node_zones + MAX_NR_ZONES; zone++)
+				if (!busiest || zone->active_pages > busiest->active_pages)
+					busiest = zone;
+		if (busiest && refill_inactive_scan_zone(busiest, priority, 1))
+			return 1;
+	}
+
+	for (pgdat = pgdat_list; pgdat; pgdat = pgdat->node_next)
+		for (zone = pgdat->node_zones; zone < pgdat->node_zones + MAX_NR_ZONES; zone++) {
+			if (zone == busiest)
+				continue;
+			if (refill_inactive_scan_zone(zone, priority, oneshot)) {
+				ret = 1;
+				if (oneshot)
+					return ret;
+			}
+		}
 
 	return ret;	//成功将页面从从active移动到inactive_dirty中返回1
 }
@@ -860,7 +619,7 @@ int inactive_shortage(void)
 	//减去当前满足条件的页面数
 	shortage -= nr_free_pages();
 	shortage -= nr_inactive_clean_pages();
-	shortage -= nr_inactive_dirty_pages;
+	shortage -= nr_inactive_dirty_pages();
 
 	//如果大于0 表示当前满足条件的小于期望
 	if (shortage > 0)
@@ -869,6 +628,157 @@ int inactive_shortage(void)
 	return 0;
 }
 
+/*
+ * /proc/lrustat: the page lists of every zone, and what the reclaim
+ * code did with them. "reclaimed" are the pages deactivated from the
+ * active list, cleaned or freed from the inactive_dirty list and
+ * freed from the inactive_clean list. The counters are read without
+ * the locks.
+ */
+int get_lru_stats(char *page)
+{
+	static char *list_names[NR_LRU_LISTS] = {
+		"active", "inactive_dirty", "inactive_clean"
+	};
+	pg_data_t *pgdat;
+	zone_t *zone;
+	int len, i;
+
+	len = sprintf(page, "%-4s %-8s %-15s %8s %10s %10s %10s %10s\n",
+		      "node", "zone", "list", "pages", "scanned", "rotated",
+		      "reclaimed", "written");
+	for (pgdat = pgdat_list; pgdat; pgdat = pgdat->node_next)
+		for (zone = pgdat->node_zones; zone < pgdat->node_zones + MAX_NR_ZONES; zone++) {
+			unsigned long pages[NR_LRU_LISTS];
+
+			if (!zone->size)
+				continue;
+			pages[LRU_ACTIVE] = zone->active_pages;
+			pages[LRU_INACTIVE_DIRTY] = zone->inactive_dirty_pages;
+			pages[LRU_INACTIVE_CLEAN] = zone->inactive_clean_pages;
+			for (i = 0; i < NR_LRU_LISTS; i++) {
+				struct zone_lru_stat *stat = zone->lru_stat + i;
+
+				len += sprintf(page + len,
+					"%-4d %-8s %-15s %8lu %10lu %10lu %10lu %10lu\n",
+					pgdat->node_id, zone->name, list_names[i],
+					pages[i], stat->scanned, stat->rotated,
+					stat->reclaimed, stat->written);
+			}
+		}
+	return len;
+}
+
+/*
+ * Caches outside the page cache that can give memory back (dentries,
+ * inodes, ...) register a shrinker. Whenever reclaim has scanned part
+ * of the LRU lists, each cache is asked to free the same part of its
+ * freeable objects, scaled by how many seeks it takes to recreate one.
+ */
+struct shrinker {
+	shrinker_t		shrink;
+	int			seeks;		/* seeks to recreate an object */
+	unsigned long		nr;		/* objects still to be freed */
+	struct list_head	list;
+};
+
+#define SHRINK_BATCH	128
+
+static LIST_HEAD(shrinker_list);
+static DECLARE_MUTEX(shrinker_sem);
+
+/**
+ * set_shrinker - register a cache with the reclaim code
+ * @seeks: how expensive an object is to recreate, DEFAULT_SEEKS if unsure
+ * @shrink: the callback, see shrinker_t
+ *
+ * Returns the shrinker to pass to remove_shrinker(), or NULL if out
+ * of memory.
+ */
+struct shrinker * set_shrinker(int seeks, shrinker_t shrink)
+{
+	struct shrinker *shrinker;
+
+	shrinker = kmalloc(sizeof(*shrinker), GFP_KERNEL);
+	if (shrinker) {
+		shrinker->shrink = shrink;
+		shrinker->seeks = seeks;
+		shrinker->nr = 0;
+		down(&shrinker_sem);
+		list_add(&shrinker->list, &shrinker_list);
+		up(&shrinker_sem);
+	}
+	return shrinker;
+}
+
+void remove_shrinker(struct shrinker *shrinker)
+{
+	down(&shrinker_sem);
+	list_del(&shrinker->list);
+	up(&shrinker_sem);
+	kfree(shrinker);
+}
+
+/* Pages looked at by the reclaim code so far, see /proc/lrustat */
+static unsigned long nr_lru_scanned(void)
+{
+	pg_data_t *pgdat;
+	zone_t *zone;
+	unsigned long scanned = 0;
+	int i;
+
+	for (pgdat = pgdat_list; pgdat; pgdat = pgdat->node_next)
+		for (zone = pgdat->node_zones; zone < pgdat->node_zones + MAX_NR_ZONES; zone++)
+			for (i = 0; i < NR_LRU_LISTS; i++)
+				scanned += zone->lru_stat[i].scanned;
+	return scanned;
+}
+
+/*
+ * Ask every registered cache to free its share, after @scanned LRU pages
+ * were looked at. A cache that can't free anything with this @gfp_mask
+ * keeps its share for the next call.
+ */
+static void shrink_slab(unsigned long scanned, unsigned int gfp_mask)
+{
+	unsigned long lru_pages;
+	struct list_head *p;
+
+	if (!scanned)
+		return;
+	if (down_trylock(&shrinker_sem))
+		return;
+
+	lru_pages = nr_active_pages() + nr_inactive_dirty_pages() +
+		nr_inactive_clean_pages() + 1;
+	list_for_each(p, &shrinker_list) {
+		struct shrinker *shrinker = list_entry(p, struct shrinker, list);
+		unsigned long long delta;
+		int objects;
+
+		objects = (*shrinker->shrink)(0, gfp_mask);
+		if (objects <= 0)
+			continue;
+		delta = (unsigned long long) (4 * scanned / shrinker->seeks) * objects;
+		do_div(delta, lru_pages);
+		shrinker->nr += (unsigned long) delta;
+		/* don't let a cache that couldn't shrink save up too much */
+		if (shrinker->nr > 2 * objects)
+			shrinker->nr = 2 * objects;
+
+		while (shrinker->nr >= SHRINK_BATCH) {
+			if ((*shrinker->shrink)(SHRINK_BATCH, gfp_mask) < 0)
+				break;
+			shrinker->nr -= SHRINK_BATCH;
+			if (current->need_resched) {
+				__set_current_state(TASK_RUNNING);
+				schedule();
+			}
+		}
+	}
+	up(&shrinker_sem);
+}
+
 /*
  * We need to make the locks finer granularity, but right
  * now we need this so that we can do page allocations
@@ -899,6 +809,8 @@ static int refill_inactive(unsigned int gfp_mask, int user)
 
 	priority = 6;
 	do {
+		unsigned long scanned = nr_lru_scanned();
+
 		made_progress = 0;
 
 		//为了防止长时间占用CPU不放，强制调度
@@ -915,22 +827,10 @@ static int refill_inactive(unsigned int gfp_mask, int user)
 		}
 
 		/*
-		 * don't be too light against the d/i cache since
-	   	 * refill_inactive() almost never fail when there's
-	   	 * really plenty of memory free. 
+		 * Shrink the dentry, inode, ... caches as hard as
+		 * we just scanned the page cache.
 		 */
-		shrink_dcache_memory(priority, gfp_mask);
-		shrink_icache_memory(priority, gfp_mask);
-
-		/*
-		 * Then, try to page stuff out..
-		 * 扫描进程映射表，从中找出能够转入不活跃状态的页面.
-		 */
-		while (swap_out(priority, gfp_mask)) {
-			made_progress = 1;
-			if (--count <= 0)
-				goto done;
-		}
+		shrink_slab(nr_lru_scanned() - scanned, gfp_mask);
 
 		/*
 		 * If we either have enough free memory, or if
@@ -964,8 +864,12 @@ done:
 
 static int do_try_to_free_pages(unsigned int gfp_mask, int user)
 {
+	unsigned long scanned = nr_lru_scanned();
 	int ret = 0;
 
+	/* Put the pages this CPU has batched up on the lists first. */
+	lru_add_drain();
+
 	/*
 	 * If we're low on free pages, move pages from the
 	 * inactive_dirty list to the inactive_clean list.
@@ -980,7 +884,7 @@ static int do_try_to_free_pages(unsigned int gfp_mask, int user)
 	 * 通常bdflush 会在我们移动之前就提前将页面清理干净，所
 	 * 以通常这个操作不会太费劲。
 	 */
-	if (free_shortage() || nr_inactive_dirty_pages > nr_free_pages() +
+	if (free_shortage() || nr_inactive_dirty_pages() > nr_free_pages() +
 			nr_inactive_clean_pages())
 		ret += page_launder(gfp_mask, user);
 
@@ -990,8 +894,7 @@ static int do_try_to_free_pages(unsigned int gfp_mask, int user)
 	 * the inode and dentry cache whenever we do this.
 	 */
 	if (free_shortage() || inactive_shortage()) {
-		shrink_dcache_memory(6, gfp_mask);
-		shrink_icache_memory(6, gfp_mask);
+		shrink_slab(nr_lru_scanned() - scanned, gfp_mask);
 		ret += refill_inactive(gfp_mask, user);
 	} else {
 		/*
@@ -1029,8 +932,7 @@ int kswapd(void *unused)
 {
 	struct task_struct *tsk = current;
 
-	tsk->session = 1;
-	tsk->pgrp = 1;
+	change_pids(tsk, 1, 1);
 	strcpy(tsk->comm, "kswapd");
 	sigfillset(&tsk->blocked);	//屏蔽所有信号
 	kswapd_task = tsk;		//设置全局变量
@@ -1182,8 +1084,7 @@ int kreclaimd(void *unused)
 	struct task_struct *tsk = current;
 	pg_data_t *pgdat;
 
-	tsk->session = 1;
-	tsk->pgrp = 1;
+	change_pids(tsk, 1, 1);
 	strcpy(tsk->comm, "kreclaimd");
 	sigfillset(&tsk->blocked);
 	current->flags |= PF_MEMALLOC;
@@ -1220,7 +1121,8 @@ int kreclaimd(void *unused)
 					page = reclaim_page(zone);
 					if (!page)
 						break;
-					__free_page(page);	//将page放回到zone中的free_area{}中
+					/* it sat on the inactive list, it is cold */
+					free_cold_page(page);	//将page放回到zone中的free_area{}中
 				}
 			}
 			pgdat = pgdat->node_next;
@@ -1185,18 +1185,18 @@ static int deliver_to_old_ones(struct packet_type *pt, struct sk_buff *skb, int
 	}
 
 	/* The assumption (correct one) is that old protocols
-	   did not depened on BHs different of NET_BH and TIMER_BH.
+	   did not depened on BHs different of NET_BH and timers.
 	 */
 
 	/* Emulate NET_BH with special spinlock */
 	spin_lock(&net_bh_lock);
 
-	/* Disable timers and wait for all timers completion */
-	tasklet_disable(bh_task_vec+TIMER_BH);
+	/* Wait for all timer handlers and keep them off meanwhile */
+	block_timers();
 
 	ret = pt->func(skb, skb->dev, pt);
 
-	tasklet_enable(bh_task_vec+TIMER_BH);
+	unblock_timers();
 	spin_unlock(&net_bh_lock);
 	return ret;
 }
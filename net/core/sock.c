@@ -1083,8 +1083,13 @@ void sock_def_error_report(struct sock *sk)
 void sock_def_readable(struct sock *sk, int len)
 {
 	read_lock(&sk->callback_lock);
+	/*
+	 * Exclusive waiters (accept()) are woken CPU-affine: the
+	 * data or connection they are after is hot in this CPU's
+	 * cache.
+	 */
 	if (sk->sleep && waitqueue_active(sk->sleep))
-		wake_up_interruptible(sk->sleep);
+		wake_up_interruptible_affine(sk->sleep);
 	sk_wake_async(sk,1,POLL_IN);
 	read_unlock(&sk->callback_lock);
 }
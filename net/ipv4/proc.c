@@ -49,6 +49,7 @@
 #include <linux/skbuff.h>
 #include <net/sock.h>
 #include <net/raw.h>
+#include <linux/percpu_stat.h>
 
 static int fold_prot_inuse(struct proto *proto)
 {
@@ -98,16 +99,7 @@ int afinet_get_info(char *buffer, char **start, off_t offset, int length)
 
 static unsigned long fold_field(unsigned long *begin, int sz, int nr)
 {
-	unsigned long res = 0;
-	int i;
-
-	sz /= sizeof(unsigned long);
-
-	for (i=0; i<smp_num_cpus; i++) {
-		res += begin[2*cpu_logical_map(i)*sz + nr];
-		res += begin[(2*cpu_logical_map(i)+1)*sz + nr];
-	}
-	return res;
+	return percpu_stat_fold(begin, sz, 2, nr);
 }
 
 /* 
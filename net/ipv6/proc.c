@@ -25,6 +25,7 @@
 #include <net/tcp.h>
 #include <net/transp_v6.h>
 #include <net/ipv6.h>
+#include <linux/percpu_stat.h>
 
 static int fold_prot_inuse(struct proto *proto)
 {
@@ -137,15 +138,7 @@ struct snmp6_item
 
 static unsigned long fold_field(unsigned long *ptr, int size)
 {
-	unsigned long res = 0;
-	int i;
-
-	for (i=0; i<smp_num_cpus; i++) {
-		res += ptr[2*cpu_logical_map(i)*size];
-		res += ptr[(2*cpu_logical_map(i)+1)*size];
-	}
-
-	return res;
+	return percpu_stat_fold(ptr, size*sizeof(unsigned long), 2, 0);
 }
 
 int afinet6_get_snmp(char *buffer, char **start, off_t offset, int length)
@@ -653,20 +653,17 @@ static ssize_t sock_writev(struct file *file, const struct iovec *vector,
 /*
  *	With an ioctl arg may well be a user mode pointer, but we don't know what to do
  *	with it - that's up to the protocol still.
+ *
+ *	No kernel lock held: sys_ioctl() leaves sockets alone.
  */
 
 int sock_ioctl(struct inode *inode, struct file *file, unsigned int cmd,
 	   unsigned long arg)
 {
 	struct socket *sock;
-	int err;
 
-	unlock_kernel();
 	sock = socki_lookup(inode);
-	err = sock->ops->ioctl(sock, cmd, arg);
-	lock_kernel();
-
-	return err;
+	return sock->ops->ioctl(sock, cmd, arg);
 }
 
 
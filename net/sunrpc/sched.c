@@ -1068,8 +1068,7 @@ rpciod(void *ptr)
 	recalc_sigpending(current);
 	spin_unlock_irq(&current->sigmask_lock);
 
-	current->session = 1;
-	current->pgrp = 1;
+	change_pids(current, 1, 1);
 	strcpy(current->comm, "rpciod");
 
 	dprintk("RPC: rpciod starting (pid %d)\n", rpciod_pid);